@@ -310,6 +310,42 @@ namespace ConfigurationHelper {
 	 */
 	SALSA_CONF_API bool configKeysLessThan(const QString& s1, const QString& s2);
 
+	/**
+	 * \brief Returns the canonical form of a group or property name
+	 *
+	 * If the name has a number after the colon, the number is written
+	 * without leading zeros, so that names that are considered equal by
+	 * configKeysEqual() have the same canonical form. This is used to
+	 * index names in hash tables (see ConfigurationSnapshot)
+	 * \param key the group or property name
+	 * \return the canonical form of key
+	 */
+	SALSA_CONF_API QString canonicalConfigKey(const QString& key);
+
+	/**
+	 * \brief Converts a string to double, also accepting infinite values
+	 *
+	 * Infinite values can be specified as "inf", "+inf" or "-inf"
+	 * \param str the string to convert
+	 * \param ok if not nullptr, this is set to true if the conversion was
+	 *           successful, to false otherwise
+	 * \return the converted value
+	 */
+	SALSA_CONF_API double stringToDoubleAcceptingInfinite(const QString& str, bool* ok = nullptr);
+
+	/**
+	 * \brief Converts a string to bool
+	 *
+	 * The string must already be lowercase and without leading and
+	 * trailing spaces. Valid values are "t", "true" and "1" for true and
+	 * "f", "false" and "0" for false
+	 * \param str the string to convert
+	 * \param ok if not nullptr, this is set to true if the conversion was
+	 *           successful, to false otherwise
+	 * \return the converted value (false if the conversion failed)
+	 */
+	SALSA_CONF_API bool stringToBool(const QString& str, bool* ok = nullptr);
+
 	/**
 	 * \brief A utility function to ease throwing the exception
 	 *        UserDefinedCheckFailureException
@@ -35,6 +35,7 @@
 #include <QMutex>
 #include "parametersfileloadersaver.h"
 #include "configurationnode.h"
+#include "configurationsnapshot.h"
 
 namespace salsa {
 
@@ -233,7 +234,9 @@ class ResourceChangeNotifee;
  * safe to share the same ConfigurationManager object between objects in
  * different threads. Refer to the documentation of the Component class for more
  * information on multithreading and ConfigurationManager (in particular
- * regarding resources)
+ * regarding resources). Functions reading parameters and groups do not lock:
+ * they use an immutable snapshot of the configuration tree (see getSnapshot()),
+ * which is created again the first time parameters are read after a change
  *
  * \note All functions throw exceptions in case of errors (e.g. missing
  *       parameters or groups, invalid names...). See the description of
@@ -701,6 +704,19 @@ public:
 	 */
 	QStringList getFilteredParametersList(QString group, QRegExp filter) const;
 
+	/**
+	 * \brief Returns an immutable snapshot of the configuration parameters
+	 *
+	 * The snapshot reflects the parameters at the time of the call and can
+	 * be read concurrently without locking. Functions modifying parameters
+	 * or groups discard the current snapshot, a new one is created by the
+	 * first call to this function after the change. Typed values are
+	 * converted once, when the snapshot is created (see
+	 * ConfigurationSnapshot)
+	 * \return the current snapshot
+	 */
+	std::shared_ptr<const ConfigurationSnapshot> getSnapshot() const;
+
 	/**
 	 * \brief Returns the object for the given group, creating it if it
 	 *        doesn't exist
@@ -792,6 +808,10 @@ private:
 	// prefix of the group from which the object is being created
 	QString getPrefixForCurrentComponent();
 
+	// Discards the current snapshot. This must be called with the mutex
+	// locked before modifying the tree of parameters
+	void invalidateSnapshot();
+
 	// Recursively destroys all components associated to nodes. The
 	// components in parent nodes are destroyed first
 	void recursivelyDestroyComponents(ConfigurationNode* node);
@@ -854,6 +874,7 @@ private:
 			: QSharedData()
 			, mutex(QMutex::Recursive)
 			, root()
+			, snapshot()
 			, getComponentFromGroupRecursionLevel(0)
 			, componentsToConfigure()
 			, componentsConfiguredNotInitialized()
@@ -875,6 +896,13 @@ private:
 		// The root of the tree with configuration parameters
 		std::unique_ptr<ConfigurationNode> root;
 
+		// The snapshot of the tree of parameters used by read
+		// functions. This is nullptr if the tree has changed since the
+		// snapshot was created. It must only be accessed with
+		// std::atomic_load and std::atomic_store and it is only
+		// written with the mutex locked
+		std::shared_ptr<const ConfigurationSnapshot> snapshot;
+
 		// The level of recursion for calls to getComponentFromGroup.
 		// This is incremented every time the getComponentFromGroup
 		// starts its execution and decremented on function exit
@@ -0,0 +1,193 @@
+/***************************************************************************
+ *  SALSA Configuration Library                                            *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#ifndef CONFIGURATION_SNAPSHOT_H
+#define CONFIGURATION_SNAPSHOT_H
+
+#include "configurationconfig.h"
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+namespace salsa {
+
+class ConfigurationNode;
+
+/**
+ * \brief An immutable copy of a tree of configuration parameters
+ *
+ * The snapshot stores groups and parameters in hash tables indexed by their
+ * full path, so that looking up a parameter does not require walking the
+ * tree. Values are also converted to int, real and bool once, when the
+ * snapshot is created. As a snapshot is never modified after creation, it
+ * can be read concurrently from multiple threads without locking.
+ * ConfigurationManager creates a new snapshot when it is read after being
+ * modified (see ConfigurationManager::getSnapshot()).
+ *
+ * Paths have the same syntax used by ConfigurationManager, including
+ * references to parent groups. Group and parameter names are compared as
+ * explained in the documentation of ConfigurationManager (see
+ * ConfigurationHelper::canonicalConfigKey())
+ *
+ * \internal
+ */
+class SALSA_CONF_API ConfigurationSnapshot
+{
+public:
+	/**
+	 * \brief The value of a parameter and its conversions
+	 *
+	 * Conversions are performed on the value converted to lowercase and
+	 * with leading and trailing whitespaces removed, as done by the
+	 * functions in ConfigurationHelper
+	 */
+	struct Value
+	{
+		/**
+		 * \brief The value of the parameter
+		 */
+		QString string;
+
+		/**
+		 * \brief Whether the value could be converted to int
+		 */
+		bool intValid;
+
+		/**
+		 * \brief The value converted to int (0 if intValid is false)
+		 */
+		int intValue;
+
+		/**
+		 * \brief Whether the value could be converted to a real number
+		 */
+		bool realValid;
+
+		/**
+		 * \brief The value converted to a real number
+		 */
+		double realValue;
+
+		/**
+		 * \brief Whether the value could be converted to bool
+		 */
+		bool boolValid;
+
+		/**
+		 * \brief The value converted to bool
+		 */
+		bool boolValue;
+	};
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * Copies the whole tree starting from root
+	 * \param root the root of the tree to copy
+	 */
+	ConfigurationSnapshot(const ConfigurationNode* root);
+
+	/**
+	 * \brief Returns true if the group exists
+	 *
+	 * \param groupPath the path of the group
+	 * \return true if the group exists
+	 */
+	bool groupExists(QString groupPath) const;
+
+	/**
+	 * \brief Returns the value of a parameter
+	 *
+	 * \param path the path of the parameter
+	 * \return the value of the parameter or nullptr if the parameter or one
+	 *         of the groups in the path do not exist. The pointer is valid
+	 *         as long as this object exists
+	 */
+	const Value* getValue(QString path) const;
+
+	/**
+	 * \brief Returns the value of a parameter, searching the parameter also
+	 *        in parent groups
+	 *
+	 * \param path the path of the parameter
+	 * \return the value of the parameter or nullptr if the parameter is not
+	 *         found or one of the groups in the path do not exist. The
+	 *         pointer is valid as long as this object exists
+	 */
+	const Value* getValueAlsoMatchParents(QString path) const;
+
+	/**
+	 * \brief Returns the list of subgroups of a group
+	 *
+	 * \param group the path of the group
+	 * \return the list of names of subgroups or nullptr if the group does
+	 *         not exist. The pointer is valid as long as this object exists
+	 */
+	const QStringList* getGroupsList(QString group) const;
+
+	/**
+	 * \brief Returns the list of parameters of a group
+	 *
+	 * \param group the path of the group
+	 * \return the list of names of parameters or nullptr if the group does
+	 *         not exist. The pointer is valid as long as this object exists
+	 */
+	const QStringList* getParametersList(QString group) const;
+
+private:
+	// The lists of subgroups and parameters of a group. The order is the
+	// same as in the tree
+	struct Group
+	{
+		QStringList groups;
+		QStringList parameters;
+	};
+
+	// Adds node and its descendants. path is the canonical path of node
+	void addNode(const ConfigurationNode* node, const QString& path);
+
+	// Returns the canonical path of a group, resolving references to
+	// parent groups. Returns false if the group does not exist
+	bool canonicalGroupPath(const QString& path, QString& canonicalPath) const;
+
+	// Returns the key of the element in the given group
+	static QString elementKey(const QString& canonicalGroup, const QString& element);
+
+	// Groups, indexed by their canonical path. The main group has the
+	// empty string as path
+	QHash<QString, Group> m_groups;
+
+	// Parameters, indexed by their canonical path
+	QHash<QString, Value> m_values;
+
+private:
+	// Copy constructor. Here to prevent usage
+	ConfigurationSnapshot(const ConfigurationSnapshot& other);
+
+	// Copy operator. Here to prevent usage
+	ConfigurationSnapshot& operator=(const ConfigurationSnapshot& other);
+};
+
+} // end namespace salsa
+
+#endif
@@ -40,45 +40,6 @@ namespace ConfigurationHelper {
 
 // Anonymous namespace with helper functions
 namespace {
-	double stringToDoubleAcceptingInfinite(const QString& str, bool* ok)
-	{
-		if (ok != nullptr) {
-			*ok = true;
-		}
-
-		bool internalOk;
-		double d = str.toDouble(&internalOk);
-		if (!internalOk) {
-			QString trimmedStr = str.trimmed();
-			if ((trimmedStr == "+inf") || (trimmedStr == "inf")) {
-				d = +Infinity;
-			} else if (trimmedStr == "-inf") {
-				d = -Infinity;
-			} else {
-				if (ok != nullptr) {
-					*ok = false;
-				}
-			}
-		}
-
-		return d;
-	}
-
-	bool boolToString(QString paramPath, QString value)
-	{
-		bool retVal;
-
-		if ((value == "t") || (value == "true") || (value == "1")) {
-			retVal = true;
-		} else if ((value == "f") || (value == "false") || (value == "0")) {
-			retVal = false;
-		} else {
-			throw CannotConvertParameterValueToTypeException(paramPath.toLatin1().data(), "bool");
-		}
-
-		return retVal;
-	}
-
 	template <class T>
 	const T& getTypedDescriptorForParameter(const ConfigurationManager& params, QString paramPath)
 	{
@@ -96,6 +57,49 @@ namespace {
 	}
 }
 
+double stringToDoubleAcceptingInfinite(const QString& str, bool* ok)
+{
+	if (ok != nullptr) {
+		*ok = true;
+	}
+
+	bool internalOk;
+	double d = str.toDouble(&internalOk);
+	if (!internalOk) {
+		QString trimmedStr = str.trimmed();
+		if ((trimmedStr == "+inf") || (trimmedStr == "inf")) {
+			d = +Infinity;
+		} else if (trimmedStr == "-inf") {
+			d = -Infinity;
+		} else {
+			if (ok != nullptr) {
+				*ok = false;
+			}
+		}
+	}
+
+	return d;
+}
+
+bool stringToBool(const QString& str, bool* ok)
+{
+	if (ok != nullptr) {
+		*ok = true;
+	}
+
+	if ((str == "t") || (str == "true") || (str == "1")) {
+		return true;
+	} else if ((str == "f") || (str == "false") || (str == "0")) {
+		return false;
+	}
+
+	if (ok != nullptr) {
+		*ok = false;
+	}
+
+	return false;
+}
+
 #warning ====================== SEMPLIFICARE QUESTE FUNZIONI USANDO I NUOVI DESCRIPTORS!!! ======================
 
 int getInt(const ConfigurationManager& params, QString paramPath)
@@ -113,18 +117,18 @@ int getInt(const ConfigurationManager& params, QString paramPath)
 
 int getInt(const ConfigurationManager& params, QString paramPath, int defaultValue)
 {
-	if (!params.parameterExists(paramPath)) {
+	// Using the snapshot, values have already been converted
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = params.getSnapshot();
+	const ConfigurationSnapshot::Value* value = snapshot->getValue(paramPath);
+	if (value == nullptr) {
 		return defaultValue;
 	}
 
-	const QString value = params.getValue(paramPath).toLower().trimmed();
-	bool ok;
-	const int valueInt = value.toInt(&ok);
-	if (!ok) {
+	if (!value->intValid) {
 		CannotConvertParameterValueToTypeException(paramPath.toLatin1().data(), "int");
 	}
 
-	return valueInt;
+	return value->intValue;
 }
 
 double getReal(const ConfigurationManager& params, QString paramPath)
@@ -142,18 +146,18 @@ double getReal(const ConfigurationManager& params, QString paramPath)
 
 double getReal(const ConfigurationManager& params, QString paramPath, double defaultValue)
 {
-	if (!params.parameterExists(paramPath)) {
+	// Using the snapshot, values have already been converted
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = params.getSnapshot();
+	const ConfigurationSnapshot::Value* value = snapshot->getValue(paramPath);
+	if (value == nullptr) {
 		return defaultValue;
 	}
 
-	const QString value = params.getValue(paramPath).toLower().trimmed();
-	bool ok;
-	double valueDouble = stringToDoubleAcceptingInfinite(value, &ok);
-	if (!ok) {
+	if (!value->realValid) {
 		throw CannotConvertParameterValueToTypeException(paramPath.toLatin1().data(), "real");
 	}
 
-	return valueDouble;
+	return value->realValue;
 }
 
 bool getBool(const ConfigurationManager& params, QString paramPath)
@@ -165,13 +169,18 @@ bool getBool(const ConfigurationManager& params, QString paramPath)
 
 bool getBool(const ConfigurationManager& params, QString paramPath, bool defaultValue)
 {
-	if (!params.parameterExists(paramPath)) {
+	// Using the snapshot, values have already been converted
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = params.getSnapshot();
+	const ConfigurationSnapshot::Value* value = snapshot->getValue(paramPath);
+	if (value == nullptr) {
 		return defaultValue;
 	}
 
-	const QString value = params.getValue(paramPath).toLower().trimmed();
+	if (!value->boolValid) {
+		throw CannotConvertParameterValueToTypeException(paramPath.toLatin1().data(), "bool");
+	}
 
-	return boolToString(paramPath, value);
+	return value->boolValue;
 }
 
 QString getString(const ConfigurationManager& params, QString paramPath)
@@ -183,11 +192,10 @@ QString getString(const ConfigurationManager& params, QString paramPath)
 
 QString getString(const ConfigurationManager& params, QString paramPath, QString defaultValue)
 {
-	if (params.parameterExists(paramPath)) {
-		return params.getValue(paramPath);
-	} else {
-		return defaultValue;
-	}
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = params.getSnapshot();
+	const ConfigurationSnapshot::Value* value = snapshot->getValue(paramPath);
+
+	return (value == nullptr) ? defaultValue : value->string;
 }
 
 QString getEnum(const ConfigurationManager& params, QString paramPath)
@@ -211,11 +219,10 @@ QString getEnum(const ConfigurationManager& params, QString paramPath)
 
 QString getEnum(const ConfigurationManager& params, QString paramPath, QString defaultValue)
 {
-	if (params.parameterExists(paramPath)) {
-		return params.getValue(paramPath);
-	} else {
-		return defaultValue;
-	}
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = params.getSnapshot();
+	const ConfigurationSnapshot::Value* value = snapshot->getValue(paramPath);
+
+	return (value == nullptr) ? defaultValue : value->string;
 }
 
 QString encodeListOfInts(const QVector<int>& list)
@@ -477,6 +484,20 @@ bool configKeysLessThan(const QString& s1, const QString& s2)
 	}
 }
 
+QString canonicalConfigKey(const QString& key)
+{
+	const int colonPos = key.indexOf(':');
+	if (colonPos == -1) {
+		return key;
+	}
+
+	// Replacing the number after the colon with its canonical representation, if present
+	bool numberAfterColonPresent;
+	const unsigned int numberAfterColon = key.midRef(colonPos + 1).toUInt(&numberAfterColonPresent);
+
+	return numberAfterColonPresent ? (key.left(colonPos + 1) + QString::number(numberAfterColon)) : key;
+}
+
 void throwUserConfigError(QString paramName, QString paramValue, QString description)
 {
 	throw UserDefinedCheckFailureException(paramName.toLatin1().data(), paramValue.toLatin1().data(), description.toLatin1().data());
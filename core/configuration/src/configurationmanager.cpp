@@ -28,6 +28,7 @@
 #include <QFileInfo>
 #include <QQueue>
 #include <QMutexLocker>
+#include <atomic>
 #include <memory>
 
 
@@ -142,6 +143,7 @@ void ConfigurationManager::clearAll()
 	QMutexLocker locker(&(m_shared->mutex));
 
 	destroyAllComponents();
+	invalidateSnapshot();
 	m_shared->root->clearAll();
 }
 
@@ -176,6 +178,13 @@ ConfigurationManager* ConfigurationManager::createDeepCopy(ConfigurationManager*
 
 QStringList ConfigurationManager::getGroupsList(QString group) const
 {
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = getSnapshot();
+	const QStringList* groups = snapshot->getGroupsList(group);
+	if (groups != nullptr) {
+		return *groups;
+	}
+
+	// The group does not exist, using the tree to throw the appropriate exception
 	QMutexLocker locker(&(m_shared->mutex));
 
 	return m_shared->root->getNode(group)->getChildrenNamesList();
@@ -193,15 +202,17 @@ QStringList ConfigurationManager::getGroupsWithPrefixList(QString group, QString
 
 QStringList ConfigurationManager::getFilteredGroupsList(QString group, QRegExp filter) const
 {
-	QMutexLocker locker(&(m_shared->mutex));
+	// No need to lock, we call the other function here
 
-	return m_shared->root->getNode(group)->getFilteredChildrenNamesList(filter);
+	return getGroupsList(group).filter(filter);
 }
 
 void ConfigurationManager::createGroup(QString groupPath)
 {
 	QMutexLocker locker(&(m_shared->mutex));
 
+	invalidateSnapshot();
+
 	// Splitting path
 	QStringList splittedPath = groupPath.split(GroupSeparator, QString::SkipEmptyParts, Qt::CaseSensitive);
 	if (splittedPath.isEmpty()) {
@@ -230,15 +241,17 @@ QString ConfigurationManager::createSubGroup(QString parentPath, QString groupNa
 
 bool ConfigurationManager::groupExists(QString groupPath) const
 {
-	QMutexLocker locker(&(m_shared->mutex));
+	// Not locking, using the snapshot
 
-	return m_shared->root->isPathValid(groupPath);
+	return getSnapshot()->groupExists(groupPath);
 }
 
 void ConfigurationManager::deleteGroup(QString groupPath)
 {
 	QMutexLocker locker(&(m_shared->mutex));
 
+	invalidateSnapshot();
+
 	// Extract the group name and the path
 	ConfigurationNode::ElementAndPath ep = ConfigurationNode::separateLastElement(groupPath);
 
@@ -249,6 +262,8 @@ void ConfigurationManager::renameGroup(QString oldGroupPath, QString newGroupNam
 {
 	QMutexLocker locker(&(m_shared->mutex));
 
+	invalidateSnapshot();
+
 	// Extract the group name and the path
 	ConfigurationNode::ElementAndPath ep = ConfigurationNode::separateLastElement(oldGroupPath);
 
@@ -259,6 +274,8 @@ void ConfigurationManager::copyGroup(QString sourceGroup, QString destGroup)
 {
 	QMutexLocker locker(&(m_shared->mutex));
 
+	invalidateSnapshot();
+
 	ConfigurationNode::ElementAndPath ep = ConfigurationNode::separateLastElement(destGroup);
 	createGroup(ep.elementPath);
 
@@ -270,6 +287,8 @@ void ConfigurationManager::createParameter(QString groupPath, QString parameter)
 {
 	QMutexLocker locker(&(m_shared->mutex));
 
+	invalidateSnapshot();
+
 	ConfigurationNode* node = m_shared->root->getNode(groupPath);
 	node->addParameter(parameter);
 }
@@ -284,27 +303,30 @@ void ConfigurationManager::createParameter(QString groupPath, QString parameter,
 
 bool ConfigurationManager::parameterExists(QString path) const
 {
-	QMutexLocker locker(&(m_shared->mutex));
-
-	// Extract the group name and the parameter
-	ConfigurationNode::ElementAndPath ep = ConfigurationNode::separateLastElement(path);
-	if (groupExists(ep.elementPath)) {
-		return m_shared->root->getNode(ep.elementPath)->parameterExists(ep.element);
-	}
+	// Not locking, using the snapshot
 
-	return false;
+	return (getSnapshot()->getValue(path) != nullptr);
 }
 
 void ConfigurationManager::deleteParameter(QString groupPath, QString parameter)
 {
 	QMutexLocker locker(&(m_shared->mutex));
 
+	invalidateSnapshot();
+
 	ConfigurationNode* node = m_shared->root->getNode(groupPath);
 	node->deleteParameter(parameter);
 }
 
 QString ConfigurationManager::getValue(QString path) const
 {
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = getSnapshot();
+	const ConfigurationSnapshot::Value* value = snapshot->getValue(path);
+	if (value != nullptr) {
+		return value->string;
+	}
+
+	// The parameter does not exist, using the tree to throw the appropriate exception
 	QMutexLocker locker(&(m_shared->mutex));
 
 	return m_shared->root->getValue(path);
@@ -312,6 +334,13 @@ QString ConfigurationManager::getValue(QString path) const
 
 QString ConfigurationManager::getValueAlsoMatchParents(QString path) const
 {
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = getSnapshot();
+	const ConfigurationSnapshot::Value* value = snapshot->getValueAlsoMatchParents(path);
+	if (value != nullptr) {
+		return value->string;
+	}
+
+	// The parameter does not exist, using the tree to throw the appropriate exception
 	QMutexLocker locker(&(m_shared->mutex));
 
 	return m_shared->root->getValueAlsoMatchParents(path);
@@ -321,11 +350,20 @@ void ConfigurationManager::setValue(QString path, QString value)
 {
 	QMutexLocker locker(&(m_shared->mutex));
 
+	invalidateSnapshot();
+
 	m_shared->root->setValue(path, value);
 }
 
 QStringList ConfigurationManager::getParametersList(QString group) const
 {
+	const std::shared_ptr<const ConfigurationSnapshot> snapshot = getSnapshot();
+	const QStringList* parameters = snapshot->getParametersList(group);
+	if (parameters != nullptr) {
+		return *parameters;
+	}
+
+	// The group does not exist, using the tree to throw the appropriate exception
 	QMutexLocker locker(&(m_shared->mutex));
 
 	return m_shared->root->getNode(group)->getParametersList();
@@ -343,9 +381,28 @@ QStringList ConfigurationManager::getParametersWithPrefixList(QString group, QSt
 
 QStringList ConfigurationManager::getFilteredParametersList(QString group, QRegExp filter) const
 {
+	// No need to lock, we call the other function here
+
+	return getParametersList(group).filter(filter);
+}
+
+std::shared_ptr<const ConfigurationSnapshot> ConfigurationManager::getSnapshot() const
+{
+	std::shared_ptr<const ConfigurationSnapshot> snapshot = std::atomic_load(&(m_shared->snapshot));
+	if (snapshot) {
+		return snapshot;
+	}
+
 	QMutexLocker locker(&(m_shared->mutex));
 
-	return m_shared->root->getNode(group)->getFilteredParametersList(filter);
+	// Checking again, another thread could have created the snapshot while we were waiting
+	snapshot = std::atomic_load(&(m_shared->snapshot));
+	if (!snapshot) {
+		snapshot = std::make_shared<const ConfigurationSnapshot>(m_shared->root.get());
+		std::atomic_store(&(m_shared->snapshot), snapshot);
+	}
+
+	return snapshot;
 }
 
 bool ConfigurationManager::loadParameters(QString filename, bool keepOld, QString format)
@@ -489,6 +546,11 @@ QString ConfigurationManager::getPrefixForCurrentComponent()
 	return m_shared->prefixForComponentBeingCreated;
 }
 
+void ConfigurationManager::invalidateSnapshot()
+{
+	std::atomic_store(&(m_shared->snapshot), std::shared_ptr<const ConfigurationSnapshot>());
+}
+
 void ConfigurationManager::recursivelyDestroyComponents(ConfigurationNode* node)
 {
 	ComponentAndStatus o = node->getComponentForNode("");
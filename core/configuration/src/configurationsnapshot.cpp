@@ -0,0 +1,161 @@
+/***************************************************************************
+ *  SALSA Configuration Library                                            *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+
+#include "configurationsnapshot.h"
+#include "configurationnode.h"
+#include "configurationhelper.h"
+#include <QVector>
+
+namespace salsa {
+
+ConfigurationSnapshot::ConfigurationSnapshot(const ConfigurationNode* root)
+	: m_groups()
+	, m_values()
+{
+	addNode(root, QString());
+}
+
+bool ConfigurationSnapshot::groupExists(QString groupPath) const
+{
+	QString canonicalPath;
+
+	return canonicalGroupPath(groupPath, canonicalPath);
+}
+
+const ConfigurationSnapshot::Value* ConfigurationSnapshot::getValue(QString path) const
+{
+	const ConfigurationNode::ElementAndPath ep = ConfigurationNode::separateLastElement(path);
+
+	QString group;
+	if (!canonicalGroupPath(ep.elementPath, group)) {
+		return nullptr;
+	}
+
+	QHash<QString, Value>::const_iterator it = m_values.constFind(elementKey(group, ep.element));
+
+	return (it == m_values.constEnd()) ? nullptr : &(*it);
+}
+
+const ConfigurationSnapshot::Value* ConfigurationSnapshot::getValueAlsoMatchParents(QString path) const
+{
+	const ConfigurationNode::ElementAndPath ep = ConfigurationNode::separateLastElement(path);
+
+	QString group;
+	if (!canonicalGroupPath(ep.elementPath, group)) {
+		return nullptr;
+	}
+
+	// Searching the parameter in the group and then in its ancestors
+	while (true) {
+		QHash<QString, Value>::const_iterator it = m_values.constFind(elementKey(group, ep.element));
+		if (it != m_values.constEnd()) {
+			return &(*it);
+		} else if (group.isEmpty()) {
+			return nullptr;
+		}
+
+		// Moving to the parent group (the main group if there is no separator)
+		group.truncate(qMax(group.lastIndexOf(GroupSeparator), 0));
+	}
+}
+
+const QStringList* ConfigurationSnapshot::getGroupsList(QString group) const
+{
+	QString canonicalPath;
+	if (!canonicalGroupPath(group, canonicalPath)) {
+		return nullptr;
+	}
+
+	return &(m_groups.constFind(canonicalPath)->groups);
+}
+
+const QStringList* ConfigurationSnapshot::getParametersList(QString group) const
+{
+	QString canonicalPath;
+	if (!canonicalGroupPath(group, canonicalPath)) {
+		return nullptr;
+	}
+
+	return &(m_groups.constFind(canonicalPath)->parameters);
+}
+
+void ConfigurationSnapshot::addNode(const ConfigurationNode* node, const QString& path)
+{
+	Group g;
+	g.groups = node->getChildrenNamesList();
+	g.parameters = node->getParametersList();
+
+	// Adding parameters, converting values once here
+	foreach (const QString& p, g.parameters) {
+		Value v;
+		v.string = node->getValue(p);
+
+		const QString normalized = v.string.toLower().trimmed();
+		v.intValue = normalized.toInt(&v.intValid);
+		v.realValue = ConfigurationHelper::stringToDoubleAcceptingInfinite(normalized, &v.realValid);
+		v.boolValue = ConfigurationHelper::stringToBool(normalized, &v.boolValid);
+
+		m_values.insert(elementKey(path, p), v);
+	}
+
+	// Recursively adding subgroups
+	foreach (const QString& c, g.groups) {
+		addNode(node->getNode(c), elementKey(path, c));
+	}
+
+	m_groups.insert(path, g);
+}
+
+bool ConfigurationSnapshot::canonicalGroupPath(const QString& path, QString& canonicalPath) const
+{
+	canonicalPath.clear();
+
+	// The length of canonicalPath before each group was appended, to move back to parent groups
+	QVector<int> lengths;
+	foreach (const QString& g, path.split(GroupSeparator, QString::SkipEmptyParts)) {
+		if (g == ParentGroup) {
+			// The parent of the main group is the main group itself
+			if (!lengths.isEmpty()) {
+				canonicalPath.truncate(lengths.takeLast());
+			}
+		} else {
+			lengths.append(canonicalPath.size());
+			canonicalPath = elementKey(canonicalPath, g);
+
+			if (!m_groups.contains(canonicalPath)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+QString ConfigurationSnapshot::elementKey(const QString& canonicalGroup, const QString& element)
+{
+	const QString key = ConfigurationHelper::canonicalConfigKey(element);
+
+	return canonicalGroup.isEmpty() ? key : (canonicalGroup + GroupSeparator + key);
+}
+
+} // end namespace salsa
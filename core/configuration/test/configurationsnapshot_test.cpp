@@ -0,0 +1,169 @@
+/***************************************************************************
+ *  SALSA Configuration Library                                            *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#include "configurationsnapshot.h"
+#include "configurationnode.h"
+#include "configurationmanager.h"
+#include "configurationhelper.h"
+#include "componentdescriptors.h"
+#include <QtTest/QtTest>
+#include <memory>
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class ConfigurationSnapshot_Test : public QObject
+{
+	Q_OBJECT
+
+	typedef std::unique_ptr<ConfigurationNode> ConfigurationNodeUniquePtr;
+
+	ConfigurationNodeUniquePtr generateTree()
+	{
+		// Indentation reflects the hierarchy of nodes
+		ConfigurationNodeUniquePtr root(new ConfigurationNode("root"));
+		root->addParameter("rootParam");
+		root->setValue("rootParam", "rootValue");
+			ConfigurationNode* one = root->addNode("one");
+			one->addParameter("intParam");
+			one->setValue("intParam", " 17 ");
+			one->addParameter("realParam");
+			one->setValue("realParam", "-inf");
+			one->addParameter("boolParam");
+			one->setValue("boolParam", "True");
+				ConfigurationNode* child = one->addNode("child:1");
+				child->addParameter("stringParam");
+				child->setValue("stringParam", "Some Text");
+			root->addNode("two");
+
+		return root;
+	}
+
+private slots:
+	void groups()
+	{
+		ConfigurationNodeUniquePtr root = generateTree();
+		ConfigurationSnapshot snapshot(root.get());
+
+		QVERIFY(snapshot.groupExists(""));
+		QVERIFY(snapshot.groupExists("one"));
+		QVERIFY(snapshot.groupExists("/one//child:1/"));
+		QVERIFY(snapshot.groupExists("one/child:01"));
+		QVERIFY(snapshot.groupExists("one/child:1/../../two"));
+		QVERIFY(snapshot.groupExists("../one"));
+		QVERIFY(!snapshot.groupExists("three"));
+		QVERIFY(!snapshot.groupExists("three/../one"));
+		QVERIFY(!snapshot.groupExists("one/child:2"));
+	}
+
+	void lists()
+	{
+		ConfigurationNodeUniquePtr root = generateTree();
+		ConfigurationSnapshot snapshot(root.get());
+
+		QVERIFY(snapshot.getGroupsList("three") == nullptr);
+		QVERIFY(snapshot.getParametersList("three") == nullptr);
+		QCOMPARE(*(snapshot.getGroupsList("")), root->getChildrenNamesList());
+		QCOMPARE(*(snapshot.getParametersList("one")), root->getNode("one")->getParametersList());
+		QCOMPARE(*(snapshot.getGroupsList("one/child:1")), QStringList());
+	}
+
+	void values()
+	{
+		ConfigurationNodeUniquePtr root = generateTree();
+		ConfigurationSnapshot snapshot(root.get());
+
+		QVERIFY(snapshot.getValue("nonExistent") == nullptr);
+		QVERIFY(snapshot.getValue("three/intParam") == nullptr);
+		QCOMPARE(snapshot.getValue("rootParam")->string, QString("rootValue"));
+		QCOMPARE(snapshot.getValue("one/child:1/stringParam")->string, QString("Some Text"));
+		QCOMPARE(snapshot.getValue("two/../one/child:001/stringParam")->string, QString("Some Text"));
+
+		const ConfigurationSnapshot::Value* intValue = snapshot.getValue("one/intParam");
+		QCOMPARE(intValue->string, QString(" 17 "));
+		QVERIFY(intValue->intValid);
+		QCOMPARE(intValue->intValue, 17);
+		QVERIFY(intValue->realValid);
+		QCOMPARE(intValue->realValue, 17.0);
+		QVERIFY(!intValue->boolValid);
+
+		const ConfigurationSnapshot::Value* realValue = snapshot.getValue("one/realParam");
+		QVERIFY(!realValue->intValid);
+		QVERIFY(realValue->realValid);
+		QCOMPARE(realValue->realValue, -Infinity);
+
+		const ConfigurationSnapshot::Value* boolValue = snapshot.getValue("one/boolParam");
+		QVERIFY(!boolValue->intValid);
+		QVERIFY(!boolValue->realValid);
+		QVERIFY(boolValue->boolValid);
+		QCOMPARE(boolValue->boolValue, true);
+	}
+
+	void valuesAlsoMatchParents()
+	{
+		ConfigurationNodeUniquePtr root = generateTree();
+		ConfigurationSnapshot snapshot(root.get());
+
+		QCOMPARE(snapshot.getValueAlsoMatchParents("one/child:1/intParam")->string, QString(" 17 "));
+		QCOMPARE(snapshot.getValueAlsoMatchParents("one/child:1/rootParam")->string, QString("rootValue"));
+		QCOMPARE(snapshot.getValueAlsoMatchParents("two/stringParam"), (const ConfigurationSnapshot::Value*) nullptr);
+		QCOMPARE(snapshot.getValueAlsoMatchParents("three/rootParam"), (const ConfigurationSnapshot::Value*) nullptr);
+	}
+
+	void managerSnapshotIsReplacedOnChange()
+	{
+		ConfigurationManager manager;
+		manager.createGroup("group");
+		manager.createParameter("group", "param", "1");
+
+		std::shared_ptr<const ConfigurationSnapshot> first = manager.getSnapshot();
+		QVERIFY(manager.getSnapshot() == first);
+		QCOMPARE(first->getValue("group/param")->intValue, 1);
+
+		manager.setValue("group/param", "2");
+
+		std::shared_ptr<const ConfigurationSnapshot> second = manager.getSnapshot();
+		QVERIFY(second != first);
+		QCOMPARE(first->getValue("group/param")->intValue, 1);
+		QCOMPARE(second->getValue("group/param")->intValue, 2);
+		QCOMPARE(ConfigurationHelper::getInt(manager, "group/param", 0), 2);
+	}
+
+	void canonicalConfigKey()
+	{
+		QCOMPARE(ConfigurationHelper::canonicalConfigKey("group"), QString("group"));
+		QCOMPARE(ConfigurationHelper::canonicalConfigKey("group:007"), QString("group:7"));
+		QCOMPARE(ConfigurationHelper::canonicalConfigKey("group:a"), QString("group:a"));
+		QCOMPARE(ConfigurationHelper::canonicalConfigKey("group:1a"), QString("group:1a"));
+	}
+};
+
+QTEST_MAIN(ConfigurationSnapshot_Test)
+#include "configurationsnapshot_test.moc"
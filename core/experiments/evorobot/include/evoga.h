@@ -36,11 +36,16 @@
 #include <QString>
 #include <QMutex>
 #include <QWaitCondition>
+#include <QThreadStorage>
+#include <QVector>
 
 #include <Eigen/Core>
 
 namespace salsa {
 
+class OutputWriterForEvoga;
+class EvogaFarmMaster;
+
 /*! \brief Genetic algorithm from evorobot more or less (spare parts)
  *
  *  Mandatory Resources that the EvoRobotExperiment has to declare:
@@ -168,6 +173,25 @@ public:
      *  \param mut The mutation probability (i.e. the probability that each bit of the gene is flipped)
      */
     int mutate(int w, double mut);
+    /*! Copy a genome applying mutations
+     *  This gives the same result, on average, as calling mutate() on each gene with the standard or
+     *  the parameter-specific mutation rate, but instead of drawing a random number for each bit it
+     *  draws the distance between consecutive flipped bits from a geometric distribution and flips
+     *  them with XOR masks. The number of random numbers drawn is proportional to the number of
+     *  flipped bits, not to the length of the genome
+     *
+     *  \param from The genome to copy
+     *  \param to The genome receiving the mutated copy (can be the same as from)
+     */
+    void copyAndMutateGenes(const quint8* from, quint8* to);
+    /*! Return the number of bits not flipped before the next flipped one
+     *  The value is drawn from a geometric distribution and never exceeds maxSkip
+     *
+     *  \param logNotFlip The logarithm of the probability that a bit is not flipped (must be negative,
+     *                    -inf if all bits are flipped)
+     *  \param maxSkip The maximum value to return
+     */
+    int geometricSkip(double logNotFlip, int maxSkip);
     /*! Randomize the genome of the population
      *
      */
@@ -205,6 +229,7 @@ public:
     void loadgenotype(FILE *fp, int ind);
     /*! Save the genome of the current population in a G?S?.gen file
      *
+     *  The genomes are copied and the file is written by a background thread (see flushOutput())
      */
     void saveallg();
 
@@ -237,6 +262,7 @@ public:
     void computeFStat2();
     /*! Save the average, minimal and maximal fitness by appending a line to the statS%d.fit file
      *
+     *  The file is written by a background thread (see flushOutput())
      */
     void saveFStat();
     /*! Save the information regarding the offspring retention by appending a line to the retention statistics file (function retentions
@@ -256,11 +282,15 @@ public:
      */
     int loadStatistics(char *filename);
     /*! Return a pointer to the genome of one individual of the current population
+     *  Genes are stored as bytes, so they are expanded in a buffer local to the calling thread. The
+     *  returned pointer is valid until the next call to this function from the same thread
      *
      *  \param ind The id of the individual
      */
     int* getGenes(int ind);
     /*! Return a pointer to the genome of one individual stored in the bestgenome matrix
+     *  The returned pointer is valid until the next call to this function from the same thread (see
+     *  getGenes())
      *
      *  \param ind The id of the individual
      */
@@ -340,6 +370,25 @@ public:
      */
     void stop();
 
+    /*! \brief waits until all files queued by the save functions have been written
+     *
+     *  Statistics and genomes are saved by a background thread while the evolution goes on.
+     *  This is called automatically when evolveAllReplicas() returns (also when the evolution
+     *  is stopped) and at the end of each replication
+     */
+    void flushOutput();
+
+    /*! \brief evaluates individuals on behalf of a master process until the master or the user stops it
+     *
+     *  This is what evolveAllReplicas() does when the farmRole parameter is "worker". The worker
+     *  connects to the master at farmAddress (retrying if the master is not running or if the
+     *  connection is lost) and evaluates the individuals it receives with the experiment of this
+     *  object. Individuals are evaluated one at a time, but the physics engine gets the same number of
+     *  threads as in an evolution without farm (see computeThreadsSplit()). See EvogaFarmMaster for more
+     *  information
+     */
+    void runFarmWorker();
+
     /*! \brief this method marks the point on which it is called as a commited step of evolution
      *
      *  This method allow to divide the code on blocks where each of it can be considered as
@@ -562,6 +611,20 @@ public slots:
     void doNextStep();
 
 protected:
+    /*! Decide how to split the numThreads threads between parallel evaluations and the physics engine of each experiment
+     *
+     *  When the physicsThreads parameter is 0, as many individuals as possible are evaluated in parallel and the
+     *  remaining threads are given to the physics engine of each experiment (which gets only one thread if the world
+     *  is kinematic-only). Otherwise the physics engine uses physicsThreads threads and the other ones are used for
+     *  parallel evaluations. The split only depends on parameters and it is the same for the whole evolution: the
+     *  fitness doesn't depend on the number of parallel evaluations, but can depend on the number of threads of the
+     *  physics engine, so keeping it constant makes results reproducible. The chosen split is logged
+     *
+     *  \param maxParallelEvaluations The maximum number of individuals that can be evaluated in parallel
+     *  \param evaluationThreads The number of individuals to evaluate in parallel is written here
+     *  \param worldThreads The number of threads of the physics engine of each experiment is written here
+     */
+    void computeThreadsSplit(int maxParallelEvaluations, int& evaluationThreads, int& worldThreads);
     //! the EvoRobotExperiment
     EvoRobotExperiment *exp;
     //! population size
@@ -577,27 +640,32 @@ protected:
 
     /**
      * \brief A class modelling a population of genomes
+     *
+     * Genes only take values between 0 and 255, so they are stored as bytes.
+     * All genomes are kept one after the other in a single buffer, each
+     * starting at a multiple of 8 bytes (the stride) so that they can be
+     * processed one machine word at a time. Adding or removing genomes only
+     * resizes the buffer, genomes are never allocated one by one. Pointers
+     * returned by operator[] are invalidated when the population grows
      * \internal
      */
     class Population {
     public:
         Population() :
-            m_pop(),
-            m_genomelength(1)
+            m_genes(),
+            m_size(0),
+            m_genomelength(1),
+            m_stride(computeStride(1))
         {
         }
 
-        ~Population()
-        {
-            clear();
-        }
-
         void setGenomeLength(int genomelength)
         {
             if (genomelength < 1) {
                 genomelength = 1;
             }
             m_genomelength = genomelength;
+            m_stride = computeStride(genomelength);
 
             clear();
         }
@@ -607,33 +675,27 @@ protected:
             return m_genomelength;
         }
 
+        int getStride() const
+        {
+            return m_stride;
+        }
+
         void resize(int newSize)
         {
             if (newSize < 0) {
                 newSize = 0;
             }
 
-            // We have to be careful clearing or allocating memory
-            if (newSize < m_pop.size()) {
-                for (int i = (m_pop.size() - 1); i >= newSize; i--) {
-                    delete[] m_pop[i];
-                }
-                m_pop.resize(newSize);
-            } else if (newSize > m_pop.size()) {
-                const int oldSize = m_pop.size();
-                m_pop.resize(newSize);
-                for (int i = oldSize; i < newSize; i++) {
-                    m_pop[i] = new int[m_genomelength];
-                }
-            }
+            m_genes.resize(newSize * m_stride);
+            m_size = newSize;
         }
 
         int addOne()
         {
-            m_pop.append(new int[m_genomelength]);
+            resize(m_size + 1);
 
             // Returning the index of the new genome
-            return (m_pop.size() - 1);
+            return (m_size - 1);
         }
 
         void clear()
@@ -643,37 +705,48 @@ protected:
 
         int size() const
         {
-            return m_pop.size();
+            return m_size;
         }
 
-        int* operator[](int i)
+        quint8* operator[](int i)
         {
 #ifdef SALSA_DEBUG
-            if (i > m_pop.size()) {
+            if (i > m_size) {
                 abort();
             }
 #endif
-            return m_pop[i];
+            return m_genes.data() + i * m_stride;
         }
 
-        const int* operator[](int i) const
+        const quint8* operator[](int i) const
         {
 #ifdef SALSA_DEBUG
-            if (i > m_pop.size()) {
+            if (i > m_size) {
                 abort();
             }
 #endif
-            return m_pop[i];
+            return m_genes.constData() + i * m_stride;
         }
 
     private:
-        QVector<int *> m_pop;
+        static int computeStride(int genomelength)
+        {
+            return ((genomelength + 7) / 8) * 8;
+        }
+
+        QVector<quint8> m_genes;
+        int m_size;
         int m_genomelength;
+        int m_stride;
     };
     //! The matrix that contain the genome of the corrent population
     Population genome;
     //! The matrix that contains a copy of the genome of the best individuals
     Population bestgenome;
+    //! The per-thread buffer returned by getGenes()
+    QThreadStorage<QVector<int> > genesBuffer;
+    //! The per-thread buffer returned by getBestGenes()
+    QThreadStorage<QVector<int> > bestGenesBuffer;
 	// Matrix containing genotypes for XNES algorithm
 	QVector<float *> genotypes;
     //! The number of individual genome loaded from a .gen file into the genome matrix (-1 when none has been loaded)
@@ -731,6 +804,21 @@ protected:
     QWaitCondition waitForNextStep;
     //! The number of concurrent threads to use
     unsigned int numThreads;
+    //! The number of threads of the physics engine of each experiment (0 means decided from numThreads, see computeThreadsSplit())
+    int physicsThreads;
+    //! The thread writing statistics and genomes to files
+    OutputWriterForEvoga* outputWriter;
+    /*! The role of this process in a farm of processes evaluating individuals: "none" (individuals are
+     *  evaluated by this process), "master" (individuals are evaluated by worker processes) or
+     *  "worker" (this process evaluates individuals for a master)
+     */
+    QString farmRole;
+    //! The address on which the master listens for workers and to which workers connect
+    QString farmAddress;
+    //! The maximum number of individuals sent to a worker that it has not evaluated yet
+    int farmJobsPerWorker;
+    //! The object sending individuals to workers, only used by the master during evolution
+    EvogaFarmMaster* farmMaster;
     //! How often (i.e. how many generations) we want to same the population genome in a .gen file
     int savePopulationEachNGenerations;
     /**
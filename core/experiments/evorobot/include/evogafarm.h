@@ -0,0 +1,415 @@
+/********************************************************************************
+ *  SALSA Experiments Library                                                   *
+ *  Copyright (C) 2007-2012                                                     *
+ *  Stefano Nolfi <stefano.nolfi@istc.cnr.it>                                   *
+ *  Onofrio Gigliotta <onofrio.gigliotta@istc.cnr.it>                           *
+ *  Gianluca Massera <emmegian@yahoo.it>                                        *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                         *
+ *                                                                              *
+ *  This program is free software; you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by        *
+ *  the Free Software Foundation; either version 2 of the License, or           *
+ *  (at your option) any later version.                                         *
+ *                                                                              *
+ *  This program is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+ *  GNU General Public License for more details.                                *
+ *                                                                              *
+ *  You should have received a copy of the GNU General Public License           *
+ *  along with this program; if not, write to the Free Software                 *
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA  *
+ ********************************************************************************/
+
+#ifndef EVOGAFARM_H
+#define EVOGAFARM_H
+
+#include "experimentsconfig.h"
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QList>
+#include <QQueue>
+#include <QHash>
+
+class QIODevice;
+class QTcpServer;
+class QTcpSocket;
+class QLocalServer;
+class QLocalSocket;
+
+namespace salsa {
+
+class Evoga;
+
+/**
+ * \brief The framing of messages exchanged by the master and the workers of
+ *        the farm
+ *
+ * Each message is prefixed by its length as a 32 bits big endian unsigned
+ * integer. Data read from a connection can contain an incomplete message or
+ * more than one message, takeMessage() extracts complete messages one at a
+ * time
+ */
+class SALSA_EXPERIMENTS_API EvogaFarmFraming
+{
+public:
+	/**
+	 * \brief Messages longer than this are considered invalid
+	 */
+	static const quint32 maxMessageSize = 64 * 1024 * 1024;
+
+	/**
+	 * \brief Writes a message prefixed by its length
+	 *
+	 * \param device the device to write to
+	 * \param payload the message
+	 */
+	static void writeMessage(QIODevice* device, const QByteArray& payload);
+
+	/**
+	 * \brief Extracts the first message from the data received so far
+	 *
+	 * \param buffer the data received so far. If a message is extracted,
+	 *               it is removed from here
+	 * \param payload the message is written here
+	 * \return 1 if a message was extracted, 0 if more data is needed and -1
+	 *         if the data is invalid
+	 */
+	static int takeMessage(QByteArray& buffer, QByteArray& payload);
+};
+
+/**
+ * \brief A request from the master to a worker of the farm
+ */
+struct SALSA_EXPERIMENTS_API EvogaFarmRequest
+{
+	/**
+	 * \brief Whether the worker must evaluate an individual or quit
+	 */
+	bool quit;
+
+	/**
+	 * \brief The id of the job, to be sent back with the result
+	 */
+	quint32 jobId;
+
+	/**
+	 * \brief The seed of the replication
+	 */
+	quint32 seed;
+
+	/**
+	 * \brief The generation
+	 */
+	qint32 generation;
+
+	/**
+	 * \brief The id of the individual
+	 */
+	qint32 individual;
+
+	/**
+	 * \brief The genes of the individual
+	 */
+	QByteArray genes;
+};
+
+/**
+ * \brief The encoding of messages exchanged by the master and the workers of
+ *        the farm
+ *
+ * These functions create the payload of messages (see EvogaFarmMaster for
+ * their content) and decode it. Payloads are then framed with
+ * EvogaFarmFraming. Functions decoding a message return false if the payload
+ * is not a valid message of the expected type
+ */
+class SALSA_EXPERIMENTS_API EvogaFarmMessages
+{
+public:
+	/**
+	 * \brief The type of messages
+	 */
+	enum Type {
+		InvalidMessage = 0,
+		HelloMessage,
+		EvaluateMessage,
+		ResultMessage,
+		QuitMessage
+	};
+
+	/**
+	 * \brief Returns the type of a message
+	 *
+	 * \param payload the message
+	 * \return the type of the message, InvalidMessage if it is unknown
+	 */
+	static Type type(const QByteArray& payload);
+
+	/**
+	 * \brief Creates a Hello message
+	 *
+	 * \param genomeLength the length of genomes of the worker
+	 * \return the message
+	 */
+	static QByteArray hello(int genomeLength);
+
+	/**
+	 * \brief Decodes a Hello message
+	 *
+	 * \param payload the message
+	 * \param genomeLength the length of genomes of the worker is written
+	 *                     here
+	 * \return false also if the magic number or the protocol version are
+	 *         wrong
+	 */
+	static bool readHello(const QByteArray& payload, int& genomeLength);
+
+	/**
+	 * \brief Creates an Evaluate message or, if request.quit is true, a Quit
+	 *        message
+	 *
+	 * \param request the request to send
+	 * \return the message
+	 */
+	static QByteArray request(const EvogaFarmRequest& request);
+
+	/**
+	 * \brief Decodes an Evaluate or a Quit message
+	 *
+	 * \param payload the message
+	 * \param request the request is written here
+	 * \return false if the message is neither an Evaluate nor a Quit
+	 *         message
+	 */
+	static bool readRequest(const QByteArray& payload, EvogaFarmRequest& request);
+
+	/**
+	 * \brief Creates a Result message
+	 *
+	 * \param jobId the id of the job
+	 * \param fitness the fitness of the individual
+	 * \return the message
+	 */
+	static QByteArray result(quint32 jobId, double fitness);
+
+	/**
+	 * \brief Decodes a Result message
+	 *
+	 * \param payload the message
+	 * \param jobId the id of the job is written here
+	 * \param fitness the fitness of the individual is written here
+	 * \return false if the message is not a valid Result message
+	 */
+	static bool readResult(const QByteArray& payload, quint32& jobId, double& fitness);
+};
+
+/**
+ * \brief The master of a farm of processes evaluating individuals for Evoga
+ *
+ * Workers are separated processes running the same experiment (see
+ * Evoga::runFarmWorker()). They connect to the master, which sends them
+ * genomes to evaluate and collects fitness values as soon as they arrive.
+ * The address is the name of a local socket (a Unix domain socket or a named
+ * pipe on Windows) or, if it has the form host:port, a TCP address. In the
+ * latter case workers can run on different machines. When listening, an
+ * empty host means any address.
+ *
+ * Each request carries the seed, the generation and the id of the individual
+ * together with the genes, so workers keep no state between requests and
+ * can be started, stopped or restarted at any time. Each worker has at most
+ * jobsPerWorker pending requests, so that it doesn't wait for the master
+ * between two evaluations. If a worker disconnects (e.g. because it crashed)
+ * its pending requests are sent to other workers. A worker that hangs
+ * without closing the connection is not detected.
+ *
+ * The protocol is made of messages prefixed by their length (see
+ * EvogaFarmFraming). Each message starts with its type and is serialized
+ * with QDataStream (see EvogaFarmMessages):
+ *  - Hello (worker to master): magic number, protocol version, genome length;
+ *  - Evaluate (master to worker): job id, seed, generation, individual id,
+ *    genes (one byte per gene);
+ *  - Result (worker to master): job id, fitness;
+ *  - Quit (master to worker): no data, the worker terminates.
+ *
+ * All functions must be called from the thread that created this object
+ */
+class SALSA_EXPERIMENTS_API EvogaFarmMaster : public QObject
+{
+	Q_OBJECT
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param ga the genetic algorithm whose individuals are evaluated
+	 * \param genomeLength the length of genomes. Workers with a different
+	 *                     genome length are refused
+	 * \param jobsPerWorker the maximum number of pending requests for each
+	 *                      worker
+	 */
+	EvogaFarmMaster(Evoga* ga, int genomeLength, int jobsPerWorker);
+
+	/**
+	 * \brief Destructor
+	 *
+	 * Tells all connected workers to quit
+	 */
+	~EvogaFarmMaster();
+
+	/**
+	 * \brief Starts listening for workers
+	 *
+	 * \param address the address to listen to (see class description)
+	 * \return false in case of errors
+	 */
+	bool listen(const QString& address);
+
+	/**
+	 * \brief Evaluates a set of consecutive individuals
+	 *
+	 * This returns when all individuals have been evaluated or when
+	 * evolution is stopped. Genes, seed and generation are taken from the
+	 * genetic algorithm when requests are sent
+	 * \param firstId the id of the first individual to evaluate
+	 * \param numIds the number of individuals to evaluate
+	 * \param fitness the fitness of individuals (relative to firstId) is
+	 *                written here. It must have at least numIds elements
+	 * \return false if evolution was stopped before all individuals were
+	 *         evaluated
+	 */
+	bool evaluate(int firstId, int numIds, QVector<double>& fitness);
+
+	/**
+	 * \brief Returns the number of connected workers
+	 *
+	 * \return the number of connected workers
+	 */
+	int numWorkers() const;
+
+private slots:
+	void acceptTcpConnection();
+	void acceptLocalConnection();
+	void readFromWorker();
+	void workerDisconnected();
+
+private:
+	struct Worker
+	{
+		QString name;
+		QByteArray buffer;
+		bool ready;
+		QList<quint32> jobs;
+	};
+
+	void addWorker(QIODevice* device, const QString& name);
+	void handleMessage(QIODevice* device, Worker& worker, const QByteArray& payload);
+	void dropWorker(QIODevice* device, const QString& reason);
+	void dispatchJobs();
+
+	Evoga* const m_ga;
+	const int m_genomeLength;
+	const int m_jobsPerWorker;
+	QString m_address;
+	QTcpServer* m_tcpServer;
+	QLocalServer* m_localServer;
+	QHash<QIODevice*, Worker> m_workers;
+	// Workers in the order they connected, so that jobs are dispatched in a
+	// predictable order
+	QList<QIODevice*> m_workersOrder;
+	int m_connectionsCounter;
+	int m_firstId;
+	QVector<double>* m_fitness;
+	int m_numDone;
+	// Indexes (relative to m_firstId) of individuals waiting for a worker
+	QQueue<int> m_pendingJobs;
+	// The index (relative to m_firstId) of each job sent to a worker
+	QHash<quint32, int> m_jobs;
+	quint32 m_nextJobId;
+};
+
+/**
+ * \brief The connection of a worker of the farm to the master
+ *
+ * See EvogaFarmMaster for a description of the protocol. All functions block
+ * at most for the given time, so that the worker can check whether it has
+ * been stopped
+ */
+class SALSA_EXPERIMENTS_API EvogaFarmWorkerConnection
+{
+public:
+	/**
+	 * \brief A request from the master
+	 */
+	typedef EvogaFarmRequest Request;
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param address the address of the master (see EvogaFarmMaster)
+	 * \param genomeLength the length of genomes, sent to the master when
+	 *                     connecting
+	 */
+	EvogaFarmWorkerConnection(const QString& address, int genomeLength);
+
+	/**
+	 * \brief Destructor
+	 */
+	~EvogaFarmWorkerConnection();
+
+	/**
+	 * \brief Returns true if we are connected to the master
+	 *
+	 * \return true if we are connected to the master
+	 */
+	bool isConnected() const;
+
+	/**
+	 * \brief Connects to the master
+	 *
+	 * \param msecs the maximum time to wait
+	 * \return true if the connection succeeded
+	 */
+	bool connectToMaster(int msecs);
+
+	/**
+	 * \brief Waits for the next request from the master
+	 *
+	 * \param request the request is written here
+	 * \param msecs the maximum time to wait
+	 * \return false if no request arrived in time or the connection was
+	 *         closed (use isConnected() to check)
+	 */
+	bool waitForRequest(Request& request, int msecs);
+
+	/**
+	 * \brief Sends the result of an evaluation to the master
+	 *
+	 * \param jobId the id of the job
+	 * \param fitness the fitness of the individual
+	 * \return false if the connection was closed
+	 */
+	bool sendResult(quint32 jobId, double fitness);
+
+private:
+	void closeConnection();
+
+	const QString m_address;
+	const int m_genomeLength;
+	QTcpSocket* m_tcpSocket;
+	QLocalSocket* m_localSocket;
+	QIODevice* m_device;
+	QByteArray m_buffer;
+
+	// Copy constructor. Here to prevent usage
+	EvogaFarmWorkerConnection(const EvogaFarmWorkerConnection&);
+
+	// Copy operator. Here to prevent usage
+	EvogaFarmWorkerConnection& operator=(const EvogaFarmWorkerConnection&);
+};
+
+} // end namespace salsa
+
+#endif
@@ -40,6 +40,7 @@
 #include "randomgenerator.h"
 #include "experimentsconfig.h"
 #include "guirendererscontainer.h"
+#include "trajectoryrecorder.h"
 #include "renderer2d.h"
 
 #include <QCoreApplication>
@@ -402,6 +403,25 @@ public:
 	 */
 	void newGASeed(int seed);
 
+	/**
+	 * \brief Sets the number of threads used by the physics engine
+	 *
+	 * This is called by the ga, which decides how to split threads between
+	 * parallel evaluations and the physics engine of each experiment. The
+	 * default is 1
+	 * \param numThreads the number of threads used by the physics engine
+	 */
+	void setPhysicsThreads(int numThreads);
+
+	/**
+	 * \brief Returns true if the world only contains kinematic objects
+	 *
+	 * In this case the physics engine does nothing, so there is no reason
+	 * to give it more than one thread
+	 * \return true if the world only contains kinematic objects
+	 */
+	bool isKinematicOnlyWorld() const;
+
 	/**
 	 * \brief Returns the renderers container
 	 *
@@ -412,6 +432,22 @@ public:
 		return renderersContainer;
 	}
 
+	/**
+	 * \brief Returns the object recording trajectories
+	 *
+	 * Trajectories are recorded if the World/trajectoryFile parameter is
+	 * not empty. The inputs and outputs of the controller of each agent are
+	 * recorded at every step, subclasses can record more values calling
+	 * TrajectoryRecorder::recordValues() before the world advances (e.g.
+	 * in beforeWorldAdvance())
+	 * \return the object recording trajectories or nullptr if trajectories
+	 *         are not recorded
+	 */
+	TrajectoryRecorder* getTrajectoryRecorder()
+	{
+		return trajectoryRecorder;
+	}
+
 public slots:
 	/*! \brief set the delay to apply at each step for slowing down the simulation
 	 *  \param delay the delay expressed in msec
@@ -493,6 +529,16 @@ private:
 	GUIRenderersContainer* renderersContainer;
 	//! the timestep
 	float timestep;
+	//! whether the world only contains kinematic objects (see World::setKinematicOnly())
+	bool kinematicOnlyWorld;
+	//! the file where trajectories are recorded, empty if they are not recorded
+	QString trajectoryFile;
+	//! the number of frames between two keyframes of the trajectory file
+	int trajectoryKeyframeInterval;
+	//! the object recording trajectories, nullptr if they are not recorded
+	TrajectoryRecorder* trajectoryRecorder;
+	//! the number of threads used by the physics engine (see setPhysicsThreads())
+	int physicsThreads;
 	//! the embodied agents
 	QList<EmbodiedAgent*> eagents;
 	//! current activity (evolution, test, batch)
@@ -22,18 +22,24 @@
  ********************************************************************************/
 
 #include "evoga.h"
+#include "evogafarm.h"
 #include "evodataviewer.h"
 #include "logger.h"
 #include "randomgenerator.h"
+#include "simpletimer.h"
 #include <configurationhelper.h>
 #include <QVector>
 #include <QThreadPool>
+#include <QAtomicInt>
 #include <QtConcurrentMap>
 #include <QtAlgorithms>
 #include <QTime>
 #include <QFile>
+#include <QThread>
+#include <QQueue>
 
 #include <cmath>
+#include <algorithm>
 
 #include <Eigen/Core>
 #include <Eigen/Dense>
@@ -51,6 +57,88 @@
 
 namespace salsa {
 
+/**
+ * \brief Evaluates a genotype with the given experiment and returns its
+ *        fitness
+ *
+ * While evaluating, globalRNG is redirected to rng, whose sequence only
+ * depends on the seed, the genotype and the generation. All evaluations of
+ * Evoga (sequential, in a pool of threads or in a worker of a farm) go
+ * through here, so that the fitness of a genotype does not depend on which
+ * thread or process evaluates it, nor on how many are used. This also means
+ * that evaluations don't consume numbers from globalRNG, that is only used
+ * by the genetic algorithm
+ * \param exp the experiment to run
+ * \param rng the generator to use in place of globalRNG
+ * \param genes the genes of the genotype
+ * \param seed the seed of the replication
+ * \param id the id of the genotype
+ * \param generation the current generation
+ * \return the fitness of the genotype
+ */
+double evaluateGenotypeForEvoga(EvoRobotExperiment* exp, RandomGenerator& rng, int* genes, unsigned int seed, int id, unsigned int generation)
+{
+	GlobalRNGThreadOverride rngOverride(&rng);
+
+	// The generation is used as the trial id, so that genotypes get a new sequence at each generation
+	rng.setStream(seed, id, generation);
+	exp->setNetParameters(genes);
+	exp->doAllTrialsForIndividual(id);
+	return exp->getFitness();
+}
+
+/**
+ * \brief A set of consecutive genotypes evaluated in parallel by a pool of
+ *        EvaluatorThreadForEvoga
+ *
+ * Evaluators take genotypes from here one at a time, so that faster threads
+ * evaluate more individuals. Which evaluator gets which genotype changes from
+ * run to run. Results are reproducible only because each genotype is
+ * evaluated with its own random stream (see evaluateGenotypeForEvoga()), so
+ * evaluators must never share a generator or any other state that depends
+ * on the order of evaluations
+ */
+struct EvaluationBatchForEvoga
+{
+	/**
+	 * \brief Constructor
+	 *
+	 * \param first the id of the first genotype to evaluate
+	 * \param num the number of genotypes to evaluate
+	 */
+	EvaluationBatchForEvoga(int first, int num)
+		: firstId(first)
+		, numIds(num)
+		, nextIndex(0)
+		, fitness(num, 0.0)
+	{
+	}
+
+	/**
+	 * \brief The id of the first genotype to evaluate
+	 */
+	const int firstId;
+
+	/**
+	 * \brief The number of genotypes to evaluate
+	 */
+	const int numIds;
+
+	/**
+	 * \brief The index (relative to firstId) of the next genotype to
+	 *        evaluate
+	 */
+	QAtomicInt nextIndex;
+
+	/**
+	 * \brief The fitness of each genotype (relative to firstId)
+	 *
+	 * Each element is written by the only evaluator that took the
+	 * corresponding genotype
+	 */
+	QVector<double> fitness;
+};
+
 /*! \brief this is an helper class for implementing multithread in Evoga */
 class EvaluatorThreadForEvoga
 {
@@ -64,7 +152,9 @@ public:
 	 */
 	EvaluatorThreadForEvoga(Evoga *ga, EvoRobotExperiment *exp) :
 		m_ga(ga),
-		m_exp(exp)
+		m_exp(exp),
+		m_batch(nullptr),
+		m_rng()
 	{
 	}
 
@@ -77,43 +167,30 @@ public:
 	}
 
 	/**
-	 * \brief Configures the experiment with the given genotype id
+	 * \brief Sets the batch of genotypes to evaluate
 	 *
-	 * \param id the genotype id to use in this experiment
+	 * The same batch is shared by all evaluators of the pool
+	 * \param batch the batch of genotypes to evaluate
 	 */
-	void setGenotype(int id)
+	void setBatch(EvaluationBatchForEvoga* batch)
 	{
-		m_id = id;
-		m_exp->setNetParameters(m_ga->getGenes(id));
+		m_batch = batch;
 	}
 
 	/**
-	 * \brief Returns the id of the genotype used in this experiment
+	 * \brief Runs the experiment on genotypes of the batch until there are
+	 *        no more genotypes to evaluate
 	 *
-	 * \return the id of the genotype used in this experiment
-	 */
-	int getGenotypeId() const
-	{
-		return m_id;
-	}
-
-	/**
-	 * \brief Runs the experiment
+	 * The experiment is re-targeted at each genotype simply by changing the
+	 * parameters of the network (see evaluateGenotypeForEvoga())
 	 */
 	void run()
 	{
-		m_exp->doAllTrialsForIndividual(m_id);
-		m_fitness = m_exp->getFitness();
-	}
+		for (int i = m_batch->nextIndex.fetchAndAddRelaxed(1); i < m_batch->numIds; i = m_batch->nextIndex.fetchAndAddRelaxed(1)) {
+			const int id = m_batch->firstId + i;
 
-	/**
-	 * \brief Returns the fitness of the last run
-	 *
-	 * \return the fitness of the last run
-	 */
-	double getFitness() const
-	{
-		return m_fitness;
+			m_batch->fitness[i] = evaluateGenotypeForEvoga(m_exp, m_rng, m_ga->getGenes(id), m_ga->getCurrentSeed(), id, m_ga->getCurrentGeneration());
+		}
 	}
 
 	/**
@@ -138,14 +215,14 @@ private:
 	EvoRobotExperiment *const m_exp;
 
 	/**
-	 * \brief The id of the genotype used in this experiment
+	 * \brief The batch of genotypes to evaluate
 	 */
-	int m_id;
+	EvaluationBatchForEvoga* m_batch;
 
 	/**
-	 * \brief The resulting fitness
+	 * \brief The generator used in place of globalRNG in this thread
 	 */
-	double m_fitness;
+	RandomGenerator m_rng;
 };
 
 /**
@@ -157,6 +234,21 @@ void runEvaluatorThreadForEvoga(EvaluatorThreadForEvoga* e)
 	e->run();
 }
 
+/**
+ * \brief Evaluates all genotypes of the batch, either with the given
+ *        evaluators or, if farm is not nullptr, with the workers of the farm
+ */
+void evaluateBatchForEvoga(EvogaFarmMaster* farm, QVector<EvaluatorThreadForEvoga*>& evaluators, EvaluationBatchForEvoga& batch)
+{
+	if (farm != nullptr) {
+		// If evolution is stopped, the caller will notice
+		farm->evaluate(batch.firstId, batch.numIds, batch.fitness);
+	} else {
+		QFuture<void> evaluationFuture = QtConcurrent::map(evaluators, runEvaluatorThreadForEvoga);
+		evaluationFuture.waitForFinished();
+	}
+}
+
 /**
  * \brief A simple structure keeping a fitness value and the id of a
  *        genotype
@@ -182,6 +274,276 @@ bool operator<(FitnessAndId first, FitnessAndId second)
 	return (first.fitness < second.fitness);
 }
 
+/**
+ * \brief The thread writing the files produced by Evoga during evolution
+ *
+ * Evoga describes each file operation as a job, copying the genomes to save,
+ * so that a job is a consistent snapshot of the generation in which it was
+ * queued. Conversion to text and file access happen in this thread, so that
+ * evaluators can go on with the next generation in the meantime. Jobs are
+ * executed in the order they were queued. At most maxQueuedJobs jobs can be
+ * pending: if Evoga produces output faster than it can be written, queueing
+ * a job blocks until there is room for it
+ */
+class OutputWriterForEvoga : public QThread
+{
+public:
+	/**
+	 * \brief The possible operations on a file
+	 */
+	enum Operation {
+		Create, ///< Creates the file, truncating it if it exists
+		Append, ///< Appends to the file, creating it if it doesn't exist
+		Remove ///< Removes the file
+	};
+
+	/**
+	 * \brief A file operation
+	 */
+	struct Job
+	{
+		/**
+		 * \brief Constructor
+		 *
+		 * \param op the operation to perform
+		 * \param f the name of the file
+		 * \param err the message logged if the operation fails
+		 */
+		Job(Operation op, const QString& f, const QString& err)
+			: operation(op)
+			, filename(f)
+			, errorMessage(err)
+			, text()
+			, genomeLength(0)
+			, genes()
+			, headers()
+		{
+		}
+
+		/**
+		 * \brief Prepares the job to store count genomes
+		 *
+		 * \param length the length of genomes
+		 * \param count the number of genomes that will be added
+		 */
+		void reserveGenomes(int length, int count)
+		{
+			genomeLength = length;
+			genes.reserve(length * count);
+			headers.reserve(count);
+		}
+
+		/**
+		 * \brief Adds a copy of a genome to be written after text
+		 *
+		 * \param header the line written before the genome
+		 * \param g the genes to copy
+		 */
+		void addGenome(const QByteArray& header, const quint8* g)
+		{
+			const int start = genes.size();
+			genes.resize(start + genomeLength);
+			std::copy(g, g + genomeLength, genes.begin() + start);
+			headers.append(header);
+		}
+
+		/**
+		 * \brief The operation to perform
+		 */
+		Operation operation;
+
+		/**
+		 * \brief The name of the file
+		 */
+		QString filename;
+
+		/**
+		 * \brief The message logged if the operation fails
+		 */
+		QString errorMessage;
+
+		/**
+		 * \brief The text written at the beginning
+		 */
+		QByteArray text;
+
+		/**
+		 * \brief The length of genomes
+		 */
+		int genomeLength;
+
+		/**
+		 * \brief The genomes written after text, one after the other
+		 */
+		QVector<quint8> genes;
+
+		/**
+		 * \brief The line written before each genome
+		 */
+		QVector<QByteArray> headers;
+	};
+
+	/**
+	 * \brief The maximum number of jobs waiting to be executed
+	 */
+	static const int maxQueuedJobs = 32;
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * The thread is started when the first job is queued
+	 */
+	OutputWriterForEvoga()
+		: QThread()
+		, m_mutex()
+		, m_jobAvailable()
+		, m_jobDone()
+		, m_jobs()
+		, m_quit(false)
+	{
+	}
+
+	/**
+	 * \brief Destructor
+	 *
+	 * Executes all pending jobs before returning
+	 */
+	~OutputWriterForEvoga()
+	{
+		{
+			QMutexLocker locker(&m_mutex);
+			m_quit = true;
+			m_jobAvailable.wakeAll();
+		}
+
+		wait();
+	}
+
+	/**
+	 * \brief Queues a job
+	 *
+	 * This blocks if there are already maxQueuedJobs pending jobs
+	 * \param job the job to queue
+	 */
+	void enqueue(const Job& job)
+	{
+		if (!isRunning()) {
+			start(QThread::LowPriority);
+		}
+
+		QMutexLocker locker(&m_mutex);
+		while (m_jobs.size() >= maxQueuedJobs) {
+			m_jobDone.wait(&m_mutex);
+		}
+		m_jobs.enqueue(job);
+		m_jobAvailable.wakeOne();
+	}
+
+	/**
+	 * \brief Waits until all queued jobs have been executed
+	 */
+	void flush()
+	{
+		QMutexLocker locker(&m_mutex);
+		while (!m_jobs.isEmpty()) {
+			m_jobDone.wait(&m_mutex);
+		}
+	}
+
+protected:
+	/**
+	 * \brief Executes jobs until the object is destroyed
+	 */
+	void run() override
+	{
+		forever {
+			// The job is removed from the queue only when it has been
+			// executed, so that flush() also waits for the running one
+			m_mutex.lock();
+			while (m_jobs.isEmpty() && !m_quit) {
+				m_jobAvailable.wait(&m_mutex);
+			}
+			if (m_jobs.isEmpty()) {
+				m_mutex.unlock();
+				return;
+			}
+			const Job job = m_jobs.head();
+			m_mutex.unlock();
+
+			execute(job);
+
+			m_mutex.lock();
+			m_jobs.dequeue();
+			m_jobDone.wakeAll();
+			m_mutex.unlock();
+		}
+	}
+
+private:
+	/**
+	 * \brief Performs the operation of a job
+	 *
+	 * Genomes are written in the format of Evoga::saveagenotype()
+	 * \param job the job to execute
+	 */
+	static void execute(const Job& job)
+	{
+		if (job.operation == Remove) {
+			if (!QFile::remove(job.filename)) {
+				Logger::warning(job.errorMessage);
+			}
+
+			return;
+		}
+
+		QByteArray data = job.text;
+		for (int i = 0; i < job.headers.size(); i++) {
+			const quint8* g = job.genes.constData() + i * job.genomeLength;
+
+			data += job.headers[i];
+			data += "DYNAMICAL NN\n";
+			for (int j = 0; j < job.genomeLength; j++) {
+				data += QByteArray::number(g[j]);
+				data += '\n';
+			}
+			data += "END\n";
+		}
+
+		QFile file(job.filename);
+		const QIODevice::OpenMode mode = (job.operation == Append) ? QIODevice::Append : QIODevice::Truncate;
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text | mode) || (file.write(data) != data.size())) {
+			Logger::error(job.errorMessage);
+		}
+	}
+
+	/**
+	 * \brief The mutex protecting the queue
+	 */
+	QMutex m_mutex;
+
+	/**
+	 * \brief The condition signalled when a job is queued or the thread
+	 *        must quit
+	 */
+	QWaitCondition m_jobAvailable;
+
+	/**
+	 * \brief The condition signalled when a job has been executed
+	 */
+	QWaitCondition m_jobDone;
+
+	/**
+	 * \brief The queued jobs. The head is the one being executed
+	 */
+	QQueue<Job> m_jobs;
+
+	/**
+	 * \brief Whether the thread must quit once there are no more jobs
+	 */
+	bool m_quit;
+};
+
 int Evoga::mrand(int i)
 {
 	int r;
@@ -229,6 +591,12 @@ Evoga::Evoga(ConfigurationManager& params)
 	, mutexStepByStep()
 	, waitForNextStep()
 	, numThreads(1)
+	, physicsThreads(1)
+	, outputWriter(new OutputWriterForEvoga())
+	, farmRole("none")
+	, farmAddress()
+	, farmJobsPerWorker(2)
+	, farmMaster(nullptr)
 	, savePopulationEachNGenerations(0)
 	, averageIndividualFitnessOverGenerations(true)
 {
@@ -236,6 +604,9 @@ Evoga::Evoga(ConfigurationManager& params)
 
 Evoga::~Evoga()
 {
+	delete farmMaster;
+	// This waits for pending files to be written
+	delete outputWriter;
 	delete exp;
 	delete[] tfitness;
 	delete[] terror;
@@ -303,12 +674,93 @@ int Evoga::mutate(int w, double mut)
 	return(w);
 }
 
+namespace {
+	// Flips bits of the 8 genes starting at genes[8 * word] using the mask of each gene. Whole words
+	// are processed at once, only the last incomplete word of the genome is processed byte by byte
+	void xorGenesWord(quint8* genes, int glen, int word, const quint8 mask[8])
+	{
+		quint8* const w = genes + 8 * word;
+
+		if ((8 * word + 8) <= glen) {
+			quint64 v;
+			quint64 m;
+			memcpy(&v, w, 8);
+			memcpy(&m, mask, 8);
+			v ^= m;
+			memcpy(w, &v, 8);
+		} else {
+			for (int i = 0; i < (glen - 8 * word); i++) {
+				w[i] ^= mask[i];
+			}
+		}
+	}
+}
+
+void Evoga::copyAndMutateGenes(const quint8* from, quint8* to)
+{
+	const int numBits = glen * 8;
+
+	if (from != to) {
+		memcpy(to, from, glen);
+	}
+
+	// Genes with the standard mutation rate. Flipped bits are taken from the bit stream of the whole
+	// genome (bit b is the bit b % 8 of gene b / 8), skipping bits of genes with a specific mutation
+	// rate. Masks are accumulated for 8 genes (one machine word) at a time
+	if (mutation > 0.0) {
+		const double logNotFlip = log1p(-qMin(mutation, 1.0));
+		quint8 mask[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+		int curWord = -1;
+		for (int b = geometricSkip(logNotFlip, numBits); b < numBits; b += 1 + geometricSkip(logNotFlip, numBits)) {
+			const int i = b / 8;
+			if (mutations[i] != Evonet::DEFAULT_VALUE) {
+				continue;
+			}
+			if ((i / 8) != curWord) {
+				if (curWord != -1) {
+					xorGenesWord(to, glen, curWord, mask);
+					memset(mask, 0, 8);
+				}
+				curWord = i / 8;
+			}
+			mask[i % 8] |= quint8(1 << (b % 8));
+		}
+		if (curWord != -1) {
+			xorGenesWord(to, glen, curWord, mask);
+		}
+	}
+
+	// Genes with a specific mutation rate, the mask of flipped bits is built one gene at a time
+	for (int i = 0; i < glen; i++) {
+		if ((mutations[i] != Evonet::DEFAULT_VALUE) && (mutations[i] > 0.0)) {
+			const double logNotFlip = log1p(-qMin(double(mutations[i]), 1.0));
+			quint8 mask = 0;
+			for (int b = geometricSkip(logNotFlip, 8); b < 8; b += 1 + geometricSkip(logNotFlip, 8)) {
+				mask |= quint8(1 << b);
+			}
+			to[i] ^= mask;
+		}
+	}
+}
+
+int Evoga::geometricSkip(double logNotFlip, int maxSkip)
+{
+	// 1.0 - drand() is in (0, 1] unless drand() returns exactly 1.0, in which case no bit is flipped
+	const double u = 1.0 - drand();
+	if (u <= 0.0) {
+		return maxSkip;
+	}
+
+	// When the probability of flipping is 1.0, logNotFlip is -inf and skip is always 0
+	const double skip = floor(log(u) / logNotFlip);
+
+	return (skip < double(maxSkip)) ? int(skip) : maxSkip;
+}
+
 void Evoga::putGenome(int fromgenome, int tobestgenome)
 {
 	if (tobestgenome < this->nreproducing) {
-		for (int i = 0; i < this->glen; i++) {
-			bestgenome[tobestgenome][i] = genome[fromgenome][i];
-		}
+		memcpy(bestgenome[tobestgenome], genome[fromgenome], glen);
 	} else {
 		Logger::error("putGenomeError!");
 	}
@@ -316,31 +768,21 @@ void Evoga::putGenome(int fromgenome, int tobestgenome)
 
 void Evoga::getGenome(int frombestgenome, int togenome, int mut)
 {
-	for(int i = 0; i < this->glen; i++) {
-		if (mut == 0) {
-			genome[togenome][i] = bestgenome[frombestgenome][i];
-		} else {
-			if (mutations[i] == Evonet::DEFAULT_VALUE) {	//standard mutation
-				genome[togenome][i] = mutate(bestgenome[frombestgenome][i], mutation);
-			} else {				//specific mutation
-				genome[togenome][i] = mutate(bestgenome[frombestgenome][i], mutations[i]);
-			}
-		}
+	if (mut == 0) {
+		memcpy(genome[togenome], bestgenome[frombestgenome], glen);
+	} else {
+		copyAndMutateGenes(bestgenome[frombestgenome], genome[togenome]);
 	}
 }
 
 void Evoga::copyGenes(int from, int to, int mut)
 {
-	for(int i = 0; i < this->glen; i++) {
-		if (mut == 0) {
-			genome[to][i] = genome[from][i];
-		} else {
-			if (mutations[i] == Evonet::DEFAULT_VALUE) {	//standard mutation
-				genome[to][i] = mutate(genome[from][i], mutation);
-			} else {				//specific mutation
-				genome[to][i] = mutate(genome[from][i], mutations[i]);
-			}
+	if (mut == 0) {
+		if (from != to) {
+			memcpy(genome[to], genome[from], glen);
 		}
+	} else {
+		copyAndMutateGenes(genome[from], genome[to]);
 	}
 }
 
@@ -354,7 +796,6 @@ void Evoga::reproduce()
 	double bn;
 
 	char sbuffer[64];
-	FILE *fp;
 
 	//first of all we compute fitness stat
 	this->computeFStat();
@@ -375,20 +816,11 @@ void Evoga::reproduce()
 		//here we save best genome
 		if ((bi+1)<=this->savebest && cgen< this->nogenerations) {
 			sprintf(sbuffer,"B%dS%d.gen",bi+1,this->currentSeed);
-			if (cgen==0) {
-				if ((fp=fopen(sbuffer, "w")) == nullptr) {
-					Logger::error(QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
-				}
-			} else {
-				if ((fp=fopen(sbuffer, "a")) == nullptr) {
-					Logger::error(QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
-				}
-			}
-
-			fprintf(fp,"**NET : s%d_%d.wts\n",cgen,bx);
-			saveagenotype(fp,bx);
-			fflush(fp);
-			fclose(fp);
+			OutputWriterForEvoga::Job job((cgen == 0) ? OutputWriterForEvoga::Create : OutputWriterForEvoga::Append, QString(sbuffer), QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
+			sprintf(sbuffer,"**NET : s%d_%d.wts\n",cgen,bx);
+			job.reserveGenomes(glen, 1);
+			job.addGenome(sbuffer, genome[bx]);
+			outputWriter->enqueue(job);
 		}
 		tfitness[bx]=-9999.0;
 	}
@@ -422,18 +854,9 @@ void Evoga::saveBestInd()
 	bi=-1;
 
 	char sbuffer[64];
-	FILE *fp;
 
 	sprintf(sbuffer,"B%dS%d.gen",bi+1,this->currentSeed);
-	if (cgen==0) {
-		if ((fp=fopen(sbuffer, "w")) == nullptr) {
-			Logger::error(QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
-		}
-	} else {
-		if ((fp=fopen(sbuffer, "a")) == nullptr) {
-			Logger::error(QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
-		}
-	}
+	OutputWriterForEvoga::Job job((cgen == 0) ? OutputWriterForEvoga::Create : OutputWriterForEvoga::Append, QString(sbuffer), QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
 
 	//finding the best simply the best, one individual
 	for(i=0;i<this->popSize;i++) {
@@ -445,10 +868,10 @@ void Evoga::saveBestInd()
 	}
 
 	//now saving
-	fprintf(fp,"**NET : s%d_%d.wts\n",cgen,bi);
-	saveagenotype(fp,bi);
-	fflush(fp);
-	fclose(fp);
+	sprintf(sbuffer,"**NET : s%d_%d.wts\n",cgen,bi);
+	job.reserveGenomes(glen, 1);
+	job.addGenome(sbuffer, genome[bi]);
+	outputWriter->enqueue(job);
 }
 
 void Evoga::saveBestTeam(QVector< QVector<int> > teams, QVector<double> fitness)
@@ -464,12 +887,9 @@ void Evoga::saveBestTeam(QVector< QVector<int> > teams, QVector<double> fitness)
     int indMax;
 
     char sbuffer[64];
-    FILE *fp;
 
     sprintf(sbuffer,"B%dS%d.G%d.gen",bi+1,this->currentSeed,cgen);
-    if ((fp=fopen(sbuffer, "w")) == nullptr) {
-        Logger::error(QString("I cannot open file B%1S%2.G%3.gen").arg(bi+1).arg(this->currentSeed).arg(cgen));
-    }
+    OutputWriterForEvoga::Job job(OutputWriterForEvoga::Create, QString(sbuffer), QString("I cannot open file B%1S%2.G%3.gen").arg(bi+1).arg(this->currentSeed).arg(cgen));
 
     max = fitness[0];
     indMax = 0;
@@ -480,13 +900,13 @@ void Evoga::saveBestTeam(QVector< QVector<int> > teams, QVector<double> fitness)
         }
     }
 
+    job.reserveGenomes(glen, numModules);
     for(int i=0;i<numModules;i++){
         //now saving
-        fprintf(fp,"**NET : s%d_%d.wts\n",cgen,teams[indMax][i]);
-        saveagenotype(fp,teams[indMax][i]);
+        sprintf(sbuffer,"**NET : s%d_%d.wts\n",cgen,teams[indMax][i]);
+        job.addGenome(sbuffer, genome[teams[indMax][i]]);
     }
-    fclose(fp);
-    fflush(fp);
+    outputWriter->enqueue(job);
 }
 
 
@@ -500,7 +920,6 @@ void Evoga::mreproduce()
 	double bn;
 
 	char sbuffer[64];
-	FILE *fp;
 
 	//first of all we compute fitness stat
 	this->computeFStat();
@@ -521,20 +940,11 @@ void Evoga::mreproduce()
 		//here we save best genome
 		if ((bi+1)<=this->savebest && cgen< this->nogenerations) {
 			sprintf(sbuffer,"B%dS%d.gen",bi+1,this->currentSeed);
-			if (cgen==0) {
-				if ((fp=fopen(sbuffer, "w")) == nullptr) {
-					Logger::error(QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
-				}
-			} else {
-				if ((fp=fopen(sbuffer, "a")) == nullptr) {
-					Logger::error(QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
-				}
-			}
-
-			fprintf(fp,"**NET : s%d_%d.wts\n",cgen,bx);
-			saveagenotype(fp,bx);
-			fflush(fp);
-			fclose(fp);
+			OutputWriterForEvoga::Job job((cgen == 0) ? OutputWriterForEvoga::Create : OutputWriterForEvoga::Append, QString(sbuffer), QString("I cannot open file B%1S%2.gen").arg(bi+1).arg(this->currentSeed));
+			sprintf(sbuffer,"**NET : s%d_%d.wts\n",cgen,bx);
+			job.reserveGenomes(glen, 1);
+			job.addGenome(sbuffer, genome[bx]);
+			outputWriter->enqueue(job);
 		}
 		tfitness[bx]=9999.0;
 	}
@@ -563,7 +973,7 @@ void Evoga::printPop()
 	for(int i = 0; i < this->popSize; i++) {
 		QString output = QString("Fit %1 | ").arg(tfitness[i]);
 		for(int l = 0; l < this->glen; l++) {
-			output += QString("%1 ").arg(this->genome[i][l]);
+			output += QString("%1 ").arg(int(this->genome[i][l]));
 		}
 		Logger::info(output);
 	}
@@ -574,7 +984,7 @@ void Evoga::printBest()
 	for(int i = 0; i < bestgenome.size(); i++) {
 		QString output = QString("Best %d | ").arg(i);
 		for (int s = 0; s < this->glen; s++) {
-			output += QString("%1 ").arg(this->bestgenome[i][s]);
+			output += QString("%1 ").arg(int(this->bestgenome[i][s]));
 		}
 		Logger::info(output);
 	}
@@ -649,82 +1059,67 @@ void Evoga::saveagenotype(FILE *fp, int ind)
 //save all current generation
 void Evoga::saveallg()
 {
-	FILE *fp;
 	char filename[64];
+	char header[64];
 	int i;
 
 	sprintf(filename,"G%dS%d.gen",cgen,currentSeed);
-	if ((fp=fopen(filename, "w+")) == nullptr) {
-		Logger::error(QString("Cannot open file %1").arg(filename));
-	} else {
-		//we save
-		for(i=0;i<this->popSize;i++) {
-			fprintf(fp,"**NET : %d_%d_%d.wts\n",cgen,0,i);
-			this->saveagenotype(fp,i);
-		}
-		fclose( fp );
+	OutputWriterForEvoga::Job job(OutputWriterForEvoga::Create, QString(filename), QString("Cannot open file %1").arg(filename));
+	//we save
+	job.reserveGenomes(glen, popSize);
+	for(i=0;i<this->popSize;i++) {
+		sprintf(header,"**NET : %d_%d_%d.wts\n",cgen,0,i);
+		job.addGenome(header, genome[i]);
 	}
+	outputWriter->enqueue(job);
 }
 
 void Evoga::saveallgComposed(QVector< QVector<int> > composedGen)
 {
-    FILE *fp;
     char filename[64];
+    char sbuffer[64];
     int i;
 
     sprintf(filename,"G%dS%d.composed.gen",cgen,currentSeed);
-    if ((fp=fopen(filename, "w+")) == nullptr) {
-        Logger::error(QString("Cannot open file %1").arg(filename));
-    } else {
-        //we save
-        for(i=0;i<composedGen.size();i++) {
-            fprintf(fp,"**TEAM : %d_%d_%d.wts\n",cgen,0,i);
-            for(int j=0;j<numModules;j++)
-                fprintf(fp,"%d ",composedGen[i][j]);
-
-            fprintf(fp, "\nEND\n");
+    OutputWriterForEvoga::Job job(OutputWriterForEvoga::Create, QString(filename), QString("Cannot open file %1").arg(filename));
+    //we save
+    for(i=0;i<composedGen.size();i++) {
+        sprintf(sbuffer,"**TEAM : %d_%d_%d.wts\n",cgen,0,i);
+        job.text += sbuffer;
+        for(int j=0;j<numModules;j++) {
+            sprintf(sbuffer,"%d ",composedGen[i][j]);
+            job.text += sbuffer;
         }
-        fclose( fp );
+
+        job.text += "\nEND\n";
     }
+    outputWriter->enqueue(job);
 }
 
 
 void Evoga::saveFStat()
 {
-	FILE *fp;
 	char sbuffer[128];
 	sprintf(sbuffer,"statS%d.fit",currentSeed);
-        if (cgen == 0)
-		fp=fopen(sbuffer , "w");
-	else
-		fp=fopen(sbuffer , "a");
+	OutputWriterForEvoga::Job job((cgen == 0) ? OutputWriterForEvoga::Create : OutputWriterForEvoga::Append, QString(sbuffer), "unable to save statistics on a file");
 
-	if (fp != nullptr) {
-		fprintf(fp,"%.3f %.3f %.3f\n",fmax,faverage,fmin);
-		fclose(fp);
-	} else
-		Logger::error("unable to save statistics on a file");
+	sprintf(sbuffer,"%.3f %.3f %.3f\n",fmax,faverage,fmin);
+	job.text = sbuffer;
+	outputWriter->enqueue(job);
 }
 
 void Evoga::saveRStat(QVector<int> subsVec)
 {
-    FILE *fp;
     char sbuffer[128];
     sprintf(sbuffer,"statS%d.ret",currentSeed);
+    OutputWriterForEvoga::Job job((cgen == 0) ? OutputWriterForEvoga::Create : OutputWriterForEvoga::Append, QString(sbuffer), "unable to save statistics of retentions on a file");
 
-    if (cgen == 0)
-        fp=fopen(sbuffer , "w");
-    else
-        fp=fopen(sbuffer , "a");
-
-    if(fp!=nullptr){
-        for(int i=0;i<subsVec.size();i++){
-            fprintf(fp,"%i ",subsVec[i]);
-        }
-        fprintf(fp,"\n");
-        fclose(fp);
-    } else
-        Logger::error("unable to save statistics of retentions on a file");
+    for(int i=0;i<subsVec.size();i++){
+        sprintf(sbuffer,"%i ",subsVec[i]);
+        job.text += sbuffer;
+    }
+    job.text += "\n";
+    outputWriter->enqueue(job);
 }
 
 void Evoga::getLastFStat( double &min, double &max, double &average ) {
@@ -741,7 +1136,7 @@ void Evoga::loadgenotype(FILE *fp, int ind)
 	fscanf(fp, "DYNAMICAL NN\n");
 	for (j=0; j <this->glen; j++) {
 		fscanf(fp,"%d\n",&v);//this->genome[ind][j]);
-		this->genome[ind][j]=v;
+		this->genome[ind][j]=quint8(qBound(0, v, 255));
 	}
 	fscanf(fp, "END\n");
 }
@@ -871,7 +1266,7 @@ void Evoga::setInitialPopulation(int* ge)
 			if(ge[g] == Evonet::DEFAULT_VALUE)
 				genome[i][g] = mrand(256);
 			else
-				genome[i][g] = ge[g];
+				genome[i][g] = quint8(qBound(0, ge[g], 255));
 		}
 }
 
@@ -887,12 +1282,22 @@ int* Evoga::getGenes(int ind)
 #if defined(__GNUC__) && defined(DEVELOPER_WARNINGS)
 	#warning CONTROLLARE INDICE? ALLE VOLTE CRASHA SE NELLA GUI SI SELEZIONA UN INDICE OLTRE IL MASSIMO
 #endif
-	return this->genome[ind];
+	// Expanding genes in the buffer of the calling thread, so that evaluators running in parallel
+	// don't overwrite each other
+	QVector<int>& buffer = genesBuffer.localData();
+	buffer.resize(glen);
+	std::copy(genome[ind], genome[ind] + glen, buffer.begin());
+
+	return buffer.data();
 }
 
 int* Evoga::getBestGenes(int ind)
 {
-	return this->bestgenome[ind];
+	QVector<int>& buffer = bestGenesBuffer.localData();
+	buffer.resize(glen);
+	std::copy(bestgenome[ind], bestgenome[ind] + glen, buffer.begin());
+
+	return buffer.data();
 }
 
 void Evoga::resetGenerationCounter()
@@ -928,7 +1333,9 @@ void Evoga::updateGenomeFromEvonet(int ind) {
 	float wrange = evonet->getWrange();
 
 	for (int i = 0; i<glen; i++) {
-		genome[ind][i] = -(evonet->getFreeParameter(i)-wrange)/(2*wrange)*255;
+		// Parameters outside [-wrange, wrange] would wrap around when converted to a byte
+		const float gene = -(evonet->getFreeParameter(i)-wrange)/(2*wrange)*255;
+		genome[ind][i] = quint8(qBound(0.0f, gene, 255.0f));
 	}
 	/*
 	printf("%s : %d : ",__PRETTY_FUNCTION__,ind);
@@ -946,27 +1353,13 @@ QString Evoga::getEvolutionType()
 
 void Evoga::saveBestFitness()
 {
-	FILE *fp;
 	char sbuffer[128];
 	sprintf(sbuffer, "bestgenS%d.fit", currentSeed);
-	if (cgen == 0)
-	{
-		fp = fopen(sbuffer, "w");
-	}
-	else
-	{
-		fp = fopen(sbuffer, "a");
-	}
+	OutputWriterForEvoga::Job job((cgen == 0) ? OutputWriterForEvoga::Create : OutputWriterForEvoga::Append, QString(sbuffer), "unable to save best generation statistics on a file");
 
-	if (fp != nullptr)
-	{
-		fprintf(fp, "%d %.3f\n", fbestgen, fbest);
-		fclose(fp);
-	}
-	else
-	{
-		Logger::error("unable to save best generation statistics on a file");
-	}
+	sprintf(sbuffer, "%d %.3f\n", fbestgen, fbest);
+	job.text = sbuffer;
+	outputWriter->enqueue(job);
 }
 
 /*
@@ -997,20 +1390,39 @@ void Evoga::    evolveSteadyState()
 	Logger::info("EVOLUTION: steady state");
 	Logger::info("Number of replications: " + QString::number(nreplications));
 
-	// Creating evaluator objects in case of a multithread simulation. Also setting the actual number of threads used
-	QVector<EvaluatorThreadForEvoga*> evaluators(popSize, nullptr);
-	if (numThreads > 1) {
+	// Deciding how many individuals to evaluate in parallel and how many threads each world gets. Each batch
+	// has popSize individuals
+	int evaluationThreads = 1;
+	int worldThreads = 1;
+	if (farmMaster == nullptr) {
+		computeThreadsSplit(popSize, evaluationThreads, worldThreads);
+		exp->setPhysicsThreads(worldThreads);
+	}
+
+	// Creating evaluator objects in case of a multithread simulation. Also setting the actual number of threads used.
+	// We only need one experiment per thread: each evaluator takes genotypes to evaluate from a shared batch.
+	// When workers of a farm evaluate individuals we use the multithread code but no local evaluators
+	const bool useLocalThreads = (evaluationThreads > 1) && (farmMaster == nullptr);
+	QVector<EvaluatorThreadForEvoga*> evaluators(useLocalThreads ? evaluationThreads : 0, nullptr);
+	// The generator used by evaluations when not using multiple threads
+	RandomGenerator evaluationRNG;
+	if (useLocalThreads) {
 		const QString experimentGroup = confPath() + "Experiment";
 		for (int i = 0; i < evaluators.size(); i++) {
 			// Duplicating group
 			const QString copiedExperimentGroup = experimentGroup + ":" + QString::number(i);
 			configurationManager().copyGroup(experimentGroup, copiedExperimentGroup);
+			// Copies must not write to the same trajectory file
+			if (configurationManager().parameterExists(copiedExperimentGroup + "/World/trajectoryFile")) {
+				configurationManager().deleteParameter(copiedExperimentGroup + "/World", "trajectoryFile");
+			}
 
 			EvoRobotExperiment* newExp = configurationManager().getComponentFromGroup<EvoRobotExperiment>(copiedExperimentGroup);
 			newExp->setEvoga(this);
+			newExp->setPhysicsThreads(worldThreads);
 			evaluators[i] = new EvaluatorThreadForEvoga(this, newExp);
 		}
-		QThreadPool::globalInstance()->setMaxThreadCount(numThreads);
+		QThreadPool::globalInstance()->setMaxThreadCount(evaluationThreads);
 	}
 
 	for(rp=0;rp<nreplications;rp++) {	// replications
@@ -1034,7 +1446,7 @@ void Evoga::    evolveSteadyState()
 
 		// Resetting seed in experiments
 		exp->newGASeed(getCurrentSeed());
-		if (numThreads > 1) {
+		if (useLocalThreads) {
 			for (int i = 0; i < evaluators.size(); i++) {
 				evaluators[i]->getExperiment()->newGASeed(getCurrentSeed());
 			}
@@ -1070,15 +1482,12 @@ void Evoga::    evolveSteadyState()
 			Logger::info(" Generation " + QString::number(gn+1));
 			// Here we do this to avoid too many complications: if we have to run no threads, we use the old
 			// code, otherwise we go for the multithread code below
-			if (numThreads <= 1) {
+			if (!useLocalThreads && (farmMaster == nullptr)) {
 				exp->initGeneration(gn);
 				if ( commitStep() ) { return; }
 				// Not running with multiple threads, using the old code
 				for(id=0;id<popSize;id++) {	//individuals
-					fit=0.0;
-					exp->setNetParameters(getGenes(id)); // get the free parameters from the genotype
-					exp->doAllTrialsForIndividual(id);
-					fit = exp->getFitness();
+					fit = evaluateGenotypeForEvoga(exp, evaluationRNG, getGenes(id), getCurrentSeed(), id, getCurrentGeneration());
 					if (averageIndividualFitnessOverGenerations) {
 						tfitness[id] += fit;
 						ntfitness[id]++;
@@ -1093,9 +1502,7 @@ void Evoga::    evolveSteadyState()
                     tfitness[popSize+id]=0;
                     ntfitness[popSize+id]=0;
 
-					exp->setNetParameters(getGenes(popSize)); // get the free parameters from the genotype
-					exp->doAllTrialsForIndividual(popSize + id);
-					fit = exp->getFitness();
+					fit = evaluateGenotypeForEvoga(exp, evaluationRNG, getGenes(popSize + id), getCurrentSeed(), popSize + id, getCurrentGeneration());
 					if (averageIndividualFitnessOverGenerations) {
                         tfitness[popSize+id] += fit;
                         ntfitness[popSize+id]++;
@@ -1114,62 +1521,64 @@ void Evoga::    evolveSteadyState()
 				// Multithread code
 
 				// Calling initGeneration on all evaluator
-				for (int i = 0; i < popSize; i++) {
+				for (int i = 0; i < evaluators.size(); i++) {
 					evaluators[i]->getExperiment()->initGeneration(gn);
 				}
 				if (commitStep()) return; // stop the evolution process
 
-				// We first evaluate all parents, so setting genotypes of parents (we have as many evaluators as individuals)
-				for (int i = 0; i < popSize; i++) {
-					evaluators[i]->setGenotype(i);
+				// We first evaluate all parents (genotypes from 0 to popSize - 1)
+				EvaluationBatchForEvoga parentsBatch(0, popSize);
+				for (int i = 0; i < evaluators.size(); i++) {
+					evaluators[i]->setBatch(&parentsBatch);
 				}
 				if (commitStep()) return; // stop the evolution process
 
 				// Now starting parallel evaluation of parents and wating for it to finish
-				QFuture<void> evaluationFuture = QtConcurrent::map(evaluators, runEvaluatorThreadForEvoga);
-				evaluationFuture.waitForFinished();
+				evaluateBatchForEvoga(farmMaster, evaluators, parentsBatch);
 				if (commitStep()) return; // stop the evolution process
 
 				// We have finished evaluating parents, updating the fitness vectors
 				for (int i = 0; i < popSize; i++) {
 					if (averageIndividualFitnessOverGenerations) {
-						tfitness[evaluators[i]->getGenotypeId()] += evaluators[i]->getFitness();
-						ntfitness[evaluators[i]->getGenotypeId()]++;
+						tfitness[i] += parentsBatch.fitness[i];
+						ntfitness[i]++;
 					} else {
-						tfitness[evaluators[i]->getGenotypeId()] = evaluators[i]->getFitness();
-						ntfitness[evaluators[i]->getGenotypeId()] = 1;
+						tfitness[i] = parentsBatch.fitness[i];
+						ntfitness[i] = 1;
 					}
 				}
 				if (commitStep()) return; // stop the evolution process
 
-				// Now we can generate all children for all individuals and set them in the evaluators
+				// Now we can generate all children for all individuals (genotypes from popSize to 2 * popSize - 1)
 				for (int i = 0; i < popSize; i++) {
 					copyGenes(i, popSize + i, 1); //generate a variation by duplicating and mutating
 					tfitness[popSize + i] = 0;
 					ntfitness[popSize + i] = 0;
-					evaluators[i]->setGenotype(popSize + i);
+				}
+				EvaluationBatchForEvoga childrenBatch(popSize, popSize);
+				for (int i = 0; i < evaluators.size(); i++) {
+					evaluators[i]->setBatch(&childrenBatch);
 				}
 				if (commitStep()) return; // stop the evolution process
 
 				// Now starting parallel evaluation of children and wating for it to finish
-				evaluationFuture = QtConcurrent::map(evaluators, runEvaluatorThreadForEvoga);
-				evaluationFuture.waitForFinished();
+				evaluateBatchForEvoga(farmMaster, evaluators, childrenBatch);
 				if (commitStep()) return; // stop the evolution process
 
-				// We have finished evaluating parents, updating the fitness vectors
+				// We have finished evaluating children, updating the fitness vectors
 				for (int i = 0; i < popSize; i++) {
 					if (averageIndividualFitnessOverGenerations) {
-						tfitness[evaluators[i]->getGenotypeId()] += evaluators[i]->getFitness();
-						ntfitness[evaluators[i]->getGenotypeId()]++;
+						tfitness[popSize + i] += childrenBatch.fitness[i];
+						ntfitness[popSize + i]++;
 					} else {
-						tfitness[evaluators[i]->getGenotypeId()] = evaluators[i]->getFitness();
-						ntfitness[evaluators[i]->getGenotypeId()] = 1;
+						tfitness[popSize + i] = childrenBatch.fitness[i];
+						ntfitness[popSize + i] = 1;
 					}
 				}
 				if (commitStep()) return; // stop the evolution process
 
 				// Calling endGeneration on all evaluator
-				for (int i = 0; i < popSize; i++) {
+				for (int i = 0; i < evaluators.size(); i++) {
 					evaluators[i]->getExperiment()->endGeneration(gn);
 				}
 				if (commitStep()) return; // stop the evolution process
@@ -1245,10 +1654,9 @@ void Evoga::    evolveSteadyState()
 			//remove the previous genfile unless it has to be kept because of the savePopulationEachNGenerations param
 			if ((savePopulationEachNGenerations == 0) || (gn>1 && ((gn-1) % (savePopulationEachNGenerations) != 0))) {
 				//EX: gn 998 = G999S1.gen --- gn 999 = G1000S1.gen --- gn = 1000 = G1001S1.gen --- gn 1001 = G1002S1.gen
+				// The removal is queued after the file has been written
 				sprintf(filename,"G%dS%d.gen",gn,currentSeed);
-				if(!QFile::remove(filename)) {
-					Logger::warning(QString("Error deleting temporary gen file: ") + QString::fromStdString(filename));
-				}
+				outputWriter->enqueue(OutputWriterForEvoga::Job(OutputWriterForEvoga::Remove, QString(filename), QString("Error deleting temporary gen file: ") + QString::fromStdString(filename)));
 			}
 
             Logger::info(QString("Generation %1 took %2 minutes - Best fitness = %3").arg(gn+1).arg((double)evotimer.elapsed()/60000.0, 0, 'f', 2).arg(fmax));
@@ -1260,6 +1668,7 @@ void Evoga::    evolveSteadyState()
 
 		// Save the best generation fitness statistics
 		saveBestFitness();
+		flushOutput();
 	}
 
 	// Deleting all evaluators
@@ -1284,6 +1693,17 @@ void Evoga::evolveGenerational()
 	// Resizing genome
 	genome.resize(popSize);
 
+	// The generator used by evaluations
+	RandomGenerator evaluationRNG;
+
+	// Individuals are evaluated one at a time, so all threads can be given to the physics engine
+	if (farmMaster == nullptr) {
+		int evaluationThreads;
+		int worldThreads;
+		computeThreadsSplit(1, evaluationThreads, worldThreads);
+		exp->setPhysicsThreads(worldThreads);
+	}
+
 	for(rp=0;rp<nreplications;rp++) {// replications
 		startGeneration = 0;
 		setSeed(getStartingSeed()+rp);
@@ -1323,14 +1743,24 @@ void Evoga::evolveGenerational()
 			evotimer.restart();
 			Logger::info(" Generation " + QString::number(gn+1));
 			exp->initGeneration( gn );
-			for(id=0;id<popSize;id++) { //individuals
-				exp->setNetParameters(getGenes(id)); // get the free parameters from the genotype
-				exp->doAllTrialsForIndividual(id);
-				fit = exp->getFitness();
-				tfitness[id]=fit;
+			if (farmMaster != nullptr) {
+				// Workers of the farm evaluate all individuals
+				QVector<double> fitness(popSize, 0.0);
+				farmMaster->evaluate(0, popSize, fitness);
 				if (commitStep()) { // stop evolution
 					return;
 				}
+				for(id=0;id<popSize;id++) {
+					tfitness[id]=fitness[id];
+				}
+			} else {
+				for(id=0;id<popSize;id++) { //individuals
+					fit = evaluateGenotypeForEvoga(exp, evaluationRNG, getGenes(id), getCurrentSeed(), id, getCurrentGeneration());
+					tfitness[id]=fit;
+					if (commitStep()) { // stop evolution
+						return;
+					}
+				}
 			}
 			reproduce();
 
@@ -1348,6 +1778,7 @@ void Evoga::evolveGenerational()
 
 		// Save the best generation fitness statistics
 		saveBestFitness();
+		flushOutput();
 	}
 }
 
@@ -1399,6 +1830,10 @@ void Evoga::configure()
 	savebest = ConfigurationHelper::getInt(configurationManager(), confPath() + "savenbest");
 	elitism = ConfigurationHelper::getBool(configurationManager(), confPath() + "elitism");
 	numThreads = ConfigurationHelper::getInt(configurationManager(), confPath() + "numThreads");
+	physicsThreads = ConfigurationHelper::getInt(configurationManager(), confPath() + "physicsThreads");
+	farmRole = ConfigurationHelper::getEnum(configurationManager(), confPath() + "farmRole");
+	farmAddress = ConfigurationHelper::getString(configurationManager(), confPath() + "farmAddress");
+	farmJobsPerWorker = ConfigurationHelper::getInt(configurationManager(), confPath() + "farmJobsPerWorker");
 	savePopulationEachNGenerations = ConfigurationHelper::getInt(configurationManager(), confPath() + "savePopulationEachNGenerations");
 	averageIndividualFitnessOverGenerations = ConfigurationHelper::getBool(configurationManager(), confPath() + "averageIndividualFitnessOverGenerations");
     saveRetStat = ConfigurationHelper::getBool(configurationManager(), confPath() + "saveRetetionStatistics");
@@ -1455,6 +1890,10 @@ void Evoga::describe(RegisteredComponentDescriptor& d)
 	d.describeInt("savenbest").def(1).limits(1,MaxInteger).help("The number of best genotypes to save each generation");
 	d.describeBool("elitism").def(false).help("If use elitism or not");
 	d.describeInt("numThreads").def(1).limits(1,MaxInteger).help("The number of thread used to parallelize the evaluation of individuals");
+	d.describeInt("physicsThreads").def(1).limits(0,MaxInteger).help("The number of threads used by the physics engine of each experiment", "The numThreads threads are split between parallel evaluations and the physics engine of each experiment: the number of parallel evaluations is numThreads / physicsThreads. If 0, the split is decided automatically, evaluating in parallel as many individuals as possible and giving the remaining threads to the physics engine. This is useful when the population is smaller than the number of threads. The split is the same for the whole evolution and is written in the log. The results of the simulation can change with the number of threads of the physics engine");
+	d.describeEnum("farmRole").def("none").values(QStringList() << "none" << "master" << "worker").help("The role of this process in a farm of processes evaluating individuals", "If \"master\", individuals are not evaluated by this process but sent to worker processes connected to farmAddress (numThreads is ignored). If \"worker\", the evolve action doesn't run the evolution but evaluates individuals received from the master at farmAddress until the master ends the evolution. Workers must use the same configuration as the master (apart from this parameter) and can be started, stopped or restarted at any time. Each worker evaluates one individual at a time, giving the physics engine the same number of threads as an evolution without farm (see physicsThreads), so that results do not depend on the farm");
+	d.describeString("farmAddress").def("salsaEvogaFarm").help("The address of the master of the farm", "If it has the form host:port it is a TCP address (an empty host in the master means listening on all network interfaces), otherwise it is the name of a local socket");
+	d.describeInt("farmJobsPerWorker").def(2).limits(1,MaxInteger).help("The maximum number of individuals sent to a worker that it has not evaluated yet", "Values greater than 1 avoid that workers wait for the master between two evaluations");
 	d.describeInt("savePopulationEachNGenerations").def(0).limits(0,MaxInteger).help("If is zero only the population of the last generation are saved into a file; otherwise it saves the population each N generations done");
 	d.describeReal("mutation_rate").def(0.05).limits(0,100).help("The mutation rate", "The rate at which a mutation will occur during a genotype copy; a real value below 1 (i.e. 0.12) is considered as a rate (i.e. 0.12 correspond to 12% of mutation); a value egual or above 1 is considered as a percentage of mutation (i.e. 25 correspond to 25% of mutation, or 0.25 rate of mutation)");
 	d.describeReal("mutation_decay").def(0.01).limits(0,1).help("At first generation the mutation rate will be always 0.5, and at each generation done the mutation rate will be decreased by this value until it reachs the mutation_rate value");
@@ -1548,6 +1987,17 @@ void Evoga::postConfigureInitialization()
 void Evoga::evolveAllReplicas()
 {
 	stopEvolution = false;
+	if (farmRole == "worker") {
+		runFarmWorker();
+		return;
+	} else if (farmRole == "master") {
+		farmMaster = new EvogaFarmMaster(this, glen, farmJobsPerWorker);
+		if (!farmMaster->listen(farmAddress)) {
+			delete farmMaster;
+			farmMaster = nullptr;
+			return;
+		}
+	}
 	if ( evolutionType == "steadyState" ) {
 		evolveSteadyState();
 	} else if ( evolutionType == "generational" ) {
@@ -1555,6 +2005,11 @@ void Evoga::evolveAllReplicas()
 	} else {
 		Logger::error( QString("Evoga - request to execute a unrecognized evolution type: %1").arg(evolutionType) );
 	}
+	// This also tells workers to quit
+	delete farmMaster;
+	farmMaster = nullptr;
+	// Also reached when the evolution has been stopped: the files must be complete to recover from them
+	flushOutput();
 }
 
 void Evoga::stop() {
@@ -1562,6 +2017,83 @@ void Evoga::stop() {
 	waitForNextStep.wakeAll();
 }
 
+void Evoga::flushOutput() {
+	outputWriter->flush();
+}
+
+void Evoga::runFarmWorker() {
+	EvogaFarmWorkerConnection connection(farmAddress, glen);
+
+	// The generator used by evaluations, see evaluateGenotypeForEvoga()
+	RandomGenerator evaluationRNG;
+
+	// Requests say which seed and generation to use, here we only notify the experiment when they change
+	bool seedSet = false;
+	bool generationStarted = false;
+
+	// The genes of the individual to evaluate are copied in the only genome of the population
+	genome.resize(1);
+
+	// The results of the simulation can depend on the number of threads of the physics engine, so we use the same
+	// split as a local evolution with the same parameters, even if individuals are evaluated one at a time here
+	int evaluationThreads;
+	int worldThreads;
+	computeThreadsSplit((evolutionType == "steadyState") ? popSize : 1, evaluationThreads, worldThreads);
+	exp->setPhysicsThreads(worldThreads);
+	if (evaluationThreads > 1) {
+		Logger::info(QString("Evoga farm worker - individuals are evaluated one at a time, start %1 workers to use all threads").arg(evaluationThreads));
+	}
+
+	Logger::info("Evoga farm worker - connecting to the master at " + farmAddress);
+	while (!isStopped()) {
+		if (!connection.isConnected()) {
+			if (!connection.connectToMaster(1000)) {
+				// The master could not be running yet, retrying later
+				salsa::msleep(1000);
+				continue;
+			}
+			Logger::info("Evoga farm worker - connected to the master at " + farmAddress);
+		}
+
+		EvogaFarmWorkerConnection::Request request;
+		if (!connection.waitForRequest(request, 1000)) {
+			if (!connection.isConnected()) {
+				Logger::warning("Evoga farm worker - connection to the master lost, reconnecting");
+			}
+			continue;
+		}
+		if (request.quit) {
+			Logger::info("Evoga farm worker - the master ended the evolution");
+			break;
+		}
+
+		if (!seedSet || (int(request.seed) != currentSeed)) {
+			setSeed(request.seed);
+			exp->newGASeed(request.seed);
+			seedSet = true;
+		}
+		if (!generationStarted || (request.generation != cgen)) {
+			if (generationStarted) {
+				exp->endGeneration(cgen);
+			}
+			cgen = request.generation;
+			exp->initGeneration(cgen);
+			generationStarted = true;
+		}
+
+		std::copy(request.genes.constBegin(), request.genes.constEnd(), genome[0]);
+		const double fitness = evaluateGenotypeForEvoga(exp, evaluationRNG, getGenes(0), request.seed, request.individual, request.generation);
+		if (isStopped()) {
+			break;
+		}
+		connection.sendResult(request.jobId, fitness);
+	}
+
+	if (generationStarted) {
+		exp->endGeneration(cgen);
+	}
+}
+
 bool Evoga::commitStep() {
 	if ( isStepByStep && !stopEvolution ) {
 		// will block waiting the command for going ahead
@@ -1683,6 +2215,27 @@ QString Evoga::generationFilename()
 void Evoga::doNotUseMultipleThreads()
 {
 	numThreads = 1;
+	physicsThreads = 1;
+}
+
+void Evoga::computeThreadsSplit(int maxParallelEvaluations, int& evaluationThreads, int& worldThreads)
+{
+	const int totalThreads = qMax(1, int(numThreads));
+	maxParallelEvaluations = qMax(1, maxParallelEvaluations);
+
+	if (physicsThreads > 0) {
+		worldThreads = physicsThreads;
+		evaluationThreads = qBound(1, totalThreads / physicsThreads, maxParallelEvaluations);
+	} else if (exp->isKinematicOnlyWorld()) {
+		// The physics engine does nothing in kinematic-only worlds
+		worldThreads = 1;
+		evaluationThreads = qMin(totalThreads, maxParallelEvaluations);
+	} else {
+		evaluationThreads = qMin(totalThreads, maxParallelEvaluations);
+		worldThreads = qMax(1, totalThreads / evaluationThreads);
+	}
+
+	Logger::info(QString("Evoga - evaluating %1 individuals in parallel, the physics engine of each experiment uses %2 threads").arg(evaluationThreads).arg(worldThreads));
 }
 
 QString Evoga::retentionsFilename(unsigned int seed)
@@ -0,0 +1,624 @@
+/********************************************************************************
+ *  SALSA Experiments Library                                                   *
+ *  Copyright (C) 2007-2012                                                     *
+ *  Stefano Nolfi <stefano.nolfi@istc.cnr.it>                                   *
+ *  Onofrio Gigliotta <onofrio.gigliotta@istc.cnr.it>                           *
+ *  Gianluca Massera <emmegian@yahoo.it>                                        *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                         *
+ *                                                                              *
+ *  This program is free software; you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by        *
+ *  the Free Software Foundation; either version 2 of the License, or           *
+ *  (at your option) any later version.                                         *
+ *                                                                              *
+ *  This program is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+ *  GNU General Public License for more details.                                *
+ *                                                                              *
+ *  You should have received a copy of the GNU General Public License           *
+ *  along with this program; if not, write to the Free Software                 *
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA  *
+ ********************************************************************************/
+
+#include "evogafarm.h"
+#include "evoga.h"
+#include "logger.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QHostAddress>
+#include <QDataStream>
+#include <QEventLoop>
+#include <QTimer>
+#include <QtEndian>
+
+namespace salsa {
+
+namespace {
+	// The first value sent by workers, to check that they are really workers
+	const quint32 farmMagicNumber = 0x45564746;
+
+	// The version of the protocol, increase it when the protocol changes
+	const quint32 farmProtocolVersion = 1;
+
+	// Returns true if the address has the form host:port (i.e. it is a TCP
+	// address), false if it is the name of a local socket
+	bool isTcpAddress(const QString& address, QString& host, quint16& port)
+	{
+		const int colon = address.lastIndexOf(':');
+		if (colon < 0) {
+			return false;
+		}
+
+		bool ok;
+		port = address.mid(colon + 1).toUShort(&ok);
+		if (!ok) {
+			return false;
+		}
+		host = address.left(colon);
+
+		return true;
+	}
+
+	// Creates a stream to write a message or read it
+	void setupStream(QDataStream& stream)
+	{
+		stream.setVersion(QDataStream::Qt_5_0);
+	}
+
+	// Waits until all data has been written. Returns false in case of
+	// errors or timeout
+	bool flushDevice(QIODevice* device, int msecs)
+	{
+		while (device->bytesToWrite() > 0) {
+			if (!device->waitForBytesWritten(msecs)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+void EvogaFarmFraming::writeMessage(QIODevice* device, const QByteArray& payload)
+{
+	uchar header[4];
+	qToBigEndian<quint32>(payload.size(), header);
+	device->write(reinterpret_cast<const char*>(header), 4);
+	device->write(payload);
+}
+
+int EvogaFarmFraming::takeMessage(QByteArray& buffer, QByteArray& payload)
+{
+	if (buffer.size() < 4) {
+		return 0;
+	}
+
+	const quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(buffer.constData()));
+	if (size > maxMessageSize) {
+		return -1;
+	}
+	if (quint32(buffer.size() - 4) < size) {
+		return 0;
+	}
+	payload = buffer.mid(4, size);
+	buffer.remove(0, 4 + size);
+
+	return 1;
+}
+
+EvogaFarmMessages::Type EvogaFarmMessages::type(const QByteArray& payload)
+{
+	QDataStream stream(payload);
+	setupStream(stream);
+
+	quint8 type;
+	stream >> type;
+	if ((stream.status() != QDataStream::Ok) || (type < HelloMessage) || (type > QuitMessage)) {
+		return InvalidMessage;
+	}
+
+	return Type(type);
+}
+
+QByteArray EvogaFarmMessages::hello(int genomeLength)
+{
+	QByteArray payload;
+	QDataStream stream(&payload, QIODevice::WriteOnly);
+	setupStream(stream);
+	stream << quint8(HelloMessage) << farmMagicNumber << farmProtocolVersion << qint32(genomeLength);
+
+	return payload;
+}
+
+bool EvogaFarmMessages::readHello(const QByteArray& payload, int& genomeLength)
+{
+	QDataStream stream(payload);
+	setupStream(stream);
+
+	quint8 type;
+	quint32 magic;
+	quint32 version;
+	qint32 length;
+	stream >> type >> magic >> version >> length;
+	if ((stream.status() != QDataStream::Ok) || !stream.atEnd() || (type != HelloMessage) || (magic != farmMagicNumber) || (version != farmProtocolVersion)) {
+		return false;
+	}
+	genomeLength = length;
+
+	return true;
+}
+
+QByteArray EvogaFarmMessages::request(const EvogaFarmRequest& request)
+{
+	QByteArray payload;
+	QDataStream stream(&payload, QIODevice::WriteOnly);
+	setupStream(stream);
+	if (request.quit) {
+		stream << quint8(QuitMessage);
+	} else {
+		stream << quint8(EvaluateMessage) << request.jobId << request.seed << request.generation << request.individual << request.genes;
+	}
+
+	return payload;
+}
+
+bool EvogaFarmMessages::readRequest(const QByteArray& payload, EvogaFarmRequest& request)
+{
+	QDataStream stream(payload);
+	setupStream(stream);
+
+	quint8 type;
+	stream >> type;
+	if (stream.status() != QDataStream::Ok) {
+		return false;
+	}
+
+	if (type == QuitMessage) {
+		request.quit = true;
+
+		return stream.atEnd();
+	} else if (type == EvaluateMessage) {
+		request.quit = false;
+		stream >> request.jobId >> request.seed >> request.generation >> request.individual >> request.genes;
+
+		return (stream.status() == QDataStream::Ok) && stream.atEnd();
+	}
+
+	return false;
+}
+
+QByteArray EvogaFarmMessages::result(quint32 jobId, double fitness)
+{
+	QByteArray payload;
+	QDataStream stream(&payload, QIODevice::WriteOnly);
+	setupStream(stream);
+	stream << quint8(ResultMessage) << jobId << fitness;
+
+	return payload;
+}
+
+bool EvogaFarmMessages::readResult(const QByteArray& payload, quint32& jobId, double& fitness)
+{
+	QDataStream stream(payload);
+	setupStream(stream);
+
+	quint8 type;
+	stream >> type >> jobId >> fitness;
+
+	return (stream.status() == QDataStream::Ok) && stream.atEnd() && (type == ResultMessage);
+}
+
+EvogaFarmMaster::EvogaFarmMaster(Evoga* ga, int genomeLength, int jobsPerWorker)
+	: QObject()
+	, m_ga(ga)
+	, m_genomeLength(genomeLength)
+	, m_jobsPerWorker(qMax(1, jobsPerWorker))
+	, m_address()
+	, m_tcpServer(nullptr)
+	, m_localServer(nullptr)
+	, m_workers()
+	, m_workersOrder()
+	, m_connectionsCounter(0)
+	, m_firstId(0)
+	, m_fitness(nullptr)
+	, m_numDone(0)
+	, m_pendingJobs()
+	, m_jobs()
+	, m_nextJobId(0)
+{
+}
+
+EvogaFarmMaster::~EvogaFarmMaster()
+{
+	EvogaFarmRequest quitRequest;
+	quitRequest.quit = true;
+	const QByteArray payload = EvogaFarmMessages::request(quitRequest);
+
+	foreach (QIODevice* device, m_workersOrder) {
+		device->disconnect(this);
+		EvogaFarmFraming::writeMessage(device, payload);
+		flushDevice(device, 1000);
+		device->close();
+		delete device;
+	}
+
+	// Servers are deleted by QObject because we are their parent
+}
+
+bool EvogaFarmMaster::listen(const QString& address)
+{
+	m_address = address;
+
+	QString host;
+	quint16 port;
+	if (isTcpAddress(address, host, port)) {
+		QHostAddress hostAddress(QHostAddress::Any);
+		if (host == "localhost") {
+			hostAddress = QHostAddress(QHostAddress::LocalHost);
+		} else if (!host.isEmpty() && !hostAddress.setAddress(host)) {
+			Logger::error("Evoga farm - invalid address to listen to: " + address);
+			return false;
+		}
+
+		m_tcpServer = new QTcpServer(this);
+		if (!m_tcpServer->listen(hostAddress, port)) {
+			Logger::error(QString("Evoga farm - cannot listen on %1: %2").arg(address).arg(m_tcpServer->errorString()));
+			return false;
+		}
+		connect(m_tcpServer, SIGNAL(newConnection()), this, SLOT(acceptTcpConnection()));
+	} else {
+		m_localServer = new QLocalServer(this);
+		// Removing the socket left by a master that crashed, if any
+		QLocalServer::removeServer(address);
+		if (!m_localServer->listen(address)) {
+			Logger::error(QString("Evoga farm - cannot listen on %1: %2").arg(address).arg(m_localServer->errorString()));
+			return false;
+		}
+		connect(m_localServer, SIGNAL(newConnection()), this, SLOT(acceptLocalConnection()));
+	}
+
+	Logger::info("Evoga farm - listening for workers on " + address);
+
+	return true;
+}
+
+bool EvogaFarmMaster::evaluate(int firstId, int numIds, QVector<double>& fitness)
+{
+	// Forgetting jobs of a previous evaluation that was stopped. If results
+	// for them arrive, they are discarded
+	for (QHash<QIODevice*, Worker>::iterator it = m_workers.begin(); it != m_workers.end(); ++it) {
+		it->jobs.clear();
+	}
+	m_jobs.clear();
+	m_pendingJobs.clear();
+
+	m_firstId = firstId;
+	m_fitness = &fitness;
+	m_numDone = 0;
+	for (int i = 0; i < numIds; i++) {
+		m_pendingJobs.enqueue(i);
+	}
+
+	if (numWorkers() == 0) {
+		Logger::info("Evoga farm - no workers connected, waiting for workers on " + m_address);
+	}
+	dispatchJobs();
+
+	// Everything happens in slots called by the event loop. The timer wakes
+	// the loop up periodically to check whether evolution has been stopped
+	QTimer stopCheckTimer;
+	stopCheckTimer.start(100);
+	QEventLoop eventLoop;
+	while ((m_numDone < numIds) && !m_ga->isStopped()) {
+		eventLoop.processEvents(QEventLoop::WaitForMoreEvents);
+	}
+
+	m_fitness = nullptr;
+
+	return (m_numDone == numIds);
+}
+
+int EvogaFarmMaster::numWorkers() const
+{
+	int n = 0;
+	foreach (const Worker& worker, m_workers) {
+		if (worker.ready) {
+			n++;
+		}
+	}
+
+	return n;
+}
+
+void EvogaFarmMaster::acceptTcpConnection()
+{
+	while (m_tcpServer->hasPendingConnections()) {
+		QTcpSocket* socket = m_tcpServer->nextPendingConnection();
+		// Messages are small, we don't want them to be delayed
+		socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+		addWorker(socket, QString("%1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort()));
+	}
+}
+
+void EvogaFarmMaster::acceptLocalConnection()
+{
+	while (m_localServer->hasPendingConnections()) {
+		QLocalSocket* socket = m_localServer->nextPendingConnection();
+		addWorker(socket, QString("local worker %1").arg(m_connectionsCounter + 1));
+	}
+}
+
+void EvogaFarmMaster::readFromWorker()
+{
+	QIODevice* const device = qobject_cast<QIODevice*>(sender());
+	if (!m_workers.contains(device)) {
+		return;
+	}
+
+	m_workers[device].buffer.append(device->readAll());
+
+	QByteArray payload;
+	int res;
+	while ((res = EvogaFarmFraming::takeMessage(m_workers[device].buffer, payload)) == 1) {
+		handleMessage(device, m_workers[device], payload);
+
+		// The worker could have been dropped
+		if (!m_workers.contains(device)) {
+			return;
+		}
+	}
+	if (res < 0) {
+		dropWorker(device, "invalid message");
+	}
+}
+
+void EvogaFarmMaster::workerDisconnected()
+{
+	QIODevice* const device = qobject_cast<QIODevice*>(sender());
+	if (m_workers.contains(device)) {
+		dropWorker(device, "connection closed");
+	}
+}
+
+void EvogaFarmMaster::addWorker(QIODevice* device, const QString& name)
+{
+	m_connectionsCounter++;
+
+	Worker worker;
+	worker.name = name;
+	worker.ready = false;
+	m_workers.insert(device, worker);
+	m_workersOrder.append(device);
+
+	connect(device, SIGNAL(readyRead()), this, SLOT(readFromWorker()));
+	connect(device, SIGNAL(disconnected()), this, SLOT(workerDisconnected()));
+}
+
+void EvogaFarmMaster::handleMessage(QIODevice* device, Worker& worker, const QByteArray& payload)
+{
+	const EvogaFarmMessages::Type type = EvogaFarmMessages::type(payload);
+	if ((type == EvogaFarmMessages::HelloMessage) && !worker.ready) {
+		int genomeLength;
+		if (!EvogaFarmMessages::readHello(payload, genomeLength)) {
+			dropWorker(device, "invalid handshake or different protocol version");
+			return;
+		}
+		if (genomeLength != m_genomeLength) {
+			dropWorker(device, QString("genome length is %1 instead of %2").arg(genomeLength).arg(m_genomeLength));
+			return;
+		}
+
+		worker.ready = true;
+		Logger::info(QString("Evoga farm - worker %1 connected, %2 workers available").arg(worker.name).arg(numWorkers()));
+
+		dispatchJobs();
+	} else if ((type == EvogaFarmMessages::ResultMessage) && worker.ready) {
+		quint32 jobId;
+		double fitness;
+		if (!EvogaFarmMessages::readResult(payload, jobId, fitness)) {
+			dropWorker(device, "invalid result");
+			return;
+		}
+
+		// Discarding results of jobs of a previous evaluation
+		if ((m_fitness == nullptr) || !worker.jobs.removeOne(jobId)) {
+			return;
+		}
+		(*m_fitness)[m_jobs.take(jobId)] = fitness;
+		m_numDone++;
+
+		dispatchJobs();
+	} else {
+		dropWorker(device, "unexpected message");
+	}
+}
+
+void EvogaFarmMaster::dropWorker(QIODevice* device, const QString& reason)
+{
+	const Worker worker = m_workers.take(device);
+	m_workersOrder.removeOne(device);
+
+	// The jobs of the worker are given to other workers before the others,
+	// keeping their order
+	for (int i = worker.jobs.size() - 1; i >= 0; i--) {
+		m_pendingJobs.prepend(m_jobs.take(worker.jobs[i]));
+	}
+
+	if (worker.ready) {
+		Logger::warning(QString("Evoga farm - worker %1 dropped (%2), %3 individuals will be evaluated by other workers").arg(worker.name).arg(reason).arg(worker.jobs.size()));
+	} else {
+		Logger::warning(QString("Evoga farm - connection from %1 refused: %2").arg(worker.name).arg(reason));
+	}
+
+	device->disconnect(this);
+	device->close();
+	device->deleteLater();
+
+	dispatchJobs();
+}
+
+void EvogaFarmMaster::dispatchJobs()
+{
+	if (m_fitness == nullptr) {
+		return;
+	}
+
+	foreach (QIODevice* device, m_workersOrder) {
+		Worker& worker = m_workers[device];
+		if (!worker.ready) {
+			continue;
+		}
+
+		while ((worker.jobs.size() < m_jobsPerWorker) && !m_pendingJobs.isEmpty()) {
+			const int index = m_pendingJobs.dequeue();
+			const int id = m_firstId + index;
+			const quint32 jobId = m_nextJobId++;
+
+			EvogaFarmRequest request;
+			request.quit = false;
+			request.jobId = jobId;
+			request.seed = quint32(m_ga->getCurrentSeed());
+			request.generation = qint32(m_ga->getCurrentGeneration());
+			request.individual = qint32(id);
+
+			// Genes take values between 0 and 255, we send them as bytes
+			const int* const genes = m_ga->getGenes(id);
+			request.genes = QByteArray(m_genomeLength, 0);
+			for (int g = 0; g < m_genomeLength; g++) {
+				request.genes[g] = char(genes[g]);
+			}
+
+			EvogaFarmFraming::writeMessage(device, EvogaFarmMessages::request(request));
+
+			worker.jobs.append(jobId);
+			m_jobs.insert(jobId, index);
+		}
+	}
+}
+
+EvogaFarmWorkerConnection::EvogaFarmWorkerConnection(const QString& address, int genomeLength)
+	: m_address(address)
+	, m_genomeLength(genomeLength)
+	, m_tcpSocket(nullptr)
+	, m_localSocket(nullptr)
+	, m_device(nullptr)
+	, m_buffer()
+{
+}
+
+EvogaFarmWorkerConnection::~EvogaFarmWorkerConnection()
+{
+	closeConnection();
+}
+
+bool EvogaFarmWorkerConnection::isConnected() const
+{
+	return (m_device != nullptr);
+}
+
+bool EvogaFarmWorkerConnection::connectToMaster(int msecs)
+{
+	closeConnection();
+
+	QString host;
+	quint16 port;
+	if (isTcpAddress(m_address, host, port)) {
+		m_tcpSocket = new QTcpSocket();
+		m_tcpSocket->connectToHost(host.isEmpty() ? QString("localhost") : host, port);
+		if (!m_tcpSocket->waitForConnected(msecs)) {
+			closeConnection();
+			return false;
+		}
+		m_tcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+		m_device = m_tcpSocket;
+	} else {
+		m_localSocket = new QLocalSocket();
+		m_localSocket->connectToServer(m_address);
+		if (!m_localSocket->waitForConnected(msecs)) {
+			closeConnection();
+			return false;
+		}
+		m_device = m_localSocket;
+	}
+
+	EvogaFarmFraming::writeMessage(m_device, EvogaFarmMessages::hello(m_genomeLength));
+	if (!flushDevice(m_device, msecs)) {
+		closeConnection();
+		return false;
+	}
+
+	return true;
+}
+
+bool EvogaFarmWorkerConnection::waitForRequest(Request& request, int msecs)
+{
+	if (m_device == nullptr) {
+		return false;
+	}
+
+	QByteArray payload;
+	int res = EvogaFarmFraming::takeMessage(m_buffer, payload);
+	while (res == 0) {
+		if (!m_device->waitForReadyRead(msecs)) {
+			// Either a timeout or the connection has been closed
+			const bool connected = (m_tcpSocket != nullptr) ? (m_tcpSocket->state() == QAbstractSocket::ConnectedState) : (m_localSocket->state() == QLocalSocket::ConnectedState);
+			if (!connected) {
+				closeConnection();
+			}
+
+			return false;
+		}
+		m_buffer.append(m_device->readAll());
+		res = EvogaFarmFraming::takeMessage(m_buffer, payload);
+	}
+	if (res < 0) {
+		Logger::error("Evoga farm worker - invalid message from the master");
+		closeConnection();
+		return false;
+	}
+
+	if (EvogaFarmMessages::readRequest(payload, request) && (request.quit || (request.genes.size() == m_genomeLength))) {
+		return true;
+	}
+
+	Logger::error("Evoga farm worker - invalid request from the master");
+	closeConnection();
+
+	return false;
+}
+
+bool EvogaFarmWorkerConnection::sendResult(quint32 jobId, double fitness)
+{
+	if (m_device == nullptr) {
+		return false;
+	}
+
+	EvogaFarmFraming::writeMessage(m_device, EvogaFarmMessages::result(jobId, fitness));
+	if (!flushDevice(m_device, 30000)) {
+		closeConnection();
+		return false;
+	}
+
+	return true;
+}
+
+void EvogaFarmWorkerConnection::closeConnection()
+{
+	if (m_tcpSocket != nullptr) {
+		m_tcpSocket->abort();
+	}
+	if (m_localSocket != nullptr) {
+		m_localSocket->abort();
+	}
+	delete m_tcpSocket;
+	m_tcpSocket = nullptr;
+	delete m_localSocket;
+	m_localSocket = nullptr;
+	m_device = nullptr;
+	m_buffer.clear();
+}
+
+} // end namespace salsa
@@ -61,6 +61,11 @@ EvoRobotExperiment::EvoRobotExperiment(ConfigurationManager& params)
 	, world()
 	, renderersContainer(nullptr)
 	, timestep(0.05f)
+	, kinematicOnlyWorld(false)
+	, trajectoryFile()
+	, trajectoryKeyframeInterval(100)
+	, trajectoryRecorder(nullptr)
+	, physicsThreads(1)
 	, eagents()
 	, gaPhase(NONE)
 	, stopCurrentTrial(false)
@@ -108,6 +113,9 @@ void EvoRobotExperiment::configure()
 
 	// Reading world parameters. We need to do this before calling createWorld because that function uses the parameters
 	timestep = ConfigurationHelper::getReal(configurationManager(), confPath() + "World/timestep");
+	kinematicOnlyWorld = ConfigurationHelper::getBool(configurationManager(), confPath() + "World/kinematicOnly");
+	trajectoryFile = ConfigurationHelper::getString(configurationManager(), confPath() + "World/trajectoryFile");
+	trajectoryKeyframeInterval = ConfigurationHelper::getInt(configurationManager(), confPath() + "World/trajectoryKeyframeInterval");
 	// initializing the stepDelay at the same amount of timestep
 	// will slow down the simulation at real-time pace when the GUI is on
 	stepDelay = timestep * 1000;
@@ -146,6 +154,19 @@ void EvoRobotExperiment::configure()
 		}
 	}
 
+	// In kinematic-only mode the world does not simulate dynamics, so a robot that is not kinematic would not move
+	if (kinematicOnlyWorld) {
+		for (int i = 0; i < eagents.size(); ++i) {
+			if (eagents[i]->robot() == nullptr) {
+				continue;
+			}
+			const RobotOnPlane* robot = dynamic_cast<const RobotOnPlane*>(eagents[i]->robot());
+			if ((robot == nullptr) || !robot->isKinematic()) {
+				ConfigurationHelper::throwUserConfigError(confPath() + "World/kinematicOnly", "true", QString("The robot of agent %1 is not kinematic, it would not move in a world that does not simulate dynamics").arg(i));
+			}
+		}
+	}
+
 	// Declaring the evonet resource
 #warning THIS WILL BE REMOVED WHEN WE HAVE REMOVED/HEAVILY REFACTORED THE Evoga/Evonet/EvorobotExperiment MESS
 	declareResource("evonet", dynamic_cast<Evonet*>(eagents[0]->controller()));
@@ -174,6 +195,9 @@ void EvoRobotExperiment::describe(RegisteredComponentDescriptor& d)
 
 	SubgroupDescriptor& world = d.describeSubgroup("World").help("Parameters affecting the simulated World");
 	world.describeReal("timestep").def(0.05).help("The time in seconds corresponding to one simulated step of the World");
+	world.describeBool("kinematicOnly").def(false).help("Whether the World only contains kinematic objects", "If true the physics engine does not simulate dynamics and the position of objects is sent to it only when needed (e.g. for ray casts). This is much faster but can only be used if all robots are kinematic (e.g. wheeled robots in an arena with kinematic collisions), a configuration error is raised otherwise. Dynamic objects will not move. Objects are still created in the physics engine, which is used for ray casts");
+	world.describeString("trajectoryFile").def("").help("The file where trajectories are recorded", "If not empty, the pose of all objects, the contacts and the inputs and outputs of the controller of each agent are written to this file at every step (see TrajectoryRecorder), so that the simulation can be replayed or analysed later with TrajectoryReader. Use this when testing individuals or when evolving with a single thread: the copies of the experiment used by Evoga to evaluate individuals in parallel do not record trajectories and farm workers write the file in their working directory");
+	world.describeInt("trajectoryKeyframeInterval").def(100).limits(1, MaxInteger).help("The number of steps between two keyframes of the trajectory file", "Keyframes contain the pose of all objects, the other frames only the poses that changed. Reading a frame requires decoding all frames since the previous keyframe");
 }
 
 void EvoRobotExperiment::postConfigureInitialization()
@@ -386,6 +410,19 @@ void EvoRobotExperiment::newGASeed(int seed)
 	localRNG.setSeed(seed);
 }
 
+void EvoRobotExperiment::setPhysicsThreads(int numThreads)
+{
+	physicsThreads = qMax(1, numThreads);
+	if (world.get() != nullptr) {
+		world->setMultiThread(physicsThreads);
+	}
+}
+
+bool EvoRobotExperiment::isKinematicOnlyWorld() const
+{
+	return kinematicOnlyWorld;
+}
+
 void EvoRobotExperiment::setStepDelay(int delay)
 {
 	stepDelay = delay;
@@ -482,6 +519,22 @@ void EvoRobotExperiment::doStep()
 		agent->updateMotors();
 	}
 	beforeWorldAdvance();
+	// recording the activity of controllers, the recorder writes it when the world advances
+	if (trajectoryRecorder != nullptr) {
+		for (int i = 0; i < eagents.size(); i++) {
+			Evonet* evonet = dynamic_cast<Evonet*>(eagents[i]->controller());
+			QVector<real> inputs(evonet->getNoInputs());
+			for (int j = 0; j < inputs.size(); j++) {
+				inputs[j] = evonet->getInput(j);
+			}
+			QVector<real> outputs(evonet->getNoOutputs());
+			for (int j = 0; j < outputs.size(); j++) {
+				outputs[j] = evonet->getOutput(j);
+			}
+			trajectoryRecorder->recordValues(QString("agent%1/inputs").arg(i), inputs);
+			trajectoryRecorder->recordValues(QString("agent%1/outputs").arg(i), outputs);
+		}
+	}
 	// advance the world simulation
 	if (arena != nullptr) {
 		arena->prepareToHandleKinematicRobotCollisions();
@@ -501,10 +554,11 @@ void EvoRobotExperiment::createWorld()
 	// TODO: parametrize the name and the dontUseYarp and all other parameters
 	world.reset(new World("World"));
 	world->setTimeStep(timestep);
+	world->setKinematicOnly(kinematicOnlyWorld);
 	world->setSize(wVector(-2.0f, -2.0f, -0.50f), wVector(+2.0f, +2.0f, +2.0f));
 	world->setFrictionModel("exact");
 	world->setSolverModel("exact");
-	world->setMultiThread(1);
+	world->setMultiThread(physicsThreads);
 
 	declareResource("world", world.get());
 
@@ -512,6 +566,12 @@ void EvoRobotExperiment::createWorld()
 	if (!batchRunning) {
 		renderersContainer = world->createRenderersContainer(TypeToCreate<GUIRenderersContainer>());
 	}
+
+	// Recording trajectories if requested. The recorder is deleted with the world
+	if (!trajectoryFile.isEmpty()) {
+		trajectoryRecorder = world->createRenderersContainer(TypeToCreate<TrajectoryRecorder>(), trajectoryFile, trajectoryKeyframeInterval);
+		Logger::info("Recording trajectories in " + trajectoryFile);
+	}
 }
 
 void EvoRobotExperiment::destroyArena()
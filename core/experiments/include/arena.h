@@ -33,9 +33,12 @@
 #include <QMap>
 #include <QString>
 #include <QSet>
+#include <memory>
 
 namespace salsa {
 
+class KinematicCollisionsBroadPhase;
+
 /**
  * \brief The class modelling an arena
  *
@@ -417,6 +420,14 @@ private:
 	 */
 	void circleCollisionsHandle();
 
+	/**
+	 * \brief Registers all objects in the broad phase grid used by
+	 *        collision handlers
+	 *
+	 * The size of cells depends on the radius of the biggest kinematic robot
+	 */
+	void rebuildBroadPhase();
+
 	/**
 	 * \brief Creates the plane of the arena
 	 *
@@ -483,6 +494,14 @@ private:
 	 */
 	QMap<WheeledRobot2DWrapper*, QSet<PhyObject2DWrapper*> > m_kinematicRobotCollisions;
 
+	/**
+	 * \brief The broad phase of collision detection for kinematic robots
+	 *
+	 * This selects the objects that are near a robot, so that collision
+	 * handlers don't have to check all objects
+	 */
+	std::unique_ptr<KinematicCollisionsBroadPhase> m_broadPhase;
+
 	/**
 	 * \brief The simulated world
 	 */
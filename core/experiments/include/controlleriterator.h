@@ -30,6 +30,7 @@
 #include <QString>
 #include <QColor>
 #include <QMap>
+#include <algorithm>
 
 namespace salsa {
 
@@ -136,6 +137,61 @@ public:
 	 * \param value the value of the current input
 	 */
 	virtual void setInput(real value) = 0;
+
+	/**
+	 * \brief Returns the inputs from the current one to the end of the
+	 *        current block as a contiguous array
+	 *
+	 * This allows to set all inputs of a block at once instead of calling
+	 * setInput() and next() for each of them. Writing to the array doesn't
+	 * change the current input. The array is valid until the current block
+	 * is changed or the controller is modified. Iterators that cannot give
+	 * direct access to inputs (e.g. because they process values in
+	 * setInput()) return nullptr, as this implementation does
+	 * \param size the number of elements of the array is written here
+	 * \return the array of inputs or nullptr if direct access is not
+	 *         possible
+	 */
+	virtual real* inputSpan(int& size)
+	{
+		size = 0;
+
+		return nullptr;
+	}
+
+	/**
+	 * \brief Sets num inputs starting from the current one
+	 *
+	 * This uses inputSpan() if possible, otherwise it calls setInput() and
+	 * next() for each value. In both cases the iterator is then moved past
+	 * the last value that was set, as if next() had been called num times,
+	 * so calls to this function can be mixed with calls to setInput(). If
+	 * num is not positive, nothing is done (the current block may even be
+	 * empty)
+	 * \param values the values of the inputs
+	 * \param num the number of values
+	 */
+	void setInputs(const real* values, int num)
+	{
+		if (num <= 0) {
+			return;
+		}
+
+		int size;
+		real* const inputs = inputSpan(size);
+
+		if ((inputs != nullptr) && (size >= num)) {
+			std::copy(values, values + num, inputs);
+			for (int i = 0; i < num; i++) {
+				next();
+			}
+		} else {
+			for (int i = 0; i < num; i++) {
+				setInput(values[i]);
+				next();
+			}
+		}
+	}
 };
 
 /**
@@ -162,6 +218,59 @@ public:
 	 * \return the value of the current output
 	 */
 	virtual real getOutput() const = 0;
+
+	/**
+	 * \brief Returns the outputs from the current one to the end of the
+	 *        current block as a contiguous array
+	 *
+	 * This is the read-only counterpart of
+	 * AbstractControllerInputIterator::inputSpan(), see its description.
+	 * This implementation returns nullptr
+	 * \param size the number of elements of the array is written here
+	 * \return the array of outputs or nullptr if direct access is not
+	 *         possible
+	 */
+	virtual const real* outputSpan(int& size) const
+	{
+		size = 0;
+
+		return nullptr;
+	}
+
+	/**
+	 * \brief Gets num outputs starting from the current one
+	 *
+	 * This uses outputSpan() if possible, otherwise it calls getOutput()
+	 * and next() for each value. In both cases the iterator is then moved
+	 * past the last value that was read, as if next() had been called num
+	 * times, so calls to this function can be mixed with calls to
+	 * getOutput(). If num is not positive, nothing is done (the current
+	 * block may even be empty)
+	 * \param values the array where outputs are copied. It must have at
+	 *               least num elements
+	 * \param num the number of values
+	 */
+	void getOutputs(real* values, int num)
+	{
+		if (num <= 0) {
+			return;
+		}
+
+		int size;
+		const real* const outputs = outputSpan(size);
+
+		if ((outputs != nullptr) && (size >= num)) {
+			std::copy(outputs, outputs + num, values);
+			for (int i = 0; i < num; i++) {
+				next();
+			}
+		} else {
+			for (int i = 0; i < num; i++) {
+				values[i] = getOutput();
+				next();
+			}
+		}
+	}
 };
 
 } // end namespace salsa
@@ -36,11 +36,13 @@
 #include <cstdlib>
 #include <QString>
 #include <QStringList>
+#include <QVector>
 #include <QColor>
 #include <QDebug>
 #include <QObject>
 #include <QMutex>
 #include <memory>
+#include <array>
 
 // All this stuff is to get rid of annoying warnings...
 #ifdef __GNUC__
@@ -66,6 +68,8 @@ namespace salsa {
 
 class EvonetUI;
 class EvonetIterator;
+class EvonetExecutionPlan;
+class EvonetBatch;
 
 /**
  * \brief The class with data exchanged with the GUI
@@ -125,6 +129,8 @@ class SALSA_EXPERIMENTS_API Evonet : public Controller
 {
 // 	friend class NetworkDialog;
 // 	friend class RendNetwork;
+	friend class EvonetBatch;
+	friend class EvonetIterator;
 
 public:
 	static bool configuresInConstructor()
@@ -134,8 +140,6 @@ public:
 
 	//! \brief The maximum number of stored activation vectors
 	static const int MAXSTOREDACTIVATIONS = 100;
-	//! \brief Maximum number of neurons for a neural network of this type
-	static const int MAXN = 1000;
 	//! \brief DEFAULT_VALUE is used for do not assign values to mut and parameters
 	static const float DEFAULT_VALUE;
 
@@ -145,6 +149,11 @@ public:
 	 */
 	Evonet(ConfigurationManager& params);
 
+	/**
+	 * \brief Destructor
+	 */
+	~Evonet();
+
 	/**
 	 * \brief Configures the object using
 	 */
@@ -421,40 +430,41 @@ public:
 	void activateMonitorUpdate();
 
 	/*!
-	 * deactivate the neurons monitor update
+	 * deactivate the neurons monitor update. This also releases the memory
+	 * used to store past activations
 	 */
 	void deactivateMonitorUpdate();
 
 	/*!
 	 * the labels of the neurons displayed by the graphic widget
 	 */
-	char neuronl[MAXN][10];
+	QVector<QString> neuronl;
 
 	/*!
 	 * the vectors that specify for each neuron whether it should be displayed or not by the neuron monitor widget
 	 */
-	int neurondisplay[MAXN];   // whether neurons should be displayed or not
+	QVector<int> neurondisplay;   // whether neurons should be displayed or not
 
 	/*!
 	 * the matrix that contain the variation range of neurons
 	 * used by the neuron monitor graphic widget
 	 */
-	double neuronrange[MAXN][2];  // the range of variation of the neuron
+	QVector<std::array<double, 2> > neuronrange;  // the range of variation of the neuron
 
 	/*!
 	 * the color used to display the actiovation state of each neuron in the neuron monitor widget
 	 */
-	QColor neurondcolor[MAXN];
+	QVector<QColor> neurondcolor;
 
 	/*!
 	 * a vector that speficy lesioned and unlesioned neurons
 	 */
-	bool neuronlesion[MAXN];    // if >0 the n neurons will be silented
+	QVector<bool> neuronlesion;    // if >0 the n neurons will be silented
 
 	/*!
 	 * the value to be assigned to the state of lesioned neurons
 	 */
-	float neuronlesionVal[MAXN]; //value to be assigned to the lesioned neuron
+	QVector<float> neuronlesionVal; //value to be assigned to the lesioned neuron
 
 	/**
 	 * \brief Set to true if labels or colors have to be updated in the neuron monitor
@@ -476,7 +486,9 @@ public:
 	 * This returns the oldest activation vector and deletes it (memory is
 	 * not freed, simply an internal index is incremented), so that
 	 * subsequent calls will progressively return newer activation vectors.
-	 * Returns nullptr when no activation vector is stored
+	 * Returns nullptr when no activation vector is stored. Activations are
+	 * only stored while the neurons monitor is active and a downloader is
+	 * attached to it
 	 * \return the oldest stored activation or nullptr if no stored activation
 	 *         vector is present
 	 */
@@ -535,9 +547,62 @@ private:
 	 * (i) the property of the neurons (stored in the vectors neurontype[], neuronbias[], neurongain[])
 	 * (ii) the update, connection, and gain blocks (stored in the matrix net_block[b][0])
 	 * (iii) the value of the free parameters
+	 *
+	 * The blocks are not interpreted here: the network is first compiled
+	 * into an execution plan (see compileNet()) which is rebuilt only when
+	 * the architecture or the free parameters change
 	 */
 	void updateNet();
 
+	/*!
+	 * Compile the block description and the free parameters into the
+	 * execution plan used by updateNet()
+	 *
+	 * Parameters are consumed in the same order used by the block
+	 * description. Gains and biases are precomputed, connection weights are
+	 * copied into contiguous column-major matrices (one per connection
+	 * block) and update blocks are split in runs of neurons sharing the same
+	 * activation function. The plan gives the same activations, bit for bit,
+	 * as walking the blocks: each netinput still sums its inputs in the
+	 * original order, only the loop over target neurons is vectorized
+	 */
+	void compileNet();
+
+	/*!
+	 * Compile the block description and the given free parameters into
+	 * plan. This is used by compileNet() and by EvonetBatch, which compiles
+	 * the parameters of many individuals sharing the same architecture
+	 *
+	 * \param plan the plan to fill
+	 * \param params the free parameters, in the same format as freep
+	 */
+	void compilePlan(EvonetExecutionPlan& plan, const float* params) const;
+
+	/*!
+	 * Mark the execution plan as outdated, so that it is rebuilt at the next
+	 * update. This must be called whenever the blocks, the neuron properties,
+	 * the ranges or the free parameters change
+	 */
+	void invalidateExecutionPlan();
+
+	/*!
+	 * Resize all vectors with one element per neuron to nneurons. Elements
+	 * that already existed are kept, new ones get the default values. This
+	 * must be called whenever nneurons changes
+	 */
+	void allocateNeuronStorage();
+
+	/*!
+	 * Store the current activations in the circular buffer of stored
+	 * activations. The buffer is allocated the first time this is called
+	 */
+	void storeActivations();
+
+	/*!
+	 * Release the circular buffer of stored activations
+	 */
+	void releaseStoredActivations();
+
 	/*!
 	 * reset to 0.0 the activation state of all neurons
 	 */
@@ -569,26 +634,26 @@ private:
 	 * the fourth and fifth element contain the id of the first neuron and the number of neurons of the block that send connections (only for connection blocks)
 	 * the sixth element describe whether the parameters are genetic or subjected to learning (in the case of connection blocks)
 	 */
-	int net_block[MAXN][6];
+	QVector<std::array<int, 6> > net_block;
 
 	/*! \brief Vector specifying whether neurons have not or have a bias
 	 *
 	 */
-	int neuronbias[MAXN];
+	QVector<int> neuronbias;
 
 	/*! \brief Vector specifying the neurons type (i.e. the update function associated to the neuron)
 	 * 0=logistic neurons, 1=dynamic neurons with timeconstat parameter, 2=binary neuron, 3=logistic neuron with flatter curve
 	 */
-	int neurontype[MAXN];
+	QVector<int> neurontype;
 
 	/*! \brief Vector specifying whether neurons have not or have a gain parameter
 	 *
 	 */
-	int neurongain[MAXN];
+	QVector<int> neurongain;
 
 	/*! \brief The x and y position of the neurons used to display the architecture with the graphic widget
 	 */
-	int neuronxy[MAXN][2];
+	QVector<std::array<int, 2> > neuronxy;
 
 	/*! \brief the range of the connection weights
 	 */
@@ -611,9 +676,14 @@ private:
 
 	/*! \brief vector containing the activation state of the neurons
 	 */
-	float act[MAXN];
+	QVector<float> act;
 
-	float storedActivations[MAXSTOREDACTIVATIONS][MAXN]; // Stored activations
+	/*! \brief The circular buffer of stored activations
+	 * This contains MAXSTOREDACTIVATIONS vectors of nneurons elements one
+	 * after the other. It is only allocated while activations are sent to
+	 * the neurons monitor (see storeActivations())
+	 */
+	QVector<float> storedActivations;
 
 	int nextStoredActivation;	// The index where the next activation will be stored
 
@@ -622,11 +692,11 @@ private:
 	/*! \brief vector containing the activation state of the sensory neurons
 	 * This vector is updated by the sensors and then used to activate the sensory neurons
 	 */
-	float input[MAXN];
+	QVector<float> input;
 
 	/*! \brief the netinput of the neurons
 	 */
-	float netinput[MAXN];
+	QVector<float> netinput;
 
 	/*! \brief vector containing the value of the parameters (gains, biases, connection weights, time constants)
 	 */
@@ -690,6 +760,188 @@ private:
 	EvonetIterator* m_evonetIterator;
 	int m_inputCurIndex;
 	int m_outputCurIndex;
+
+	/**
+	 * \brief The execution plan built by compileNet()
+	 */
+	std::unique_ptr<EvonetExecutionPlan> m_plan;
+
+	/**
+	 * \brief Whether m_plan has to be rebuilt before the next update
+	 */
+	bool m_planOutdated;
+};
+
+/**
+ * \brief Evaluates many Evonet networks with the same architecture at once
+ *
+ * The networks share the architecture of an existing Evonet and differ only
+ * in their free parameters (e.g. the individuals of a population). All
+ * parameters and activations are stored in matrices with one row for each
+ * parameter or neuron and one column for each network. Rows are contiguous in
+ * memory, so each operation of the execution plan of Evonet is performed for
+ * all networks with a single vectorized pass. The activations of each network
+ * are the same computed by an Evonet with the same parameters.
+ *
+ * Use this to step the controllers of many robots simulated in lockstep:
+ * copy the inputs of the i-th robot in the i-th column of inputs(), call
+ * updateNet() once and read the outputs with getOutput(). The architecture is
+ * copied when this object is created, later changes to the Evonet are not
+ * seen
+ * \ingroup experiments_utils
+ */
+class SALSA_EXPERIMENTS_API EvonetBatch
+{
+public:
+	/**
+	 * \brief The type of matrices with one column for each network
+	 */
+	typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Matrix;
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * All networks have zero parameters after construction, call
+	 * setParameters() for each one of them
+	 * \param net the network whose architecture is used
+	 * \param size the number of networks
+	 */
+	EvonetBatch(const Evonet* net, int size);
+
+	/**
+	 * \brief Destructor
+	 */
+	~EvonetBatch();
+
+	/**
+	 * \brief Returns the number of networks
+	 *
+	 * \return the number of networks
+	 */
+	int size() const
+	{
+		return m_size;
+	}
+
+	/**
+	 * \brief Returns the number of free parameters of each network
+	 *
+	 * \return the number of free parameters of each network
+	 */
+	int freeParameters() const
+	{
+		return m_nparameters;
+	}
+
+	/**
+	 * \brief Sets the free parameters of a network
+	 *
+	 * \param individual the index of the network
+	 * \param dt the parameters, in the same format of
+	 *           Evonet::setParameters(const float*)
+	 */
+	void setParameters(int individual, const float* dt);
+
+	/**
+	 * \brief Sets the free parameters of a network from an integer genotype
+	 *
+	 * \param individual the index of the network
+	 * \param dt the genes, in the same format of
+	 *           Evonet::setParameters(const int*)
+	 */
+	void setParameters(int individual, const int* dt);
+
+	/**
+	 * \brief Resets the activations of all networks
+	 */
+	void resetNet();
+
+	/**
+	 * \brief Resets the activations of a network
+	 *
+	 * \param individual the index of the network
+	 */
+	void resetNet(int individual);
+
+	/**
+	 * \brief Returns the inputs of the networks
+	 *
+	 * The matrix has one row for each input neuron and one column for each
+	 * network. Set inputs here before calling updateNet()
+	 * \return the inputs of the networks
+	 */
+	Matrix& inputs()
+	{
+		return m_input;
+	}
+
+	/**
+	 * \brief Returns the activations of all neurons of the networks
+	 *
+	 * \return the activations, one row for each neuron and one column for
+	 *         each network
+	 */
+	const Matrix& activations() const
+	{
+		return m_act;
+	}
+
+	/**
+	 * \brief Returns the activation of an output neuron of a network
+	 *
+	 * \param individual the index of the network
+	 * \param out the index of the output neuron
+	 * \return the activation of the output neuron
+	 */
+	float getOutput(int individual, int out) const
+	{
+		return m_act(m_firstOutput + out, individual);
+	}
+
+	/**
+	 * \brief Performs a step of all networks
+	 */
+	void updateNet();
+
+private:
+	// The network whose architecture we use. Only used to compile parameters
+	const Evonet* const m_net;
+	// The number of networks
+	const int m_size;
+	// The number of free parameters of each network
+	const int m_nparameters;
+	// The index of the first output neuron
+	const int m_firstOutput;
+	// The execution plan. Only the operations are used, parameters are in the matrices below
+	std::unique_ptr<EvonetExecutionPlan> m_plan;
+	// The initial netinput of each neuron
+	Matrix m_bias;
+	// The gain of each neuron, before gain blocks are applied
+	Matrix m_gain;
+	// The weights of connection blocks, in the same order as in the plan
+	Matrix m_weights;
+	// The time constants of delta neurons, in the same order as in the plan
+	Matrix m_deltas;
+	// The working copy of gains (only used when there are gain blocks)
+	Matrix m_gainWork;
+	// The inputs of the networks
+	Matrix m_input;
+	// The activations of the networks
+	Matrix m_act;
+	// The netinputs of the networks
+	Matrix m_netinput;
+	// The activation of a source neuron multiplied by its gain
+	Eigen::Array<float, 1, Eigen::Dynamic> m_scaled;
+	// The indices of lesioned neurons and the value to use for them
+	QVector<int> m_lesioned;
+	QVector<float> m_lesionedVal;
+
+	// Copy constructor. Here to prevent usage
+	EvonetBatch(const EvonetBatch& other);
+
+	// Copy operator. Here to prevent usage
+	EvonetBatch& operator=(const EvonetBatch& other);
 };
 
 } // end namespace salsa
@@ -291,13 +291,33 @@ public:
 	 */
 	virtual real getOutput() const;
 
+	/**
+	 * \brief Returns the inputs from the current one to the end of the
+	 *        current block as a contiguous array
+	 *
+	 * \param size the number of elements of the array is written here
+	 * \return the array of inputs or nullptr if the block has no inputs
+	 *         of the network
+	 */
+	virtual real* inputSpan(int& size);
+
+	/**
+	 * \brief Returns the outputs from the current one to the end of the
+	 *        current block as a contiguous array
+	 *
+	 * \param size the number of elements of the array is written here
+	 * \return the array of outputs or nullptr if the block has no outputs
+	 *         of the network
+	 */
+	virtual const real* outputSpan(int& size) const;
+
 private:
 	// Checks the user is not attempting to do something nasty (e.g. access
 	// values outside range). This is called by setInput(), getOutput() and
 	// setGraphicProperties() to check everything is ok. If something goes
 	// wrong an exception is thrown. funcName is the name of the calling
 	// function (just to write a more informational message)
-	void checkCurrentStatus(const QString& funcName) const;
+	void checkCurrentStatus(const char* funcName) const;
 
 	int layerIndexToLinearIndex(int index, Layer layer) const;
 
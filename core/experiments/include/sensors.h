@@ -31,6 +31,7 @@
 #include "baseexception.h"
 #include "intervals.h"
 #include <QVector>
+#include <memory>
 
 namespace salsa {
 
@@ -811,6 +812,8 @@ private:
 	char m_errorMessage[1024];
 };
 
+class SampledIRTable;
+
 /**
  * \brief An helper class to load sampled data from file
  *
@@ -844,6 +847,14 @@ private:
  *       common to take angles positive counterclockwise. This class takes care
  *       of the conversion, so positive angles are considered counterclockwise
  *       as usual
+ *
+ * Samples are read only once per process: all instances loading the same
+ * file share the same immutable table (files are identified by their
+ * canonical path, size and modification time). The table is released when
+ * the last instance using it is destroyed. Samples can also be stored in a
+ * binary file (see saveBinary()) that is much faster to load than the text
+ * one. The format of a file is detected when it is loaded, so a binary file
+ * can be used wherever a .sam file is expected
  */
 class SALSA_EXPERIMENTS_API SampledIRDataLoader
 {
@@ -956,6 +967,18 @@ public:
 	 */
 	QVector<unsigned int>::const_iterator getActivation(real dist, real ang) const;
 
+	/**
+	 * \brief Saves samples in binary format
+	 *
+	 * The binary file is a header (the "SALSASAM" magic string, the version
+	 * of the format and the five values of the first line of .sam files,
+	 * with distances in meters) followed by all activations as 16 bits
+	 * unsigned integers. All values are little endian
+	 * \param filename the name of the file to write
+	 * \return true if the file was written successfully
+	 */
+	bool saveBinary(QString filename) const;
+
 private:
 	/**
 	 * \brief Returns the index in m_activations for the given IR id,
@@ -1003,20 +1026,10 @@ private:
 	real m_finalDistance;
 
 	/**
-	 * \brief The vector with activations
-	 *
-	 * This is a linear vector containing all the data. To convert to/from
-	 * linear indexes use the getLinearIndex and getIndexes functions above
-	 */
-	QVector<unsigned int> m_activations;
-
-	/**
-	 * \brief The vector with null activations
-	 *
-	 * This is a vector with all 0 values, used when returning activations
-	 * further than the limit distance
+	 * \brief The table with activations, shared by all instances loading
+	 *        the same file
 	 */
-	QVector<unsigned int> m_nullActivations;
+	std::shared_ptr<const SampledIRTable> m_table;
 };
 
 // /**
@@ -28,6 +28,11 @@
 #include "robots.h"
 #include "utilitiesexceptions.h"
 #include "randomgenerator.h"
+#include "phycylinder.h"
+#include "physphere.h"
+#include <QHash>
+#include <algorithm>
+#include <cmath>
 
 namespace salsa {
 
@@ -81,8 +86,306 @@ namespace {
 	 * \internal
 	 */
 	const real defaultLightBulbRadius = 0.01f;
+
+	/**
+	 * \brief The margin added to bounding boxes in the broad phase of
+	 *        collision detection, to absorb rounding errors
+	 *
+	 * \internal
+	 */
+	const real broadPhaseMargin = 0.001f;
+
+	/**
+	 * \brief The maximum number of cells of the broad phase grid
+	 *
+	 * \internal
+	 */
+	const int broadPhaseMaxCells = 65536;
+
+	/**
+	 * \brief The maximum number of cells an object can cover in the broad
+	 *        phase grid. Bigger objects (e.g. walls) are always checked
+	 *
+	 * \internal
+	 */
+	const int broadPhaseMaxCellsPerObject = 64;
 }
 
+/**
+ * \brief The broad phase of the collision detection for kinematic robots
+ *
+ * This is a uniform grid on the plane in which objects are registered using
+ * their bounding boxes. Only objects whose bounding box overlaps the one of
+ * a robot are passed to the narrow phase (i.e.
+ * PhyObject2DWrapper::computeDistanceAndOrientationFromRobot()). Bounding
+ * boxes are conservative, so the result is the same as checking all objects.
+ * Objects whose bounding box cannot be computed, objects that are too big
+ * and objects in invalid positions are always returned as candidates.
+ * Candidates are returned sorted by their index in the list of objects, so
+ * that collisions are handled in the same order as with a linear scan
+ *
+ * \internal
+ */
+class SALSA_EXPERIMENTS_INTERNAL KinematicCollisionsBroadPhase
+{
+public:
+	KinematicCollisionsBroadPhase()
+		: m_objects(nullptr)
+		, m_cellSize(1.0)
+		, m_minX(0.0)
+		, m_minY(0.0)
+		, m_numCellsX(0)
+		, m_numCellsY(0)
+		, m_cells()
+		, m_alwaysChecked()
+		, m_ranges()
+		, m_indexes()
+		, m_queryStamps()
+		, m_currentStamp(0)
+		, m_candidates()
+	{
+	}
+
+	// Registers all objects in the grid. The list of objects must not change
+	// until the next call to this function. cellSize is the minimum size of
+	// cells
+	void rebuild(const QVector<PhyObject2DWrapper*>& objects, real cellSize)
+	{
+		m_objects = &objects;
+		m_indexes.clear();
+		m_alwaysChecked.clear();
+		m_ranges.resize(objects.size());
+		m_queryStamps.fill(0, objects.size());
+		m_currentStamp = 0;
+
+		// Computing bounding boxes and the area covered by objects
+		QVector<BoundingBox> boxes(objects.size());
+		bool emptyArea = true;
+		real areaMinX = 0.0;
+		real areaMinY = 0.0;
+		real areaMaxX = 0.0;
+		real areaMaxY = 0.0;
+		for (int i = 0; i < objects.size(); i++) {
+			m_indexes.insert(objects[i], i);
+			boxes[i] = boundingBox(objects[i]);
+			if (boxes[i].valid) {
+				areaMinX = emptyArea ? boxes[i].minX : min(areaMinX, boxes[i].minX);
+				areaMinY = emptyArea ? boxes[i].minY : min(areaMinY, boxes[i].minY);
+				areaMaxX = emptyArea ? boxes[i].maxX : max(areaMaxX, boxes[i].maxX);
+				areaMaxY = emptyArea ? boxes[i].maxY : max(areaMaxY, boxes[i].maxY);
+				emptyArea = false;
+			}
+		}
+
+		// Computing the size of the grid, enlarging cells if there are too many
+		m_cellSize = max(cellSize, broadPhaseMargin);
+		m_minX = areaMinX;
+		m_minY = areaMinY;
+		double numCellsX;
+		double numCellsY;
+		while (true) {
+			numCellsX = ceil(double(areaMaxX - areaMinX) / m_cellSize) + 1.0;
+			numCellsY = ceil(double(areaMaxY - areaMinY) / m_cellSize) + 1.0;
+			if ((numCellsX * numCellsY) <= broadPhaseMaxCells) {
+				break;
+			}
+			m_cellSize *= 2.0;
+		}
+		m_numCellsX = int(numCellsX);
+		m_numCellsY = int(numCellsY);
+		m_cells.resize(m_numCellsX * m_numCellsY);
+		for (int c = 0; c < m_cells.size(); c++) {
+			m_cells[c].clear();
+		}
+
+		// Adding objects
+		for (int i = 0; i < objects.size(); i++) {
+			insert(i, boxes[i]);
+		}
+	}
+
+	// Updates the cells of an object after it has been moved
+	void update(PhyObject2DWrapper* obj)
+	{
+		const int i = m_indexes.value(obj, -1);
+		if (i == -1) {
+			return;
+		}
+
+		// Removing the object from its cells (objects that are always checked stay so)
+		const CellRange& range = m_ranges[i];
+		if (!range.inGrid) {
+			return;
+		}
+		for (int y = range.minY; y <= range.maxY; y++) {
+			for (int x = range.minX; x <= range.maxX; x++) {
+				m_cells[cellIndex(x, y)].removeOne(i);
+			}
+		}
+
+		insert(i, boundingBox(obj));
+	}
+
+	// Returns the indexes of the objects which could collide with the robot,
+	// sorted in ascending order. The returned vector is valid until the
+	// next call to this function
+	const QVector<int>& candidates(const WheeledRobot2DWrapper* robot)
+	{
+		m_candidates.clear();
+
+		const BoundingBox box = boundingBox(robot);
+		if (!box.valid) {
+			// Returning all objects, the grid cannot be used
+			for (int i = 0; i < m_objects->size(); i++) {
+				m_candidates.append(i);
+			}
+
+			return m_candidates;
+		}
+
+		// Using a stamp to add objects spanning multiple cells only once
+		++m_currentStamp;
+		foreach (int i, m_alwaysChecked) {
+			m_queryStamps[i] = m_currentStamp;
+			m_candidates.append(i);
+		}
+		const CellRange range = cellRange(box);
+		for (int y = range.minY; y <= range.maxY; y++) {
+			for (int x = range.minX; x <= range.maxX; x++) {
+				foreach (int i, m_cells[cellIndex(x, y)]) {
+					if (m_queryStamps[i] != m_currentStamp) {
+						m_queryStamps[i] = m_currentStamp;
+						m_candidates.append(i);
+					}
+				}
+			}
+		}
+
+		std::sort(m_candidates.begin(), m_candidates.end());
+
+		return m_candidates;
+	}
+
+private:
+	struct BoundingBox
+	{
+		bool valid;
+		real minX;
+		real minY;
+		real maxX;
+		real maxY;
+	};
+
+	struct CellRange
+	{
+		bool inGrid;
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	// Returns the bounding box of the object on the plane. The box is not
+	// valid if it cannot be computed for the object
+	static BoundingBox boundingBox(const PhyObject2DWrapper* obj)
+	{
+		BoundingBox box;
+		box.valid = false;
+
+		const wVector pos = obj->position();
+		real halfX;
+		real halfY;
+		if (dynamic_cast<const WheeledRobot2DWrapper*>(obj) != nullptr) {
+			halfX = halfY = dynamic_cast<const WheeledRobot2DWrapper*>(obj)->getRadius();
+		} else if (dynamic_cast<const Cylinder2DWrapper*>(obj) != nullptr) {
+			halfX = halfY = dynamic_cast<const Cylinder2DWrapper*>(obj)->phyObject()->radius();
+		} else if (dynamic_cast<const Sphere2DWrapper*>(obj) != nullptr) {
+			halfX = halfY = dynamic_cast<const Sphere2DWrapper*>(obj)->phyObject()->radius();
+		} else if (dynamic_cast<const Box2DWrapper*>(obj) != nullptr) {
+			// Distances from boxes are computed in the frame of reference of the box, so we can only use
+			// the bounding box if the box lies on the plane (i.e. its z axis is vertical)
+			const PhyBox* phyBox = dynamic_cast<const Box2DWrapper*>(obj)->phyObject();
+			const wMatrix& mtr = phyBox->matrix();
+			if ((fabs(mtr.z_ax.x) > 0.000001) || (fabs(mtr.z_ax.y) > 0.000001)) {
+				return box;
+			}
+			halfX = (fabs(mtr.x_ax.x) * phyBox->sideX() + fabs(mtr.y_ax.x) * phyBox->sideY()) / 2.0;
+			halfY = (fabs(mtr.x_ax.y) * phyBox->sideX() + fabs(mtr.y_ax.y) * phyBox->sideY()) / 2.0;
+		} else {
+			return box;
+		}
+
+		box.minX = pos.x - halfX - broadPhaseMargin;
+		box.minY = pos.y - halfY - broadPhaseMargin;
+		box.maxX = pos.x + halfX + broadPhaseMargin;
+		box.maxY = pos.y + halfY + broadPhaseMargin;
+		box.valid = std::isfinite(box.minX) && std::isfinite(box.minY) && std::isfinite(box.maxX) && std::isfinite(box.maxY);
+
+		return box;
+	}
+
+	// Returns the cell coordinate for the given position. Positions outside
+	// the grid are clamped, which keeps overlapping ranges overlapping
+	int cellCoordinate(real v, real minV, int numCells) const
+	{
+		return int(qBound(0.0, double(floor((v - minV) / m_cellSize)), double(numCells - 1)));
+	}
+
+	CellRange cellRange(const BoundingBox& box) const
+	{
+		CellRange range;
+
+		range.inGrid = true;
+		range.minX = cellCoordinate(box.minX, m_minX, m_numCellsX);
+		range.minY = cellCoordinate(box.minY, m_minY, m_numCellsY);
+		range.maxX = cellCoordinate(box.maxX, m_minX, m_numCellsX);
+		range.maxY = cellCoordinate(box.maxY, m_minY, m_numCellsY);
+
+		return range;
+	}
+
+	int cellIndex(int x, int y) const
+	{
+		return y * m_numCellsX + x;
+	}
+
+	void insert(int i, const BoundingBox& box)
+	{
+		CellRange range;
+		if (box.valid) {
+			range = cellRange(box);
+			range.inGrid = (((range.maxX - range.minX + 1) * (range.maxY - range.minY + 1)) <= broadPhaseMaxCellsPerObject);
+		} else {
+			range.inGrid = false;
+		}
+		m_ranges[i] = range;
+
+		if (range.inGrid) {
+			for (int y = range.minY; y <= range.maxY; y++) {
+				for (int x = range.minX; x <= range.maxX; x++) {
+					m_cells[cellIndex(x, y)].append(i);
+				}
+			}
+		} else {
+			m_alwaysChecked.append(i);
+		}
+	}
+
+	const QVector<PhyObject2DWrapper*>* m_objects;
+	real m_cellSize;
+	real m_minX;
+	real m_minY;
+	int m_numCellsX;
+	int m_numCellsY;
+	QVector<QVector<int> > m_cells;
+	QVector<int> m_alwaysChecked;
+	QVector<CellRange> m_ranges;
+	QHash<const PhyObject2DWrapper*, int> m_indexes;
+	QVector<int> m_queryStamps;
+	int m_currentStamp;
+	QVector<int> m_candidates;
+};
+
 Arena::KinematicCollisionHandlers Arena::stringToCollisionHandler(QString str)
 {
 	str = str.toLower();
@@ -120,6 +423,7 @@ Arena::Arena(ConfigurationManager& params)
 	, m_plane(createPlane(m_z))
 	, m_robotResourceWrappers()
 	, m_kinematicRobotCollisions()
+	, m_broadPhase(new KinematicCollisionsBroadPhase())
 	, m_world(nullptr)
 {
 	addNotifiedResource("world");
@@ -471,6 +775,19 @@ void Arena::resourceChanged(QString name, Component* owner, ResourceChangeType c
 	}
 }
 
+void Arena::rebuildBroadPhase()
+{
+	// Cells are big enough to contain a few robots
+	real maxRobotRadius = 0.0;
+	foreach (WheeledRobot2DWrapper* robot, m_robotResourceWrappers) {
+		if ((robot != nullptr) && (robot->robotOnPlane()->isKinematic())) {
+			maxRobotRadius = max(maxRobotRadius, real(robot->getRadius()));
+		}
+	}
+
+	m_broadPhase->rebuild(m_objects2DList, 4.0 * maxRobotRadius);
+}
+
 void Arena::simpleCollisionsPreAdvance()
 {
 	// Cycling through the list of robots and storing the matrix
@@ -488,8 +805,9 @@ void Arena::simpleCollisionsPreAdvance()
 
 void Arena::simpleCollisionsHandle()
 {
-	// Here we use a naive approach: we check collision of every object with every robot. This is not
-	// the best possible algorithm (complexity is O(n^2)...), but it's the way things are done in evorobot
+	// We check collision of every robot with the objects that are near it (selected using the broad phase grid). This
+	// gives the same result as checking every object with every robot, which is the way things are done in evorobot
+	rebuildBroadPhase();
 
 	// Cycling through the list of robots
 	foreach (WheeledRobot2DWrapper* robot, m_robotResourceWrappers) {
@@ -500,7 +818,9 @@ void Arena::simpleCollisionsHandle()
 
 		bool collides = false;
 		// Checking if the robot collides
-		foreach (PhyObject2DWrapper* obj, m_objects2DList) {
+		foreach (int objIndex, m_broadPhase->candidates(robot)) {
+			PhyObject2DWrapper* obj = m_objects2DList[objIndex];
+
 			// Not checking the collision of the robot with itself (obviously...) and
 			// not checking collisions with non-collidable objects
 			if ((obj == robot) || ((obj->phyObject() != nullptr) && (obj->phyObject()->isCollidable() == false))) {
@@ -538,6 +858,7 @@ void Arena::simpleCollisionsHandle()
 		// If the robot collides with something else, moving it back to its previous position
 		if (collides) {
 			robot->wObject()->setMatrix(robot->previousMatrix());
+			m_broadPhase->update(robot);
 		}
 	}
 }
@@ -559,10 +880,10 @@ void Arena::circleCollisionsPreAdvance()
 
 void Arena::circleCollisionsHandle()
 {
-	// Here we use a naive approach: we check collision of every object with every robot like in the other implementation
-	// (simpleCollisions). If the robot collides with a non-static object, we move the object forward and the robot a bit
-	// backward. The percentage of the robot displacement which is transferred to the object is defined by the constant
-	// below (not a parameter because this part should probably be re-written from scratch)
+	// We check collision of every robot with the objects near it like in the other implementation (simpleCollisions). If
+	// the robot collides with a non-static object, we move the object forward and the robot a bit backward. The
+	// percentage of the robot displacement which is transferred to the object is defined by the constant below (not a
+	// parameter because this part should probably be re-written from scratch)
 	const real robotDisplacementFractionToObject = 0.5;
 	// If the robot collides with another robot we move both robots backward to resolve the collision, if it collides with
 	// a static object, we move only the colliding robot bacward. In both cases we add some noise to the position and
@@ -570,6 +891,8 @@ void Arena::circleCollisionsHandle()
 	const real noiseOnPosition = 0.05f; // Absolute, added to k, see below
 	const real noiseOnOrientation = PI_GRECO * 0.005f; // Absolute maximum angular displacement
 
+	rebuildBroadPhase();
+
 	// Cycling through the list of robots
 	foreach (WheeledRobot2DWrapper* robot, m_robotResourceWrappers) {
 		// We only act on kinematic robots
@@ -584,7 +907,9 @@ void Arena::circleCollisionsHandle()
 
 		// Checking if the robot collides
 		bool collides = false;
-		foreach (PhyObject2DWrapper* obj, m_objects2DList) {
+		foreach (int objIndex, m_broadPhase->candidates(robot)) {
+			PhyObject2DWrapper* obj = m_objects2DList[objIndex];
+
 			// Not checking the collision of the robot with itself (obviously...) and
 			// not checking collisions with non-collidable objects
 			if ((obj == robot) || ((obj->phyObject() != nullptr) && (obj->phyObject()->isCollidable() == false))) {
@@ -648,12 +973,14 @@ void Arena::circleCollisionsHandle()
 				wMatrix robotMtr = robot->wObject()->matrix();
 				robotMtr.w_pos -= objectDisplacement;
 				robot->wObject()->setMatrix(robotMtr);
+				m_broadPhase->update(robot);
 
 				// Now moving objects
 				foreach (PhyObject2DWrapper* obj, collidingObjs) {
 					wMatrix objectMtr = obj->wObject()->matrix();
 					objectMtr.w_pos += objectDisplacement;
 					obj->wObject()->setMatrix(objectMtr);
+					m_broadPhase->update(obj);
 				}
 			} else {
 				if (dynamic_cast<WheeledRobot2DWrapper*>(firstStaticObj) != nullptr) {
@@ -718,6 +1045,7 @@ void Arena::circleCollisionsHandle()
 						wMatrix robotMtr = robot->wObject()->matrix();
 						robotMtr.w_pos.x = sqrt(-1.0);
 						robot->wObject()->setMatrix(robotMtr);
+						m_broadPhase->update(robot);
 						continue;
 					} else if (k < 0.0) {
 						continue;
@@ -730,12 +1058,14 @@ void Arena::circleCollisionsHandle()
 					robotMtr = robotMtr.rotateAround(wVector::Z(), robotMtr.w_pos, globalRNG->getDouble(-noiseOnOrientation, noiseOnOrientation));
 					robotMtr.w_pos = robotPos;
 					robot->wObject()->setMatrix(robotMtr);
+					m_broadPhase->update(robot);
 					// Second robot
 					robotMtr = otherRobot->wObject()->matrix();
 					robotPos = robotMtr.w_pos - v2.scale(k + globalRNG->getDouble(0.0, noiseOnPosition));
 					robotMtr = robotMtr.rotateAround(wVector::Z(), robotMtr.w_pos, globalRNG->getDouble(-noiseOnOrientation, noiseOnOrientation));
 					robotMtr.w_pos = robotPos;
 					otherRobot->wObject()->setMatrix(robotMtr);
+					m_broadPhase->update(otherRobot);
 				} else if (dynamic_cast<Box2DWrapper*>(firstStaticObj) != nullptr) {
 #if defined(__GNUC__) && defined(DEVELOPER_WARNINGS)
 	#warning COMPLETARE QUESTO (COLLISIONI CON BOX)
@@ -749,6 +1079,7 @@ void Arena::circleCollisionsHandle()
 // 					angleStaticObj
 
 					robot->wObject()->setMatrix(robot->previousMatrix());
+					m_broadPhase->update(robot);
 				} else if (dynamic_cast<Cylinder2DWrapper*>(firstStaticObj) != nullptr) {
 					// Computing the robot displacement
 					const wVector robotDisplacement = robot->position() - robot->previousMatrix().w_pos;
@@ -764,6 +1095,7 @@ void Arena::circleCollisionsHandle()
 						robotMtr = robotMtr.rotateAround(wVector::Z(), robotMtr.w_pos, globalRNG->getDouble(-noiseOnOrientation, noiseOnOrientation));
 						robotMtr.w_pos = robot->previousMatrix().w_pos;
 						robot->wObject()->setMatrix(robotMtr);
+						m_broadPhase->update(robot);
 					} else {
 						const real k = -distanceStaticObj / robotDisplacementNorm;
 
@@ -773,6 +1105,7 @@ void Arena::circleCollisionsHandle()
 						robotMtr = robotMtr.rotateAround(wVector::Z(), robotMtr.w_pos, globalRNG->getDouble(-noiseOnOrientation, noiseOnOrientation));
 						robotMtr.w_pos = robotPos;
 						robot->wObject()->setMatrix(robotMtr);
+						m_broadPhase->update(robot);
 					}
 				} else {
 					qDebug() << "Unknown object type when resolving collisions, skipping";
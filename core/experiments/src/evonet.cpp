@@ -48,18 +48,98 @@
 
 namespace salsa {
 
-// MAXN and MAXSTOREDACTIVATIONS are declared in .h and their value is set there, but that is not a
-// definition. This means that if you try to get the address of MAXN or MAXSTOREDACTIVATIONS you get
-// a linker error (this also happends if you pass one of them to a function that takes a reference
-// or const reference). However, we cannot initialize them here because these are used to define
-// arrays, so their value must be present in the .h
-// We must however not define them on Visual Studio 2008...
+// MAXSTOREDACTIVATIONS is declared in .h and its value is set there, but that is not a definition.
+// This means that if you try to get the address of MAXSTOREDACTIVATIONS you get a linker error (this
+// also happends if you pass it to a function that takes a reference or const reference), so we
+// define it here
+// We must however not define it on Visual Studio 2008...
 #if !defined(_MSC_VER) || _MSC_VER > 1600
 const int Evonet::MAXSTOREDACTIVATIONS;
-const int Evonet::MAXN;
 #endif
 const float Evonet::DEFAULT_VALUE = -99.0f;
 
+/**
+ * \brief The flat execution plan of an Evonet
+ *
+ * This is built by Evonet::compileNet() from the block description and the
+ * free parameters and is used by Evonet::updateNet(). See the description of
+ * Evonet::compileNet() for more information
+ * \internal
+ */
+class SALSA_EXPERIMENTS_INTERNAL EvonetExecutionPlan
+{
+public:
+	/**
+	 * \brief The type of operations
+	 */
+	enum OperationType {
+		Connections,        ///< Adds weighted activations of a group of neurons to netinputs
+		GainCopy,           ///< Sets the gain of a group of neurons equal to the gain of the first one
+		GainFromActivation, ///< Sets the gain of a group of neurons equal to the activation of a neuron
+		Update              ///< Updates the activation of a run of neurons with the same function
+	};
+
+	/**
+	 * \brief The activation functions of update operations
+	 */
+	enum UpdateFunction {
+		InputRelay,    ///< Input neurons copying the input
+		InputDelta,    ///< Input neurons with a time constant
+		InputNone,     ///< Input neurons of unknown type (activation is not changed)
+		Logistic,      ///< Logistic neurons
+		LogisticDelta, ///< Logistic neurons with a time constant
+		Binary,        ///< Binary neurons
+		Logistic02     ///< Logistic neurons with a flatter curve
+	};
+
+	/**
+	 * \brief A single operation of the plan
+	 */
+	struct Operation {
+		OperationType type;
+		UpdateFunction function;
+		//! The first target neuron
+		int first;
+		//! The number of target neurons
+		int num;
+		//! The first source neuron (Connections) or the neuron giving the gain (GainFromActivation)
+		int srcFirst;
+		//! The number of source neurons (Connections)
+		int srcNum;
+		//! The offset in weights (Connections) or in deltas (Update)
+		int offset;
+	};
+
+	EvonetExecutionPlan()
+		: operations()
+		, bias()
+		, gain()
+		, hasGainBlocks(false)
+		, weights()
+		, deltas()
+		, gainWork()
+		, scaledActivations()
+	{
+	}
+
+	//! The sequence of operations
+	QVector<Operation> operations;
+	//! The initial netinput of each neuron
+	QVector<float> bias;
+	//! The gain of each neuron, before gain blocks are applied
+	QVector<float> gain;
+	//! Whether there are gain blocks, in which case gains are copied to gainWork before each update
+	bool hasGainBlocks;
+	//! The weights of connection blocks, column-major (weights from one source are contiguous)
+	QVector<float> weights;
+	//! The time constants of delta neurons, in update order
+	QVector<float> deltas;
+	//! Working copy of gains (only used when there are gain blocks)
+	QVector<float> gainWork;
+	//! Activations of source neurons multiplied by their gains
+	QVector<float> scaledActivations;
+};
+
 Evonet::Evonet(ConfigurationManager& params)
 	: Controller(params)
 	, neuronsMonitorUploader(20, DataUploader<ActivationsToGui>::IncreaseQueueSize /*BlockUploader*/) // we can be ahead of GUI by at most 20 steps, then we are blocked
@@ -67,6 +147,8 @@ Evonet::Evonet(ConfigurationManager& params)
 	, m_evonetIterator(nullptr)
 	, m_inputCurIndex(0)
 	, m_outputCurIndex(0)
+	, m_plan(new EvonetExecutionPlan())
+	, m_planOutdated(true)
 {
 	wrange = 5.0; // weight range
 	grange = 5.0; // gain range
@@ -78,15 +160,7 @@ Evonet::Evonet(ConfigurationManager& params)
 	geneMaxValue = 255;
 	pheloaded = false;
 	selectedp= (float **) malloc(100 * sizeof(float **));
-	for (int i = 0; i < MAXN; i++) {
-		neuronl[i][0] = '\0';
-		neurondisplay[i] = 1;
-		neuronrange[i][0] = 0.0;
-		neuronrange[i][1] = 1.0;
-		neurondcolor[i] = Qt::black;
-		neuronlesion[i] = false;
-		neuronlesionVal[i] = 0.0;
-	}
+	nneurons = 0;
 	net_nblocks = 0;
 
 	nextStoredActivation = 0;
@@ -96,6 +170,14 @@ Evonet::Evonet(ConfigurationManager& params)
 	updateNeuronMonitor = false;
 }
 
+Evonet::~Evonet()
+{
+	delete[] freep;
+	delete[] phep;
+	delete[] muts;
+	free(selectedp);
+}
+
 void Evonet::setNetworkName(const QString& name)
 {
 	networkName = name;
@@ -128,9 +210,7 @@ void Evonet::configure()
 		nhiddens = nHiddens;
 		noutputs = nMotors;
 		nneurons = ninputs + nhiddens + noutputs;
-		if (this->nneurons > MAXN) {
-			ConfigurationHelper::throwUserConfigError(confPath() + "(nSensors + nHiddens + nMotors)", QString::number(nneurons), "Too many neurons: increase MAXN to support more than " + QString::number(MAXN) + " neurons");
-		}
+		allocateNeuronStorage();
 		int inputNeuronType = 0;
 		QString str = ConfigurationHelper::getEnum( configurationManager(), confPath() + "inputNeuronType");
 		if ( str == QString("no_delta") ) {
@@ -203,6 +283,7 @@ void Evonet::configure()
 		QString filePhe = fileNet.baseName() + ".phe";
 		load_net_blocks(filePhe.toLatin1().data(), 1);
 	}
+	invalidateExecutionPlan();
 
 	//resetting net
 	resetNet();
@@ -211,7 +292,7 @@ void Evonet::configure()
 
 	// we create the labels of the hidden neurons
 	for(int i = 0; i < nhiddens; i++) {
-		sprintf(neuronl[ninputs+i], "h%d", i);
+		neuronl[ninputs+i] = QString("h%1").arg(i);
 		neuronrange[ninputs+i][0] = 0.0;
 		neuronrange[ninputs+i][1] = 1.0;
 		neurondcolor[ninputs+i] = QColor(125,125,125);
@@ -229,7 +310,7 @@ void Evonet::describe(RegisteredComponentDescriptor& d)
 
 	d.help("Neural Network imported from Evorobot");
 
-	d.describeInt( "nHiddens" ).limits( 0, MAXN ).def(0).help( "The number of hidden neurons" );
+	d.describeInt( "nHiddens" ).limits( 0, MaxInteger ).def(0).help( "The number of hidden neurons" );
 	d.describeString( "netFile" ).def("").help( "The file .net where is defined the architecture to load. WARNING: when this parameter is specified any other parameters will be ignored" );
 	d.describeReal( "weightRange" ).def(5.0f).limits(1,+Infinity).help( "The synpatic weight of the neural network can only assume values in [-weightRange, +weightRange]" );
 	d.describeReal( "gainRange" ).def(5.0f).limits(0,+Infinity).help( "The gain of a neuron will can only assume values in [0, +gainRange]" );
@@ -267,6 +348,10 @@ void Evonet::create_net_block( int inputNeuronType, int hiddenNeuronType, int ou
 	int startx;
 	int dx;
 
+	allocateNeuronStorage();
+	// at most 8 blocks are created below, the vector is shrinked at the end
+	net_block.resize(8);
+
 	// setting the neuron types
 	for(i = 0; i < this->ninputs; i++) {
 		this->neurontype[i]= inputNeuronType;
@@ -370,6 +455,7 @@ void Evonet::create_net_block( int inputNeuronType, int hiddenNeuronType, int ou
 	this->net_block[this->net_nblocks][4] = 0;
 	this->net_block[this->net_nblocks][5] = 0;
 	this->net_nblocks++;
+	net_block.resize(net_nblocks);
 
 	// cartesian xy coordinate for sensory neurons for display (y=400)
 	n = 0;
@@ -447,10 +533,10 @@ int Evonet::load_net_blocks(const char *filename, int mode)
 		fscanf(fp,"nneurons %d\n", &nneurons);
 		fscanf(fp,"nsensors %d\n", &ninputs);
 		fscanf(fp,"nmotors %d\n", &noutputs);
-		if (nneurons > MAXN)
-			Logger::error( "Evonet - increase MAXN to support more than "+QString::number(MAXN)+" neurons" );
 		nhiddens = nneurons - (ninputs + noutputs);
+		allocateNeuronStorage();
 		fscanf(fp,"nblocks %d\n", &net_nblocks);
+		net_block.resize(net_nblocks);
 		for (b=0; b < net_nblocks; b++)
 		{
 			fscanf(fp,"%d %d %d %d %d %d", &net_block[b][0],&net_block[b][1],&net_block[b][2],&net_block[b][3],&net_block[b][4], &net_block[b][5]);
@@ -511,6 +597,7 @@ int Evonet::load_net_blocks(const char *filename, int mode)
 				p++;
 			}
 			pheloaded = true;
+			invalidateExecutionPlan();
 		}
 		fclose(fp);
 
@@ -626,14 +713,14 @@ void Evonet::save_net_blocks(const char *filename, int mode)
 			fprintf(fp,"FREE PARAMETERS %d\n", nparameters);
 			for(i = 0; i < nneurons; i++) {
 				if (neurongain[i] == 1) {
-					fprintf(fp,"%s \t %s \tgain %s\n",*p, *mu, neuronl[i]);
+					fprintf(fp,"%s \t %s \tgain %s\n",*p, *mu, neuronl[i].toLatin1().constData());
 					p++;
 					mu++;
 				}
 			}
 			for(i=0; i<nneurons; i++) {
 				if (neuronbias[i] == 1) {
-					fprintf(fp,"%s \t %s \tbias %s\n",*p, *mu, neuronl[i]);
+					fprintf(fp,"%s \t %s \tbias %s\n",*p, *mu, neuronl[i].toLatin1().constData());
 					p++;
 					mu++;
 				}
@@ -642,7 +729,7 @@ void Evonet::save_net_blocks(const char *filename, int mode)
 				if (net_block[b][0] == 0) {
 					for(t=net_block[b][1]; t < net_block[b][1] + net_block[b][2];t++) {
 						for(i=net_block[b][3]; i < net_block[b][3] + net_block[b][4];i++) {
-							fprintf(fp,"%s \t %s \tweight %s from %s\n",*p, *mu, neuronl[t], neuronl[i]);
+							fprintf(fp,"%s \t %s \tweight %s from %s\n",*p, *mu, neuronl[t].toLatin1().constData(), neuronl[i].toLatin1().constData());
 							p++;
 							mu++;
 						}
@@ -656,7 +743,7 @@ void Evonet::save_net_blocks(const char *filename, int mode)
 								timeC = fabs(timeC)/wrange;  //(timeC + wrange)/(wrange*2);
 							}
 
-							fprintf(fp,"%s \t %s \ttimeconstant %s (%f)\n", *p, *mu, neuronl[t], timeC);
+							fprintf(fp,"%s \t %s \ttimeconstant %s (%f)\n", *p, *mu, neuronl[t].toLatin1().constData(), timeC);
 							p++;
 							mu++;
 						}
@@ -689,7 +776,7 @@ void Evonet::computeParameters()
 	int i;
 	int t;
 	int b;
-	int updated[MAXN];
+	QVector<int> updated(nneurons);
 	int ng;
 	int nwarnings;
 
@@ -739,6 +826,8 @@ void Evonet::computeParameters()
 		}
 	}
 	nparameters=ng; // number of parameters
+
+	invalidateExecutionPlan();
 }
 
 QPair<AbstractControllerInputIterator*, AbstractControllerOutputIterator*> Evonet::createIterators()
@@ -786,148 +875,248 @@ int Evonet::computeNumMotorsFromControllerOutputsList() const
 	return n;
 }
 
-void Evonet::updateNet()
+void Evonet::compileNet()
 {
-	int i;
-	int t;
-	int b;
-	float *p;
-	float delta;
-	float netinput[MAXN];
-	float gain[MAXN];
+	compilePlan(*m_plan, freep);
+
+	m_planOutdated = false;
+}
+
+void Evonet::compilePlan(EvonetExecutionPlan& plan, const float* params) const
+{
+	const float* p = params;
 
-	p  = freep;
-	//nl  = neuronlesion;
+	plan.operations.clear();
+	plan.weights.clear();
+	plan.deltas.clear();
+	plan.hasGainBlocks = false;
+	plan.bias.resize(nneurons);
+	plan.gain.resize(nneurons);
+	plan.gainWork.resize(nneurons);
+	plan.scaledActivations.resize(nneurons);
 
 	// gain
-	for(i=0;i < nneurons;i++) {
+	for (int i = 0; i < nneurons; i++) {
 		if (neurongain[i] == 1) {
-			gain[i] = (float) (fabs((double) *p) / wrange) * grange;
+			plan.gain[i] = (float) (fabs((double) *p) / wrange) * grange;
 			p++;
 		} else {
-			gain[i] = 1.0f;
+			plan.gain[i] = 1.0f;
 		}
 	}
 	// biases
-
-/*    printf("weights: ");
-    printWeights();
-    printf("\n");
-*/
-	for(i=0;i < nneurons;i++) {
+	for (int i = 0; i < nneurons; i++) {
 		if (neuronbias[i] == 1) {
-//            printf("netinput[%d]= [%ld] %f/%f*%f = %f*%f = %f",i,p-freep, *p,wrange,brange,((double)*p/wrange),brange,((double)*p/wrange)*brange);
-			netinput[i] = ((double)*p/wrange)*brange;
+			plan.bias[i] = ((double)*p/wrange)*brange;
 			p++;
 		} else {
-			netinput[i] = 0.0f;
+			plan.bias[i] = 0.0f;
 		}
 	}
 
 	// blocks
-	for (b=0; b < net_nblocks; b++) {
-		// connection block
+	for (int b = 0; b < net_nblocks; b++) {
+		EvonetExecutionPlan::Operation op;
+		op.first = net_block[b][1];
+		op.num = net_block[b][2];
+		op.srcFirst = 0;
+		op.srcNum = 0;
+		op.offset = 0;
+		op.function = EvonetExecutionPlan::InputNone;
+
 		if (net_block[b][0] == 0) {
-			for(t=net_block[b][1]; t < net_block[b][1] + net_block[b][2];t++) {
-				for(i=net_block[b][3]; i < net_block[b][3] + net_block[b][4];i++) {
-					netinput[t] += act[i] * gain[i] * *p;
-//                    printf("netinput[%d] += act[%d] * gain[%d] * %f += %f * %f * %f += %f = %f\n",t,i,i,*p,act[i],gain[i], *p,act[i] * gain[i] * *p, netinput[t] );
+			// connection block. Parameters are stored row by row (all weights of a target neuron are
+			// contiguous), here we transpose them so that the update can proceed one source at a time
+			op.type = EvonetExecutionPlan::Connections;
+			op.srcFirst = net_block[b][3];
+			op.srcNum = net_block[b][4];
+			op.offset = plan.weights.size();
+			plan.weights.resize(op.offset + op.num * op.srcNum);
+			float* const w = plan.weights.data() + op.offset;
+			for (int t = 0; t < op.num; t++) {
+				for (int i = 0; i < op.srcNum; i++) {
+					w[i * op.num + t] = *p;
 					p++;
 				}
 			}
-		}
-		// gain block (gain of neuron a-b set equal to gain of neuron a)
-		if (net_block[b][0] == 2) {
-			for(t=net_block[b][1]; t < net_block[b][1] + net_block[b][2];t++) {
-				gain[t] = gain[net_block[b][1]];
-			}
-		}
-		// gain block (gain of neuron a-b set equal to act[c])
-		if (net_block[b][0] == 3) {
-			for(t=net_block[b][1]; t < net_block[b][1] + net_block[b][2];t++) {
-				gain[t] = act[net_block[b][3]];
-			}
-		}
-		// update block
-		if (net_block[b][0] == 1) {
-			for(t=net_block[b][1]; t < (net_block[b][1] + net_block[b][2]); t++) {
+			plan.operations.append(op);
+		} else if (net_block[b][0] == 2) {
+			op.type = EvonetExecutionPlan::GainCopy;
+			plan.hasGainBlocks = true;
+			plan.operations.append(op);
+		} else if (net_block[b][0] == 3) {
+			op.type = EvonetExecutionPlan::GainFromActivation;
+			op.srcFirst = net_block[b][3];
+			plan.hasGainBlocks = true;
+			plan.operations.append(op);
+		} else if (net_block[b][0] == 1) {
+			// update block, split in runs of neurons with the same activation function
+			op.type = EvonetExecutionPlan::Update;
+			op.num = 0;
+			for (int t = net_block[b][1]; t < (net_block[b][1] + net_block[b][2]); t++) {
+				EvonetExecutionPlan::UpdateFunction f;
 				if (t < ninputs) {
-					switch(neurontype[t]) {
-						case 0: // simple rely units
-							act[t] = input[t];
+					switch (neurontype[t]) {
+						case 0:
+							f = EvonetExecutionPlan::InputRelay;
+							break;
+						case 1:
+							f = EvonetExecutionPlan::InputDelta;
+							break;
+						default:
+							f = EvonetExecutionPlan::InputNone;
 							break;
-						case 1: // delta neurons
-							delta = (float) (fabs((double) *p) / wrange);
-							p++;
-							act[t] = (act[t] * delta)  + (input[t] * (1.0f - delta));
-							// Check whether activation is within range [0,1]
-							if (act[t] < 0.0)
-							{
-								act[t] = 0.0;
-							}
-							if (act[t] > 1.0)
-							{
-								act[t] = 1.0;
-							}
-						break;
-					}
-					if(neuronlesions > 0 && neuronlesion[t]) {
-						act[t]= (float)neuronlesionVal[t];
 					}
 				} else {
-					switch(neurontype[t]) {
-						case 0: // simple logistic
+					switch (neurontype[t]) {
+						case 0:
 						default:
-							act[t] = logistic(netinput[t]);
-							delta = 0.0;
+							f = EvonetExecutionPlan::Logistic;
 							break;
-						case 1: // delta neurons
-							delta = (float) (fabs((double) *p) / wrange);
-							p++;
-							act[t] = (act[t] * delta)  + (logistic(netinput[t]) * (1.0f - delta));
-							// Check whether activation is within range [0,1]
-							if (act[t] < 0.0)
-							{
-								act[t] = 0.0;
-							}
-							if (act[t] > 1.0)
-							{
-								act[t] = 1.0;
-							}
+						case 1:
+							f = EvonetExecutionPlan::LogisticDelta;
 							break;
-						case 2: // binary neurons
-							if (netinput[t] >= 0.0) {
-								act[t] = 1.0;
-							} else {
-								act[t] = 0.0;
-							}
+						case 2:
+							f = EvonetExecutionPlan::Binary;
 							break;
-						case 3: // logistic2 neurons
-							act[t] = logistic(netinput[t]*0.2f);
-							delta = 0.0;
+						case 3:
+							f = EvonetExecutionPlan::Logistic02;
 							break;
 					}
-					if(neuronlesions > 0 && neuronlesion[t]) {
-						act[t]= (float)neuronlesionVal[t];
-					}
 				}
+				if ((op.num != 0) && (f != op.function)) {
+					plan.operations.append(op);
+					op.num = 0;
+				}
+				if (op.num == 0) {
+					op.first = t;
+					op.function = f;
+					op.offset = plan.deltas.size();
+				}
+				op.num++;
+				if (neurontype[t] == 1) {
+					plan.deltas.append((float) (fabs((double) *p) / wrange));
+					p++;
+				}
+			}
+			if (op.num != 0) {
+				plan.operations.append(op);
 			}
 		}
 	}
+}
 
-	// Storing the current activations
-	memcpy(storedActivations[nextStoredActivation], act, nneurons * sizeof(float));
-	nextStoredActivation = (nextStoredActivation + 1) % MAXSTOREDACTIVATIONS;
-	if (firstStoredActivation == nextStoredActivation) {
-		// We have filled the circular buffer, discarding the oldest activation
-		firstStoredActivation = (firstStoredActivation + 1) % MAXSTOREDACTIVATIONS;
+void Evonet::invalidateExecutionPlan()
+{
+	m_planOutdated = true;
+}
+
+void Evonet::updateNet()
+{
+	if (m_planOutdated) {
+		compileNet();
+	}
+
+	const EvonetExecutionPlan& plan = *m_plan;
+
+	// biases
+	std::copy(plan.bias.constBegin(), plan.bias.constEnd(), netinput.begin());
+
+	// gain. The working copy is only needed if gain blocks change gains
+	const float* gain = plan.gain.constData();
+	if (plan.hasGainBlocks) {
+		std::copy(plan.gain.constBegin(), plan.gain.constEnd(), m_plan->gainWork.begin());
+		gain = m_plan->gainWork.constData();
+	}
+	float* const gainWork = m_plan->gainWork.data();
+	float* const x = m_plan->scaledActivations.data();
+	const float* const weights = plan.weights.constData();
+	const float* const deltas = plan.deltas.constData();
+	float* const act = this->act.data();
+	float* const netinput = this->netinput.data();
+	const float* const input = this->input.constData();
+
+	for (int o = 0; o < plan.operations.size(); o++) {
+		const EvonetExecutionPlan::Operation& op = plan.operations[o];
+		switch (op.type) {
+			case EvonetExecutionPlan::Connections: {
+				// netinput[t] += act[i] * gain[i] * w[t][i], one source at a time so that each netinput
+				// accumulates its terms in the same order of the block description
+				for (int i = 0; i < op.srcNum; i++) {
+					x[i] = act[op.srcFirst + i] * gain[op.srcFirst + i];
+				}
+				Eigen::Map<Eigen::VectorXf> net(netinput + op.first, op.num);
+				for (int i = 0; i < op.srcNum; i++) {
+					net.noalias() += x[i] * Eigen::Map<const Eigen::VectorXf>(weights + op.offset + i * op.num, op.num);
+				}
+				break;
+			}
+			case EvonetExecutionPlan::GainCopy:
+				for (int t = op.first; t < op.first + op.num; t++) {
+					gainWork[t] = gainWork[op.first];
+				}
+				break;
+			case EvonetExecutionPlan::GainFromActivation:
+				for (int t = op.first; t < op.first + op.num; t++) {
+					gainWork[t] = act[op.srcFirst];
+				}
+				break;
+			case EvonetExecutionPlan::Update: {
+				const int end = op.first + op.num;
+				const float* d = deltas + op.offset;
+				switch (op.function) {
+					case EvonetExecutionPlan::InputRelay:
+						std::copy(input + op.first, input + end, act + op.first);
+						break;
+					case EvonetExecutionPlan::InputDelta:
+						for (int t = op.first; t < end; t++, d++) {
+							act[t] = (act[t] * *d) + (input[t] * (1.0f - *d));
+							act[t] = std::min(std::max(act[t], 0.0f), 1.0f);
+						}
+						break;
+					case EvonetExecutionPlan::InputNone:
+						break;
+					case EvonetExecutionPlan::Logistic:
+						for (int t = op.first; t < end; t++) {
+							act[t] = logistic(netinput[t]);
+						}
+						break;
+					case EvonetExecutionPlan::LogisticDelta:
+						for (int t = op.first; t < end; t++, d++) {
+							act[t] = (act[t] * *d) + (logistic(netinput[t]) * (1.0f - *d));
+							act[t] = std::min(std::max(act[t], 0.0f), 1.0f);
+						}
+						break;
+					case EvonetExecutionPlan::Binary:
+						for (int t = op.first; t < end; t++) {
+							act[t] = (netinput[t] >= 0.0) ? 1.0f : 0.0f;
+						}
+						break;
+					case EvonetExecutionPlan::Logistic02:
+						for (int t = op.first; t < end; t++) {
+							act[t] = logistic(netinput[t]*0.2f);
+						}
+						break;
+				}
+				if (neuronlesions > 0) {
+					for (int t = op.first; t < end; t++) {
+						if (neuronlesion[t]) {
+							act[t] = (float)neuronlesionVal[t];
+						}
+					}
+				}
+				break;
+			}
+		}
 	}
 
 	// increment the counter
 	updatescounter++;
 
-	// If a downloader is associated with the neuronsMonitorUploader, uploading activations
+	// If a downloader is associated with the neuronsMonitorUploader, storing and uploading activations
 	if (neuronsMonitorUploader.downloaderPresent() && updateMonitor) {
+		storeActivations();
+
 		// This call can return nullptr if GUI is too slow
 		DatumToUpload<ActivationsToGui> d(neuronsMonitorUploader);
 
@@ -938,7 +1127,7 @@ void Evonet::updateNet()
 		d->data.resize(nneurons);
 
 		// Copying data
-		std::copy(act, &(act[nneurons]), d->data.begin());
+		std::copy(act, act + nneurons, d->data.begin());
 
 		// Adding the current step
 		d->updatesCounter = updatescounter;
@@ -995,15 +1184,76 @@ float Evonet::getNeuron(int in)
 
 void Evonet::resetNet()
 {
-	int i;
-	for (i = 0; i < MAXN; i++) {
-		act[i]=0.0;
-		netinput[i]=0.0;
-		input[i]=0.0;
-	}
+	act.fill(0.0f);
+	netinput.fill(0.0f);
+	input.fill(0.0f);
 	updatescounter = 0;
 }
 
+void Evonet::allocateNeuronStorage()
+{
+	const int oldSize = neuronl.size();
+
+	neuronl.resize(nneurons);
+	neurondisplay.resize(nneurons);
+	neuronrange.resize(nneurons);
+	neurondcolor.resize(nneurons);
+	neuronlesion.resize(nneurons);
+	neuronlesionVal.resize(nneurons);
+	neuronbias.resize(nneurons);
+	neurontype.resize(nneurons);
+	neurongain.resize(nneurons);
+	neuronxy.resize(nneurons);
+	act.resize(nneurons);
+	input.resize(nneurons);
+	netinput.resize(nneurons);
+
+	for (int i = oldSize; i < nneurons; i++) {
+		neurondisplay[i] = 1;
+		neuronrange[i][0] = 0.0;
+		neuronrange[i][1] = 1.0;
+		neurondcolor[i] = Qt::black;
+		neuronlesion[i] = false;
+		neuronlesionVal[i] = 0.0;
+		neuronbias[i] = 0;
+		neurontype[i] = 0;
+		neurongain[i] = 0;
+		neuronxy[i][0] = 0;
+		neuronxy[i][1] = 0;
+		act[i] = 0.0;
+		input[i] = 0.0;
+		netinput[i] = 0.0;
+	}
+
+	// The size of stored activations depends on the number of neurons
+	releaseStoredActivations();
+	invalidateExecutionPlan();
+}
+
+void Evonet::storeActivations()
+{
+	if (storedActivations.isEmpty()) {
+		storedActivations.resize(MAXSTOREDACTIVATIONS * nneurons);
+		nextStoredActivation = 0;
+		firstStoredActivation = 0;
+	}
+
+	std::copy(act.constBegin(), act.constBegin() + nneurons, storedActivations.begin() + nextStoredActivation * nneurons);
+	nextStoredActivation = (nextStoredActivation + 1) % MAXSTOREDACTIVATIONS;
+	if (firstStoredActivation == nextStoredActivation) {
+		// We have filled the circular buffer, discarding the oldest activation
+		firstStoredActivation = (firstStoredActivation + 1) % MAXSTOREDACTIVATIONS;
+	}
+}
+
+void Evonet::releaseStoredActivations()
+{
+	storedActivations.clear();
+	storedActivations.squeeze();
+	nextStoredActivation = 0;
+	firstStoredActivation = 0;
+}
+
 void Evonet::injectHidden(int nh, float val)
 {
 	if(nh<nhiddens) {
@@ -1047,6 +1297,7 @@ void Evonet::setParameters(const float *dt)
 	for (i=0; i<freeParameters(); i++, p++) {
 		*p = dt[i];
 	}
+	invalidateExecutionPlan();
 }
 
 void Evonet::setParameters(const int *dt)
@@ -1058,6 +1309,7 @@ void Evonet::setParameters(const int *dt)
 	for (i=0; i<freeParameters(); i++, p++) {
 		*p = wrange - ((float)dt[i]/geneMaxValue)*wrange*2;
 	}
+	invalidateExecutionPlan();
 }
 
 void Evonet::getMutations(float* GAmut)
@@ -1169,6 +1421,7 @@ void Evonet::setRanges(double weight, double bias, double gain)
 	wrange=weight;
 	brange=bias;
 	grange=gain;
+	invalidateExecutionPlan();
 }
 
 float* Evonet::getOldestStoredActivations()
@@ -1179,7 +1432,7 @@ float* Evonet::getOldestStoredActivations()
 
 	const int ret = firstStoredActivation;
 	firstStoredActivation = (firstStoredActivation + 1) % MAXSTOREDACTIVATIONS;
-	return storedActivations[ret];
+	return storedActivations.data() + ret * nneurons;
 }
 
 int Evonet::updateCounts()
@@ -1193,8 +1446,177 @@ int Evonet::updateCounts()
 
     void Evonet::deactivateMonitorUpdate(){
         updateMonitor = false;
+        releaseStoredActivations();
     }
 
+namespace {
+	// The same as Evonet::logistic()
+	inline float batchLogistic(float f)
+	{
+		return (float) (1.0 / (1.0 + exp(0.0 - f)));
+	}
+
+	inline float batchLogistic02(float f)
+	{
+		return batchLogistic(f * 0.2f);
+	}
+}
+
+EvonetBatch::EvonetBatch(const Evonet* net, int size)
+	: m_net(net)
+	, m_size(size)
+	, m_nparameters(net->nparameters)
+	, m_firstOutput(net->ninputs + net->nhiddens)
+	, m_plan(new EvonetExecutionPlan())
+	, m_bias()
+	, m_gain()
+	, m_weights()
+	, m_deltas()
+	, m_gainWork()
+	, m_input(Matrix::Zero(net->ninputs, size))
+	, m_act(Matrix::Zero(net->nneurons, size))
+	, m_netinput(Matrix::Zero(net->nneurons, size))
+	, m_scaled(size)
+	, m_lesioned()
+	, m_lesionedVal()
+{
+	// Compiling a plan with all parameters set to zero, to get the operations and the size of matrices
+	const QVector<float> zeroParams(qMax(m_nparameters, 1), 0.0f);
+	m_net->compilePlan(*m_plan, zeroParams.constData());
+
+	m_bias.setZero(m_plan->bias.size(), m_size);
+	m_gain.setZero(m_plan->gain.size(), m_size);
+	m_weights.setZero(m_plan->weights.size(), m_size);
+	m_deltas.setZero(m_plan->deltas.size(), m_size);
+	m_gainWork.setZero(m_plan->gain.size(), m_size);
+
+	if (m_net->neuronlesions > 0) {
+		for (int t = 0; t < m_net->nneurons; t++) {
+			if (m_net->neuronlesion[t]) {
+				m_lesioned.append(t);
+				m_lesionedVal.append(m_net->neuronlesionVal[t]);
+			}
+		}
+	}
+}
+
+EvonetBatch::~EvonetBatch()
+{
+	// Nothing to do here
+}
+
+void EvonetBatch::setParameters(int individual, const float* dt)
+{
+	// Compiling the parameters of this individual and copying them in its column. The plan has the same
+	// operations for all individuals, as they only depend on the architecture
+	EvonetExecutionPlan plan;
+	m_net->compilePlan(plan, dt);
+
+	m_bias.col(individual) = Eigen::Map<const Eigen::VectorXf>(plan.bias.constData(), plan.bias.size());
+	m_gain.col(individual) = Eigen::Map<const Eigen::VectorXf>(plan.gain.constData(), plan.gain.size());
+	m_weights.col(individual) = Eigen::Map<const Eigen::VectorXf>(plan.weights.constData(), plan.weights.size());
+	m_deltas.col(individual) = Eigen::Map<const Eigen::VectorXf>(plan.deltas.constData(), plan.deltas.size());
+}
+
+void EvonetBatch::setParameters(int individual, const int* dt)
+{
+	// The same conversion performed by Evonet::setParameters(const int*)
+	QVector<float> params(m_nparameters);
+	for (int i = 0; i < m_nparameters; i++) {
+		params[i] = m_net->wrange - ((float)dt[i]/m_net->geneMaxValue)*m_net->wrange*2;
+	}
+
+	setParameters(individual, params.constData());
+}
+
+void EvonetBatch::resetNet()
+{
+	m_act.setZero();
+	m_netinput.setZero();
+	m_input.setZero();
+}
+
+void EvonetBatch::resetNet(int individual)
+{
+	m_act.col(individual).setZero();
+	m_netinput.col(individual).setZero();
+	m_input.col(individual).setZero();
+}
+
+void EvonetBatch::updateNet()
+{
+	const EvonetExecutionPlan& plan = *m_plan;
+
+	// biases
+	m_netinput = m_bias;
+
+	// gain. The working copy is only needed if gain blocks change gains
+	const Matrix* gain = &m_gain;
+	if (plan.hasGainBlocks) {
+		m_gainWork = m_gain;
+		gain = &m_gainWork;
+	}
+
+	// This is the same as Evonet::updateNet(), but each row holds the values of one neuron for all networks
+	for (int o = 0; o < plan.operations.size(); o++) {
+		const EvonetExecutionPlan::Operation& op = plan.operations[o];
+		switch (op.type) {
+			case EvonetExecutionPlan::Connections:
+				for (int i = 0; i < op.srcNum; i++) {
+					m_scaled = m_act.row(op.srcFirst + i).array() * gain->row(op.srcFirst + i).array();
+					m_netinput.middleRows(op.first, op.num).array() += m_weights.middleRows(op.offset + i * op.num, op.num).array().rowwise() * m_scaled;
+				}
+				break;
+			case EvonetExecutionPlan::GainCopy:
+				for (int t = op.first; t < op.first + op.num; t++) {
+					m_gainWork.row(t) = m_gainWork.row(op.first);
+				}
+				break;
+			case EvonetExecutionPlan::GainFromActivation:
+				for (int t = op.first; t < op.first + op.num; t++) {
+					m_gainWork.row(t) = m_act.row(op.srcFirst);
+				}
+				break;
+			case EvonetExecutionPlan::Update: {
+				Eigen::Block<Matrix> act(m_act, op.first, 0, op.num, m_size);
+				switch (op.function) {
+					case EvonetExecutionPlan::InputRelay:
+						act = m_input.middleRows(op.first, op.num);
+						break;
+					case EvonetExecutionPlan::InputDelta: {
+						const Eigen::Block<const Matrix> d(m_deltas, op.offset, 0, op.num, m_size);
+						act = ((act.array() * d.array()) + (m_input.middleRows(op.first, op.num).array() * (1.0f - d.array()))).max(0.0f).min(1.0f).matrix();
+						break;
+					}
+					case EvonetExecutionPlan::InputNone:
+						break;
+					case EvonetExecutionPlan::Logistic:
+						act = m_netinput.middleRows(op.first, op.num).unaryExpr(&batchLogistic);
+						break;
+					case EvonetExecutionPlan::LogisticDelta: {
+						const Eigen::Block<const Matrix> d(m_deltas, op.offset, 0, op.num, m_size);
+						act = ((act.array() * d.array()) + (m_netinput.middleRows(op.first, op.num).unaryExpr(&batchLogistic).array() * (1.0f - d.array()))).max(0.0f).min(1.0f).matrix();
+						break;
+					}
+					case EvonetExecutionPlan::Binary:
+						act = (m_netinput.middleRows(op.first, op.num).array() >= 0.0f).cast<float>().matrix();
+						break;
+					case EvonetExecutionPlan::Logistic02:
+						act = m_netinput.middleRows(op.first, op.num).unaryExpr(&batchLogistic02);
+						break;
+				}
+				for (int l = 0; l < m_lesioned.size(); l++) {
+					const int t = m_lesioned[l];
+					if ((t >= op.first) && (t < (op.first + op.num))) {
+						m_act.row(t).setConstant(m_lesionedVal[l]);
+					}
+				}
+				break;
+			}
+		}
+	}
+}
+
 
 } // end namespace salsa
 
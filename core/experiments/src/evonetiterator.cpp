@@ -90,7 +90,7 @@ void EvonetIterator::setProperties(QString label, real minValue, real maxValue,
 	const int index = layerIndexToLinearIndex(m_curIndex, m_curBlock->layer);
 
 	label.truncate(9);
-	sprintf(m_evonet->neuronl[index], "%s", label.toLatin1().data());
+	m_evonet->neuronl[index] = label;
 
 	m_evonet->neuronrange[index][0] = minValue;
 
@@ -107,7 +107,7 @@ QString EvonetIterator::label() const
 
 	const int index = layerIndexToLinearIndex(m_curIndex, m_curBlock->layer);
 
-	return QString(m_evonet->neuronl[index]);
+	return m_evonet->neuronl[index];
 }
 
 real EvonetIterator::minValue() const
@@ -151,13 +151,43 @@ real EvonetIterator::getOutput() const
 	return m_evonet->getOutput(m_curIndex);
 }
 
-void EvonetIterator::checkCurrentStatus(const QString& funcName) const
+real* EvonetIterator::inputSpan(int& size)
+{
+	checkCurrentStatus("inputSpan");
+
+	// Using the same indexes as setInput(), values outside the network inputs are not accessible
+	size = qMin(m_curBlock->endIndex, m_evonet->ninputs) - m_curIndex;
+	if (size <= 0) {
+		size = 0;
+
+		return nullptr;
+	}
+
+	return m_evonet->input.data() + m_curIndex;
+}
+
+const real* EvonetIterator::outputSpan(int& size) const
+{
+	checkCurrentStatus("outputSpan");
+
+	// Using the same indexes as getOutput(), values outside the network outputs are not accessible
+	size = qMin(m_curBlock->endIndex, m_evonet->noutputs) - m_curIndex;
+	if (size <= 0) {
+		size = 0;
+
+		return nullptr;
+	}
+
+	return m_evonet->act.constData() + m_evonet->ninputs + m_evonet->nhiddens + m_curIndex;
+}
+
+void EvonetIterator::checkCurrentStatus(const char* funcName) const
 {
 	if (m_curBlock == nullptr) {
-		throw EvonetIteratorInvalidStatusException(funcName.toLatin1().data(), "you should call setCurrentBlock first");
+		throw EvonetIteratorInvalidStatusException(funcName, "you should call setCurrentBlock first");
 	}
 	if (m_curIndex >= m_curBlock->endIndex) {
-		throw EvonetIteratorInvalidStatusException(funcName.toLatin1().data(), "attempt to access beyond the size of the current block");
+		throw EvonetIteratorInvalidStatusException(funcName, "attempt to access beyond the size of the current block");
 	}
 }
 
@@ -89,9 +89,10 @@ void KheperaWheelVelocityMotor::updateCalled()
 	m_robot->wheelsController()->getSpeedLimits(minSpeed1, minSpeed2, maxSpeed1, maxSpeed2);
 
 	// Computing desired wheel velocities
-	const double v1 = (maxSpeed1 - minSpeed1) * it()->getOutput() + minSpeed1;
-	it()->next();
-	const double v2 = (maxSpeed2 - minSpeed2) * it()->getOutput() + minSpeed2;
+	real outputs[2];
+	it()->getOutputs(outputs, 2);
+	const double v1 = (maxSpeed1 - minSpeed1) * outputs[0] + minSpeed1;
+	const double v2 = (maxSpeed2 - minSpeed2) * outputs[1] + minSpeed2;
 
 	m_robot->wheelsController()->setSpeeds(v1, v2);
 }
@@ -237,13 +237,15 @@ void KheperaSampledProximityIRSensor::updateCalled()
 		}
 	}
 
-	// Finally activating neurons
+	// Finally activating neurons. Activations of active sensors are moved at the beginning of the
+	// vector so that they can be set all at once
+	int numActive = 0;
 	for (int i = 0; i < m_activeSensors.size(); i++) {
 		if (m_activeSensors[i]) {
-			it()->setInput(activations[i]);
-			it()->next();
+			activations[numActive++] = activations[i];
 		}
 	}
+	it()->setInputs(activations.constData(), numActive);
 }
 
 void KheperaSampledProximityIRSensor::resourceChanged(QString name, Component*, ResourceChangeType changeType)
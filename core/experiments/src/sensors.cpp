@@ -36,6 +36,13 @@
 #include <QLinkedList>
 #include <QFile>
 #include <QTextStream>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QtEndian>
+#include <cstring>
 
 namespace salsa {
 
@@ -1266,105 +1273,275 @@ namespace salsa {
 // 	}
 // }
 
-SampledIRDataLoader::SampledIRDataLoader(QString filename) :
-	m_filename(filename),
-	m_numIR(0),
-	m_numSamplingAngles(0),
-	m_numDistances(0),
-	m_initialDistance(0.0f),
-	m_distanceInterval(0.0f),
-	m_finalDistance(0.0f),
-	m_activations(),
-	m_nullActivations()
+/**
+ * \brief The table of samples shared by SampledIRDataLoader instances
+ *
+ * \internal
+ */
+class SALSA_EXPERIMENTS_INTERNAL SampledIRTable
 {
-	// The maximum length of a line. This value is greater than needed, we use it just
-	// to avoid problems with maalformed files
-	const int maxLineLength = 1024;
-
-	// Opening the input file
-	QFile file(m_filename);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-		throw SampleFileLoadingException(m_filename.toLatin1().data(), "Cannot open file for reading");
+public:
+	SampledIRTable()
+		: numIR(0)
+		, numSamplingAngles(0)
+		, numDistances(0)
+		, initialDistance(0.0f)
+		, distanceInterval(0.0f)
+		, activations()
+		, nullActivations()
+	{
 	}
 
-	// Now opening a text stream on the file to read it
-	QTextStream in(&file);
+	unsigned int numIR;
+	unsigned int numSamplingAngles;
+	unsigned int numDistances;
+	real initialDistance;
+	real distanceInterval;
 
-	// Reading the first line, the one with configuration parameters and splitting it
-	QStringList confs = in.readLine(maxLineLength).split(" ", QString::SkipEmptyParts);
-	if (confs.size() != 5) {
-		throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Wrong format for the first line, expected 5 elements, got " + QString::number(confs.size())).toLatin1().data());
-	}
+	// The vector with activations. This is a linear vector containing all
+	// the data. To convert to/from linear indexes use
+	// SampledIRDataLoader::getLinearIndex()
+	QVector<unsigned int> activations;
 
-	// Now converting the elements of the configuration line
-	bool ok;
-	m_numIR = confs[0].toUInt(&ok);
-	if (!ok) {
-		throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Error reading the first element of the first row: expected an unsigned integer, got \"" + confs[0] + "\"").toLatin1().data());
-	}
-	m_numSamplingAngles = confs[1].toUInt(&ok);
-	if (!ok) {
-		throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Error reading the second element of the first row: expected an unsigned integer, got \"" + confs[1] + "\"").toLatin1().data());
-	}
-	m_numDistances = confs[2].toUInt(&ok);
-	if (!ok) {
-		throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Error reading the third element of the first row: expected an unsigned integer, got \"" + confs[2] + "\"").toLatin1().data());
-	}
-	m_initialDistance = confs[3].toFloat(&ok) / 1000.0;
-	if (!ok) {
-		throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Error reading the fourth element of the first row: expected a real number, got \"" + confs[3] + "\"").toLatin1().data());
+	// The vector with null activations. This is a vector with all 0 values,
+	// used when returning activations further than the limit distance
+	QVector<unsigned int> nullActivations;
+};
+
+namespace {
+	// The string at the beginning of binary files with samples
+	const char sampledIRBinaryMagic[] = "SALSASAM";
+	const int sampledIRBinaryMagicSize = 8;
+
+	// The version of the format of binary files with samples
+	const quint32 sampledIRBinaryVersion = 1;
+
+	// The size of the header of binary files with samples: the magic string,
+	// the version, the number of sensors, angles and distances, the initial
+	// distance and the distance interval
+	const int sampledIRBinaryHeaderSize = sampledIRBinaryMagicSize + 4 * sizeof(quint32) + 2 * sizeof(float);
+
+	// The maximum value of activations
+	const unsigned int maxSampledIRActivation = 1023;
+
+	float readFloatLittleEndian(const uchar* src)
+	{
+		const quint32 v = qFromLittleEndian<quint32>(src);
+		float f;
+		memcpy(&f, &v, sizeof(float));
+
+		return f;
 	}
-	m_distanceInterval = confs[4].toFloat(&ok) / 1000.0;
-	if (!ok) {
-		throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Error reading the fifth element of the first row: expected a real number, got \"" + confs[4] + "\"").toLatin1().data());
+
+	void writeFloatLittleEndian(float f, uchar* dest)
+	{
+		quint32 v;
+		memcpy(&v, &f, sizeof(float));
+		qToLittleEndian<quint32>(v, dest);
 	}
-	m_finalDistance = m_initialDistance + (m_numDistances - 1) * m_distanceInterval;
 
-	// Resizing the vector of activations
-	m_activations.resize(m_numIR * m_numSamplingAngles * m_numDistances);
-	m_nullActivations.fill(0, m_numIR);
+	void loadTextSamples(QFile& file, const QString& filename, SampledIRTable& table)
+	{
+		// The maximum length of a line. This value is greater than needed, we use it just
+		// to avoid problems with maalformed files
+		const int maxLineLength = 1024;
 
-	// Now reading the blocks. I use the id after "TURN" for a safety check, the original evorobot code used that
-	// in a "creative" way...
-	int i = 0; // The index over the m_activations array
-	for (unsigned int dist = 0; dist < m_numDistances; dist++) {
-		QString turnLine = in.readLine(maxLineLength);
-		QStringList turnLineSplitted = turnLine.split(" ", QString::SkipEmptyParts);
+		// Now opening a text stream on the file to read it
+		QTextStream in(&file);
 
-		// The line we just read should have been split in two. The first element should
-		// be equal to "TURN", the second one to the current dist
-		if ((turnLineSplitted.size() != 2) || (turnLineSplitted[0] != "TURN") || (turnLineSplitted[1].toUInt() != dist)) {
-			throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Invalid TURN line: \"" + turnLine + "\"").toLatin1().data());
+		// Reading the first line, the one with configuration parameters and splitting it
+		QStringList confs = in.readLine(maxLineLength).split(" ", QString::SkipEmptyParts);
+		if (confs.size() != 5) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("Wrong format for the first line, expected 5 elements, got " + QString::number(confs.size())).toLatin1().data());
 		}
 
-		// Now reading the block for the current distance
-		for (unsigned int ang = 0; ang < m_numSamplingAngles; ang++) {
-			QString activationsLine = in.readLine(maxLineLength);
-			QStringList activationsLineSplitted = activationsLine.split(" ", QString::SkipEmptyParts);
+		// Now converting the elements of the configuration line
+		bool ok;
+		table.numIR = confs[0].toUInt(&ok);
+		if (!ok) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("Error reading the first element of the first row: expected an unsigned integer, got \"" + confs[0] + "\"").toLatin1().data());
+		}
+		table.numSamplingAngles = confs[1].toUInt(&ok);
+		if (!ok) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("Error reading the second element of the first row: expected an unsigned integer, got \"" + confs[1] + "\"").toLatin1().data());
+		}
+		table.numDistances = confs[2].toUInt(&ok);
+		if (!ok) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("Error reading the third element of the first row: expected an unsigned integer, got \"" + confs[2] + "\"").toLatin1().data());
+		}
+		table.initialDistance = confs[3].toFloat(&ok) / 1000.0;
+		if (!ok) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("Error reading the fourth element of the first row: expected a real number, got \"" + confs[3] + "\"").toLatin1().data());
+		}
+		table.distanceInterval = confs[4].toFloat(&ok) / 1000.0;
+		if (!ok) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("Error reading the fifth element of the first row: expected a real number, got \"" + confs[4] + "\"").toLatin1().data());
+		}
 
-			// activationsLineSplitted should have m_numIR elements, all integers between 0 and 1023
-			if (activationsLineSplitted.size() != int(m_numIR)) {
-				throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Invalid activations line (wrong number of elements, expected " + QString::number(m_numIR) + ", got " + QString::number(activationsLineSplitted.size()) + "): \"" + activationsLine + "\"").toLatin1().data());
+		// Resizing the vector of activations
+		table.activations.resize(table.numIR * table.numSamplingAngles * table.numDistances);
+
+		// Now reading the blocks. I use the id after "TURN" for a safety check, the original evorobot code used that
+		// in a "creative" way...
+		int i = 0; // The index over the activations array
+		for (unsigned int dist = 0; dist < table.numDistances; dist++) {
+			QString turnLine = in.readLine(maxLineLength);
+			QStringList turnLineSplitted = turnLine.split(" ", QString::SkipEmptyParts);
+
+			// The line we just read should have been split in two. The first element should
+			// be equal to "TURN", the second one to the current dist
+			if ((turnLineSplitted.size() != 2) || (turnLineSplitted[0] != "TURN") || (turnLineSplitted[1].toUInt() != dist)) {
+				throw SampleFileLoadingException(filename.toLatin1().data(), ("Invalid TURN line: \"" + turnLine + "\"").toLatin1().data());
 			}
-			// Reading activations
-			for (unsigned int id = 0; id < m_numIR; id++) {
-				bool ok;
-				const unsigned int act = activationsLineSplitted[id].toUInt(&ok);
-				if ((!ok) || (act > 1023)) {
-					throw SampleFileLoadingException(m_filename.toLatin1().data(), ("Invalid activations line (invalid activation value): \"" + activationsLineSplitted[id] + "\"").toLatin1().data());
+
+			// Now reading the block for the current distance
+			for (unsigned int ang = 0; ang < table.numSamplingAngles; ang++) {
+				QString activationsLine = in.readLine(maxLineLength);
+				QStringList activationsLineSplitted = activationsLine.split(" ", QString::SkipEmptyParts);
+
+				// activationsLineSplitted should have numIR elements, all integers between 0 and 1023
+				if (activationsLineSplitted.size() != int(table.numIR)) {
+					throw SampleFileLoadingException(filename.toLatin1().data(), ("Invalid activations line (wrong number of elements, expected " + QString::number(table.numIR) + ", got " + QString::number(activationsLineSplitted.size()) + "): \"" + activationsLine + "\"").toLatin1().data());
+				}
+				// Reading activations
+				for (unsigned int id = 0; id < table.numIR; id++) {
+					bool ok;
+					const unsigned int act = activationsLineSplitted[id].toUInt(&ok);
+					if ((!ok) || (act > maxSampledIRActivation)) {
+						throw SampleFileLoadingException(filename.toLatin1().data(), ("Invalid activations line (invalid activation value): \"" + activationsLineSplitted[id] + "\"").toLatin1().data());
+					}
+					table.activations[i++] = act;
 				}
-				m_activations[i++] = act;
 			}
 		}
+
+		// The final row in the file should be "END"
+		QString finalLine = in.readLine(maxLineLength);
+		if (finalLine != "END") {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("The last line in the file should be \"END\", actual value: \"" + finalLine + "\"").toLatin1().data());
+		}
 	}
 
-	// The final row in the file should be "END"
-	QString finalLine = in.readLine(maxLineLength);
-	if (finalLine != "END") {
-		throw SampleFileLoadingException(m_filename.toLatin1().data(), ("The last line in the file should be \"END\", actual value: \"" + finalLine + "\"").toLatin1().data());
+	void loadBinarySamples(QFile& file, const QString& filename, SampledIRTable& table)
+	{
+		// Mapping the file in memory, there is no need to copy it in a buffer
+		const qint64 size = file.size();
+		const uchar* data = file.map(0, size);
+		if (data == nullptr) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("Cannot map file in memory: " + file.errorString()).toLatin1().data());
+		}
+
+		if (size < sampledIRBinaryHeaderSize) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), "The file is too short to contain the header");
+		}
+
+		const uchar* cur = data + sampledIRBinaryMagicSize;
+		const quint32 version = qFromLittleEndian<quint32>(cur);
+		cur += sizeof(quint32);
+		if (version != sampledIRBinaryVersion) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), ("Unsupported version of the binary format: " + QString::number(version)).toLatin1().data());
+		}
+		table.numIR = qFromLittleEndian<quint32>(cur);
+		cur += sizeof(quint32);
+		table.numSamplingAngles = qFromLittleEndian<quint32>(cur);
+		cur += sizeof(quint32);
+		table.numDistances = qFromLittleEndian<quint32>(cur);
+		cur += sizeof(quint32);
+		table.initialDistance = readFloatLittleEndian(cur);
+		cur += sizeof(float);
+		table.distanceInterval = readFloatLittleEndian(cur);
+		cur += sizeof(float);
+
+		// Checking the size in floating point to avoid overflows with corrupted headers
+		const double numActivations = double(table.numIR) * double(table.numSamplingAngles) * double(table.numDistances);
+		if ((numActivations * sizeof(quint16)) != double(size - sampledIRBinaryHeaderSize)) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), "The size of the file does not match the number of samples in the header");
+		}
+
+		table.activations.resize(int(numActivations));
+		for (int i = 0; i < table.activations.size(); i++, cur += sizeof(quint16)) {
+			const unsigned int act = qFromLittleEndian<quint16>(cur);
+			if (act > maxSampledIRActivation) {
+				throw SampleFileLoadingException(filename.toLatin1().data(), ("Invalid activation value: " + QString::number(act)).toLatin1().data());
+			}
+			table.activations[i] = act;
+		}
+
+		file.unmap(const_cast<uchar*>(data));
+	}
+
+	std::shared_ptr<const SampledIRTable> loadSampledIRTable(const QString& filename)
+	{
+		// Tables already loaded. Tables are kept as long as there is a SampledIRDataLoader using them.
+		// Files are identified by their canonical path, size and modification time, so that a file is
+		// loaded again if it changes
+		static QMutex tablesMutex;
+		static QHash<QString, std::weak_ptr<const SampledIRTable> > tables;
+
+		const QFileInfo info(filename);
+		const QString canonicalPath = info.canonicalFilePath();
+		if (canonicalPath.isEmpty()) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), "Cannot open file for reading");
+		}
+		const QString key = canonicalPath + "|" + QString::number(info.size()) + "|" + QString::number(info.lastModified().toMSecsSinceEpoch());
+
+		// The lock is kept while loading the file, so that concurrent requests of the same file only load it once
+		QMutexLocker locker(&tablesMutex);
+
+		std::shared_ptr<const SampledIRTable> table = tables.value(key).lock();
+		if (table) {
+			return table;
+		}
+
+		// Opening the input file
+		QFile file(filename);
+		if (!file.open(QIODevice::ReadOnly)) {
+			throw SampleFileLoadingException(filename.toLatin1().data(), "Cannot open file for reading");
+		}
+
+		std::shared_ptr<SampledIRTable> newTable(new SampledIRTable());
+		if (file.peek(sampledIRBinaryMagicSize) == QByteArray(sampledIRBinaryMagic, sampledIRBinaryMagicSize)) {
+			loadBinarySamples(file, filename, *newTable);
+		} else {
+			file.close();
+			if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+				throw SampleFileLoadingException(filename.toLatin1().data(), "Cannot open file for reading");
+			}
+			loadTextSamples(file, filename, *newTable);
+		}
+		newTable->nullActivations.fill(0, newTable->numIR);
+
+		// Removing entries of tables that have been released
+		QMutableHashIterator<QString, std::weak_ptr<const SampledIRTable> > it(tables);
+		while (it.hasNext()) {
+			if (it.next().value().expired()) {
+				it.remove();
+			}
+		}
+		tables.insert(key, newTable);
+
+		return newTable;
 	}
 }
 
+SampledIRDataLoader::SampledIRDataLoader(QString filename) :
+	m_filename(filename),
+	m_numIR(0),
+	m_numSamplingAngles(0),
+	m_numDistances(0),
+	m_initialDistance(0.0f),
+	m_distanceInterval(0.0f),
+	m_finalDistance(0.0f),
+	m_table(loadSampledIRTable(m_filename))
+{
+	m_numIR = m_table->numIR;
+	m_numSamplingAngles = m_table->numSamplingAngles;
+	m_numDistances = m_table->numDistances;
+	m_initialDistance = m_table->initialDistance;
+	m_distanceInterval = m_table->distanceInterval;
+	m_finalDistance = m_initialDistance + (m_numDistances - 1) * m_distanceInterval;
+}
+
 SampledIRDataLoader::~SampledIRDataLoader()
 {
 	// Nothing to do here
@@ -1385,7 +1562,7 @@ QVector<unsigned int>::const_iterator SampledIRDataLoader::getActivation(real di
 
 	// If we are over the maximum distance, returning all zeros
 	if (d >= m_numDistances) {
-		return m_nullActivations.begin();
+		return m_table->nullActivations.begin();
 	}
 
 	// We first have to restrict the angle between 0.0 and 2*PI, then we can compute the index.
@@ -1396,7 +1573,44 @@ QVector<unsigned int>::const_iterator SampledIRDataLoader::getActivation(real di
 		a = m_numSamplingAngles - 1;
 	}
 
-	return m_activations.begin() + getLinearIndex(0, a, d);
+	return m_table->activations.begin() + getLinearIndex(0, a, d);
+}
+
+bool SampledIRDataLoader::saveBinary(QString filename) const
+{
+	QByteArray data(sampledIRBinaryHeaderSize + m_table->activations.size() * sizeof(quint16), '\0');
+
+	uchar* cur = reinterpret_cast<uchar*>(data.data());
+	memcpy(cur, sampledIRBinaryMagic, sampledIRBinaryMagicSize);
+	cur += sampledIRBinaryMagicSize;
+	qToLittleEndian<quint32>(sampledIRBinaryVersion, cur);
+	cur += sizeof(quint32);
+	qToLittleEndian<quint32>(m_numIR, cur);
+	cur += sizeof(quint32);
+	qToLittleEndian<quint32>(m_numSamplingAngles, cur);
+	cur += sizeof(quint32);
+	qToLittleEndian<quint32>(m_numDistances, cur);
+	cur += sizeof(quint32);
+	writeFloatLittleEndian(m_initialDistance, cur);
+	cur += sizeof(float);
+	writeFloatLittleEndian(m_distanceInterval, cur);
+	cur += sizeof(float);
+	foreach (unsigned int act, m_table->activations) {
+		qToLittleEndian<quint16>(act, cur);
+		cur += sizeof(quint16);
+	}
+
+	QSaveFile file(filename);
+	if (!file.open(QIODevice::WriteOnly)) {
+		Logger::error("Cannot open file " + filename + " to save samples: " + file.errorString());
+		return false;
+	}
+	if ((file.write(data) != data.size()) || !file.commit()) {
+		Logger::error("Error writing samples to file " + filename + ": " + file.errorString());
+		return false;
+	}
+
+	return true;
 }
 
 unsigned int SampledIRDataLoader::getLinearIndex(unsigned int id, unsigned int ang, unsigned int dist) const
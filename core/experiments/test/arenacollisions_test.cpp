@@ -0,0 +1,189 @@
+/***************************************************************************
+ *  SALSA Experiments Library                                              *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QMap>
+#include <QSet>
+#include <QVector>
+#include "experimentsconfig.h"
+#include "configurationmanager.h"
+#include "arena.h"
+#include "wheeledexperimenthelper.h"
+#include "evorobotexperiment.h"
+#include "randomgenerator.h"
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+namespace {
+	const char* configuration =
+		"[__INTERNAL__]\n"
+		"BatchRunning = true\n"
+		"\n"
+		"[Experiment]\n"
+		"type = EvoRobotExperiment\n"
+		"nagents = 12\n"
+		"\n"
+		"[Experiment/ARENA]\n"
+		"type = Arena\n"
+		"collisionHandler = SimpleCollisions\n"
+		"planeWidth = 1.0\n"
+		"planeHeight = 1.0\n"
+		"\n"
+		"[Experiment/AGENT]\n"
+		"type = EmbodiedAgent\n"
+		"\n"
+		"[Experiment/AGENT/ROBOT]\n"
+		"type = Khepera\n"
+		"kinematicRobot = true\n"
+		"\n"
+		"[Experiment/AGENT/CONTROLLER]\n"
+		"type = Evonet\n"
+		"inputsList = ../\n"
+		"outputsList = ../\n"
+		"\n"
+		"[Experiment/AGENT/MOTOR:0]\n"
+		"type = KheperaWheelVelocityMotor\n"
+		"name = Wheels\n";
+
+	// Computes the collisions of each robot checking every object against
+	// every robot, as the arena did before the broad phase was introduced.
+	// Robots must not have moved since prepareToHandleKinematicRobotCollisions()
+	// was called, so that moving back colliding robots has no effect
+	QMap<PhyObject2DWrapper*, QSet<PhyObject2DWrapper*> > bruteForceCollisions(const QVector<PhyObject2DWrapper*>& objects)
+	{
+		QMap<PhyObject2DWrapper*, QSet<PhyObject2DWrapper*> > collisions;
+
+		foreach (PhyObject2DWrapper* o, objects) {
+			WheeledRobot2DWrapper* robot = dynamic_cast<WheeledRobot2DWrapper*>(o);
+			if ((robot == nullptr) || (!robot->robotOnPlane()->isKinematic())) {
+				continue;
+			}
+
+			foreach (PhyObject2DWrapper* obj, objects) {
+				if ((obj == robot) || ((obj->phyObject() != nullptr) && (obj->phyObject()->isCollidable() == false))) {
+					continue;
+				}
+
+				double distance;
+				double angle;
+				if (obj->computeDistanceAndOrientationFromRobot(*robot, distance, angle) && (distance < 0.0)) {
+					collisions[robot].insert(obj);
+
+					WheeledRobot2DWrapper* otherRobot = dynamic_cast<WheeledRobot2DWrapper*>(obj);
+					if (otherRobot != nullptr) {
+						collisions[otherRobot].insert(robot);
+					}
+				}
+			}
+		}
+
+		return collisions;
+	}
+}
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class ArenaCollisions_Test : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void broadPhaseGivesSameCollisionsAsBruteForce()
+	{
+		QTemporaryDir dir;
+		QVERIFY(dir.isValid());
+		const QString confFilename = dir.path() + "/configuration.ini";
+		{
+			QFile confFile(confFilename);
+			QVERIFY(confFile.open(QIODevice::WriteOnly));
+			confFile.write(configuration);
+		}
+
+		ConfigurationManager manager;
+		QVERIFY(manager.loadParameters(confFilename));
+		EvoRobotExperiment* exp = manager.getComponentFromGroup<EvoRobotExperiment>("Experiment");
+		Arena* arena = exp->getArena();
+		QVERIFY(arena != nullptr);
+
+		RandomGenerator rng(1234);
+
+		// Walls with random orientations (only boxes lying on the plane use the grid), some cylinders and light bulbs
+		for (int i = 0; i < 4; i++) {
+			const wVector start(rng.getDouble(-0.5, 0.5), rng.getDouble(-0.5, 0.5), 0.0);
+			const wVector end(rng.getDouble(-0.5, 0.5), rng.getDouble(-0.5, 0.5), 0.0);
+			arena->createWall(Qt::blue, start, end, 0.02);
+		}
+		QVector<PhyObject2DWrapper*> movableObjects;
+		for (int i = 0; i < 20; i++) {
+			movableObjects.append(arena->createSmallCylinder(Qt::red));
+			movableObjects.append(arena->createBigCylinder(Qt::green));
+		}
+		for (int i = 0; i < 5; i++) {
+			movableObjects.append(arena->createLightBulb(Qt::yellow));
+		}
+		QVector<WheeledRobot2DWrapper*> robots;
+		foreach (PhyObject2DWrapper* o, arena->getObjects()) {
+			WheeledRobot2DWrapper* robot = dynamic_cast<WheeledRobot2DWrapper*>(o);
+			if (robot != nullptr) {
+				robots.append(robot);
+			}
+		}
+		QCOMPARE(robots.size(), 12);
+
+		int numCollisions = 0;
+		for (int iteration = 0; iteration < 200; iteration++) {
+			// Some objects may end up outside the plane, the result must be the same anyway
+			foreach (PhyObject2DWrapper* o, movableObjects) {
+				o->setPosition(rng.getDouble(-0.6, 0.6), rng.getDouble(-0.6, 0.6));
+			}
+			foreach (WheeledRobot2DWrapper* robot, robots) {
+				robot->setPosition(rng.getDouble(-0.6, 0.6), rng.getDouble(-0.6, 0.6));
+			}
+
+			arena->prepareToHandleKinematicRobotCollisions();
+			const QMap<PhyObject2DWrapper*, QSet<PhyObject2DWrapper*> > expected = bruteForceCollisions(arena->getObjects());
+			arena->handleKinematicRobotCollisions();
+
+			foreach (WheeledRobot2DWrapper* robot, robots) {
+				QCOMPARE(arena->getKinematicRobotCollisionsSet(robot), expected.value(robot));
+				numCollisions += expected.value(robot).size();
+			}
+		}
+
+		// Checking that the test is meaningful
+		QVERIFY(numCollisions > 0);
+
+		delete exp;
+	}
+};
+
+QTEST_MAIN(ArenaCollisions_Test)
+#include "arenacollisions_test.moc"
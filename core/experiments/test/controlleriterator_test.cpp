@@ -0,0 +1,243 @@
+/***************************************************************************
+ *  SALSA Experiments Library                                              *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QVector>
+#include "controlleriterator.h"
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+/**
+ * \brief An iterator on a single block of values, which can give direct
+ *        access to them or not
+ */
+class VectorIterator : public AbstractControllerInputIterator, public AbstractControllerOutputIterator
+{
+public:
+	VectorIterator(int size, bool allowSpans)
+		: m_values(size, 0.0)
+		, m_allowSpans(allowSpans)
+		, m_curIndex(0)
+	{
+	}
+
+	virtual void setCurrentBlock(int)
+	{
+		m_curIndex = 0;
+	}
+
+	virtual bool next()
+	{
+		if (m_curIndex >= m_values.size()) {
+			throw "next() called past the end of the block";
+		}
+
+		m_curIndex++;
+
+		return m_curIndex < m_values.size();
+	}
+
+	virtual void setProperties(QString, real, real, QColor)
+	{
+	}
+
+	virtual QString label() const
+	{
+		return QString();
+	}
+
+	virtual real minValue() const
+	{
+		return 0.0;
+	}
+
+	virtual real maxValue() const
+	{
+		return 1.0;
+	}
+
+	virtual QColor color() const
+	{
+		return QColor();
+	}
+
+	virtual void setInput(real value)
+	{
+		m_values[m_curIndex] = value;
+	}
+
+	// Like EvonetIterator, this throws when called past the end of the block
+	virtual real* inputSpan(int& size)
+	{
+		if (m_curIndex >= m_values.size()) {
+			throw "inputSpan() called past the end of the block";
+		}
+		if (!m_allowSpans) {
+			return AbstractControllerInputIterator::inputSpan(size);
+		}
+
+		size = m_values.size() - m_curIndex;
+
+		return m_values.data() + m_curIndex;
+	}
+
+	virtual real getOutput() const
+	{
+		return m_values[m_curIndex];
+	}
+
+	virtual const real* outputSpan(int& size) const
+	{
+		if (m_curIndex >= m_values.size()) {
+			throw "outputSpan() called past the end of the block";
+		}
+		if (!m_allowSpans) {
+			return AbstractControllerOutputIterator::outputSpan(size);
+		}
+
+		size = m_values.size() - m_curIndex;
+
+		return m_values.constData() + m_curIndex;
+	}
+
+	QVector<real>& values()
+	{
+		return m_values;
+	}
+
+	int currentIndex() const
+	{
+		return m_curIndex;
+	}
+
+private:
+	QVector<real> m_values;
+	const bool m_allowSpans;
+	int m_curIndex;
+};
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class ControllerIterator_Test : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void mixSetInputAndSetInputs_data()
+	{
+		QTest::addColumn<bool>("allowSpans");
+
+		QTest::newRow("per value") << false;
+		QTest::newRow("span") << true;
+	}
+
+	void mixSetInputAndSetInputs()
+	{
+		QFETCH(bool, allowSpans);
+
+		const real block1[] = {1.0, 2.0, 3.0};
+		const real block2[] = {5.0, 6.0};
+
+		VectorIterator it(7, allowSpans);
+		it.setCurrentBlock(0);
+
+		it.setInputs(block1, 3);
+		QCOMPARE(it.currentIndex(), 3);
+		it.setInput(4.0);
+		it.next();
+		it.setInputs(block2, 2);
+		QCOMPARE(it.currentIndex(), 6);
+		it.setInput(7.0);
+		QVERIFY(!it.next());
+
+		QCOMPARE(it.values(), QVector<real>() << 1.0 << 2.0 << 3.0 << 4.0 << 5.0 << 6.0 << 7.0);
+	}
+
+	void mixGetOutputAndGetOutputs_data()
+	{
+		QTest::addColumn<bool>("allowSpans");
+
+		QTest::newRow("per value") << false;
+		QTest::newRow("span") << true;
+	}
+
+	void mixGetOutputAndGetOutputs()
+	{
+		QFETCH(bool, allowSpans);
+
+		VectorIterator it(5, allowSpans);
+		it.values() = QVector<real>() << 1.0 << 2.0 << 3.0 << 4.0 << 5.0;
+		it.setCurrentBlock(0);
+
+		real outputs[2];
+		QCOMPARE(it.getOutput(), real(1.0));
+		it.next();
+		it.getOutputs(outputs, 2);
+		QCOMPARE(outputs[0], real(2.0));
+		QCOMPARE(outputs[1], real(3.0));
+		QCOMPARE(it.currentIndex(), 3);
+		QCOMPARE(it.getOutput(), real(4.0));
+		it.next();
+		it.getOutputs(outputs, 1);
+		QCOMPARE(outputs[0], real(5.0));
+		QCOMPARE(it.currentIndex(), 5);
+	}
+
+	void noValues_data()
+	{
+		QTest::addColumn<bool>("allowSpans");
+		QTest::addColumn<int>("blockSize");
+
+		QTest::newRow("per value, empty block") << false << 0;
+		QTest::newRow("span, empty block") << true << 0;
+		QTest::newRow("per value, end of block") << false << 2;
+		QTest::newRow("span, end of block") << true << 2;
+	}
+
+	void noValues()
+	{
+		QFETCH(bool, allowSpans);
+		QFETCH(int, blockSize);
+
+		VectorIterator it(blockSize, allowSpans);
+		it.setCurrentBlock(0);
+		for (int i = 0; i < blockSize; i++) {
+			it.next();
+		}
+
+		// Nothing must be accessed, not even the span
+		real value = 0.0;
+		it.setInputs(&value, 0);
+		it.getOutputs(&value, 0);
+		QCOMPARE(it.currentIndex(), blockSize);
+	}
+};
+
+QTEST_MAIN(ControllerIterator_Test)
+#include "controlleriterator_test.moc"
@@ -0,0 +1,195 @@
+/***************************************************************************
+ *  SALSA Experiments Library                                              *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include "experimentsconfig.h"
+#include "configurationmanager.h"
+#include "typesdb.h"
+#include "evoga.h"
+#include "evonet.h"
+#include "evorobotexperiment.h"
+#include "embodiedagent.h"
+#include "randomgenerator.h"
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+/**
+ * \brief An experiment whose fitness depends on the genes and on noise
+ *        taken from globalRNG
+ */
+class EvogaDeterminismTestExperiment : public EvoRobotExperiment
+{
+public:
+	EvogaDeterminismTestExperiment(ConfigurationManager& params)
+		: EvoRobotExperiment(params)
+	{
+	}
+
+	virtual void endStep(int)
+	{
+		Evonet* evonet = dynamic_cast<Evonet*>(getAgent(0)->controller());
+
+		trialFitnessValue += evonet->getOutput(0) * globalRNG->getDouble(0.5, 1.5) + evonet->getOutput(1);
+	}
+};
+
+namespace {
+	const char* configurationTemplate =
+		"[__INTERNAL__]\n"
+		"BatchRunning = true\n"
+		"\n"
+		"[GA]\n"
+		"type = Evoga\n"
+		"evolutionType = %1\n"
+		"ngenerations = 3\n"
+		"nreplications = 2\n"
+		"nreproducing = 3\n"
+		"noffspring = 2\n"
+		"seed = 7\n"
+		"numThreads = %2\n"
+		"physicsThreads = %3\n"
+		"\n"
+		"[GA/Experiment]\n"
+		"type = EvogaDeterminismTestExperiment\n"
+		"ntrials = 2\n"
+		"nsteps = 5\n"
+		"\n"
+		"[GA/Experiment/AGENT]\n"
+		"type = EmbodiedAgent\n"
+		"\n"
+		"[GA/Experiment/AGENT/ROBOT]\n"
+		"type = Khepera\n"
+		"kinematicRobot = true\n"
+		"\n"
+		"[GA/Experiment/AGENT/CONTROLLER]\n"
+		"type = Evonet\n"
+		"nHiddens = 2\n"
+		"biasOnHiddenNeurons = true\n"
+		"biasOnOutputNeurons = true\n"
+		"inputsList = ../\n"
+		"outputsList = ../\n"
+		"\n"
+		"[GA/Experiment/AGENT/MOTOR:0]\n"
+		"type = KheperaWheelVelocityMotor\n"
+		"name = Wheels\n";
+
+	// Runs an evolution in a new temporary directory and returns the content
+	// of all the files it produced (statistics, bests and populations)
+	QMap<QString, QByteArray> runEvolution(QString evolutionType, int numThreads, int physicsThreads)
+	{
+		QMap<QString, QByteArray> files;
+
+		// A new directory each time, otherwise Evoga would recover the
+		// previous evolution
+		QTemporaryDir dir;
+		if (!dir.isValid()) {
+			return files;
+		}
+		const QString previousDir = QDir::currentPath();
+		QDir::setCurrent(dir.path());
+
+		{
+			QFile confFile("configuration.ini");
+			if (confFile.open(QIODevice::WriteOnly)) {
+				confFile.write(QString(configurationTemplate).arg(evolutionType).arg(numThreads).arg(physicsThreads).toLatin1());
+			}
+		}
+
+		{
+			ConfigurationManager manager;
+			if (manager.loadParameters("configuration.ini")) {
+				Evoga* ga = manager.getComponentFromGroup<Evoga>("GA");
+				ga->evolveAllReplicas();
+				// This also waits for all files to be written
+				delete ga;
+			}
+		}
+
+		foreach (QString filename, QDir().entryList(QDir::Files, QDir::Name)) {
+			if (filename == "configuration.ini") {
+				continue;
+			}
+			QFile f(filename);
+			if (f.open(QIODevice::ReadOnly)) {
+				files[filename] = f.readAll();
+			}
+		}
+
+		QDir::setCurrent(previousDir);
+
+		return files;
+	}
+}
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class EvogaDeterminism_Test : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase()
+	{
+		TypesDB::instance().registerType<EvogaDeterminismTestExperiment>("EvogaDeterminismTestExperiment", QStringList() << "EvoRobotExperiment");
+	}
+
+	void steadyStateDoesNotDependOnThreads()
+	{
+		const QMap<QString, QByteArray> sequential = runEvolution("steadyState", 1, 1);
+		QVERIFY(sequential.contains("statS7.fit"));
+		QVERIFY(sequential.contains("statS8.fit"));
+
+		// A pool of evaluators with a single physics thread each
+		QCOMPARE(runEvolution("steadyState", 3, 1), sequential);
+		// Two evaluators with two physics threads each
+		QCOMPARE(runEvolution("steadyState", 4, 2), sequential);
+		// Split decided automatically
+		QCOMPARE(runEvolution("steadyState", 4, 0), sequential);
+		QCOMPARE(runEvolution("steadyState", 16, 0), sequential);
+	}
+
+	void generationalDoesNotDependOnThreads()
+	{
+		const QMap<QString, QByteArray> sequential = runEvolution("generational", 1, 1);
+		QVERIFY(sequential.contains("statS7.fit"));
+		QVERIFY(sequential.contains("statS8.fit"));
+
+		// Individuals are evaluated one at a time, all threads go to the
+		// physics engine
+		QCOMPARE(runEvolution("generational", 4, 0), sequential);
+		QCOMPARE(runEvolution("generational", 4, 2), sequential);
+	}
+};
+
+QTEST_MAIN(EvogaDeterminism_Test)
+#include "evogadeterminism_test.moc"
@@ -0,0 +1,450 @@
+/***************************************************************************
+ *  SALSA Experiments Library                                              *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QList>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QVector>
+#include "experimentsconfig.h"
+#include "configurationmanager.h"
+#include "evoga.h"
+#include "evogafarm.h"
+#include "evorobotexperiment.h"
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+namespace {
+	const char* configuration =
+		"[__INTERNAL__]\n"
+		"BatchRunning = true\n"
+		"\n"
+		"[GA]\n"
+		"type = Evoga\n"
+		"nreproducing = 4\n"
+		"noffspring = 3\n"
+		"seed = 7\n"
+		"\n"
+		"[GA/Experiment]\n"
+		"type = EvoRobotExperiment\n"
+		"\n"
+		"[GA/Experiment/AGENT]\n"
+		"type = EmbodiedAgent\n"
+		"\n"
+		"[GA/Experiment/AGENT/ROBOT]\n"
+		"type = Khepera\n"
+		"kinematicRobot = true\n"
+		"\n"
+		"[GA/Experiment/AGENT/CONTROLLER]\n"
+		"type = Evonet\n"
+		"inputsList = ../\n"
+		"outputsList = ../\n"
+		"\n"
+		"[GA/Experiment/AGENT/MOTOR:0]\n"
+		"type = KheperaWheelVelocityMotor\n"
+		"name = Wheels\n";
+
+	// The fitness sent by workers when results arrive too late. It must
+	// never be used by the master
+	const double lateFitness = -1000.0;
+
+	// An Evaluate request
+	EvogaFarmRequest evaluateRequest()
+	{
+		EvogaFarmRequest request;
+		request.quit = false;
+		request.jobId = 17;
+		request.seed = 1234;
+		request.generation = 5;
+		request.individual = 42;
+		for (int i = 0; i < 300; i++) {
+			request.genes.append(char(i % 256));
+		}
+
+		return request;
+	}
+
+	// The fitness computed by test workers. Before evolution starts all
+	// genes of an individual are equal to its id, so the expected fitness
+	// of individual id is 1.5 * id
+	double workerFitness(const EvogaFarmRequest& request)
+	{
+		return quint8(request.genes.at(0)) + 0.5 * request.individual;
+	}
+
+	// Returns the data written on a connection to send the given messages
+	QByteArray frameMessages(const QList<QByteArray>& payloads)
+	{
+		QByteArray data;
+		QBuffer buffer(&data);
+		buffer.open(QIODevice::WriteOnly);
+		foreach (const QByteArray& payload, payloads) {
+			EvogaFarmFraming::writeMessage(&buffer, payload);
+		}
+
+		return data;
+	}
+
+	// Extracts all complete messages from buffer, returns false if data is
+	// invalid
+	bool takeAllMessages(QByteArray& buffer, QList<QByteArray>& payloads)
+	{
+		QByteArray payload;
+		int res;
+		while ((res = EvogaFarmFraming::takeMessage(buffer, payload)) == 1) {
+			payloads.append(payload);
+		}
+
+		return (res == 0);
+	}
+}
+
+/**
+ * \brief A worker of the farm running in its own thread
+ *
+ * The worker evaluates individuals with workerFitness(). If jobsBeforeCrash
+ * is positive, after receiving that many requests the worker closes the
+ * connection without answering, as if it crashed. Then it connects again,
+ * sends the result of the first lost job (which the master must discard)
+ * and continues as a normal worker. All members must only be read after the
+ * thread has finished
+ */
+class EvogaFarmTestWorker : public QThread
+{
+public:
+	EvogaFarmTestWorker(const QString& address, int genomeLength, int jobsBeforeCrash, int msecsPerEvaluation)
+		: QThread()
+		, requests()
+		, lostRequests()
+		, errors()
+		, m_address(address)
+		, m_genomeLength(genomeLength)
+		, m_jobsBeforeCrash(jobsBeforeCrash)
+		, m_msecsPerEvaluation(msecsPerEvaluation)
+	{
+	}
+
+	// All requests received
+	QList<EvogaFarmRequest> requests;
+
+	// The requests received before crashing
+	QList<EvogaFarmRequest> lostRequests;
+
+	// The errors that happened
+	QStringList errors;
+
+protected:
+	virtual void run()
+	{
+		EvogaFarmWorkerConnection* connection = new EvogaFarmWorkerConnection(m_address, m_genomeLength);
+		if (!connection->connectToMaster(5000)) {
+			errors.append("cannot connect to the master");
+			delete connection;
+			return;
+		}
+
+		while (true) {
+			EvogaFarmRequest request;
+			if (!connection->waitForRequest(request, 10000)) {
+				if (connection->isConnected()) {
+					errors.append("timeout waiting for a request");
+				} else {
+					errors.append("connection closed without a Quit message");
+				}
+				break;
+			}
+			if (request.quit) {
+				break;
+			}
+			requests.append(request);
+
+			if (request.genes.count(char(request.individual)) != m_genomeLength) {
+				errors.append(QString("wrong genes for individual %1").arg(request.individual));
+			}
+
+			if (lostRequests.size() < m_jobsBeforeCrash) {
+				lostRequests.append(request);
+				if (lostRequests.size() == m_jobsBeforeCrash) {
+					// Crashing and restarting
+					delete connection;
+					connection = new EvogaFarmWorkerConnection(m_address, m_genomeLength);
+					if (!connection->connectToMaster(5000)) {
+						errors.append("cannot connect again to the master");
+						break;
+					}
+					connection->sendResult(lostRequests[0].jobId, lateFitness);
+				}
+				continue;
+			}
+
+			msleep(m_msecsPerEvaluation);
+			if (!connection->sendResult(request.jobId, workerFitness(request))) {
+				errors.append("cannot send a result");
+				break;
+			}
+		}
+
+		delete connection;
+	}
+
+private:
+	const QString m_address;
+	const int m_genomeLength;
+	const int m_jobsBeforeCrash;
+	const int m_msecsPerEvaluation;
+};
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class EvogaFarm_Test : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void coalescedMessages()
+	{
+		const QList<QByteArray> payloads = QList<QByteArray>() << EvogaFarmMessages::request(evaluateRequest()) << QByteArray() << EvogaFarmMessages::result(17, 0.123456789);
+
+		// All messages arrive at once
+		QByteArray buffer = frameMessages(payloads);
+		QList<QByteArray> received;
+		QVERIFY(takeAllMessages(buffer, received));
+
+		QCOMPARE(received, payloads);
+		QVERIFY(buffer.isEmpty());
+	}
+
+	void splitMessages()
+	{
+		const QList<QByteArray> payloads = QList<QByteArray>() << EvogaFarmMessages::request(evaluateRequest()) << EvogaFarmMessages::result(17, 0.123456789);
+		const QByteArray data = frameMessages(payloads);
+
+		// Data arrives in two parts, split at every possible position (also
+		// inside the length prefix)
+		for (int split = 0; split <= data.size(); split++) {
+			QByteArray buffer;
+			QList<QByteArray> received;
+
+			buffer.append(data.left(split));
+			QVERIFY(takeAllMessages(buffer, received));
+			buffer.append(data.mid(split));
+			QVERIFY(takeAllMessages(buffer, received));
+
+			QCOMPARE(received, payloads);
+			QVERIFY(buffer.isEmpty());
+		}
+	}
+
+	void byteByByte()
+	{
+		const QList<QByteArray> payloads = QList<QByteArray>() << EvogaFarmMessages::hello(300) << EvogaFarmMessages::request(evaluateRequest()) << EvogaFarmMessages::result(17, 0.123456789);
+		const QByteArray data = frameMessages(payloads);
+
+		QByteArray buffer;
+		QList<QByteArray> received;
+		for (int i = 0; i < data.size(); i++) {
+			buffer.append(data[i]);
+			QVERIFY(takeAllMessages(buffer, received));
+		}
+
+		QCOMPARE(received, payloads);
+		QVERIFY(buffer.isEmpty());
+	}
+
+	void invalidLength()
+	{
+		const QByteArray resultPayload = EvogaFarmMessages::result(17, 0.123456789);
+		QByteArray buffer = frameMessages(QList<QByteArray>() << resultPayload);
+		const quint32 size = EvogaFarmFraming::maxMessageSize + 1;
+		buffer.append(char(size >> 24)).append(char(size >> 16)).append(char(size >> 8)).append(char(size));
+
+		// The first message is valid, the following length is not
+		QByteArray payload;
+		QCOMPARE(EvogaFarmFraming::takeMessage(buffer, payload), 1);
+		QCOMPARE(payload, resultPayload);
+		QCOMPARE(EvogaFarmFraming::takeMessage(buffer, payload), -1);
+	}
+
+	void helloMessage()
+	{
+		const QByteArray payload = EvogaFarmMessages::hello(300);
+		QCOMPARE(EvogaFarmMessages::type(payload), EvogaFarmMessages::HelloMessage);
+
+		int genomeLength = 0;
+		QVERIFY(EvogaFarmMessages::readHello(payload, genomeLength));
+		QCOMPARE(genomeLength, 300);
+
+		// Changing the magic number (it follows the type)
+		QByteArray wrongMagic = payload;
+		wrongMagic[1] = char(wrongMagic[1] ^ 0xFF);
+		QVERIFY(!EvogaFarmMessages::readHello(wrongMagic, genomeLength));
+
+		QVERIFY(!EvogaFarmMessages::readHello(payload.left(payload.size() - 1), genomeLength));
+		QVERIFY(!EvogaFarmMessages::readHello(EvogaFarmMessages::result(17, 0.5), genomeLength));
+	}
+
+	void evaluateMessage()
+	{
+		const EvogaFarmRequest sent = evaluateRequest();
+		const QByteArray payload = EvogaFarmMessages::request(sent);
+		QCOMPARE(EvogaFarmMessages::type(payload), EvogaFarmMessages::EvaluateMessage);
+
+		EvogaFarmRequest received;
+		QVERIFY(EvogaFarmMessages::readRequest(payload, received));
+		QCOMPARE(received.quit, false);
+		QCOMPARE(received.jobId, sent.jobId);
+		QCOMPARE(received.seed, sent.seed);
+		QCOMPARE(received.generation, sent.generation);
+		QCOMPARE(received.individual, sent.individual);
+		QCOMPARE(received.genes, sent.genes);
+
+		QVERIFY(!EvogaFarmMessages::readRequest(payload.left(payload.size() - 1), received));
+		QVERIFY(!EvogaFarmMessages::readRequest(EvogaFarmMessages::hello(300), received));
+	}
+
+	void quitMessage()
+	{
+		EvogaFarmRequest sent;
+		sent.quit = true;
+		const QByteArray payload = EvogaFarmMessages::request(sent);
+		QCOMPARE(EvogaFarmMessages::type(payload), EvogaFarmMessages::QuitMessage);
+
+		EvogaFarmRequest received;
+		received.quit = false;
+		QVERIFY(EvogaFarmMessages::readRequest(payload, received));
+		QCOMPARE(received.quit, true);
+	}
+
+	void resultMessage()
+	{
+		const QByteArray payload = EvogaFarmMessages::result(17, 0.123456789);
+		QCOMPARE(EvogaFarmMessages::type(payload), EvogaFarmMessages::ResultMessage);
+
+		quint32 jobId = 0;
+		double fitness = 0.0;
+		QVERIFY(EvogaFarmMessages::readResult(payload, jobId, fitness));
+		QCOMPARE(jobId, quint32(17));
+		QCOMPARE(fitness, 0.123456789);
+
+		QVERIFY(!EvogaFarmMessages::readResult(payload.left(payload.size() - 1), jobId, fitness));
+		QVERIFY(!EvogaFarmMessages::readResult(EvogaFarmMessages::request(evaluateRequest()), jobId, fitness));
+	}
+
+	void invalidMessageType()
+	{
+		QCOMPARE(EvogaFarmMessages::type(QByteArray()), EvogaFarmMessages::InvalidMessage);
+		QCOMPARE(EvogaFarmMessages::type(QByteArray(1, char(0))), EvogaFarmMessages::InvalidMessage);
+		QCOMPARE(EvogaFarmMessages::type(QByteArray(1, char(100))), EvogaFarmMessages::InvalidMessage);
+	}
+
+	void workerDroppedDuringEvaluation()
+	{
+		QTemporaryDir dir;
+		QVERIFY(dir.isValid());
+		const QString confFilename = dir.path() + "/configuration.ini";
+		{
+			QFile confFile(confFilename);
+			QVERIFY(confFile.open(QIODevice::WriteOnly));
+			confFile.write(configuration);
+		}
+
+		// Evoga writes its files in the current directory
+		const QString previousDir = QDir::currentPath();
+		QDir::setCurrent(dir.path());
+
+		ConfigurationManager manager;
+		QVERIFY(manager.loadParameters(confFilename));
+		Evoga* ga = manager.getComponentFromGroup<Evoga>("GA");
+		const int genomeLength = ga->getEvoRobotExperiment()->getGenomeLength();
+		const int popSize = 12;
+		const int jobsPerWorker = 2;
+		// A local socket, the name is unique so that tests can run in
+		// parallel
+		const QString address = QString("salsaEvogaFarmTest%1").arg(QCoreApplication::applicationPid());
+
+		QVector<double> fitness(popSize, 0.0);
+		EvogaFarmTestWorker crashingWorker(address, genomeLength, jobsPerWorker, 0);
+		EvogaFarmTestWorker normalWorker(address, genomeLength, 0, 20);
+		{
+			EvogaFarmMaster master(ga, genomeLength, jobsPerWorker);
+			QVERIFY(master.listen(address));
+
+			// The crashing worker connects first, so that it receives the
+			// first jobs
+			crashingWorker.start();
+			QTRY_COMPARE(master.numWorkers(), 1);
+			normalWorker.start();
+			QTRY_COMPARE(master.numWorkers(), 2);
+
+			QVERIFY(master.evaluate(0, popSize, fitness));
+
+			// Here the master tells workers to quit
+		}
+		QVERIFY(crashingWorker.wait(30000));
+		QVERIFY(normalWorker.wait(30000));
+		QCOMPARE(crashingWorker.errors, QStringList());
+		QCOMPARE(normalWorker.errors, QStringList());
+
+		// Every fitness slot has the value computed by a worker, the late
+		// result has been discarded
+		for (int id = 0; id < popSize; id++) {
+			QCOMPARE(fitness[id], 1.5 * id);
+		}
+
+		// The lost jobs have been sent again with a new job id
+		const QList<EvogaFarmRequest> allRequests = crashingWorker.requests + normalWorker.requests;
+		QCOMPARE(crashingWorker.lostRequests.size(), jobsPerWorker);
+		foreach (const EvogaFarmRequest& lost, crashingWorker.lostRequests) {
+			int numResent = 0;
+			foreach (const EvogaFarmRequest& request, allRequests) {
+				if ((request.individual == lost.individual) && (request.jobId != lost.jobId)) {
+					numResent++;
+				}
+			}
+			QCOMPARE(numResent, 1);
+		}
+
+		// Each individual is sent once, apart from lost jobs
+		QCOMPARE(allRequests.size(), popSize + jobsPerWorker);
+		foreach (const EvogaFarmRequest& request, allRequests) {
+			QCOMPARE(request.seed, quint32(ga->getCurrentSeed()));
+			QCOMPARE(request.generation, qint32(ga->getCurrentGeneration()));
+		}
+
+		delete ga;
+		QDir::setCurrent(previousDir);
+	}
+};
+
+QTEST_MAIN(EvogaFarm_Test)
+#include "evogafarm_test.moc"
@@ -0,0 +1,223 @@
+/***************************************************************************
+ *  SALSA Experiments Library                                              *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QVector>
+#include "experimentsconfig.h"
+#include "configurationmanager.h"
+#include "typesdb.h"
+#include "controllerinputoutput.h"
+#include "evonet.h"
+#include "evorobotexperiment.h"
+#include "embodiedagent.h"
+#include "randomgenerator.h"
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+/**
+ * \brief A sensor that only gives the network some inputs. Inputs are set
+ *        directly on the network by the test
+ */
+class EvonetBatchTestSensor : public AbstractControllerInput
+{
+public:
+	EvonetBatchTestSensor(ConfigurationManager& params)
+		: AbstractControllerInput(params)
+	{
+	}
+
+	virtual int size() const
+	{
+		return 4;
+	}
+
+protected:
+	virtual void iteratorChanged(AbstractControllerInputIterator*)
+	{
+	}
+
+	virtual void updateCalled()
+	{
+	}
+};
+
+namespace {
+	const char* configurationTemplate =
+		"[__INTERNAL__]\n"
+		"BatchRunning = true\n"
+		"\n"
+		"[Experiment]\n"
+		"type = EvoRobotExperiment\n"
+		"\n"
+		"[Experiment/AGENT]\n"
+		"type = EmbodiedAgent\n"
+		"\n"
+		"[Experiment/AGENT/ROBOT]\n"
+		"type = Khepera\n"
+		"kinematicRobot = true\n"
+		"\n"
+		"[Experiment/AGENT/CONTROLLER]\n"
+		"type = Evonet\n"
+		"inputsList = ../\n"
+		"outputsList = ../\n"
+		"%1"
+		"\n"
+		"[Experiment/AGENT/SENSOR:0]\n"
+		"type = EvonetBatchTestSensor\n"
+		"\n"
+		"[Experiment/AGENT/MOTOR:0]\n"
+		"type = KheperaWheelVelocityMotor\n"
+		"name = Wheels\n";
+
+	// The maximum difference between the outputs of Evonet and EvonetBatch
+	const float tolerance = 1e-5f;
+}
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class EvonetBatch_Test : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase()
+	{
+		TypesDB::instance().registerType<EvonetBatchTestSensor>("EvonetBatchTestSensor", QStringList() << "AbstractControllerInput");
+	}
+
+	void sameOutputsAsEvonet_data()
+	{
+		QTest::addColumn<QString>("netParameters");
+
+		QTest::newRow("feed forward") << "nHiddens = 3\nbiasOnHiddenNeurons = true\nbiasOnOutputNeurons = true\n";
+		QTest::newRow("no hiddens") << "nHiddens = 0\ninputOutputConnections = true\nbiasOnOutputNeurons = true\n";
+		QTest::newRow("recurrent") << "nHiddens = 4\nrecurrentHiddens = true\nrecurrentOutputs = true\ninputOutputConnections = true\nbiasOnHiddenNeurons = true\nbiasOnOutputNeurons = true\n";
+		QTest::newRow("delta neurons") << "nHiddens = 3\ninputNeuronType = with_delta\nhiddenNeuronType = logistic+delta\noutputNeuronType = with_delta\nrecurrentHiddens = true\nbiasOnHiddenNeurons = true\n";
+		QTest::newRow("logistic 0.2") << "nHiddens = 3\nhiddenNeuronType = logistic_0.2\nbiasOnHiddenNeurons = true\n";
+	}
+
+	void sameOutputsAsEvonet()
+	{
+		QFETCH(QString, netParameters);
+
+		QTemporaryDir dir;
+		QVERIFY(dir.isValid());
+		const QString confFilename = dir.path() + "/configuration.ini";
+		{
+			QFile confFile(confFilename);
+			QVERIFY(confFile.open(QIODevice::WriteOnly));
+			confFile.write(QString(configurationTemplate).arg(netParameters).toLatin1());
+		}
+
+		ConfigurationManager manager;
+		QVERIFY(manager.loadParameters(confFilename));
+		EvoRobotExperiment* exp = manager.getComponentFromGroup<EvoRobotExperiment>("Experiment");
+		Evonet* net = dynamic_cast<Evonet*>(exp->getAgent(0)->controller());
+		QVERIFY(net != nullptr);
+		QCOMPARE(net->getNoInputs(), 4);
+		QCOMPARE(net->getNoOutputs(), 2);
+
+		const int numNetworks = 7;
+		const int numSteps = 20;
+		const int numInputs = net->getNoInputs();
+		const int numOutputs = net->getNoOutputs();
+		RandomGenerator rng(4321);
+
+		// Random genomes, with the same values Evoga uses
+		QVector<QVector<int> > genomes(numNetworks);
+		for (int i = 0; i < numNetworks; i++) {
+			genomes[i].resize(net->freeParameters());
+			for (int g = 0; g < genomes[i].size(); g++) {
+				genomes[i][g] = rng.getInt(0, 255);
+			}
+		}
+
+		// Random inputs for each step and each network
+		QVector<QVector<float> > inputs(numSteps * numNetworks);
+		for (int i = 0; i < inputs.size(); i++) {
+			inputs[i].resize(numInputs);
+			for (int j = 0; j < numInputs; j++) {
+				inputs[i][j] = rng.getDouble(0.0, 1.0);
+			}
+		}
+
+		// The outputs of each network, stepped one at a time with Evonet
+		QVector<QVector<float> > expectedOutputs(numSteps * numNetworks);
+		for (int i = 0; i < numNetworks; i++) {
+			net->setParameters(genomes[i].constData());
+			net->resetNet();
+
+			for (int s = 0; s < numSteps; s++) {
+				const QVector<float>& in = inputs[s * numNetworks + i];
+				for (int j = 0; j < numInputs; j++) {
+					net->setInput(j, in[j]);
+				}
+				net->updateNet();
+
+				QVector<float>& out = expectedOutputs[s * numNetworks + i];
+				for (int o = 0; o < numOutputs; o++) {
+					out.append(net->getOutput(o));
+				}
+			}
+		}
+
+		// All networks stepped together with EvonetBatch
+		EvonetBatch batch(net, numNetworks);
+		QCOMPARE(batch.freeParameters(), net->freeParameters());
+		for (int i = 0; i < numNetworks; i++) {
+			batch.setParameters(i, genomes[i].constData());
+		}
+		batch.resetNet();
+		for (int s = 0; s < numSteps; s++) {
+			for (int i = 0; i < numNetworks; i++) {
+				const QVector<float>& in = inputs[s * numNetworks + i];
+				for (int j = 0; j < numInputs; j++) {
+					batch.inputs()(j, i) = in[j];
+				}
+			}
+			batch.updateNet();
+
+			for (int i = 0; i < numNetworks; i++) {
+				const QVector<float>& out = expectedOutputs[s * numNetworks + i];
+				for (int o = 0; o < numOutputs; o++) {
+					if (qAbs(batch.getOutput(i, o) - out[o]) > tolerance) {
+						QFAIL(QString("Output %1 of network %2 at step %3 differs: %4 (batch) vs %5 (Evonet)").arg(o).arg(i).arg(s).arg(batch.getOutput(i, o)).arg(out[o]).toLatin1().data());
+					}
+				}
+			}
+		}
+
+		delete exp;
+	}
+};
+
+QTEST_MAIN(EvonetBatch_Test)
+#include "evonetbatch_test.moc"
@@ -125,6 +125,7 @@ private:
 			genotype = g;
 			this->rank = rank;
 			this->distance = distance;
+			id = 0;
 		};
 		//! The genotype
 		Genotype* genotype;
@@ -132,8 +133,8 @@ private:
 		int rank;
 		//! the crowding distance of this genotype regarding the pareto-front on which it belongs to
 		double distance;
-		//! domination counter: how many genotypes dominate this
-		int dominationCounter;
+		//! the row of NSGA2::objectives containing the objectives of this genotype
+		int id;
 		//! operator needed by QMap for using nsgaGenotype has keys
 		bool operator<( const nsgaGenotype& g ) const {
 			return this->distance < g.distance;
@@ -146,10 +147,38 @@ private:
 	typedef QVector<nsgaGenotype*> nsgaGenome;
 	/*! Last Pareto-fronts */
 	Genome lastPareto;
-	/*! Calculate the Crowding Distance */
+	/*! The objectives of the genotypes passed to fastNonDominatedSort, one row
+	 *  of numObjectives values per genotype (see nsgaGenotype::id)
+	 */
+	QVector<double> objectives;
+	/*! The number of objectives compared, the lowest among genotypes as done by
+	 *  Genotype::dominatedBy
+	 */
+	int numObjectives;
+	/*! Calculate the Crowding Distance
+	 *  \warning the genotypes must have been passed to fastNonDominatedSort
+	 */
 	void crowdingDistanceAssignment( nsgaGenome& genome );
-	/*! Calculate the pareto-fronts using the Fast NonDominated Sort */
+	/*! Calculate the pareto-fronts using the Efficient Non-dominated Sort
+	 *  Genotypes are sorted lexicographically on their objectives, so that a
+	 *  genotype can only be dominated by those before it, and then each one is
+	 *  put in the first front not dominating it, found by binary search. With
+	 *  up to two objectives only the last genotype added to a front has to be
+	 *  checked, so the sort is O(N log N); with more objectives the genotypes
+	 *  of a front are checked from the last added one. Finally, genotypes in
+	 *  each front are put in the order in which the classic Fast NonDominated
+	 *  Sort finds them, because ties in crowding distance are broken by that
+	 *  order. This only compares genotypes of adjacent fronts
+	 */
 	QVector<nsgaGenome> fastNonDominatedSort( nsgaGenome& pareto );
+	/*! Return true if a genotype in the front dominates the one with objectives p
+	 *  (see fastNonDominatedSort)
+	 */
+	bool frontDominates( const QVector<int>& front, const double* p ) const;
+	/*! Return true if the genotype with objectives q dominates the one with
+	 *  objectives p
+	 */
+	bool dominates( const double* q, const double* p ) const;
 	/*! Utility function for comparing elements by crowding distance */
 	static bool crowdingDistanceGreaterThan( const nsgaGenotype* g1, const nsgaGenotype* g2 ) {
 		return g1->distance > g2->distance;
@@ -157,10 +186,39 @@ private:
 	/*! Utility class for generating a function for comparing genotype of an objective */
 	class nObjectiveGreaterThan {
 	public:
-		bool operator()( const nsgaGenotype* g1, const nsgaGenotype* g2 ) {
-			return g1->genotype->objective( currentObjective ) > g2->genotype->objective( currentObjective );
+		nObjectiveGreaterThan( const double* objs, int numObjs ) {
+			objectives = objs;
+			numObjectives = numObjs;
+			currentObjective = 0;
+		};
+		bool operator()( const nsgaGenotype* g1, const nsgaGenotype* g2 ) const {
+			return objectives[g1->id*numObjectives + currentObjective] > objectives[g2->id*numObjectives + currentObjective];
+		};
+		const double* objectives;
+		int numObjectives;
+		int currentObjective;
+	};
+	/*! Utility class for generating a function for comparing rows of objectives in
+	 *  descending lexicographic order
+	 */
+	class lexicographicGreaterThan {
+	public:
+		lexicographicGreaterThan( const double* objs, int numObjs ) {
+			objectives = objs;
+			numObjectives = numObjs;
+		};
+		bool operator()( int id1, int id2 ) const {
+			const double* o1 = objectives + id1*numObjectives;
+			const double* o2 = objectives + id2*numObjectives;
+			for( int m=0; m<numObjectives; m++ ) {
+				if ( o1[m] != o2[m] ) {
+					return o1[m] > o2[m];
+				}
+			}
+			return false;
 		};
-		int currentObjective;	
+		const double* objectives;
+		int numObjectives;
 	};
 
 	/*! \internal
@@ -27,12 +27,13 @@
 #include <cfloat>
 #include <QThreadPool>
 #include <QtConcurrentMap>
+#include <QPair>
 using namespace QtConcurrent;
 
 namespace salsa {
 
 NSGA2::NSGA2()
-	: GeneticAlgo(), lastPareto() {
+	: GeneticAlgo(), lastPareto(), objectives(), numObjectives(0) {
 	fitfunc = 0;
 	reprod = 0;
 	numGens = 0;
@@ -282,93 +283,131 @@ void NSGA2::finalize() {
 }
 
 QVector<NSGA2::nsgaGenome> NSGA2::fastNonDominatedSort( nsgaGenome& pareto ) {
-	QMap<nsgaGenotype*, nsgaGenome> dominatedBy;
 	QVector<nsgaGenome> frontsByRank;
-	frontsByRank.resize(1);
-	//--- create the first front containing the top solutions
-	for( int p=0; p<pareto.size(); p++ ) {
-		//--- domination counter of genP reset to zero
-		pareto[p]->dominationCounter = 0;
-		for( int q=0; q<pareto.size(); q++ ) {
-			if ( p==q ) continue;
-			if ( pareto[q]->genotype->dominatedBy( pareto[p]->genotype ) ) {
-				// OPTIMIZE: it seems that most of the time is spent on accessing the QMap
-				dominatedBy[ pareto[p] ].append( pareto[q] );
-			} else if ( pareto[p]->genotype->dominatedBy( pareto[q]->genotype ) ) {
-				pareto[p]->dominationCounter++;
+	int dimPareto = pareto.size();
+	if ( dimPareto == 0 ) return frontsByRank;
+	//--- copy the objectives in a flat array
+	numObjectives = pareto[0]->genotype->numOfObjectives();
+	for( int p=1; p<dimPareto; p++ ) {
+		numObjectives = qMin( numObjectives, pareto[p]->genotype->numOfObjectives() );
+	}
+	objectives.resize( dimPareto*numObjectives );
+	QVector<int> order( dimPareto );
+	for( int p=0; p<dimPareto; p++ ) {
+		pareto[p]->id = p;
+		order[p] = p;
+		for( int m=0; m<numObjectives; m++ ) {
+			objectives[p*numObjectives + m] = pareto[p]->genotype->objective( m );
+		}
+	}
+	//--- sort in descending lexicographic order: if q dominates p, q comes before p
+	qSort( order.begin(), order.end(), lexicographicGreaterThan( objectives.constData(), numObjectives ) );
+	//--- put each genotype in the first front not dominating it. If a genotype is
+	//--- dominated by front k it is also dominated by all fronts before k, so the
+	//--- front is found by binary search
+	QVector< QVector<int> > fronts;
+	for( int i=0; i<dimPareto; i++ ) {
+		const double* p = objectives.constData() + order[i]*numObjectives;
+		int low = 0;
+		int high = fronts.size();
+		while( low < high ) {
+			int mid = (low+high)/2;
+			if ( frontDominates( fronts[mid], p ) ) {
+				low = mid+1;
+			} else {
+				high = mid;
 			}
 		}
-		//--- if nP == 0 means that genP is a solution belongs to the top pareto-front
-		if ( pareto[p]->dominationCounter == 0 ) {
-			pareto[p]->rank = 0;
-			frontsByRank[0].append( pareto[p] );
+		if ( low == fronts.size() ) {
+			fronts.append( QVector<int>() );
 		}
+		fronts[low].append( order[i] );
 	}
-	//--- create all the other fronts
-	bool done = false;
-	int currentFront = 0;
-	while( !done ) {
-		nsgaGenome newFront;
-		for( int i=0; i<frontsByRank[currentFront].size(); i++ ) {
-			nsgaGenotype* p = frontsByRank[currentFront][i];
-			nsgaGenome pDominate = dominatedBy[p];
-			for( int q=0; q<pDominate.size(); q++ ) {
-				pDominate[q]->dominationCounter--;
-				if ( pDominate[q]->dominationCounter == 0 ) {
-					pDominate[q]->rank = currentFront+1;
-					newFront.append( pDominate[q] );
-				}
+	//--- genotypes in each front are put in the order in which the classic algorithm finds
+	//--- them: the first front is in the same order of pareto; a genotype of front f+1 is
+	//--- found when the last genotype of front f dominating it is processed, and genotypes
+	//--- found by the same genotype are in the order of pareto
+	qSort( fronts[0] );
+	for( int f=1; f<fronts.size(); f++ ) {
+		const QVector<int>& previous = fronts[f-1];
+		QVector< QPair<int, int> > discoveryOrder( fronts[f].size() );
+		for( int i=0; i<fronts[f].size(); i++ ) {
+			const double* p = objectives.constData() + fronts[f][i]*numObjectives;
+			//--- the previous front surely dominates p (otherwise p would be there)
+			int last = previous.size()-1;
+			while( !dominates( objectives.constData() + previous[last]*numObjectives, p ) ) {
+				last--;
 			}
+			discoveryOrder[i] = qMakePair( last, fronts[f][i] );
 		}
-		currentFront++;
-		if ( newFront.isEmpty() ) {
-			done = true;
-		} else {
-			frontsByRank.append( newFront );
+		qSort( discoveryOrder );
+		for( int i=0; i<fronts[f].size(); i++ ) {
+			fronts[f][i] = discoveryOrder[i].second;
 		}
 	}
-	int total = 0;
-	for( int i=0; i<frontsByRank.size(); i++ ) {
-		total += frontsByRank[i].size();
+	frontsByRank.resize( fronts.size() );
+	for( int f=0; f<fronts.size(); f++ ) {
+		frontsByRank[f].reserve( fronts[f].size() );
+		for( int i=0; i<fronts[f].size(); i++ ) {
+			nsgaGenotype* gen = pareto[ fronts[f][i] ];
+			gen->rank = f;
+			frontsByRank[f].append( gen );
+		}
 	}
 	return frontsByRank;
 }
 
+bool NSGA2::frontDominates( const QVector<int>& front, const double* p ) const {
+	//--- genotypes are added to fronts in descending lexicographic order. With one or two
+	//--- objectives this means that the last genotype added to a front has the highest
+	//--- value of the last objective, so it dominates p if any genotype of the front does
+	int first = ( numObjectives <= 2 ) ? front.size()-1 : 0;
+	for( int i=front.size()-1; i>=first; i-- ) {
+		if ( dominates( objectives.constData() + front[i]*numObjectives, p ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool NSGA2::dominates( const double* q, const double* p ) const {
+	bool oneGreaterStrictly = false;
+	for( int m=0; m<numObjectives; m++ ) {
+		if ( q[m] < p[m] ) {
+			return false;
+		}
+		if ( q[m] > p[m] ) {
+			oneGreaterStrictly = true;
+		}
+	}
+	return oneGreaterStrictly;
+}
+
 void NSGA2::crowdingDistanceAssignment( nsgaGenome& genome ) {
 	int dimGenome = genome.size();
 	if ( dimGenome == 0 ) return;
-	int numObjs = genome[0]->genotype->numOfObjectives();
-	//--- vectors containing the max and min values of objectives in this genome
-	QVector<double> fmax;
-	QVector<double> fmin;
-	fmax.resize( numObjs );
-	fmin.resize( numObjs );
-	for( int i=0; i<numObjs; i++ ) {
-		fmax[i] = genome[0]->genotype->objective( i );
-		fmin[i] = genome[0]->genotype->objective( i );
-	}
-	//--- initialize distance and calculate fmax and fmin values
+	int numObjs = numObjectives;
+	//--- initialize distance
 	for( int i=0; i<dimGenome; i++ ) {
 		genome[i]->distance = 0;
-		for( int m=0; m<numObjs; m++ ) {
-			fmax[m] = qMax( fmax[m], genome[i]->genotype->objective(m) );
-			fmin[m] = qMin( fmin[m], genome[i]->genotype->objective(m) );
-		}
 	}
 	//--- calculate the distance
-	nObjectiveGreaterThan objCompare;
+	nObjectiveGreaterThan objCompare( objectives.constData(), numObjs );
 	for( int m=0; m<numObjs; m++ ) {
 		// currentObjective is used by nObjectiveGreaterThan for sorting
 		objCompare.currentObjective = m;
 		qStableSort( genome.begin(), genome.end(), objCompare );
+		// after sorting the max and min values of the objective are at the two ends
+		double fmax = objectives[genome[0]->id*numObjs + m];
+		double fmin = objectives[genome.last()->id*numObjs + m];
 		// the maximum value is numObj, setting to numObj assure that this two
 		// genotypes are always the top in the current front
 		genome[0]->distance = numObjs; //DBL_MAX;
 		genome.last()->distance = numObjs; //DBL_MAX;
 		for( int i=1; i<dimGenome-1; i++ ) {
-			double m1 = genome[i+1]->genotype->objective(m);
-			double m2 = genome[i-1]->genotype->objective(m);
-			genome[i]->distance += fabs(m1-m2)/(fmax[m]-fmin[m]);
+			double m1 = objectives[genome[i+1]->id*numObjs + m];
+			double m2 = objectives[genome[i-1]->id*numObjs + m];
+			genome[i]->distance += fabs(m1-m2)/(fmax-fmin);
 			// if the value is nan, then it will setted to zero (worst distance)
 			if ( genome[i]->distance != genome[i]->distance ) {
 				genome[i]->distance = 0.0;
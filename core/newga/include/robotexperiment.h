@@ -586,6 +586,8 @@ private:
 	World* world;
 	//! the timestep
 	float timestep;
+	//! the number of threads used by the physics engine
+	int physicsThreads;
 	//! the embodied agents
 	QList<EmbodiedAgent*> eagents;
 	//! current selected agent
@@ -33,10 +33,13 @@
 #include "randomgenerator.h"
 #include <cstdlib>
 #include <QVector>
+#include <QThreadPool>
 #include <Eigen/Core>
 
 namespace salsa {
 
+class XnesEvaluator;
+
 /**
  * \brief The xNES algorithm.
  *
@@ -54,7 +57,26 @@ namespace salsa {
  *       Moreover, we call samples the modifications that generate offspring from the
  *       individual (i.e., offspring = individual + samples).
  * \note The covariance matrix provides the user with the information about how genes
- *       correlate with each other.
+ *       correlate with each other. The algorithm does not store it, it keeps
+ *       its factor A (the covariance is A * A^T) which is updated
+ *       multiplicatively as A <- A * exp(eta * G), G being the natural
+ *       gradient. Since G is a multiple of the identity plus a matrix whose
+ *       rank is at most the number of offspring, the exponential is computed
+ *       on a small matrix (see computeUpdates())
+ * \note If variant is sNES, the separable version of the algorithm is used:
+ *       only one standard deviation per gene is adapted, so that each
+ *       generation costs O(n) per offspring instead of O(n^2)
+ * \note When numThreads is greater than 1, the tester and the evaluator are
+ *       cloned (one pair per thread) and the offspring are evaluated in
+ *       parallel. Each offspring is evaluated with its own seed, drawn
+ *       sequentially before the evaluation starts, so results do not depend
+ *       on the number of threads
+ * \note The state of the algorithm (the individual and the covariance
+ *       factor) is saved every checkpointInterval generations in a binary
+ *       file (S<seed>.xck, see saveCheckpoint()) which is used to recover an
+ *       interrupted evolution. If textCheckpoint is true, text files
+ *       (S<seed>G<generation>.gen and .exm) are also written at each
+ *       checkpoint
  */
 class SALSA_NEWGA_API XnesAlgo : public EvoAlgo
 {
@@ -66,7 +88,7 @@ public:
 	 * configuration.ini file. Furthermore, it initialises the parameters
 	 * of the algorithm:
 	 * - offspring population size
-	 * - learning rates (for both the individual and the covariance matrix)
+	 * - learning rates (for both the individual and the covariance factor)
 	 * - utility values (to be later assigned to the offspring depending on
 	 *   their fitness scores)
 	 *
@@ -103,25 +125,34 @@ public:
 
 protected:
 	/**
-	 * \brief Initialise the individual and the covariance matrix.
+	 * \brief Initialise the individual and the covariance factor.
 	 *
 	 * The individual genes are drawn from a Gaussian distribution
 	 * with mean 0.0 and standard deviation 1.0.
-	 * The covaraiance matrix is filled with null values.
+	 * The covariance factor is set to the identity (i.e. the logarithm of
+	 * the factor is null).
 	 */
 	void initialise();
+	/**
+	 * \brief Sets the covariance factor from its logarithm
+	 *
+	 * This is used to recover evolutions saved by older versions, which
+	 * stored the logarithm of the factor. In the separable variant only
+	 * the diagonal of the logarithm is used
+	 *
+	 * \param logFactor the logarithm of the covariance factor
+	 */
+	void setFactorFromLogarithm(const Eigen::MatrixXf& logFactor);
 	/**
 	 * \brief Extract the offspring.
 	 *
 	 * The offspring are varied copies of the individual.
 	 * In particular, the modifications are drawn from a Gaussian
 	 * distribution with mean 0.0 and standard deviation 0.5 and
-	 * are "weighted" by means of the exponential of the covariance
-	 * matrix.
-	 *
-	 * \param expCovMat the exponential of the covariance matrix
+	 * are "weighted" by means of the covariance factor. The weighted
+	 * samples are stored in m_scaledSamples.
 	 */
-	void extractOffspring(const Eigen::MatrixXf expCovMat);
+	void extractOffspring();
 	/**
 	 * \brief Sort fitness.
 	 *
@@ -148,21 +179,36 @@ protected:
 	 * \brief Compute updates
 	 *
 	 * This method computes the natural gradients for both the individual
-	 * and the covariance matrix. These gradients will be later used in order
-	 * to update the individual and the covariance matrix.
+	 * and the covariance factor and the resulting updates. The factor is
+	 * updated multiplicatively: in G = S * U * S^T - sum(U) * I the first
+	 * term has rank at most equal to the number of offspring, so
+	 * A * exp(eta * G) is
+	 * computed from the exponential of a (2 * numOffspring) square matrix,
+	 * in O(numGenes^2 * numOffspring) instead of O(numGenes^3).
 	 *
-	 * \param dCovMat tbe update of the covariance matrix
+	 * \param dFactor the update of the covariance factor (the difference
+	 *                between the new and the old factor)
 	 * \param utilityRank the utility ranking array
-	 * \param expCovMat the exponential of the covariance matrix
 	 */
-	void computeUpdates(Eigen::MatrixXf& dCovMat, const QVector<float> utilityRank, const Eigen::MatrixXf expCovMat);
+	void computeUpdates(Eigen::MatrixXf& dFactor, const QVector<float> utilityRank);
 	/**
-	 * \brief Update individual and covariance matrix
+	 * \brief Update individual and covariance factor
 	 *
 	 * \param dInd the update of the individual
-	 * \param dCovMat the update of the covariance matrix
+	 * \param dFactor the update of the covariance factor
 	 */
-	void update(Genotype* dInd, const Eigen::MatrixXf dCovMat);
+	void update(Genotype* dInd, const Eigen::MatrixXf& dFactor);
+	/**
+	 * \brief Evaluates all the offspring
+	 *
+	 * Offspring are split among the evaluators, which run concurrently if
+	 * there is more than one. The fitness of each offspring is stored both
+	 * in the genotype and in the given vector
+	 *
+	 * \param gn the current generation
+	 * \param offspringFitness the vector where fitnesses are stored
+	 */
+	void evaluateOffspring(int gn, QVector<float>& offspringFitness);
 
 	/**
 	 * \brief The function called when the flow controller changes
@@ -177,8 +223,56 @@ protected:
 		{
 			m_gae->setFlowController(flowController);
 		}
+		propagateFlowControllerToClones(flowController);
 	}
 
+	/**
+	 * \brief Sets the flow controller of the cloned evaluators
+	 *
+	 * \param flowController the new flow controller
+	 */
+	void propagateFlowControllerToClones(FlowController* flowController);
+
+	/**
+	 * \brief Saves the state of the algorithm in the binary checkpoint file
+	 *
+	 * The file (S<seed>.xck) is replaced atomically and has a 64 bytes
+	 * header followed by the genes of the individual and the covariance
+	 * factor (column-major, a single column for sNES), all as little-endian
+	 * 32 bits floats, so that it can also be memory-mapped. The header
+	 * contains the magic string "SALSAXNS", the format version, the number
+	 * of genes, whether the variant is separable, the number of
+	 * completed generations, the best generation and its fitness, and the
+	 * size of the statistics files at the time of the checkpoint (used to
+	 * truncate them on recovery)
+	 *
+	 * \param generation the number of completed generations
+	 * \param bestGeneration the best generation so far
+	 * \param bestFitness the fitness of the best generation
+	 * \return true if the checkpoint was saved
+	 */
+	bool saveCheckpoint(int generation, int bestGeneration, float bestFitness);
+	/**
+	 * \brief Restores the state of the algorithm from the binary checkpoint
+	 *        file
+	 *
+	 * Statistics files are truncated to their size at the time of the
+	 * checkpoint, so that generations run after it are not duplicated
+	 *
+	 * \param generation the number of completed generations
+	 * \param bestGeneration the best generation so far
+	 * \param bestFitness the fitness of the best generation
+	 * \return true if a valid checkpoint was found and loaded
+	 */
+	bool loadCheckpoint(int& generation, int& bestGeneration, float& bestFitness);
+	/**
+	 * \brief Exports the individual, the offspring and the covariance
+	 *        factor in the text format (S<seed>G<generation>.gen and .exm)
+	 *
+	 * \param generation the number of completed generations
+	 */
+	void exportTextCheckpoint(int generation);
+
 	//! The number of genes (i.e., the length of the genotype)
 	int m_numGenes;
 	//! The number of offspring (i.e., the offspring population size)
@@ -191,16 +285,25 @@ protected:
 	Genotype* m_dInd;
 	//! Genotype prototype
 	Genotype* m_prototype;
-	//! The covariance matrix
-	Eigen::MatrixXf m_covMat;
+	//! Whether the separable variant (sNES) is used
+	bool m_separable;
+	/**
+	 * \brief The covariance factor
+	 *
+	 * This is the exponential of what older versions called the covariance
+	 * matrix. For sNES it is a single column with the standard deviations
+	 */
+	Eigen::MatrixXf m_factor;
 	//! The learning rate for the individual
 	float m_indLrate;
-	//! The learning rate for the covariance matrix
+	//! The learning rate for the covariance factor
 	float m_covMatLrate;
 	//! The utility values
 	QVector<float> m_utility;
 	//! The samples
 	Eigen::MatrixXf m_samples;
+	//! The samples multiplied by the covariance factor
+	Eigen::MatrixXf m_scaledSamples;
 	//! The genotype tester
 	SingleGenotypeFloatToEvonet* m_gt;
 	//! The evaluator
@@ -211,6 +314,21 @@ protected:
 	bool m_saveFitnessAllIndividuals;
 	//! Seed for extracting random numbers
 	int m_rngSeed;
+	//! The number of threads used to evaluate the offspring
+	int m_numThreads;
+	//! The number of generations between two checkpoints
+	int m_checkpointInterval;
+	//! Whether checkpoints are also exported in the text format
+	bool m_textCheckpoint;
+	/**
+	 * \brief The evaluators (one per thread)
+	 *
+	 * The first one wraps m_gt and m_gae, the others wrap clones created
+	 * from copies of their configuration groups
+	 */
+	QVector<XnesEvaluator*> m_evaluators;
+	//! The thread pool running the evaluators
+	QThreadPool m_threadPool;
 };
 
 } // end namespace salsa
@@ -129,18 +129,12 @@ bool GenotypeFloat::saveGen(QTextStream& out)
 
 void GenotypeFloat::initRandom(const float min, const float max)
 {
-	for (int i = 0; i < m_genLength; i++)
-	{
-		m_gen[i] = globalRNG->getDouble(min, max);
-	}
+	globalRNG->fillUniform(m_gen.data(), m_genLength, min, max);
 }
 
 void GenotypeFloat::initGaussian(const float mean, const float stdDev)
 {
-	for (int i = 0; i < m_genLength; i++)
-	{
-		m_gen[i] = globalRNG->getGaussian(stdDev, mean);
-	}
+	globalRNG->fillGaussian(m_gen.data(), m_genLength, stdDev, mean);
 }
 
 GenotypeInt::GenotypeInt(ConfigurationParameters& params, QString prefix)
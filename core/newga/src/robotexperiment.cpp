@@ -64,6 +64,7 @@ RobotExperiment::RobotExperiment()
 	, savedPrefix(nullptr)
 	, world(nullptr)
 	, timestep(0.05f)
+	, physicsThreads(1)
 	, eagents()
 	, agentIdSelected(0)
 	, gaPhase(NONE)
@@ -133,6 +134,7 @@ void RobotExperiment::configure(ConfigurationParameters& params, QString prefix)
 
 	// Reading world parameters. We need to do this before calling recreateWorld because that function uses the parameters
 	timestep = ConfigurationHelper::getDouble(params, prefix + "World/timestep", timestep);
+	physicsThreads = ConfigurationHelper::getInt(params, prefix + "World/physicsThreads", physicsThreads);
 	// initializing the stepDelay at the same amount of timestep
 	// will slow down the simulation at real-time pace when the GUI is on
 	stepDelay = timestep*1000;
@@ -211,6 +213,7 @@ void RobotExperiment::describe( QString type ) {
 
 	SubgroupDescriptor world = d.describeSubgroup( "World" ).help( "Parameters affecting the simulated World" );
 	world.describeReal( "timestep" ).def(0.05).runtime( &RobotExperiment::setWorldTimestep, &RobotExperiment::getWorldTimeStep ).help( "The time in seconds corresponding to one simulated step of the World" );
+	world.describeInt( "physicsThreads" ).def(1).limits(1,MaxInteger).help( "The number of threads used by the physics engine", "Each clone of the experiment (e.g. one per thread of xNES) has its own world using this number of threads. The results of the simulation can change with the number of threads" );
 }
 
 void RobotExperiment::postConfigureInitialization()
@@ -625,7 +628,7 @@ void RobotExperiment::recreateWorld() {
 	world->setSize( wVector( -2.0f, -2.0f, -0.50f ), wVector( +2.0f, +2.0f, +2.0f ) );
 	world->setFrictionModel( "exact" );
 	world->setSolverModel( "exact" );
-	world->setMultiThread( 1 );
+	world->setMultiThread( physicsThreads );
 	world->setIsRealTime( false );
 
 	// Removing deleted resources (if they existed) and then re-declaring world
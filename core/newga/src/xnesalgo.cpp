@@ -24,13 +24,224 @@
 #include "xnesalgo.h"
 #include "evodataviewer.h"
 #include "configurationhelper.h"
+#include "randomgenerator.h"
 #include <QTextStream>
 #include <QFile>
+#include <QSaveFile>
+#include <QStringList>
+#include <QDataStream>
+#include <QtEndian>
+#include <QThreadPool>
+#include <QRunnable>
 #include <Eigen/Dense>
 #include <unsupported/Eigen/MatrixFunctions>
+#include <climits>
+#include <cstring>
 
 namespace salsa {
 
+namespace {
+	// The magic string at the beginning of checkpoint files
+	const char checkpointMagic[8] = {'S', 'A', 'L', 'S', 'A', 'X', 'N', 'S'};
+	// The version of the checkpoint format. Version 1 stored the logarithm of
+	// the covariance factor, version 2 stores the factor itself
+	const quint32 checkpointVersion = 2;
+	// The size of the header of checkpoint files. Data starts right after it
+	const int checkpointHeaderSize = 64;
+
+	// Writes n floats as little-endian values
+	bool writeFloatsLittleEndian(QIODevice& dev, const float* data, qint64 n)
+	{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+		return dev.write((const char*) data, n * 4) == (n * 4);
+#else
+		QVector<quint32> buffer(n);
+		for (qint64 i = 0; i < n; i++)
+		{
+			quint32 v;
+			memcpy(&v, &data[i], 4);
+			buffer[i] = qToLittleEndian(v);
+		}
+		return dev.write((const char*) buffer.constData(), n * 4) == (n * 4);
+#endif
+	}
+
+	// Reads n little-endian floats
+	bool readFloatsLittleEndian(QIODevice& dev, float* data, qint64 n)
+	{
+		if (dev.read((char*) data, n * 4) != (n * 4))
+		{
+			return false;
+		}
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+		for (qint64 i = 0; i < n; i++)
+		{
+			quint32 v;
+			memcpy(&v, &data[i], 4);
+			v = qFromLittleEndian(v);
+			memcpy(&data[i], &v, 4);
+		}
+#endif
+		return true;
+	}
+
+	// Returns the size of the file or 0 if it does not exist
+	qint64 fileSize(const char* filename)
+	{
+		QFile f(filename);
+		return f.exists() ? f.size() : 0;
+	}
+
+	// Truncates the file to the given size, if it is larger
+	void truncateFile(const char* filename, qint64 size)
+	{
+		QFile f(filename);
+		if (f.exists() && (f.size() > size))
+		{
+			f.resize(size);
+		}
+	}
+
+	// Reads a matrix written as text, one row per line. The size of the
+	// matrix must be already set. Returns false if the file cannot be opened
+	bool loadTextMatrix(const char* filename, Eigen::MatrixXf& matrix)
+	{
+		QFile data(filename);
+		if (!data.open(QFile::ReadOnly))
+		{
+			return false;
+		}
+
+		QTextStream input(&data);
+		for (int i = 0; i < matrix.rows(); i++)
+		{
+			for (int j = 0; j < matrix.cols(); j++)
+			{
+				QString str;
+				input >> str;
+				bool ok = false;
+				float elem = str.toFloat(&ok);
+				if (!ok || (input.status() != QTextStream::Ok))
+				{
+					Logger::error(QString("Error in the loading of the covariance matrix from ") + filename);
+				}
+				matrix(i,j) = elem;
+			}
+		}
+
+		return true;
+	}
+}
+
+/**
+ * \brief A genotype tester and its evaluator, used by XnesAlgo to evaluate
+ *        a subset of the offspring
+ *
+ * Each object evaluates the offspring whose index is congruent to its id
+ * modulo the number of evaluators. Offspring are all evaluated with their
+ * own seed, so the result does not depend on how they are split. Objects
+ * are run by the private thread pool of XnesAlgo, which doesn't delete them
+ */
+class XnesEvaluator : public QRunnable
+{
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param gt the genotype tester
+	 * \param gae the evaluator linked to the genotype tester
+	 * \param ownTester if true we take ownership of the tester (which in
+	 *                  turn owns the evaluator) and delete it at
+	 *                  destruction
+	 */
+	XnesEvaluator(SingleGenotypeFloatToEvonet* gt, RobotExperiment* gae, bool ownTester)
+		: m_gt(gt)
+		, m_gae(gae)
+		, m_ownTester(ownTester)
+		, m_id(0)
+		, m_stride(1)
+		, m_offspring(nullptr)
+		, m_seeds(nullptr)
+		, m_rng()
+	{
+		setAutoDelete(false);
+	}
+
+	/**
+	 * \brief Destructor
+	 */
+	~XnesEvaluator()
+	{
+		if (m_ownTester)
+		{
+			delete m_gt;
+		}
+	}
+
+	/**
+	 * \brief Sets the offspring to evaluate in the next run
+	 *
+	 * \param id the id of this evaluator
+	 * \param stride the total number of evaluators
+	 * \param offspring the whole offspring population
+	 * \param seeds the seeds to use for each offspring
+	 */
+	void setOffspring(int id, int stride, QVector<Genotype*>* offspring, const QVector<unsigned int>* seeds)
+	{
+		m_id = id;
+		m_stride = stride;
+		m_offspring = offspring;
+		m_seeds = seeds;
+	}
+
+	/**
+	 * \brief Evaluates the offspring assigned to this evaluator
+	 *
+	 * While evaluating an individual, globalRNG is redirected to a
+	 * generator with a sequence that only depends on the individual, so
+	 * that noise does not depend on the number of evaluators. Experiments
+	 * using the same random sequence for all individuals (see the
+	 * sameRandomSequence parameter of RobotExperiment) reseed their own
+	 * generator, so they are not affected
+	 */
+	virtual void run()
+	{
+		GlobalRNGThreadOverride rngOverride(&m_rng);
+
+		for (int g = m_id; g < m_offspring->size(); g += m_stride)
+		{
+			m_gt->setGenotype((*m_offspring)[g]);
+			m_rng.setStream((*m_seeds)[g], g);
+			m_gae->doAllTrialsForIndividual(g);
+			(*m_offspring)[g]->setFitness(m_gae->getFitness());
+			if (m_gae->stopFlow())
+			{
+				return;
+			}
+		}
+	}
+
+	/**
+	 * \brief Returns the evaluator
+	 *
+	 * \return the evaluator
+	 */
+	RobotExperiment* experiment()
+	{
+		return m_gae;
+	}
+
+private:
+	SingleGenotypeFloatToEvonet* const m_gt;
+	RobotExperiment* const m_gae;
+	const bool m_ownTester;
+	int m_id;
+	int m_stride;
+	QVector<Genotype*>* m_offspring;
+	const QVector<unsigned int>* m_seeds;
+	RandomGenerator m_rng;
+};
+
 XnesAlgo::XnesAlgo(ConfigurationParameters& params, QString prefix)
 	: EvoAlgo(params, prefix)
 	, m_numGenes(1)
@@ -39,16 +250,23 @@ XnesAlgo::XnesAlgo(ConfigurationParameters& params, QString prefix)
 	, m_individual(nullptr)
 	, m_dInd(nullptr)
 	, m_prototype(nullptr)
-	, m_covMat()
+	, m_separable(false)
+	, m_factor()
 	, m_indLrate(1.0)
 	, m_covMatLrate(1.0)
 	, m_utility()
 	, m_samples()
+	, m_scaledSamples()
 	, m_gt(nullptr)
 	, m_gae(nullptr)
 	, m_numGenerations(1)
 	, m_saveFitnessAllIndividuals(false)
 	, m_rngSeed(0)
+	, m_numThreads(1)
+	, m_checkpointInterval(1)
+	, m_textCheckpoint(false)
+	, m_evaluators()
+	, m_threadPool()
 {
 	// Get parameters' values from the configuration file (.ini), if some of these parameters
 	// are not in the file, the default values will be used
@@ -56,6 +274,26 @@ XnesAlgo::XnesAlgo(ConfigurationParameters& params, QString prefix)
 	m_gae = params.getObjectFromParameter<RobotExperiment>(prefix + QString("gaEvaluator"));
 	m_numGenerations = ConfigurationHelper::getInt(params, prefix + QString("numGenerations"), 1000);
 	m_saveFitnessAllIndividuals = ConfigurationHelper::getBool(params, prefix + QString("saveFitnessAllIndividuals"), false);
+	m_numThreads = ConfigurationHelper::getInt(params, prefix + QString("numThreads"), 1);
+	if (m_numThreads < 1)
+	{
+		m_numThreads = 1;
+	}
+	m_checkpointInterval = ConfigurationHelper::getInt(params, prefix + QString("checkpointInterval"), 1);
+	if (m_checkpointInterval < 1)
+	{
+		m_checkpointInterval = 1;
+	}
+	m_textCheckpoint = ConfigurationHelper::getBool(params, prefix + QString("textCheckpoint"), false);
+	const QString variant = ConfigurationHelper::getString(params, prefix + QString("variant"), "xNES");
+	if (variant == "sNES")
+	{
+		m_separable = true;
+	}
+	else if (variant != "xNES")
+	{
+		ConfigurationHelper::throwUserConfigError(prefix + QString("variant"), variant, "The variant must be either xNES or sNES");
+	}
 	m_numGenes = m_gt->requestedGenotypeLength();
 	// Compute the number of offspring
 	const float nGenes = (const float)m_numGenes;
@@ -64,10 +302,17 @@ XnesAlgo::XnesAlgo(ConfigurationParameters& params, QString prefix)
 	m_utility.resize(m_numOffspring);
 	// Compute the learning rates
 	m_indLrate = 1.0;
-	m_covMatLrate = 0.25;
-	if (m_covMatLrate > (1.0 / nGenes))
+	if (m_separable)
 	{
-		m_covMatLrate = (1.0 / nGenes);
+		m_covMatLrate = (3.0 + log(nGenes)) / (5.0 * sqrt(nGenes));
+	}
+	else
+	{
+		m_covMatLrate = 0.25;
+		if (m_covMatLrate > (1.0 / nGenes))
+		{
+			m_covMatLrate = (1.0 / nGenes);
+		}
 	}
 	m_covMatLrate *= 0.5;
 	// Initialise the utility vector
@@ -102,13 +347,40 @@ XnesAlgo::XnesAlgo(ConfigurationParameters& params, QString prefix)
 	{
 		m_offspring[i] = m_prototype->clone();
 	}
-	m_covMat.resize(m_numGenes, m_numGenes);
+	m_factor.resize(m_numGenes, m_separable ? 1 : m_numGenes);
 	m_samples.resize(m_numGenes, m_numOffspring);
+	m_scaledSamples.resize(m_numGenes, m_numOffspring);
+	// Creating the evaluators. The first one uses the tester and the evaluator we already have, the
+	// others use clones created from copies of their groups (the copied tester is linked to the copied
+	// evaluator)
+	m_evaluators.append(new XnesEvaluator(m_gt, m_gae, false));
+	if (m_numThreads > 1)
+	{
+		const QString testerGroup = params.getValue(prefix + QString("genotypeTester"));
+		const QString evaluatorGroup = params.getValue(prefix + QString("gaEvaluator"));
+		for (int t = 1; t < m_numThreads; t++)
+		{
+			const QString copiedTesterGroup = testerGroup + ":" + QString::number(t);
+			const QString copiedEvaluatorGroup = evaluatorGroup + ":" + QString::number(t);
+			params.copyGroup(testerGroup, copiedTesterGroup);
+			params.copyGroup(evaluatorGroup, copiedEvaluatorGroup);
+			params.createParameter(copiedTesterGroup, "gaEvaluator", copiedEvaluatorGroup);
+			SingleGenotypeFloatToEvonet* gt = params.getObjectFromGroup<SingleGenotypeFloatToEvonet>(copiedTesterGroup);
+			RobotExperiment* gae = params.getObjectFromParameter<RobotExperiment>(copiedTesterGroup + "/gaEvaluator");
+			gae->setFlowController(flowController());
+			m_evaluators.append(new XnesEvaluator(gt, gae, true));
+		}
+	}
 }
 
 XnesAlgo::~XnesAlgo()
 {
-	// Delete all objects (i.e., pointers) in order to free memory.
+	// Delete all objects (i.e., pointers) in order to free memory. Evaluators
+	// only delete the clones, not m_gt and m_gae
+	for (int i = 0; i < m_evaluators.size(); i++)
+	{
+		delete m_evaluators[i];
+	}
 	delete m_gt;
 	delete m_gae;
 	delete m_individual;
@@ -126,27 +398,41 @@ void XnesAlgo::describe(QString type)
 	d.describeObject("gaEvaluator").type("RobotExperiment").props(IsMandatory).help("Object that calculate the fitness");
 	d.describeObject("genotypeTester").type("SingleGenotypeFloatToEvonet").props(IsMandatory).help("Object that sets the genotype to be tested");
 	d.describeSubgroup("Genotype").type("GenotypeFloat").props(IsMandatory).help("Object containing the individual under evolution");
+	d.describeInt("numThreads").limits(1, INT_MAX).def(1).help("The number of threads used to evaluate the offspring", "If greater than 1, the genotype tester and the evaluator are cloned once per thread. Each offspring is evaluated with its own seed, so results do not depend on the number of threads");
+	d.describeInt("checkpointInterval").limits(1, INT_MAX).def(1).help("The number of generations between two checkpoints", "The individual and the covariance factor are saved in the binary file S<seed>.xck, which is used to recover an interrupted evolution. The evolution restarts from the last checkpoint");
+	d.describeEnum("variant").def("xNES").values(QStringList() << "xNES" << "sNES").help("The variant of the algorithm", "xNES adapts the full covariance matrix, sNES (separable NES) only adapts one standard deviation per gene. sNES costs O(n) per sample instead of O(n^2) and is suited to genotypes with thousands of genes");
+	d.describeBool("textCheckpoint").def(false).help("Whether checkpoints are also exported in text format", "If true, at each checkpoint the individual and the offspring are saved in S<seed>G<generation>.gen and the covariance factor in S<seed>G<generation>.exm");
+}
+
+void XnesAlgo::propagateFlowControllerToClones(FlowController* flowController)
+{
+	for (int i = 1; i < m_evaluators.size(); i++)
+	{
+		m_evaluators[i]->experiment()->setFlowController(flowController);
+	}
 }
 
 void XnesAlgo::runEvolution()
 {
-	Eigen::MatrixXf expCovMat(m_numGenes,m_numGenes);
 	int startGeneration = 0;
 	char statfile[64];
 	char inFilename[128];
-	char outFilename[128];
 	char bestOutFilename[128];
 	int bestGeneration = -1;
-	int bestFitness = -1;
+	float bestFitness = -1;
 	// Set the seed
 	setSeed(m_rngSeed);
 	// Initialise the individual and the covariance matrix
 	initialise();
-	// Check whether to recover a previous evolution
+	// Check whether to recover a previous evolution, first from the binary checkpoint, then from
+	// the text files written by older versions
 	sprintf(statfile,"S%d.fit", seed());
-	// Check if the file exists
 	DataChunk statTest(QString("stattest"),Qt::blue,2000,false);
-	if (statTest.loadRawData(QString(statfile),0))
+	if (loadCheckpoint(startGeneration, bestGeneration, bestFitness))
+	{
+		Logger::info("Recovered from checkpoint, startGeneration: " + QString::number(startGeneration));
+	}
+	else if (statTest.loadRawData(QString(statfile),0))
 	{
 		startGeneration = statTest.getIndex();
 		sprintf(inFilename, "S%dG%d.gen", (seed()), startGeneration);
@@ -168,30 +454,25 @@ void XnesAlgo::runEvolution()
 				Logger::error("Wrong genotype length!");
 			}
 
-			// Load the covariance matrix
+			// Load the covariance factor. The text export (see exportTextCheckpoint()) contains the
+			// factor itself, older versions saved its logarithm, which is exponentiated once here
+			char factorFilename[64];
+			sprintf(factorFilename, "S%dG%d.exm", (seed()), startGeneration);
 			char covMatFilename[64];
 			sprintf(covMatFilename, "S%dG%d.cvm", (seed()), startGeneration);
-			QFile covMatData(covMatFilename);
-			if (covMatData.open(QFile::ReadOnly))
+			Eigen::MatrixXf factor(m_factor.rows(),m_factor.cols());
+			Eigen::MatrixXf logFactor(m_numGenes,m_numGenes);
+			if (loadTextMatrix(factorFilename, factor))
 			{
-				QTextStream covMatInput(&covMatData);
-				for (int i = 0; i < m_numGenes; i++)
-				{
-					for (int j = 0; j < m_numGenes; j++)
-					{
-						QString str;
-						covMatInput >> str;
-						bool ok = false;
-						float elem = str.toFloat(&ok);
-						if (!ok || (covMatInput.status() != QTextStream::Ok))
-						{
-							Logger::error("Error in the loading of the covariance matrix");
-						}
-						m_covMat(i,j) = elem;
-						expCovMat(i,j) = 0.0;
-					}
-				}
-				covMatData.close();
+				m_factor = factor;
+			}
+			else if (loadTextMatrix(covMatFilename, logFactor))
+			{
+				setFactorFromLogarithm(logFactor);
+			}
+			else
+			{
+				Logger::error(QString("Cannot find the covariance factor (neither %1 nor %2), using the identity").arg(factorFilename).arg(covMatFilename));
 			}
 			inData.close();
 		}
@@ -207,36 +488,29 @@ void XnesAlgo::runEvolution()
 	for (int gn = startGeneration; gn < m_numGenerations; gn++)
 	{
 		m_gae->setIndividualCounter();
-		m_gae->initGeneration(gn);
-		// Compute the exponential of the covariance matrix
-		Eigen::MatrixExponential<Eigen::MatrixXf>(m_covMat).compute(expCovMat);
 		// Extract the offspring
-		extractOffspring(expCovMat);
+		extractOffspring();
 		// Prepare a vector for the fitnesses
 		QVector<float> offspringFitness(m_numOffspring);
 		QVector<int> offspringIdx(m_numOffspring);
 		// Evaluate all the offspring
-		for (int g = 0; g < m_numOffspring; g++)
+		evaluateOffspring(gn, offspringFitness);
+		m_gae->resetIndividualCounter();
+		// Flow control
+		pauseFlow();
+		if (stopFlow())
 		{
-			// Set the genotype to be tested
-			m_gt->setGenotype(m_offspring[g]);
-			// Evaluate the genotype
-			m_gae->evaluate();
-			// Get the fitness
-			offspringFitness[g] = m_gae->getFitness();
-			// Set the fitness of the current genotype
-			m_offspring[g]->setFitness(offspringFitness[g]);
+			break;
 		}
-		m_gae->resetIndividualCounter();
 		// Sort the fitnesses
 		sortFitness(offspringFitness, offspringIdx);
 		// Compute the utility ranking
 		QVector<float> utilityRank = computeUtilityRanking(offspringIdx);
 		// Compute the updates
-		Eigen::MatrixXf dCovMat(m_numGenes,m_numGenes);
-		computeUpdates(dCovMat, utilityRank, expCovMat);
-		// Update both the individual and the covariance matrix
-		update(m_dInd, dCovMat);
+		Eigen::MatrixXf dFactor(m_factor.rows(),m_factor.cols());
+		computeUpdates(dFactor, utilityRank);
+		// Update both the individual and the covariance factor
+		update(m_dInd, dFactor);
 		// Save the best genotype (i.e., the best offspring)
 		sprintf(bestOutFilename, "S%dB%d.gen", seed(), 0);
 		QFile bestOutData(bestOutFilename);
@@ -258,41 +532,6 @@ void XnesAlgo::runEvolution()
 			bestOutData.close();
 		}
 
-		// Save all the genotypes (i.e., both the individual and the offspring)
-		sprintf(outFilename, "S%dG%d.gen", (seed()), (gn + 1));
-		QFile outData(outFilename);
-		if (outData.open(QIODevice::WriteOnly))
-		{
-			QTextStream out(&outData);
-			// First save the individual
-			m_individual->saveGen(out);
-			// Then save the offspring
-			for (int j = 0; j < m_numOffspring; j++)
-			{
-				m_offspring[j]->saveGen(out);
-			}
-			outData.close();
-		}
-		
-		// Save the covariance matrix
-		char covMatFilename[64];
-		sprintf(covMatFilename, "S%dG%d.cvm", (seed()), (gn + 1));
-		QFile covMatData(covMatFilename);
-		if (covMatData.open(QIODevice::WriteOnly))
-		{
-			QTextStream covMatOutput(&covMatData);
-			for (int i = 0; i < m_numGenes; i++)
-			{
-				for (int j = 0; j < m_numGenes; j++)
-				{
-					QString str;
-					str = QString::number(m_covMat(i,j));
-					covMatOutput << " " << str;
-				}
-				covMatOutput << endl;
-			}
-			covMatData.close();
-		}
 		// Flow control
 		pauseFlow();
 		if (stopFlow())
@@ -374,7 +613,23 @@ void XnesAlgo::runEvolution()
 			bestGeneration = gn;
 		}
 
-		m_gae->endGeneration(gn);
+		// Save a checkpoint every m_checkpointInterval generations and after the last one
+		if ((((gn + 1) % m_checkpointInterval) == 0) || ((gn + 1) == m_numGenerations))
+		{
+			if (!saveCheckpoint(gn + 1, bestGeneration, bestFitness))
+			{
+				Logger::warning("Error saving the checkpoint of generation " + QString::number(gn + 1));
+			}
+			if (m_textCheckpoint)
+			{
+				exportTextCheckpoint(gn + 1);
+			}
+		}
+
+		for (int i = 0; i < m_evaluators.size(); i++)
+		{
+			m_evaluators[i]->experiment()->endGeneration(gn);
+		}
 	}
 
 	// Save the information about the best generation
@@ -415,24 +670,226 @@ void XnesAlgo::saveFitStats(QVector<float> fit, QTextStream& out)
 	out << endl;
 }
 
+bool XnesAlgo::saveCheckpoint(int generation, int bestGeneration, float bestFitness)
+{
+	char filename[64];
+	sprintf(filename, "S%d.xck", seed());
+	char fitStatFilename[64];
+	sprintf(fitStatFilename, "S%d.fit", seed());
+	char allFitStatFilename[64];
+	sprintf(allFitStatFilename, "S%dall.fit", seed());
+	char bestOutFilename[64];
+	sprintf(bestOutFilename, "S%dB%d.gen", seed(), 0);
+
+	// The previous checkpoint is only replaced when the new one has been written completely
+	QSaveFile file(filename);
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		return false;
+	}
+
+	// The header
+	QDataStream header(&file);
+	header.setByteOrder(QDataStream::LittleEndian);
+	header.setFloatingPointPrecision(QDataStream::SinglePrecision);
+	header.writeRawData(checkpointMagic, 8);
+	header << checkpointVersion;
+	header << quint32(m_numGenes);
+	header << qint32(generation);
+	header << qint32(bestGeneration);
+	header << bestFitness;
+	header << quint32(m_separable ? 1 : 0);
+	header << qint64(fileSize(fitStatFilename));
+	header << qint64(fileSize(allFitStatFilename));
+	header << qint64(fileSize(bestOutFilename));
+	const QByteArray padding(checkpointHeaderSize - file.pos(), '\0');
+	header.writeRawData(padding.constData(), padding.size());
+	if (header.status() != QDataStream::Ok)
+	{
+		file.cancelWriting();
+		return false;
+	}
+
+	// The individual and the covariance factor
+	GenotypeFloat* ind = dynamic_cast<GenotypeFloat*>(m_individual);
+	QVector<float> genes(m_numGenes);
+	for (int i = 0; i < m_numGenes; i++)
+	{
+		genes[i] = ind->getGene(i);
+	}
+	if (!writeFloatsLittleEndian(file, genes.constData(), m_numGenes) ||
+	    !writeFloatsLittleEndian(file, m_factor.data(), qint64(m_factor.rows()) * qint64(m_factor.cols())))
+	{
+		file.cancelWriting();
+		return false;
+	}
+
+	return file.commit();
+}
+
+bool XnesAlgo::loadCheckpoint(int& generation, int& bestGeneration, float& bestFitness)
+{
+	char filename[64];
+	sprintf(filename, "S%d.xck", seed());
+
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	// Reading and checking the header
+	QDataStream header(&file);
+	header.setByteOrder(QDataStream::LittleEndian);
+	header.setFloatingPointPrecision(QDataStream::SinglePrecision);
+	char magic[8];
+	quint32 version;
+	quint32 numGenes;
+	qint32 gen;
+	qint32 bestGen;
+	float bestFit;
+	quint32 separable;
+	qint64 fitStatSize;
+	qint64 allFitStatSize;
+	qint64 bestOutSize;
+	header.readRawData(magic, 8);
+	header >> version >> numGenes >> gen >> bestGen >> bestFit >> separable >> fitStatSize >> allFitStatSize >> bestOutSize;
+	if ((header.status() != QDataStream::Ok) || (memcmp(magic, checkpointMagic, 8) != 0))
+	{
+		Logger::error(QString("The checkpoint file %1 is not valid").arg(filename));
+		return false;
+	}
+	if ((version != 1) && (version != checkpointVersion))
+	{
+		Logger::error(QString("The checkpoint file %1 has an unsupported version (%2)").arg(filename).arg(version));
+		return false;
+	}
+	if (numGenes != quint32(m_numGenes))
+	{
+		Logger::error(QString("The checkpoint file %1 has the wrong number of genes (expected %2, got %3)").arg(filename).arg(m_numGenes).arg(numGenes));
+		return false;
+	}
+	if ((separable != 0) != m_separable)
+	{
+		Logger::error(QString("The checkpoint file %1 was saved by a different variant of the algorithm").arg(filename));
+		return false;
+	}
+
+	// Reading the individual and the covariance factor (the logarithm of the factor in version 1)
+	QVector<float> genes(m_numGenes);
+	Eigen::MatrixXf factor(m_numGenes, (separable != 0) ? 1 : m_numGenes);
+	if (!file.seek(checkpointHeaderSize) ||
+	    !readFloatsLittleEndian(file, genes.data(), m_numGenes) ||
+	    !readFloatsLittleEndian(file, factor.data(), qint64(factor.rows()) * qint64(factor.cols())))
+	{
+		Logger::error(QString("The checkpoint file %1 is truncated").arg(filename));
+		return false;
+	}
+	GenotypeFloat* ind = dynamic_cast<GenotypeFloat*>(m_individual);
+	for (int i = 0; i < m_numGenes; i++)
+	{
+		ind->setGene(i, genes[i]);
+	}
+	if (version == 1)
+	{
+		setFactorFromLogarithm(factor);
+	}
+	else
+	{
+		m_factor = factor;
+	}
+	generation = gen;
+	bestGeneration = bestGen;
+	bestFitness = bestFit;
+
+	// Removing from statistics files what was written after the checkpoint
+	char fitStatFilename[64];
+	sprintf(fitStatFilename, "S%d.fit", seed());
+	char allFitStatFilename[64];
+	sprintf(allFitStatFilename, "S%dall.fit", seed());
+	char bestOutFilename[64];
+	sprintf(bestOutFilename, "S%dB%d.gen", seed(), 0);
+	truncateFile(fitStatFilename, fitStatSize);
+	truncateFile(allFitStatFilename, allFitStatSize);
+	truncateFile(bestOutFilename, bestOutSize);
+
+	return true;
+}
+
+void XnesAlgo::exportTextCheckpoint(int generation)
+{
+	// Save all the genotypes (i.e., both the individual and the offspring)
+	char outFilename[128];
+	sprintf(outFilename, "S%dG%d.gen", (seed()), generation);
+	QFile outData(outFilename);
+	if (outData.open(QIODevice::WriteOnly))
+	{
+		QTextStream out(&outData);
+		// First save the individual
+		m_individual->saveGen(out);
+		// Then save the offspring
+		for (int j = 0; j < m_numOffspring; j++)
+		{
+			m_offspring[j]->saveGen(out);
+		}
+		outData.close();
+	}
+
+	// Save the covariance factor
+	char factorFilename[64];
+	sprintf(factorFilename, "S%dG%d.exm", (seed()), generation);
+	QFile factorData(factorFilename);
+	if (factorData.open(QIODevice::WriteOnly))
+	{
+		QTextStream factorOutput(&factorData);
+		for (int i = 0; i < m_factor.rows(); i++)
+		{
+			for (int j = 0; j < m_factor.cols(); j++)
+			{
+				QString str;
+				str = QString::number(m_factor(i,j));
+				factorOutput << " " << str;
+			}
+			factorOutput << endl;
+		}
+		factorData.close();
+	}
+}
+
 void XnesAlgo::initialise()
 {
 	GenotypeFloat* ind = dynamic_cast<GenotypeFloat*>(m_individual);
 	// Initialise the individual
 	ind->initGaussian(0.0, 1.0);
-	// Initialise the covariance matrix
-	for (int i = 0; i < m_numGenes; i++)
+	// Initialise the covariance factor to the identity (the exponential of a null matrix)
+	if (m_separable)
+	{
+		m_factor.setOnes();
+	}
+	else
 	{
-		for (int j = 0; j < m_numGenes; j++)
+		m_factor.setIdentity();
+	}
+}
+
+void XnesAlgo::setFactorFromLogarithm(const Eigen::MatrixXf& logFactor)
+{
+	if (m_separable)
+	{
+		// Only the diagonal is meaningful for the separable variant
+		for (int i = 0; i < m_numGenes; i++)
 		{
-			m_covMat(i,j) = 0.0;
+			m_factor(i,0) = exp(logFactor(i,(logFactor.cols() == 1) ? 0 : i));
 		}
 	}
+	else
+	{
+		Eigen::MatrixExponential<Eigen::MatrixXf>(logFactor).compute(m_factor);
+	}
 }
 
-void XnesAlgo::extractOffspring(const Eigen::MatrixXf expCovMat)
+void XnesAlgo::extractOffspring()
 {
-	Eigen::MatrixXf dSamples(m_numGenes, m_numOffspring);
 	for (int j = 0; j < m_numOffspring; j++)
 	{
 		GenotypeFloat* offspring = dynamic_cast<GenotypeFloat*>(m_offspring[j]);
@@ -443,7 +900,15 @@ void XnesAlgo::extractOffspring(const Eigen::MatrixXf expCovMat)
 			m_samples(i,j) = offspring->getGene(i);
 		}
 	}
-	dSamples = expCovMat * m_samples;
+	// The scaled samples are also used to compute the update of the individual
+	if (m_separable)
+	{
+		m_scaledSamples = m_factor.col(0).asDiagonal() * m_samples;
+	}
+	else
+	{
+		m_scaledSamples.noalias() = m_factor * m_samples;
+	}
 	// Now extract the offspring
 	for (int j = 0; j < m_numOffspring; j++)
 	{
@@ -451,12 +916,47 @@ void XnesAlgo::extractOffspring(const Eigen::MatrixXf expCovMat)
 		for (int i = 0; i < m_numGenes; i++)
 		{
 			GenotypeFloat* ind = dynamic_cast<GenotypeFloat*>(m_individual);
-			const float elem = ind->getGene(i) + dSamples(i,j);
+			const float elem = ind->getGene(i) + m_scaledSamples(i,j);
 			offspring->setGene(i, elem);
 		}
 	}
 }
 
+void XnesAlgo::evaluateOffspring(int gn, QVector<float>& offspringFitness)
+{
+	// The seeds of all offspring are drawn here, in sequence, so that they
+	// do not depend on the number of evaluators
+	QVector<unsigned int> seeds(m_numOffspring);
+	for (int g = 0; g < m_numOffspring; g++)
+	{
+		seeds[g] = (unsigned int) globalRNG->getInt(0, INT_MAX - 1);
+	}
+	const int numEvaluators = qMin(m_evaluators.size(), m_numOffspring);
+	for (int i = 0; i < m_evaluators.size(); i++)
+	{
+		m_evaluators[i]->experiment()->initGeneration(gn);
+		m_evaluators[i]->setOffspring(i, numEvaluators, &m_offspring, &seeds);
+	}
+	if (numEvaluators == 1)
+	{
+		m_evaluators[0]->run();
+	}
+	else
+	{
+		// A private pool, so that we don't change the number of threads of the global one
+		m_threadPool.setMaxThreadCount(numEvaluators);
+		for (int i = 0; i < numEvaluators; i++)
+		{
+			m_threadPool.start(m_evaluators[i]);
+		}
+		m_threadPool.waitForDone();
+	}
+	for (int g = 0; g < m_numOffspring; g++)
+	{
+		offspringFitness[g] = m_offspring[g]->getFitness();
+	}
+}
+
 void XnesAlgo::sortFitness(const QVector<float> fitness, QVector<int>& offspringIdx)
 {	
 	int startIndex = 0;
@@ -513,72 +1013,55 @@ QVector<float> XnesAlgo::computeUtilityRanking(const QVector<int> offspringIdx)
 	return utilityRank;
 }
 
-void XnesAlgo::computeUpdates(Eigen::MatrixXf& dCovMat, const QVector<float> utilityRank, const Eigen::MatrixXf expCovMat)
+void XnesAlgo::computeUpdates(Eigen::MatrixXf& dFactor, const QVector<float> utilityRank)
 {
 	GenotypeFloat* deltaInd = dynamic_cast<GenotypeFloat*>(m_dInd);
-	// Create a matrix whose rows contain weights * samples
-	Eigen::MatrixXf sortedUtility(m_numGenes,m_numOffspring);
-	Eigen::MatrixXf sortedUtilityPerSamples(m_numGenes,m_numOffspring);
-	Eigen::MatrixXf trSamples(m_numOffspring,m_numGenes);
-	// The sum of utility values
-	float utilitySum = 0.0;
-	// Define the identity matrix
-	Eigen::MatrixXf eye(m_numGenes,m_numGenes);
-	for (int i = 0; i < m_numGenes; i++)
-	{
-		for (int j = 0; j < m_numGenes; j++)
-		{
-			if (i == j)
-			{
-				eye(i,j) = 1.0;
-			}
-			else
-			{
-				eye(i,j) = 0.0;
-			}
-		}
-	}
-	// Compute the sum of utility values
+	// The utilities as a column vector and their sum
+	Eigen::VectorXf utility(m_numOffspring);
 	for (int j = 0; j < m_numOffspring; j++)
 	{
-		utilitySum += utilityRank[j];
-	}
-	// Compute the matrices necessary to calculate the gradients
-	for (int i = 0; i < m_numGenes; i++)
-	{
-		for (int j = 0; j < m_numOffspring; j++)
-		{
-			sortedUtility(i,j) = utilityRank[j];
-		}
+		utility(j) = utilityRank[j];
 	}
+	const float utilitySum = utility.sum();
+	// Compute the update of the individual. The scaled samples are the samples multiplied by the
+	// covariance factor, computed when the offspring were extracted
+	const Eigen::VectorXf trInd = m_indLrate * (m_scaledSamples * utility);
 	for (int i = 0; i < m_numGenes; i++)
 	{
-		for (int j = 0; j < m_numOffspring; j++)
-		{
-			sortedUtilityPerSamples(i,j) = sortedUtility(i,j) * m_samples(i,j);
-			trSamples(j,i) = m_samples(i,j);
-		}
+		deltaInd->setGene(i, trInd(i));
 	}
-	// Define transpose matrices for both samples and sorted utilities
-	// (they are necessary to perform the calculation of gradients)
-	Eigen::MatrixXf trSortedUtility(m_numOffspring,1);
-	Eigen::MatrixXf trInd(m_numOffspring,1);
-	for (int j = 0; j < m_numOffspring; j++)
+	// Compute the update of the covariance factor. The natural gradient with respect to the logarithm
+	// of the factor is G = S * U * S^T - utilitySum * I, where S are the samples and U is the diagonal
+	// matrix of utilities, and the factor A is updated as A <- A * exp(eta * G)
+	if (m_separable)
 	{
-		trSortedUtility(j,0) = utilityRank[j];
+		// Here G is diagonal, so its exponential is computed element by element
+		const Eigen::VectorXf g = m_samples.cwiseProduct(m_samples) * utility - Eigen::VectorXf::Constant(m_numGenes, utilitySum);
+		dFactor.col(0) = m_factor.col(0).cwiseProduct((m_covMatLrate * g).array().exp().matrix() - Eigen::VectorXf::Ones(m_numGenes));
 	}
-	// Compute the update of the individual
-	trInd = m_indLrate * expCovMat * m_samples * trSortedUtility;
-	for (int i = 0; i < m_numGenes; i++)
+	else
 	{
-		deltaInd->setGene(i, trInd(i,0));
+		// The identity commutes with everything, so exp(eta * G) = exp(-eta * utilitySum) * exp(S * M)
+		// with M = eta * U * S^T. Since (S * M)^(k + 1) = S * (M * S)^k * M, the exponential of the rank
+		// numOffspring matrix S * M is I + S * phi(M * S) * M, where phi(X) = (exp(X) - I) / X only
+		// needs the exponential of a (2 * numOffspring) x (2 * numOffspring) matrix: the top right block
+		// of exp([X I; 0 0]) is phi(X). This means that A * exp(eta * G) is computed in
+		// O(numGenes^2 * numOffspring) instead of O(numGenes^3)
+		const Eigen::MatrixXf M = m_covMatLrate * (utility.asDiagonal() * m_samples.transpose());
+		Eigen::MatrixXf augmented = Eigen::MatrixXf::Zero(2 * m_numOffspring, 2 * m_numOffspring);
+		augmented.topLeftCorner(m_numOffspring, m_numOffspring).noalias() = M * m_samples;
+		augmented.topRightCorner(m_numOffspring, m_numOffspring).setIdentity();
+		Eigen::MatrixXf expAugmented(2 * m_numOffspring, 2 * m_numOffspring);
+		Eigen::MatrixExponential<Eigen::MatrixXf>(augmented).compute(expAugmented);
+		const Eigen::MatrixXf phiM = expAugmented.topRightCorner(m_numOffspring, m_numOffspring) * M;
+		// A * exp(eta * G) - A = (scale - 1) * A + scale * (A * S) * phi(M * S) * M
+		const float scale = exp(-m_covMatLrate * utilitySum);
+		dFactor = (scale - 1.0f) * m_factor;
+		dFactor.noalias() += scale * m_scaledSamples * phiM;
 	}
-	// Compute the update of the covariance matrix
-	Eigen::MatrixXf G = sortedUtilityPerSamples * trSamples - utilitySum * eye;
-	dCovMat = m_covMatLrate * G;
 }
 	
-void XnesAlgo::update(Genotype* dInd, const Eigen::MatrixXf dCovMat)
+void XnesAlgo::update(Genotype* dInd, const Eigen::MatrixXf& dFactor)
 {
 	GenotypeFloat* deltaInd = dynamic_cast<GenotypeFloat*>(dInd);
 	GenotypeFloat* individual = dynamic_cast<GenotypeFloat*>(m_individual);
@@ -588,8 +1071,8 @@ void XnesAlgo::update(Genotype* dInd, const Eigen::MatrixXf dCovMat)
 		float newVal = individual->getGene(i) + deltaInd->getGene(i);
 		individual->setGene(i, newVal);
 	}
-	// Update of the covariance matrix
-	m_covMat += dCovMat;
+	// Update of the covariance factor
+	m_factor += dFactor;
 }
 
 } // end namespace salsa
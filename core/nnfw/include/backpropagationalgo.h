@@ -60,6 +60,27 @@ public:
 	/*! Starts a single training step. */
 	virtual void learn( Pattern* );
 
+	/*! Modify the NeuralNet trying to learn all patterns present into PatternSet passed.
+	 *  If the batch size is greater than one, patterns are grouped in batches and the weights are
+	 *  updated once for each batch (see learnBatch()), otherwise they are updated after each pattern
+	 */
+	virtual void learnOnSet( const PatternSet& set );
+
+	/*! Starts a training step on a block of patterns, updating the weights only once.
+	 *  Each column of the matrices is a pattern, so all matrices must have the same number of columns.
+	 *  The network is spread once for each pattern, while the deltas and the gradient for the whole
+	 *  block are computed with matrix-matrix products. The update is the sum of the updates for the
+	 *  single patterns, so the learning rate has the same meaning as in learn( Pattern* ). When
+	 *  momentum is enabled, the update of the previous batch is added to the current one.
+	 *  Matrix products are parallelized by Eigen if it has been compiled with OpenMP support
+	 *  \param inputs the inputs of the input Clusters, one row for each neuron
+	 *  \param targets the desired outputs of the output Clusters, one row for each neuron
+	 */
+	void learnBatch( const QMap<Cluster*, DoubleMatrix>& inputs, const QMap<Cluster*, DoubleMatrix>& targets );
+
+	/*! Starts a training step on count patterns of the set starting from first, updating the weights only once */
+	void learnBatch( const PatternSet& set, int first, int count );
+
 	/*! Calculate the Mean Square Error respect to Pattern passed */
 	virtual double calculateMSE( Pattern* );
 
@@ -91,6 +112,16 @@ public:
 		useMomentum = false;
 	};
 
+	/*! Set the number of patterns used for each update of the weights by learnOnSet() */
+	void setBatchSize( int size ) {
+		batch_size = qMax( size, 1 );
+	};
+
+	/*! return the number of patterns used for each update of the weights by learnOnSet() */
+	int batchSize() const {
+		return batch_size;
+	};
+
 	/*! This method returns the deltas calculated by the Back-propagation Algorithm.
 	 *  These deltas are set every time new targets are defined for the output layer(s),
 	 *  which are then used to update network weights when the method learn() is called.<br>
@@ -123,6 +154,7 @@ public:
 	 * rate = learningRate      ;if it's not present, default is 0.0 !!
 	 * momentum = momentumRate  ;if it's not present, means momentum disabled
 	 * order = cluster2 linker1 cluster1 ; order of Cluster and Linker on which the error is backpropagated
+	 * batchSize = 100          ;the number of patterns for each update by learnOnSet, default is 1
 	 * \endcode
 	 * As you can note, there is no configuration parameters for loading the learning set from here.
 	 * This is intended. You need to load separately the learning set and call the method learn on the
@@ -169,6 +201,8 @@ private:
 	double useMomentum;
 	//! The update order
 	UpdatableList update_order;
+	//! The number of patterns for each update in learnOnSet
+	int batch_size;
 
 	//! The struct of Clusters and Deltas
 	class SALSA_NNFW_API cluster_deltas {
@@ -180,6 +214,18 @@ private:
 		DoubleVector last_deltas_inputs;
 		QList<MatrixLinker*> incoming_linkers_vec;
 		QVector<DoubleVector> incoming_last_outputs;
+		//! index into cluster_deltas_vec of the from() Cluster of each incoming linker (-1 if not in learning)
+		QVector<int> incoming_from_index;
+		//! the inputs and outputs of the cluster for each pattern of the batch (one column per pattern)
+		DoubleMatrix batch_inputs;
+		DoubleMatrix batch_outputs;
+		DoubleMatrix batch_deltas_outputs;
+		DoubleMatrix batch_deltas_inputs;
+		//! the outputs of the from() Cluster of each incoming linker for each pattern of the batch
+		QVector<DoubleMatrix> batch_incoming_outputs;
+		//! the last update of each incoming linker and of biases (for momentum)
+		QVector<DoubleMatrix> batch_last_changes;
+		DoubleVector batch_last_biases_changes;
 	};
 	//! map to help looking for cluster_deltas info
 	QMap<Cluster*, int> mapIndex;
@@ -187,6 +233,10 @@ private:
 	QVector<cluster_deltas> cluster_deltas_vec;
 	// --- propagate delta through the net
 	void propagDeltas();
+	// --- propagate the deltas of a batch through the net
+	void propagBatchDeltas();
+	// --- fill the incoming_from_index of all cluster_deltas
+	void updateFromIndices();
 	// --- add a Cluster into the structures above
 	void addCluster( Cluster*, bool );
 	// --- add a Linker into the structures above
@@ -25,7 +25,7 @@
 namespace salsa {
 
 BackPropagationAlgo::BackPropagationAlgo(ConfigurationManager& params, QString prefix, Component* parent)
-	: LearningAlgorithm(params,prefix,parent), learn_rate(0.0) {
+	: LearningAlgorithm(params,prefix,parent), learn_rate(0.0), batch_size(1) {
 	useMomentum = false;
 	momentumv = 0.0f;
 	neuralNetChanged();
@@ -60,6 +60,7 @@ void BackPropagationAlgo::neuralNetChanged() {
 			addLinker( linker_temp );
 		}
 	}
+	updateFromIndices();
 }
 
 void BackPropagationAlgo::setUpdateOrder( const UpdatableList& update_order ) {
@@ -92,6 +93,8 @@ void BackPropagationAlgo::enableMomentum() {
 			cluster_deltas_vec[i].incoming_last_outputs[j].setZero();
 			cluster_deltas_vec[i].last_deltas_inputs.setZero();
 		}
+		// --- the momentum of batches is reinitialized by the next call to learnBatch
+		cluster_deltas_vec[i].batch_last_changes.clear();
 	}
 	useMomentum = true;
 }
@@ -99,7 +102,6 @@ void BackPropagationAlgo::enableMomentum() {
 void BackPropagationAlgo::propagDeltas() {
 	DoubleVector diff_vec;
 	for( int i=0; i<(int)cluster_deltas_vec.size(); i++ ) {
-		cluster_deltas_vec[i].incoming_linkers_vec;
 		// --- propagate DeltaOutput to DeltaInputs
 		cluster_deltas_vec[i].deltas_inputs = cluster_deltas_vec[i].deltas_outputs;
 		Cluster* cl = cluster_deltas_vec[i].cluster;
@@ -110,18 +112,58 @@ void BackPropagationAlgo::propagDeltas() {
 		}
 		// --- propagate DeltaInputs to DeltaOutput through MatrixLinker
 		for( int k=0; k<cluster_deltas_vec[i].incoming_linkers_vec.size( ); ++k ) {
-			MatrixLinker* link = dynamic_cast<MatrixLinker*>(cluster_deltas_vec[i].incoming_linkers_vec[k]);
-			if ( mapIndex.count(link->from()) == 0 ) {
+			int from_index = cluster_deltas_vec[i].incoming_from_index[k];
+			if ( from_index == -1 ) {
 				// --- the from() cluster is not in Learning
 				continue;
 			}
-			int from_index = mapIndex[ link->from() ];
-			cluster_deltas_vec[from_index].deltas_outputs = link->matrix()*cluster_deltas_vec[i].deltas_inputs;
+			MatrixLinker* link = cluster_deltas_vec[i].incoming_linkers_vec[k];
+			cluster_deltas_vec[from_index].deltas_outputs.noalias() = link->matrix()*cluster_deltas_vec[i].deltas_inputs;
 		}
 	}
 	return;
 }
 
+void BackPropagationAlgo::propagBatchDeltas() {
+	DoubleVector diff_vec;
+	DoubleVector inputs_vec;
+	DoubleVector outputs_vec;
+	for( int i=0; i<(int)cluster_deltas_vec.size(); i++ ) {
+		cluster_deltas& cd = cluster_deltas_vec[i];
+		// --- propagate DeltaOutput to DeltaInputs, the derivate is computed one pattern at a time
+		cd.batch_deltas_inputs = cd.batch_deltas_outputs;
+		OutputFunction* func = cd.cluster->outFunction();
+		diff_vec.resize( cd.batch_deltas_inputs.rows() );
+		for( int p=0; p<cd.batch_deltas_inputs.cols(); p++ ) {
+			inputs_vec = cd.batch_inputs.col(p);
+			outputs_vec = cd.batch_outputs.col(p);
+			if ( !func->derivate( inputs_vec, outputs_vec, diff_vec ) ) {
+				break;
+			}
+			cd.batch_deltas_inputs.col(p) = cd.batch_deltas_inputs.col(p).cwiseProduct(diff_vec);
+		}
+		// --- propagate DeltaInputs to DeltaOutput through MatrixLinker for all patterns at once
+		for( int k=0; k<cd.incoming_linkers_vec.size( ); ++k ) {
+			int from_index = cd.incoming_from_index[k];
+			if ( from_index == -1 ) {
+				// --- the from() cluster is not in Learning
+				continue;
+			}
+			cluster_deltas_vec[from_index].batch_deltas_outputs.noalias() = cd.incoming_linkers_vec[k]->matrix()*cd.batch_deltas_inputs;
+		}
+	}
+	return;
+}
+
+void BackPropagationAlgo::updateFromIndices() {
+	for ( int i=0; i<cluster_deltas_vec.size(); ++i ) {
+		cluster_deltas_vec[i].incoming_from_index.clear();
+		foreach( MatrixLinker* link, cluster_deltas_vec[i].incoming_linkers_vec ) {
+			cluster_deltas_vec[i].incoming_from_index.append( mapIndex.value( link->from(), -1 ) );
+		}
+	}
+}
+
 void BackPropagationAlgo::learn() {
 	// --- zeroing previous step delta information
 	for ( int i=0; i<cluster_deltas_vec.size(); ++i ) {
@@ -140,29 +182,21 @@ void BackPropagationAlgo::learn() {
 
 		for ( int j=0;  j<cluster_deltas_vec[i].incoming_linkers_vec.size(); ++j ) {
 			if ( cluster_deltas_vec[i].incoming_linkers_vec[j] != nullptr ) {
-				DoubleVector& outputs = cluster_deltas_vec[i].incoming_linkers_vec[j]->from()->outputs();
-				DoubleVector& inputs = cluster_deltas_vec[i].deltas_inputs;
+				const DoubleVector& outputs = cluster_deltas_vec[i].incoming_linkers_vec[j]->from()->outputs();
+				const DoubleVector& inputs = cluster_deltas_vec[i].deltas_inputs;
 				DoubleMatrix& matrix = cluster_deltas_vec[i].incoming_linkers_vec[j]->matrix();
-				for ( int r=0; r<outputs.size(); r++ ) {
-					for ( int c=0; c<inputs.size(); c++ ) {
-						matrix(r,c) += -learn_rate * outputs[r] * inputs[c];
-					}
-				}
+				// --- rank-1 update of the weights
+				matrix.noalias() += -learn_rate * outputs * inputs.transpose();
 				if ( !useMomentum ) continue;
 				// --- add the momentum
-				outputs = cluster_deltas_vec[i].incoming_last_outputs[j];
-				inputs = cluster_deltas_vec[i].last_deltas_inputs;
-				matrix = cluster_deltas_vec[i].incoming_linkers_vec[j]->matrix();
-				for ( int r=0; r<outputs.size(); r++ ) {
-					for ( int c=0; c<inputs.size(); c++ ) {
-						matrix(r,c) += -learn_rate*momentumv * outputs[r] * inputs[c];
-					}
-				}
+				matrix.noalias() += -learn_rate*momentumv * cluster_deltas_vec[i].incoming_last_outputs[j] * cluster_deltas_vec[i].last_deltas_inputs.transpose();
 				// --- save datas for momentum on the next step
-				cluster_deltas_vec[i].incoming_last_outputs[j] = cluster_deltas_vec[i].incoming_linkers_vec[j]->from()->outputs();
-				cluster_deltas_vec[i].last_deltas_inputs = cluster_deltas_vec[i].deltas_inputs;
+				cluster_deltas_vec[i].incoming_last_outputs[j] = outputs;
 			}
 		}
+		if ( useMomentum ) {
+			cluster_deltas_vec[i].last_deltas_inputs = cluster_deltas_vec[i].deltas_inputs;
+		}
 	}
 	return;
 }
@@ -183,6 +217,122 @@ void BackPropagationAlgo::learn( Pattern* pat ) {
 	learn();
 }
 
+void BackPropagationAlgo::learnOnSet( const PatternSet& set ) {
+	if ( batch_size <= 1 ) {
+		LearningAlgorithm::learnOnSet( set );
+		return;
+	}
+	for( int first=0; first<set.size(); first+=batch_size ) {
+		learnBatch( set, first, qMin( batch_size, set.size()-first ) );
+	}
+}
+
+void BackPropagationAlgo::learnBatch( const PatternSet& set, int first, int count ) {
+	// --- build the matrices with one pattern for each column
+	QMap<Cluster*, DoubleMatrix> inputs;
+	QMap<Cluster*, DoubleMatrix> targets;
+	ClusterList clins = neuralNet()->inputClusters();
+	for( int i=0; i<clins.size(); i++ ) {
+		DoubleMatrix& m = inputs[clins[i]];
+		m.resize( clins[i]->numNeurons(), count );
+		for( int p=0; p<count; p++ ) {
+			m.col(p) = set[first+p]->inputsOf( clins[i] );
+		}
+	}
+	ClusterList clout = neuralNet()->outputClusters();
+	for( int i=0; i<clout.size(); i++ ) {
+		DoubleMatrix& m = targets[clout[i]];
+		m.resize( clout[i]->numNeurons(), count );
+		for( int p=0; p<count; p++ ) {
+			m.col(p) = set[first+p]->outputsOf( clout[i] );
+		}
+	}
+	learnBatch( inputs, targets );
+}
+
+void BackPropagationAlgo::learnBatch( const QMap<Cluster*, DoubleMatrix>& inputs, const QMap<Cluster*, DoubleMatrix>& targets ) {
+	if ( inputs.isEmpty() ) {
+		return;
+	}
+	const int count = inputs.begin().value().cols();
+	// --- prepare the matrices for the batch, zeroing previous step delta information
+	for ( int i=0; i<cluster_deltas_vec.size(); ++i ) {
+		cluster_deltas& cd = cluster_deltas_vec[i];
+		const int size = cd.cluster->numNeurons();
+		cd.batch_inputs.resize( size, count );
+		cd.batch_outputs.resize( size, count );
+		cd.batch_deltas_outputs.setZero( size, count );
+		cd.batch_incoming_outputs.resize( cd.incoming_linkers_vec.size() );
+		for ( int j=0; j<cd.incoming_linkers_vec.size(); ++j ) {
+			cd.batch_incoming_outputs[j].resize( cd.incoming_linkers_vec[j]->from()->numNeurons(), count );
+		}
+	}
+	// --- spread the net for each pattern, saving what is needed to compute the deltas
+	ClusterList clins = neuralNet()->inputClusters();
+	QVector<const DoubleMatrix*> clinsInputs;
+	for( int i=0; i<clins.size(); i++ ) {
+		QMap<Cluster*, DoubleMatrix>::const_iterator it = inputs.constFind( clins[i] );
+		clinsInputs.append( ( it == inputs.constEnd() ) ? nullptr : &(it.value()) );
+	}
+	for( int p=0; p<count; p++ ) {
+		for( int i=0; i<clins.size(); i++ ) {
+			if ( clinsInputs[i] ) {
+				clins[i]->inputs() = clinsInputs[i]->col(p);
+			} else {
+				clins[i]->inputs().setZero();
+			}
+		}
+		neuralNet()->step();
+		for ( int i=0; i<cluster_deltas_vec.size(); ++i ) {
+			cluster_deltas& cd = cluster_deltas_vec[i];
+			cd.batch_inputs.col(p) = cd.cluster->inputs();
+			cd.batch_outputs.col(p) = cd.cluster->outputs();
+			for ( int j=0; j<cd.incoming_linkers_vec.size(); ++j ) {
+				cd.batch_incoming_outputs[j].col(p) = cd.incoming_linkers_vec[j]->from()->outputs();
+			}
+		}
+	}
+	// --- set the teaching input
+	for( QMap<Cluster*, DoubleMatrix>::const_iterator it = targets.constBegin(); it != targets.constEnd(); ++it ) {
+		if ( mapIndex.count( it.key() ) == 0 ) {
+			continue;
+		}
+		cluster_deltas& cd = cluster_deltas_vec[ mapIndex[it.key()] ];
+		cd.batch_deltas_outputs = cd.batch_outputs - it.value();
+	}
+	// --- propagating the error through the net
+	propagBatchDeltas();
+	// --- make the learn, with a single update for the whole batch
+	for ( int i=0; i<cluster_deltas_vec.size(); ++i ) {
+		cluster_deltas& cd = cluster_deltas_vec[i];
+		const bool initMomentum = useMomentum && ( cd.batch_last_changes.size() != cd.incoming_linkers_vec.size() );
+		if ( initMomentum ) {
+			cd.batch_last_changes.resize( cd.incoming_linkers_vec.size() );
+			cd.batch_last_biases_changes.setZero( cd.cluster->numNeurons() );
+		}
+		DoubleVector biasesChange = learn_rate * cd.batch_deltas_inputs.rowwise().sum();
+		if ( useMomentum ) {
+			biasesChange += momentumv * cd.batch_last_biases_changes;
+			cd.batch_last_biases_changes = biasesChange;
+		}
+		cd.cluster->biases() += biasesChange;
+		for ( int j=0; j<cd.incoming_linkers_vec.size(); ++j ) {
+			DoubleMatrix& matrix = cd.incoming_linkers_vec[j]->matrix();
+			if ( !useMomentum ) {
+				matrix.noalias() += -learn_rate * cd.batch_incoming_outputs[j] * cd.batch_deltas_inputs.transpose();
+				continue;
+			}
+			DoubleMatrix& change = cd.batch_last_changes[j];
+			if ( initMomentum ) {
+				change.setZero( matrix.rows(), matrix.cols() );
+			}
+			change *= momentumv;
+			change.noalias() += -learn_rate * cd.batch_incoming_outputs[j] * cd.batch_deltas_inputs.transpose();
+			matrix += change;
+		}
+	}
+}
+
 double BackPropagationAlgo::calculateMSE( Pattern* pat ) {
 	// --- set the inputs of the net
 	ClusterList clins = neuralNet()->inputClusters();
@@ -247,6 +397,7 @@ void BackPropagationAlgo::configure() {
 	} else {
 		useMomentum = true;
 	}
+	batch_size = qMax( params.getValue( prefix + "batchSize" ).toInt(), 1 );
 	QString str = params.getValue( prefix + "order" );
 	update_order.clear();
 	if ( !str.isEmpty() ) {
@@ -269,6 +420,7 @@ void BackPropagationAlgo::save() {
 	if ( useMomentum ) {
 		params.createParameter( prefix, "momentum", QString::number(momentumv) );
 	}
+	params.createParameter( prefix, "batchSize", QString::number(batch_size) );
 	QStringList list;
 	foreach( Updatable* up, update_order ) {
 		list << up->name();
@@ -283,6 +435,7 @@ void BackPropagationAlgo::describe( QString type ) {
 	d.describeObject( "neuralnet" ).type( "NeuralNet" ).props( ParamIsMandatory ).help( "The neural network to learn by backpropagation" );
 	d.describeReal( "rate" ).limits( 0.0, 1.0 ).def( 0.2 ).help( "The learning rate" );
 	d.describeReal( "momentum" ).limits( 0.0, 1.0 ).help( "The momentum rate; if zero momentum will be disabled" );
+	d.describeInt( "batchSize" ).limits( 1, MaxInteger ).def( 1 ).help( "The number of patterns for each update of the weights when learning a set of patterns", "When greater than one, the deltas for a batch of patterns are computed with matrix-matrix products and the weights are updated once for each batch with the sum of the updates for the single patterns" );
 }
 
 }
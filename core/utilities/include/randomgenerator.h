@@ -21,6 +21,7 @@
 #define RANDOMGENERATOR_H
 
 #include "utilitiesconfig.h"
+#include <QtGlobal>
 
 namespace salsa {
 
@@ -28,7 +29,9 @@ class RandomGenerator;
 class RandomGeneratorPrivate;
 
 /*! Global Random Generator
- *  \warning this may be not-thread safe
+ *  \warning this may be not-thread safe. Threads can redirect calls to
+ *           globalRNG to a private generator using
+ *           GlobalRNGThreadOverride
  * \ingroup utilities_rng
  */
 extern SALSA_UTIL_API RandomGenerator* globalRNG;
@@ -36,7 +39,19 @@ extern SALSA_UTIL_API RandomGenerator* globalRNG;
 /**
  * \brief Random number generator
  *
- * The class to generate random numbers
+ * The class to generate random numbers. Numbers can be generated in two ways:
+ * - by a generator with a state, initialized with setSeed(). This uses the
+ *   taus2 generator of GSL if SALSA is compiled with GSL support, otherwise
+ *   it is the same as calling setStream(seed);
+ * - by a counter-based generator (Philox4x32-10), selected with setStream().
+ *   Each combination of seed, individual, trial and stream identifies an
+ *   independent and reproducible sequence of numbers, that can be obtained
+ *   by any generator in any thread without depending on other sequences.
+ *   This is useful to make results of parallel evaluations independent of
+ *   the number of threads
+ *
+ * The fill functions generate many numbers at once and give the same numbers
+ * as calling getDouble() or getGaussian() repeatedly.
  *
  * \ingroup utilities_rng
  */
@@ -69,6 +84,21 @@ public:
 	 */
 	unsigned int seed() const;
 
+	/**
+	 * \brief Selects the counter-based sequence identified by the given
+	 *        values
+	 *
+	 * The meaning of individual, trial and stream is up to the caller,
+	 * different combinations simply give independent sequences. After this
+	 * call seed() returns the given seed
+	 * \param seed the seed
+	 * \param individual the id of the individual
+	 * \param trial the id of the trial
+	 * \param stream the id of the stream (e.g. to use different sequences
+	 *               for different purposes in the same trial)
+	 */
+	void setStream(quint32 seed, quint32 individual, quint32 trial = 0, quint32 stream = 0);
+
 	/**
 	 * \brief Returns a random boolean value
 	 *
@@ -109,11 +139,117 @@ public:
 	 */
 	double getGaussian(double var, double mean = 0.0);
 
+	/**
+	 * \brief Fills an array with random numbers taken from a flat
+	 *        distribution
+	 *
+	 * \param values the array to fill
+	 * \param n the number of values to generate
+	 * \param min the lower bound of the range
+	 * \param max the upper bound of the range
+	 */
+	void fillUniform(double* values, int n, double min, double max);
+
+	/**
+	 * \brief Fills an array with random numbers taken from a flat
+	 *        distribution
+	 *
+	 * \param values the array to fill
+	 * \param n the number of values to generate
+	 * \param min the lower bound of the range
+	 * \param max the upper bound of the range
+	 */
+	void fillUniform(float* values, int n, float min, float max);
+
+	/**
+	 * \brief Fills an array with random numbers taken from a gaussian
+	 *        distribution
+	 *
+	 * \param values the array to fill
+	 * \param n the number of values to generate
+	 * \param var the variance of the gaussian distribution
+	 * \param mean the centre of the gaussian distribution
+	 */
+	void fillGaussian(double* values, int n, double var, double mean = 0.0);
+
+	/**
+	 * \brief Fills an array with random numbers taken from a gaussian
+	 *        distribution
+	 *
+	 * \param values the array to fill
+	 * \param n the number of values to generate
+	 * \param var the variance of the gaussian distribution
+	 * \param mean the centre of the gaussian distribution
+	 */
+	void fillGaussian(float* values, int n, float var, float mean = 0.0f);
+
+	/**
+	 * \brief The Philox4x32-10 function
+	 *
+	 * This is the bijection used by the counter-based generator. It is
+	 * public mainly for testing purpouse
+	 * \param counter the counter
+	 * \param key the key
+	 * \param result the four random values corresponding to counter and
+	 *               key
+	 */
+	static void philox4x32(const quint32 counter[4], const quint32 key[2], quint32 result[4]);
+
 private:
+	/**
+	 * \brief Returns the generator to use
+	 *
+	 * This is the generator set with GlobalRNGThreadOverride for the
+	 * current thread if this is globalRNG, this object otherwise
+	 */
+	RandomGenerator* actualGenerator();
+
 	RandomGeneratorPrivate* const m_priv;
 	unsigned int m_seed;
 };
 
+/**
+ * \brief Redirects calls to globalRNG made from the current thread to
+ *        another generator
+ *
+ * While an object of this class exists, numbers requested to globalRNG from
+ * the thread that created the object are taken from the given generator.
+ * Calls from other threads are not affected. This allows code using
+ * globalRNG (e.g. noise on sensors) to run in parallel threads, each with
+ * its own reproducible sequence. Objects of this class can be nested, the
+ * destructor restores the previous generator. Only functions generating
+ * numbers are redirected, setSeed() and setStream() always act on globalRNG
+ *
+ * \ingroup utilities_rng
+ */
+class SALSA_UTIL_API GlobalRNGThreadOverride
+{
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param generator the generator to use in place of globalRNG in the
+	 *                  current thread. This is not owned by this object
+	 */
+	GlobalRNGThreadOverride(RandomGenerator* generator);
+
+	/**
+	 * \brief Destructor
+	 *
+	 * Restores the previous generator
+	 */
+	~GlobalRNGThreadOverride();
+
+private:
+	RandomGenerator* const m_previous;
+
+	// Copy constructor. Here to prevent usage
+	GlobalRNGThreadOverride(const GlobalRNGThreadOverride&);
+
+	// Copy operator. Here to prevent usage
+	GlobalRNGThreadOverride& operator=(const GlobalRNGThreadOverride&);
+};
+
 } // end namespace salsa
 
 #endif
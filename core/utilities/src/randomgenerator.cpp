@@ -28,32 +28,142 @@
 
 namespace salsa {
 
+namespace {
+	// The generator used in place of globalRNG in the current thread (see GlobalRNGThreadOverride)
+	thread_local RandomGenerator* threadGlobalRNGOverride = nullptr;
+
+	// Converts a 32 bits random integer to a double in the open interval (0, 1)
+	inline double toOpenUnitInterval(quint32 v)
+	{
+		return (double(v) + 0.5) * (1.0 / 4294967296.0);
+	}
+}
+
 class SALSA_UTIL_INTERNAL RandomGeneratorPrivate
 {
 public:
-#ifdef SALSA_USE_GSL
-	gsl_rng* const rng;
-
 	RandomGeneratorPrivate()
+#ifdef SALSA_USE_GSL
 		: rng(gsl_rng_alloc(gsl_rng_taus2))
+		, useStream(false)
+#else
+		: useStream(true)
+#endif
+		, key()
+		, counter()
+		, block()
+		, blockPos(4)
+		, spare(0.0)
+		, isSpareReady(false)
 	{
 	}
 
 	~RandomGeneratorPrivate()
 	{
+#ifdef SALSA_USE_GSL
 		gsl_rng_free( rng );
+#endif
 	}
 
-#else
-	RandomGeneratorPrivate()
-		: spare(0.0)
-		, isSpareReady(false)
+	// Generates the next block of four values of the counter-based sequence
+	void nextBlock(quint32 values[4])
+	{
+		RandomGenerator::philox4x32(counter, key, values);
+
+		// The first two elements of the counter are the 64 bits index of the block
+		if (++counter[0] == 0) {
+			++counter[1];
+		}
+	}
+
+	// Returns the next value of the counter-based sequence
+	quint32 next()
+	{
+		if (blockPos == 4) {
+			nextBlock(block);
+			blockPos = 0;
+		}
+
+		return block[blockPos++];
+	}
+
+	// Returns two values taken from the standard normal distribution (Box-Muller transform)
+	void nextStandardGaussianPair(double& z0, double& z1)
+	{
+		const double u1 = toOpenUnitInterval(next());
+		const double u2 = toOpenUnitInterval(next());
+		const double r = sqrt(-2.0 * log(u1));
+		const double theta = 2.0 * 3.14159265358979323846 * u2;
+
+		z0 = r * cos(theta);
+		z1 = r * sin(theta);
+	}
+
+	template <class T>
+	void fillUniform(T* values, int n, double min, double max)
 	{
+		const double range = max - min;
+
+		// First using values already generated, then whole blocks and finally the remaining values
+		int i = 0;
+		for (; (i < n) && (blockPos < 4); i++) {
+			values[i] = T(min + toOpenUnitInterval(block[blockPos++]) * range);
+		}
+		quint32 b[4];
+		for (; (i + 4) <= n; i += 4) {
+			nextBlock(b);
+			for (int j = 0; j < 4; j++) {
+				values[i + j] = T(min + toOpenUnitInterval(b[j]) * range);
+			}
+		}
+		for (; i < n; i++) {
+			values[i] = T(min + toOpenUnitInterval(next()) * range);
+		}
+	}
+
+	template <class T>
+	void fillGaussian(T* values, int n, double var, double mean)
+	{
+		const double stdDev = sqrt(var);
+
+		int i = 0;
+		if ((n > 0) && isSpareReady) {
+			isSpareReady = false;
+			values[i++] = T(spare * stdDev + mean);
+		}
+		for (; (i + 2) <= n; i += 2) {
+			double z0, z1;
+			nextStandardGaussianPair(z0, z1);
+			values[i] = T(mean + stdDev * z0);
+			values[i + 1] = T(mean + stdDev * z1);
+		}
+		if (i < n) {
+			double z0;
+			nextStandardGaussianPair(z0, spare);
+			isSpareReady = true;
+			values[i] = T(mean + stdDev * z0);
+		}
 	}
 
+#ifdef SALSA_USE_GSL
+	gsl_rng* const rng;
+#endif
+
+	// If true the counter-based generator is used
+	bool useStream;
+
+	// The key and the counter of the counter-based generator. The first two elements of the
+	// counter are the index of the block, the others are the trial and the stream
+	quint32 key[2];
+	quint32 counter[4];
+
+	// The last generated block and the position of the next value to use in it
+	quint32 block[4];
+	int blockPos;
+
+	// The second value generated by the Box-Muller transform
 	double spare;
 	bool isSpareReady;
-#endif
 };
 
 RandomGenerator::RandomGenerator(unsigned int seed)
@@ -70,11 +180,12 @@ RandomGenerator::~RandomGenerator()
 
 void RandomGenerator::setSeed(unsigned int seed)
 {
-	m_seed = seed;
 #ifdef SALSA_USE_GSL
+	m_seed = seed;
+	m_priv->useStream = false;
 	gsl_rng_set(m_priv->rng, seed);
 #else
-	srand(seed);
+	setStream(seed, 0);
 #endif
 }
 
@@ -83,60 +194,204 @@ unsigned int RandomGenerator::seed() const
 	return m_seed;
 }
 
+void RandomGenerator::setStream(quint32 seed, quint32 individual, quint32 trial, quint32 stream)
+{
+	m_seed = seed;
+	m_priv->useStream = true;
+	m_priv->key[0] = seed;
+	m_priv->key[1] = individual;
+	m_priv->counter[0] = 0;
+	m_priv->counter[1] = 0;
+	m_priv->counter[2] = trial;
+	m_priv->counter[3] = stream;
+	m_priv->blockPos = 4;
+	m_priv->isSpareReady = false;
+}
+
 bool RandomGenerator::getBool(double trueProbability)
 {
+	RandomGenerator* const g = actualGenerator();
+	if (g != this) {
+		return g->getBool(trueProbability);
+	}
+
 #ifdef SALSA_USE_GSL
-	return gsl_rng_uniform(m_priv->rng) < trueProbability;
-#else
-	return (double(rand()) / double(RAND_MAX)) < trueProbability;
+	if (!m_priv->useStream) {
+		return gsl_rng_uniform(m_priv->rng) < trueProbability;
+	}
 #endif
+	return toOpenUnitInterval(m_priv->next()) < trueProbability;
 }
 
 int RandomGenerator::getInt(int min, int max)
 {
+	RandomGenerator* const g = actualGenerator();
+	if (g != this) {
+		return g->getInt(min, max);
+	}
+
 #ifdef SALSA_USE_GSL
-	return gsl_rng_uniform_int(m_priv->rng, std::abs(max - min) + 1) + min;
-#else
-	return min + (rand() % (max - min));
+	if (!m_priv->useStream) {
+		return gsl_rng_uniform_int(m_priv->rng, std::abs(max - min) + 1) + min;
+	}
 #endif
+	const double range = std::fabs(double(max) - double(min)) + 1.0;
+	return int(double(min) + floor(toOpenUnitInterval(m_priv->next()) * range));
 }
 
 double RandomGenerator::getDouble(double min, double max)
 {
+	RandomGenerator* const g = actualGenerator();
+	if (g != this) {
+		return g->getDouble(min, max);
+	}
+
 #ifdef SALSA_USE_GSL
-	// FIXME: this implementation never returns max
-	return gsl_ran_flat(m_priv->rng, min, max);
-#else
-	return min + (double(rand()) / double(RAND_MAX)) * (max - min);
+	if (!m_priv->useStream) {
+		// FIXME: this implementation never returns max
+		return gsl_ran_flat(m_priv->rng, min, max);
+	}
 #endif
+	return min + toOpenUnitInterval(m_priv->next()) * (max - min);
 }
 
 double RandomGenerator::getGaussian(double var, double mean)
 {
+	RandomGenerator* const g = actualGenerator();
+	if (g != this) {
+		return g->getGaussian(var, mean);
+	}
+
 #ifdef SALSA_USE_GSL
-	return gsl_ran_gaussian(m_priv->rng, var) + mean;
-#else
-	// Using Marsaglia polar method to convert uniform random numbers to gaussian. Implementation
-	// adapted from http://en.wikipedia.org/wiki/Marsaglia_polar_method#Implementation
+	if (!m_priv->useStream) {
+		return gsl_ran_gaussian(m_priv->rng, var) + mean;
+	}
+#endif
+	double value;
+	m_priv->fillGaussian(&value, 1, var, mean);
 
-	const double stdDev = sqrt(var);
-	if (m_priv->isSpareReady) {
-		m_priv->isSpareReady = false;
-		return m_priv->spare * stdDev + mean;
+	return value;
+}
+
+void RandomGenerator::fillUniform(double* values, int n, double min, double max)
+{
+	RandomGenerator* const g = actualGenerator();
+	if (g != this) {
+		g->fillUniform(values, n, min, max);
+		return;
+	}
+
+	if (m_priv->useStream) {
+		m_priv->fillUniform(values, n, min, max);
 	} else {
-		double u, v, s;
-		do {
-			u = (double(rand()) / double(RAND_MAX)) * 2.0 - 1.0;
-			v = (double(rand()) / double(RAND_MAX)) * 2.0 - 1.0;
-			s = u * u + v * v;
-		} while (s >= 1.0 || s == 0.0);
-
-		const double mul = sqrt(-2.0 * log(s) / s);
-		m_priv->spare = v * mul;
-		m_priv->isSpareReady = true;
-		return mean + stdDev * u * mul;
+		for (int i = 0; i < n; i++) {
+			values[i] = getDouble(min, max);
+		}
 	}
-#endif
+}
+
+void RandomGenerator::fillUniform(float* values, int n, float min, float max)
+{
+	RandomGenerator* const g = actualGenerator();
+	if (g != this) {
+		g->fillUniform(values, n, min, max);
+		return;
+	}
+
+	if (m_priv->useStream) {
+		m_priv->fillUniform(values, n, min, max);
+	} else {
+		for (int i = 0; i < n; i++) {
+			values[i] = float(getDouble(min, max));
+		}
+	}
+}
+
+void RandomGenerator::fillGaussian(double* values, int n, double var, double mean)
+{
+	RandomGenerator* const g = actualGenerator();
+	if (g != this) {
+		g->fillGaussian(values, n, var, mean);
+		return;
+	}
+
+	if (m_priv->useStream) {
+		m_priv->fillGaussian(values, n, var, mean);
+	} else {
+		for (int i = 0; i < n; i++) {
+			values[i] = getGaussian(var, mean);
+		}
+	}
+}
+
+void RandomGenerator::fillGaussian(float* values, int n, float var, float mean)
+{
+	RandomGenerator* const g = actualGenerator();
+	if (g != this) {
+		g->fillGaussian(values, n, var, mean);
+		return;
+	}
+
+	if (m_priv->useStream) {
+		m_priv->fillGaussian(values, n, var, mean);
+	} else {
+		for (int i = 0; i < n; i++) {
+			values[i] = float(getGaussian(var, mean));
+		}
+	}
+}
+
+void RandomGenerator::philox4x32(const quint32 counter[4], const quint32 key[2], quint32 result[4])
+{
+	// Constants of the Philox4x32 generator, see Salmon et al., "Parallel random numbers: as easy as
+	// 1, 2, 3", 2011
+	const quint32 m0 = 0xD2511F53u;
+	const quint32 m1 = 0xCD9E8D57u;
+	const quint32 w0 = 0x9E3779B9u;
+	const quint32 w1 = 0xBB67AE85u;
+
+	quint32 c0 = counter[0];
+	quint32 c1 = counter[1];
+	quint32 c2 = counter[2];
+	quint32 c3 = counter[3];
+	quint32 k0 = key[0];
+	quint32 k1 = key[1];
+	for (int round = 0; round < 10; round++) {
+		if (round != 0) {
+			k0 += w0;
+			k1 += w1;
+		}
+
+		const quint64 p0 = quint64(m0) * quint64(c0);
+		const quint64 p1 = quint64(m1) * quint64(c2);
+		const quint32 newC0 = quint32(p1 >> 32) ^ c1 ^ k0;
+		const quint32 newC2 = quint32(p0 >> 32) ^ c3 ^ k1;
+		c1 = quint32(p1);
+		c3 = quint32(p0);
+		c0 = newC0;
+		c2 = newC2;
+	}
+
+	result[0] = c0;
+	result[1] = c1;
+	result[2] = c2;
+	result[3] = c3;
+}
+
+RandomGenerator* RandomGenerator::actualGenerator()
+{
+	return ((threadGlobalRNGOverride != nullptr) && (this == globalRNG)) ? threadGlobalRNGOverride : this;
+}
+
+GlobalRNGThreadOverride::GlobalRNGThreadOverride(RandomGenerator* generator)
+	: m_previous(threadGlobalRNGOverride)
+{
+	threadGlobalRNGOverride = generator;
+}
+
+GlobalRNGThreadOverride::~GlobalRNGThreadOverride()
+{
+	threadGlobalRNGOverride = m_previous;
 }
 
 } // end namespace salsa
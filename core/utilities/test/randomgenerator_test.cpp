@@ -0,0 +1,238 @@
+/***************************************************************************
+ *  SALSA Utilities Library                                                *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#include "randomgenerator.h"
+#include <QtTest/QtTest>
+#include <QThread>
+#include <QVector>
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class RandomGenerator_Test : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void philoxKnownAnswers()
+	{
+		// Values from the known answer tests of the Random123 library
+		quint32 result[4];
+
+		const quint32 zeroCounter[4] = {0, 0, 0, 0};
+		const quint32 zeroKey[2] = {0, 0};
+		RandomGenerator::philox4x32(zeroCounter, zeroKey, result);
+		QCOMPARE(result[0], quint32(0x6627e8d5u));
+		QCOMPARE(result[1], quint32(0xe169c58du));
+		QCOMPARE(result[2], quint32(0xbc57ac4cu));
+		QCOMPARE(result[3], quint32(0x9b00dbd8u));
+
+		const quint32 onesCounter[4] = {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu};
+		const quint32 onesKey[2] = {0xffffffffu, 0xffffffffu};
+		RandomGenerator::philox4x32(onesCounter, onesKey, result);
+		QCOMPARE(result[0], quint32(0x408f276du));
+		QCOMPARE(result[1], quint32(0x41c83b0eu));
+		QCOMPARE(result[2], quint32(0xa20bc7c6u));
+		QCOMPARE(result[3], quint32(0x6d5451fdu));
+
+		const quint32 piCounter[4] = {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u};
+		const quint32 piKey[2] = {0xa4093822u, 0x299f31d0u};
+		RandomGenerator::philox4x32(piCounter, piKey, result);
+		QCOMPARE(result[0], quint32(0xd16cfe09u));
+		QCOMPARE(result[1], quint32(0x94fdccebu));
+		QCOMPARE(result[2], quint32(0x5001e420u));
+		QCOMPARE(result[3], quint32(0x24126ea1u));
+	}
+
+	void sameStreamGivesSameSequence()
+	{
+		RandomGenerator r1;
+		RandomGenerator r2(17);
+
+		r1.setStream(3, 5, 7, 11);
+		r2.setStream(3, 5, 7, 11);
+		QCOMPARE(r1.seed(), 3u);
+		for (int i = 0; i < 100; i++) {
+			QCOMPARE(r1.getDouble(-1.0, 1.0), r2.getDouble(-1.0, 1.0));
+			QCOMPARE(r1.getInt(0, 10), r2.getInt(0, 10));
+		}
+	}
+
+	void differentStreamsGiveDifferentSequences()
+	{
+		const quint32 streams[5][4] = {{1, 0, 0, 0}, {2, 0, 0, 0}, {1, 1, 0, 0}, {1, 0, 1, 0}, {1, 0, 0, 1}};
+
+		QVector<QVector<double> > values(5);
+		for (int s = 0; s < 5; s++) {
+			RandomGenerator r;
+			r.setStream(streams[s][0], streams[s][1], streams[s][2], streams[s][3]);
+			for (int i = 0; i < 10; i++) {
+				values[s].append(r.getDouble(0.0, 1.0));
+			}
+		}
+
+		for (int s1 = 0; s1 < 5; s1++) {
+			for (int s2 = s1 + 1; s2 < 5; s2++) {
+				QVERIFY(values[s1] != values[s2]);
+			}
+		}
+	}
+
+	void valuesAreInRange()
+	{
+		RandomGenerator r;
+		r.setStream(1, 2, 3, 4);
+
+		for (int i = 0; i < 1000; i++) {
+			const int v = r.getInt(-3, 3);
+			QVERIFY((v >= -3) && (v <= 3));
+			const double d = r.getDouble(2.0, 5.0);
+			QVERIFY((d >= 2.0) && (d <= 5.0));
+		}
+	}
+
+	void fillUniformIsTheSameAsRepeatedGetDouble()
+	{
+		RandomGenerator r1;
+		RandomGenerator r2;
+		r1.setStream(42, 1);
+		r2.setStream(42, 1);
+
+		// Drawing one value first, so that filling does not start at the beginning of a block
+		QCOMPARE(r1.getDouble(0.0, 1.0), r2.getDouble(0.0, 1.0));
+
+		double d[11];
+		r1.fillUniform(d, 11, -2.0, 3.0);
+		for (int i = 0; i < 11; i++) {
+			QCOMPARE(d[i], r2.getDouble(-2.0, 3.0));
+		}
+
+		float f[6];
+		r1.fillUniform(f, 6, 0.5f, 1.5f);
+		for (int i = 0; i < 6; i++) {
+			QCOMPARE(f[i], float(r2.getDouble(0.5, 1.5)));
+		}
+	}
+
+	void fillGaussianIsTheSameAsRepeatedGetGaussian()
+	{
+		RandomGenerator r1;
+		RandomGenerator r2;
+		r1.setStream(42, 2);
+		r2.setStream(42, 2);
+
+		// Drawing one value first, so that a value is kept for the next call
+		QCOMPARE(r1.getGaussian(1.0), r2.getGaussian(1.0));
+
+		double d[7];
+		r1.fillGaussian(d, 7, 4.0, 1.0);
+		for (int i = 0; i < 7; i++) {
+			QCOMPARE(d[i], r2.getGaussian(4.0, 1.0));
+		}
+
+		float f[4];
+		r1.fillGaussian(f, 4, 0.25f, -1.0f);
+		for (int i = 0; i < 4; i++) {
+			QCOMPARE(f[i], float(r2.getGaussian(0.25, -1.0)));
+		}
+	}
+
+	void gaussianHasCorrectMeanAndVariance()
+	{
+		RandomGenerator r;
+		r.setStream(7, 0);
+
+		const int n = 100000;
+		QVector<double> values(n);
+		r.fillGaussian(values.data(), n, 4.0, 1.0);
+		double sum = 0.0;
+		double squaresSum = 0.0;
+		foreach (double v, values) {
+			sum += v;
+			squaresSum += v * v;
+		}
+		const double mean = sum / n;
+		const double variance = squaresSum / n - mean * mean;
+		QVERIFY(fabs(mean - 1.0) < 0.05);
+		QVERIFY(fabs(variance - 4.0) < 0.1);
+	}
+
+	void globalRNGOverrideOnlyAffectsCurrentThread()
+	{
+		RandomGenerator* const oldGlobalRNG = globalRNG;
+		RandomGenerator global;
+		globalRNG = &global;
+		global.setStream(1, 0);
+
+		RandomGenerator local;
+		local.setStream(2, 0);
+		RandomGenerator reference;
+		reference.setStream(2, 0);
+
+		double otherThreadValue = 0.0;
+		{
+			GlobalRNGThreadOverride o(&local);
+			QCOMPARE(globalRNG->getDouble(0.0, 1.0), reference.getDouble(0.0, 1.0));
+
+			// Another thread still uses globalRNG
+			class T : public QThread
+			{
+			public:
+				T(double& value)
+					: m_value(value)
+				{
+				}
+
+				void run()
+				{
+					m_value = globalRNG->getDouble(0.0, 1.0);
+				}
+
+			private:
+				double& m_value;
+			};
+			T t(otherThreadValue);
+			t.start();
+			t.wait();
+		}
+
+		RandomGenerator globalReference;
+		globalReference.setStream(1, 0);
+		QCOMPARE(otherThreadValue, globalReference.getDouble(0.0, 1.0));
+
+		// After the override is destroyed, globalRNG is used again
+		QCOMPARE(globalRNG->getDouble(0.0, 1.0), globalReference.getDouble(0.0, 1.0));
+
+		globalRNG = oldGlobalRNG;
+	}
+};
+
+QTEST_MAIN(RandomGenerator_Test)
+#include "randomgenerator_test.moc"
@@ -91,6 +91,9 @@ public:
 
 	/**
 	 * \brief The map of contacts
+	 *
+	 * This is only copied when the map of contacts in the world changes
+	 * (see contactsChecker)
 	 */
 	ContactMap contacts;
 
@@ -128,6 +131,14 @@ public:
 	 * every RenderingDataToGUI object has its own list
 	 */
 	UpdateCheckerLong renderingProxiesChecker;
+
+	/**
+	 * \brief The checker for changes in the map of contacts
+	 *
+	 * Like the list of AbstractRenderingProxy, every RenderingDataToGUI
+	 * object has its own copy of the map of contacts
+	 */
+	UpdateCheckerLong contactsChecker;
 };
 
 /**
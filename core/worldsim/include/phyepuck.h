@@ -92,7 +92,7 @@ public:
  * This class models an e-puck robot. For more information about the robot go to
  * http://mobots.epfl.ch/e-puck.html
  */
-class SALSA_WSIM_API PhyEpuck : public QObject, public WObject
+class SALSA_WSIM_API PhyEpuck : public QObject, public WObject, protected PhyDOFListener
 {
 	Q_OBJECT
 
@@ -350,6 +350,18 @@ protected slots:
 	void setRightWheelDesideredVelocity(real velocity);
 
 protected:
+	/**
+	 * \brief Called when the desired velocity of a wheel changes
+	 *
+	 * This calls setLeftWheelDesideredVelocity() or
+	 * setRightWheelDesideredVelocity() depending on the wheel. We are
+	 * registered as listeners of wheel DOFs instead of connecting to their
+	 * signals because this is called at every step
+	 * \param dof the DOF of the wheel
+	 * \param wishVel the desidered velocity (in radiants per second)
+	 */
+	virtual void dofChangedDesiredVelocity(PhyDOF* dof, real wishVel);
+
 	/**
 	 * \brief The function called when the transformation matrix of the
 	 *        robot is changed
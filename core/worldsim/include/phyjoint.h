@@ -30,6 +30,7 @@
 #include "wmatrix.h"
 #include "wquaternion.h"
 #include <QObject>
+#include <QVector>
 
 #include <vector>
 
@@ -41,6 +42,7 @@ class PhyObjectPrivate;
 class WorldPrivate;
 class Motor;
 class RenderPhyJoint;
+class PhyDOF;
 
 /**
  * \brief The shared data for a PhyDOF
@@ -181,13 +183,127 @@ public:
 	real maxForce;
 };
 
+/**
+ * \brief The interface for direct listeners of changes in a PhyDOF
+ *
+ * Objects implementing this interface can be registered on a PhyDOF with
+ * PhyDOF::addListener() to be notified of changes in the status of the DOF.
+ * Functions are called directly by the setters of PhyDOF, so this is much
+ * cheaper than connecting to the signals of PhyDOF. This should be used by
+ * code that needs notifications at every step of the simulation (e.g. robots
+ * moving wheels in kinematic mode), while signals are still available for
+ * other observers (e.g. GUIs). All functions have an empty default
+ * implementation, override only the ones you need. Listeners are called in
+ * the thread calling the PhyDOF setters
+ */
+class SALSA_WSIM_API PhyDOFListener
+{
+public:
+	/**
+	 * \brief Destructor
+	 */
+	virtual ~PhyDOFListener()
+	{
+	}
+
+	/**
+	 * \brief Called when a force/torque is applied
+	 *
+	 * \param dof the DOF that changed
+	 * \param force the force/torque applied
+	 */
+	virtual void dofAppliedForce(PhyDOF* dof, real force)
+	{
+		Q_UNUSED(dof)
+		Q_UNUSED(force)
+	}
+
+	/**
+	 * \brief Called when the desired position changes
+	 *
+	 * \param dof the DOF that changed
+	 * \param wishPos the new desired position
+	 */
+	virtual void dofChangedDesiredPosition(PhyDOF* dof, real wishPos)
+	{
+		Q_UNUSED(dof)
+		Q_UNUSED(wishPos)
+	}
+
+	/**
+	 * \brief Called when the desired velocity changes
+	 *
+	 * \param dof the DOF that changed
+	 * \param wishVel the new desired velocity
+	 */
+	virtual void dofChangedDesiredVelocity(PhyDOF* dof, real wishVel)
+	{
+		Q_UNUSED(dof)
+		Q_UNUSED(wishVel)
+	}
+
+	/**
+	 * \brief Called when the position changes
+	 *
+	 * \param dof the DOF that changed
+	 * \param newPos the new position
+	 */
+	virtual void dofChangedPosition(PhyDOF* dof, real newPos)
+	{
+		Q_UNUSED(dof)
+		Q_UNUSED(newPos)
+	}
+
+	/**
+	 * \brief Called when the velocity changes
+	 *
+	 * \param dof the DOF that changed
+	 * \param newVel the new velocity
+	 */
+	virtual void dofChangedVelocity(PhyDOF* dof, real newVel)
+	{
+		Q_UNUSED(dof)
+		Q_UNUSED(newVel)
+	}
+
+	/**
+	 * \brief Called when the stiffness changes
+	 *
+	 * \param dof the DOF that changed
+	 * \param newStiff the new stiffness
+	 */
+	virtual void dofChangedStiffness(PhyDOF* dof, real newStiff)
+	{
+		Q_UNUSED(dof)
+		Q_UNUSED(newStiff)
+	}
+
+	/**
+	 * \brief Called when the limits change
+	 *
+	 * \param dof the DOF that changed
+	 * \param loLimit the new lower limit
+	 * \param hiLimit the new upper limit
+	 */
+	virtual void dofChangedLimits(PhyDOF* dof, real loLimit, real hiLimit)
+	{
+		Q_UNUSED(dof)
+		Q_UNUSED(loLimit)
+		Q_UNUSED(hiLimit)
+	}
+};
+
 /**
  * \brief PhyDOF class
  *
  * Model a single degree of freedom of a joint. This is a subclass of QObject,
  * it defines signals to which to connect to be notified of changes in the
- * status of a joint. Constructor and destructor are private because objects of
- * this kind are only created and destroyed by PhyJoint
+ * status of a joint. Code that needs to be notified at every step should
+ * register a PhyDOFListener instead (see addListener()), which avoids the
+ * overhead of signal dispatch. When there are no listeners and no
+ * connections to signals, setters only pay the cost of an empty check.
+ * Constructor and destructor are private because objects of this kind are
+ * only created and destroyed by PhyJoint
  */
 class SALSA_WSIM_API PhyDOF : public QObject
 {
@@ -217,6 +333,7 @@ private:
 	PhyDOF(PhyJoint* parent, PhyDOFShared* shared, wVector axis, wVector centre, bool translate)
 		: m_parent(parent)
 		, m_shared(shared)
+		, m_listeners()
 	{
 		m_shared->axis = axis;
 		m_shared->centre = centre;
@@ -233,6 +350,31 @@ private:
 	}
 
 public:
+	/**
+	 * \brief Adds a listener of changes of this DOF
+	 *
+	 * The listener is not owned by the DOF and must be removed with
+	 * removeListener() if it is destroyed before the DOF. Adding the same
+	 * listener twice has no effect
+	 * \param listener the listener to add
+	 */
+	void addListener(PhyDOFListener* listener)
+	{
+		if (!m_listeners.contains(listener)) {
+			m_listeners.append(listener);
+		}
+	}
+
+	/**
+	 * \brief Removes a listener of changes of this DOF
+	 *
+	 * \param listener the listener to remove
+	 */
+	void removeListener(PhyDOFListener* listener)
+	{
+		m_listeners.removeAll(listener);
+	}
+
 	/**
 	 * \brief Switches the motor off
 	 */
@@ -374,6 +516,9 @@ public:
 	{
 		// Clamp newstiff between 0 and 0.99
 		m_shared->stiffness = ramp(0.0f, 0.99f, newStiff);
+		for (int i = 0; i < m_listeners.size(); i++) {
+			m_listeners[i]->dofChangedStiffness(this, m_shared->stiffness);
+		}
 		emit changedStiffness(m_shared->stiffness);
 	}
 
@@ -505,6 +650,9 @@ public:
 	void setPosition(real newPos)
 	{
 		m_shared->position = newPos;
+		for (int i = 0; i < m_listeners.size(); i++) {
+			m_listeners[i]->dofChangedPosition(this, newPos);
+		}
 		emit changedPosition(newPos);
 	}
 
@@ -518,6 +666,9 @@ public:
 	void setVelocity(real newVel)
 	{
 		m_shared->velocity = newVel;
+		for (int i = 0; i < m_listeners.size(); i++) {
+			m_listeners[i]->dofChangedVelocity(this, newVel);
+		}
 		emit changedVelocity(newVel);
 	}
 
@@ -535,6 +686,9 @@ public slots:
 	{
 		m_shared->forcea = force;
 		m_shared->motionMode = PhyDOFShared::Force;
+		for (int i = 0; i < m_listeners.size(); i++) {
+			m_listeners[i]->dofAppliedForce(this, force);
+		}
 		emit appliedForce(force);
 	}
 
@@ -548,6 +702,9 @@ public slots:
 	{
 		m_shared->desiredVel = wishVel;
 		m_shared->motionMode = PhyDOFShared::Velocity;
+		for (int i = 0; i < m_listeners.size(); i++) {
+			m_listeners[i]->dofChangedDesiredVelocity(this, wishVel);
+		}
 		emit changedDesiredVelocity(wishVel);
 	}
 
@@ -562,6 +719,9 @@ public slots:
 		real offset = (fabs(m_shared->hiLimit)-fabs(m_shared->loLimit))*0.005;
 		m_shared->desiredPos = ramp(m_shared->loLimit + offset, m_shared->hiLimit - offset, wishPos);
 		m_shared->motionMode = PhyDOFShared::Position;
+		for (int i = 0; i < m_listeners.size(); i++) {
+			m_listeners[i]->dofChangedDesiredPosition(this, m_shared->desiredPos);
+		}
 		emit changedDesiredPosition(m_shared->desiredPos);
 	}
 
@@ -593,6 +753,9 @@ public slots:
 		// Changes the current desired position to avoid to push to the limits
 		real offset = (fabs(hiLimit)-fabs(loLimit))*0.005;
 		m_shared->desiredPos = ramp(loLimit + offset, hiLimit - offset, m_shared->desiredPos);
+		for (int i = 0; i < m_listeners.size(); i++) {
+			m_listeners[i]->dofChangedLimits(this, loLimit, hiLimit);
+		}
 		emit changedLimits(loLimit, hiLimit);
 	};
 
@@ -658,6 +821,11 @@ private:
 	 */
 	PhyDOFShared* const m_shared;
 
+	/**
+	 * \brief The listeners of changes of this DOF
+	 */
+	QVector<PhyDOFListener*> m_listeners;
+
 	/**
 	 * \brief PhyJoint is friend to be able to create and destroy objects of
 	 *        this type
@@ -102,7 +102,7 @@ public:
  * allows to have slightly faster simulations when the traction sensor is used
  * but the possibility to attach two robots is not allowed
  */
-class SALSA_WSIM_API PhyMarXbot : public QObject, public WObject
+class SALSA_WSIM_API PhyMarXbot : public QObject, public WObject, protected PhyDOFListener
 {
 	Q_OBJECT
 
@@ -513,6 +513,18 @@ protected slots:
 	void setRightWheelDesideredVelocity(real velocity);
 
 protected:
+	/**
+	 * \brief Called when the desired velocity of a wheel changes
+	 *
+	 * This calls setLeftWheelDesideredVelocity() or
+	 * setRightWheelDesideredVelocity() depending on the wheel. We are
+	 * registered as listeners of wheel DOFs instead of connecting to their
+	 * signals because this is called at every step
+	 * \param dof the DOF of the wheel
+	 * \param wishVel the desidered velocity (in radiants per second)
+	 */
+	virtual void dofChangedDesiredVelocity(PhyDOF* dof, real wishVel);
+
 	/**
 	 * \brief The function called when the transformation matrix of the
 	 *        robot is changed
@@ -404,6 +404,16 @@ protected:
 	 */
 	virtual void changedMatrix();
 
+	/**
+	 * \brief Sends the transformation matrix of this object to the
+	 *        underlying physic object
+	 *
+	 * changedMatrix() calls this unless the world is in kinematic-only mode,
+	 * in which case World calls it only when needed (see
+	 * World::setKinematicOnly())
+	 */
+	void syncMatrixWithEngine();
+
 	/**
 	 * \brief Creates the objects needed by the underlying physics engine
 	 *
@@ -151,6 +151,58 @@ public:
 			return 1;
 		}
 	}
+
+	// An instance of this structure is passed to the NewtonWorldRayCast function
+	// as user data when casting rays of a RayCastBatch
+	struct WorldRayCastBatchCallbackUserData {
+		// Constructor
+		WorldRayCastBatchCallbackUserData(RayCastBatch& b, int r) :
+			batch(b),
+			ray(r),
+			hit(b.hit(r))
+		{
+		}
+
+		// The batch
+		const RayCastBatch& batch;
+
+		// The index of the ray being cast
+		const int ray;
+
+		// The closest hit of the ray
+		RayCastHit& hit;
+	};
+
+	// The NewtonWorldRayPrefilterCallback used when casting rays of a RayCastBatch. Ignored
+	// objects are discarded here, so that Newton doesn't compute intersections with them
+	static unsigned worldRayBatchPrefilterCallback(const NewtonBody* const body, const NewtonCollision* const /*collision*/, void* const userData)
+	{
+		WorldRayCastBatchCallbackUserData* data = (WorldRayCastBatchCallbackUserData*) userData;
+
+		return data->batch.isIgnored(data->ray, (PhyObject*) NewtonBodyGetUserData(body)) ? 0 : 1;
+	}
+
+	// The NewtonWorldRayFilterCallback used when casting rays of a RayCastBatch. This works
+	// like worldRayFilterCallback with onlyClosest set to true
+	static dFloat worldRayBatchFilterCallback(const NewtonBody* body, const dFloat* hitNormal, int /*collisionID*/, void* userData, dFloat intersectParam)
+	{
+		WorldRayCastBatchCallbackUserData* data = (WorldRayCastBatchCallbackUserData*) userData;
+
+		if ((data->hit.object == nullptr) || (intersectParam < data->hit.distance)) {
+			const wVector& start = data->batch.start(data->ray);
+			const wVector& end = data->batch.end(data->ray);
+
+			data->hit.object = (PhyObject*) NewtonBodyGetUserData(body);
+			data->hit.distance = intersectParam;
+			data->hit.position = start + (end - start).scale(intersectParam);
+			data->hit.normal.x = hitNormal[0];
+			data->hit.normal.y = hitNormal[1];
+			data->hit.normal.z = hitNormal[2];
+		}
+
+		// Newton will not look for intersection points further than this one
+		return intersectParam;
+	}
 };
 
 } // end namespace salsa
@@ -275,6 +275,19 @@ private:
 	 */
 	bool m_drawRealRay;
 
+	/**
+	 * \brief The batch with the rays of all active sensors
+	 *
+	 * All rays are cast at once in update(). This is kept to avoid
+	 * allocating memory at each update
+	 */
+	RayCastBatch m_rayCastBatch;
+
+	/**
+	 * \brief The index in m_rayCastBatch of the first ray of each sensor
+	 */
+	QVector<int> m_firstRay;
+
 	/**
 	 * \brief World is friend to be able to create us
 	 */
@@ -369,6 +382,19 @@ private:
 	 */
 	bool m_drawRealRay;
 
+	/**
+	 * \brief The batch with the rays of all active sensors
+	 *
+	 * All rays are cast at once in update(). This is kept to avoid
+	 * allocating memory at each update
+	 */
+	RayCastBatch m_rayCastBatch;
+
+	/**
+	 * \brief The index in m_rayCastBatch of the first ray of each sensor
+	 */
+	QVector<int> m_firstRay;
+
 	/**
 	 * \brief World is friend to be able to create us
 	 */
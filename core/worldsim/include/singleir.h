@@ -249,6 +249,30 @@ public:
 	 */
 	void update();
 
+	/**
+	 * \brief Adds the rays of this sensor to a batch of rays
+	 *
+	 * Rays are added in the global frame of reference, ignoring the object
+	 * this sensor is attached to. After the batch has been cast with
+	 * World::worldRayCastClosest(), call updateFromBatch() with the value
+	 * returned by this function. Use this instead of update() to cast the
+	 * rays of many sensors at once. Nothing is added if the sensor is not
+	 * valid
+	 * \param batch the batch to which rays are added
+	 * \return the index of the first ray of this sensor in the batch
+	 */
+	int appendRays(RayCastBatch& batch);
+
+	/**
+	 * \brief Updates the sensor reading from a batch of rays that has been
+	 *        cast
+	 *
+	 * \param batch the batch filled by appendRays() and cast with
+	 *              World::worldRayCastClosest()
+	 * \param firstRay the value returned by appendRays()
+	 */
+	void updateFromBatch(const RayCastBatch& batch, int firstRay);
+
 	/**
 	 * \brief Returns information about the last ray cast hit
 	 *
@@ -353,6 +377,13 @@ private:
 	 */
 	SharedDataWrapper<Shared> m_shared;
 
+	/**
+	 * \brief The batch used by update()
+	 *
+	 * This is kept to avoid allocating memory at each update
+	 */
+	RayCastBatch m_batch;
+
 	/**
 	 * \brief World is friend to be able to create and destroy this object
 	 */
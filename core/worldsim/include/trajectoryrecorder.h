@@ -0,0 +1,525 @@
+/********************************************************************************
+ *  SALSA                                                                       *
+ *  Copyright (C) 2007-2012                                                     *
+ *  Gianluca Massera <emmegian@yahoo.it>                                        *
+ *  Stefano Nolfi <stefano.nolfi@istc.cnr.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                         *
+ *                                                                              *
+ *  This program is free software; you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by        *
+ *  the Free Software Foundation; either version 2 of the License, or           *
+ *  (at your option) any later version.                                         *
+ *                                                                              *
+ *  This program is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+ *  GNU General Public License for more details.                                *
+ *                                                                              *
+ *  You should have received a copy of the GNU General Public License           *
+ *  along with this program; if not, write to the Free Software                 *
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA  *
+ ********************************************************************************/
+
+#ifndef TRAJECTORYRECORDER_H
+#define TRAJECTORYRECORDER_H
+
+#include "worldsimconfig.h"
+#include "rendererscontainer.h"
+#include "wmatrix.h"
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace salsa {
+
+class World;
+class WObject;
+
+/**
+ * \brief A renderers container that records the trajectories of objects to a
+ *        binary file
+ *
+ * Instead of rendering, this container writes the pose of all WObjects in the
+ * world to a file at every step, together with the contacts and any array of
+ * values passed to recordValues() (e.g. sensor activations). The file can
+ * later be read with TrajectoryReader to replay the simulation or to export
+ * data for analysis. Create it with World::createRenderersContainer(), like
+ * any other renderers container.
+ *
+ * The file is made up of a header followed by chunks. Everything is written
+ * little endian, strings are a quint32 length followed by UTF-8 bytes and
+ * reals are written as 32 bits floats. The header is the "SALSATRJ" magic
+ * followed by the version as a quint32. Each chunk starts with a quint32 type
+ * and a quint32 payload length, so that readers can build an index of the file
+ * without decoding payloads. There are two types of chunks:
+ * 	- EntitiesChunk: the number of entities as a quint32 followed by their
+ * 	  names. Following frames refer to entities by their index in this list.
+ * 	  A new table is written every time an entity is added or removed;
+ * 	- FrameChunk: a quint8 which is 1 for keyframes, the time, the number of
+ * 	  poses followed by the poses (entity index and the 12 reals of the x,
+ * 	  y, z axes and the position of the matrix), the number of contacts
+ * 	  followed by the contacts (the indices of the two entities and the
+ * 	  contact point in world coordinates) and the number of arrays of values
+ * 	  followed by the arrays (name, number of values and the values).
+ * 	  Keyframes contain the poses of all entities, the other frames only the
+ * 	  poses that changed since the previous frame.
+ *
+ * As the file has no trailing index, a recording that is interrupted (e.g.
+ * because the process is killed) can still be read up to the last complete
+ * chunk
+ */
+class SALSA_WSIM_API TrajectoryRecorder : public AbstractRendererContainer
+{
+public:
+	/**
+	 * \brief The types of chunks in the file
+	 */
+	enum ChunkType {
+		EntitiesChunk = 1,
+		FrameChunk = 2
+	};
+
+	/**
+	 * \brief The version of the file format
+	 */
+	static const quint32 formatVersion = 1;
+
+protected:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param world the world we live in
+	 * \param filename the name of the file to write. If the file cannot be
+	 *                 opened a RuntimeUserException is thrown
+	 * \param keyframeInterval the number of frames between two keyframes.
+	 *                         Frames are reconstructed starting from the
+	 *                         previous keyframe, so this bounds the cost of
+	 *                         random access when reading
+	 */
+	TrajectoryRecorder(World* world, QString filename, int keyframeInterval = 100);
+
+	/**
+	 * \brief Destructor
+	 */
+	virtual ~TrajectoryRecorder();
+
+public:
+	/**
+	 * \brief Records the current state of the world
+	 *
+	 * This is called by the world at the end of every step
+	 */
+	virtual void update();
+
+	/**
+	 * \brief Adds an array of values to the next frame
+	 *
+	 * Values are written at the next call to update() and then discarded.
+	 * Calling this function more than once with the same name before
+	 * update() only keeps the last array
+	 * \param name the name of the array
+	 * \param values the values
+	 */
+	void recordValues(const QString& name, const QVector<real>& values);
+
+	/**
+	 * \brief Returns the name of the file we are writing
+	 *
+	 * \return the name of the file we are writing
+	 */
+	QString filename() const
+	{
+		return m_file.fileName();
+	}
+
+	/**
+	 * \brief Returns the number of frames written so far
+	 *
+	 * \return the number of frames written so far
+	 */
+	int numFrames() const
+	{
+		return m_numFrames;
+	}
+
+private:
+	/**
+	 * \brief Implement in subclasses to handle the case of a renderer being
+	 *        added
+	 *
+	 * \param renderer the renderer that has been added
+	 */
+	virtual void rendererAdded(RenderWEntity* renderer);
+
+	/**
+	 * \brief Implement in subclasses to handle the case of a renderer being
+	 *        removed
+	 *
+	 * \param renderer the renderer that is going to be deleted
+	 */
+	virtual void rendererToBeDeleted(RenderWEntity* renderer);
+
+	/**
+	 * \brief Implement in subclasses to handle the case of a texture being
+	 *        added
+	 *
+	 * \param name the name of the texture that has just been added
+	 */
+	virtual void textureAdded(const QString& name);
+
+	/**
+	 * \brief Implement in subclases to handle the case of a texture being
+	 *        removed
+	 *
+	 * \param name the name of the texture that is going to be deleted
+	 */
+	virtual void textureToBeDeleted(const QString& name);
+
+	/**
+	 * \brief Implement in subclasses to handle the case of world graphical
+	 *        information changes
+	 *
+	 * \param info the updated graphical information about the world
+	 */
+	virtual void worldGraphicalInfoChanged(const WorldGraphicalInfo& info);
+
+	/**
+	 * \brief Rebuilds the list of objects and writes a new table of
+	 *        entities
+	 */
+	void writeEntitiesTable();
+
+	/**
+	 * \brief Writes a chunk with the given type and the content of
+	 *        m_payload
+	 *
+	 * \param type the type of chunk
+	 */
+	void writeChunk(ChunkType type);
+
+	/**
+	 * \brief The file we write to
+	 */
+	QFile m_file;
+
+	/**
+	 * \brief The number of frames between two keyframes
+	 */
+	const int m_keyframeInterval;
+
+	/**
+	 * \brief The number of frames written so far
+	 */
+	int m_numFrames;
+
+	/**
+	 * \brief The number of frames written since the last keyframe
+	 */
+	int m_framesSinceKeyframe;
+
+	/**
+	 * \brief True if entities have been added or removed since the last
+	 *        table of entities was written
+	 */
+	bool m_entitiesChanged;
+
+	/**
+	 * \brief The objects we record, in the same order as in the last table
+	 *        of entities
+	 */
+	QVector<const WObject*> m_objects;
+
+	/**
+	 * \brief The index of each recorded object in m_objects
+	 */
+	QHash<const WEntity*, quint32> m_objectsIndices;
+
+	/**
+	 * \brief The last pose written for each object in m_objects
+	 */
+	QVector<wMatrix> m_lastPoses;
+
+	/**
+	 * \brief The arrays of values to write with the next frame
+	 */
+	QMap<QString, QVector<real> > m_values;
+
+	/**
+	 * \brief The buffer used to build the payload of chunks
+	 *
+	 * This is a member so that its memory is reused
+	 */
+	QByteArray m_payload;
+
+	/**
+	 * \brief World is friend to be able to create and delete us
+	 */
+	friend class World;
+};
+
+/**
+ * \brief The class reading files written by TrajectoryRecorder
+ *
+ * The file is memory mapped and indexed when the object is created, then
+ * frames are decoded on request with readFrame(). Reading frames
+ * sequentially only decodes one frame at a time, while random access decodes
+ * frames starting from the closest preceding keyframe. Once a frame has been
+ * read it can be copied to the objects of a world (see applyToWorld()) so
+ * that existing renderers (e.g. a RenderWorld) show the recorded simulation
+ * without running the dynamics again. Use exportCSV() to convert the poses to
+ * a format readable by analysis tools
+ */
+class SALSA_WSIM_API TrajectoryReader
+{
+public:
+	/**
+	 * \brief A recorded contact
+	 */
+	struct RecordedContact {
+		/**
+		 * \brief The index of the first entity in entities()
+		 */
+		int object;
+
+		/**
+		 * \brief The index of the second entity in entities()
+		 */
+		int collide;
+
+		/**
+		 * \brief The contact point in world coordinates
+		 */
+		wVector worldPos;
+	};
+
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * If the file cannot be opened or is not a valid trajectory file, a
+	 * RuntimeUserException is thrown. An incomplete last chunk is ignored
+	 * \param filename the name of the file to read
+	 */
+	TrajectoryReader(QString filename);
+
+	/**
+	 * \brief Destructor
+	 */
+	~TrajectoryReader();
+
+	/**
+	 * \brief Returns the number of frames in the file
+	 *
+	 * \return the number of frames in the file
+	 */
+	int numFrames() const
+	{
+		return m_frames.size();
+	}
+
+	/**
+	 * \brief Decodes a frame
+	 *
+	 * After a successful call the accessors of this class return the data
+	 * of the frame
+	 * \param frame the index of the frame to read
+	 * \return false if frame is out of range
+	 */
+	bool readFrame(int frame);
+
+	/**
+	 * \brief Returns the index of the frame that was last read
+	 *
+	 * \return the index of the frame that was last read or -1 if no frame
+	 *         has been read
+	 */
+	int currentFrame() const
+	{
+		return m_currentFrame;
+	}
+
+	/**
+	 * \brief Returns the time of the current frame
+	 *
+	 * \return the time of the current frame
+	 */
+	real time() const
+	{
+		return m_time;
+	}
+
+	/**
+	 * \brief Returns the names of the entities of the current frame
+	 *
+	 * \return the names of the entities of the current frame
+	 */
+	const QStringList& entities() const
+	{
+		return m_entities;
+	}
+
+	/**
+	 * \brief Returns the poses of the entities of the current frame
+	 *
+	 * \return the poses of the entities, in the same order as entities()
+	 */
+	const QVector<wMatrix>& poses() const
+	{
+		return m_poses;
+	}
+
+	/**
+	 * \brief Returns the contacts of the current frame
+	 *
+	 * \return the contacts of the current frame
+	 */
+	const QVector<RecordedContact>& contacts() const
+	{
+		return m_contacts;
+	}
+
+	/**
+	 * \brief Returns the arrays of values of the current frame
+	 *
+	 * \return the arrays of values of the current frame
+	 */
+	const QMap<QString, QVector<real> >& values() const
+	{
+		return m_values;
+	}
+
+	/**
+	 * \brief Sets the pose of the objects in a world to the ones of the
+	 *        current frame
+	 *
+	 * Objects are matched by name. If more than one entity has the same
+	 * name, they are matched in the order in which they appear in the file
+	 * and in World::entities(), so give unique names to objects you want to
+	 * replay. Entities that are not found in the world are ignored. Using a
+	 * world in kinematic-only mode (see World::setKinematicOnly()) avoids
+	 * paying for the dynamics while replaying
+	 * \param world the world whose objects are moved
+	 * \return the number of objects whose pose has been set
+	 */
+	int applyToWorld(World* world) const;
+
+	/**
+	 * \brief Writes the poses of all frames to a CSV file
+	 *
+	 * The file has a row for each entity in each frame with the following
+	 * columns: frame, time, entity name, position (x, y, z) and the x, y and
+	 * z axes of the rotation matrix. This changes the current frame
+	 * \param filename the name of the file to write
+	 * \return false in case of errors
+	 */
+	bool exportCSV(QString filename);
+
+private:
+	/**
+	 * \brief The position of a frame in the file
+	 */
+	struct FrameIndex {
+		/**
+		 * \brief The offset of the payload of the frame
+		 */
+		qint64 offset;
+
+		/**
+		 * \brief The length of the payload of the frame
+		 */
+		quint32 length;
+
+		/**
+		 * \brief The index of the table of entities for the frame
+		 */
+		int entitiesTable;
+
+		/**
+		 * \brief The index of the keyframe preceding this one (or this
+		 *        frame if it is a keyframe)
+		 */
+		int keyframe;
+	};
+
+	/**
+	 * \brief Decodes the frame with the given index, applying poses to
+	 *        m_poses
+	 *
+	 * \param frame the index of the frame to decode
+	 */
+	void decodeFrame(int frame);
+
+	/**
+	 * \brief The file we read
+	 */
+	QFile m_file;
+
+	/**
+	 * \brief The mapped content of the file
+	 */
+	const uchar* m_data;
+
+	/**
+	 * \brief The size of the mapped content
+	 */
+	qint64 m_size;
+
+	/**
+	 * \brief The tables of entities in the file
+	 */
+	QVector<QStringList> m_entitiesTables;
+
+	/**
+	 * \brief The index of frames
+	 */
+	QVector<FrameIndex> m_frames;
+
+	/**
+	 * \brief The current frame
+	 */
+	int m_currentFrame;
+
+	/**
+	 * \brief The time of the current frame
+	 */
+	real m_time;
+
+	/**
+	 * \brief The names of entities in the current frame
+	 */
+	QStringList m_entities;
+
+	/**
+	 * \brief The poses of entities in the current frame
+	 */
+	QVector<wMatrix> m_poses;
+
+	/**
+	 * \brief The contacts in the current frame
+	 */
+	QVector<RecordedContact> m_contacts;
+
+	/**
+	 * \brief The arrays of values in the current frame
+	 */
+	QMap<QString, QVector<real> > m_values;
+
+private:
+	/**
+	 * \brief Copy constructor. Here to prevent usage
+	 */
+	TrajectoryReader(const TrajectoryReader& other);
+
+	/**
+	 * \brief Copy operator. Here to prevent usage
+	 */
+	TrajectoryReader& operator=(const TrajectoryReader& other);
+};
+
+} // end namespace salsa
+
+#endif
@@ -38,8 +38,10 @@
 #include <QColor>
 #include <QImage>
 #include <QMap>
+#include <QByteArray>
 #include "simpletimer.h"
 #include "worldhelpers.h"
+#include "updatetrigger.h"
 
 namespace salsa {
 
@@ -121,6 +123,39 @@ public:
 	 */
 	void resetElapsedTime();
 
+	/**
+	 * \brief Saves the dynamical state of the world
+	 *
+	 * The state contains the elapsed time and, for each PhyObject, the
+	 * transformation matrix, the linear and angular velocities, the
+	 * accumulated force and torque and the kinematic and static flags. For
+	 * each PhyJoint it contains whether the joint is enabled and the status
+	 * of all its DOFs (motion mode, desired position and velocity, applied
+	 * force, position and velocity). The state can be restored with
+	 * restoreState() to start again from this point without recreating
+	 * entities. The returned data uses the in-memory representation of
+	 * values, it is not meant to be stored on file and read by a different
+	 * build
+	 * \return the state of the world
+	 */
+	QByteArray saveState();
+
+	/**
+	 * \brief Restores a state saved with saveState()
+	 *
+	 * Entities are modified in place, nothing is created or destroyed, so
+	 * the world must contain the same physical entities, created in the
+	 * same order, that it had when the state was saved. The state of
+	 * entities that is not listed in saveState() (e.g. the internal status
+	 * of robots) is not changed. All contacts are removed. DOFs emit the
+	 * usual signals when their status is restored, so that objects
+	 * connected to them are updated. If the state doesn't match the world,
+	 * nothing is changed
+	 * \param state the state to restore
+	 * \return false if the state doesn't match the entities in the world
+	 */
+	bool restoreState(const QByteArray& state);
+
 	/**
 	 * \brief Sets the time step in seconds
 	 *
@@ -217,6 +252,20 @@ public:
 	 */
 	const ContactMap& contacts() const;
 
+	/**
+	 * \brief Checks whether the contact map has changed since the last
+	 *        time the checker was used
+	 *
+	 * This can be used to avoid copying the contact map when it has not
+	 * changed (e.g. when nothing is colliding or in kinematic-only mode)
+	 * \param checker the checker to use
+	 * \return true if the contact map has changed
+	 */
+	bool contactsUpdateNeeded(UpdateCheckerLong& checker) const
+	{
+		return checker.updateNeeded(m_contactsChanged);
+	}
+
 	/**
 	 * \brief Calculates the two closest points between the two objects
 	 *
@@ -300,6 +349,17 @@ public:
 	 */
 	RayCastHitVector worldRayCast(wVector start, wVector end, bool onlyClosest, const QSet<PhyObject*>& ignoredObjs = QSet<PhyObject*>());
 
+	/**
+	 * \brief Casts all rays in the batch, finding the closest hit of each
+	 *
+	 * This is equivalent to calling worldRayCast() with onlyClosest set to
+	 * true for each ray of the batch but it doesn't allocate memory:
+	 * ignored objects are skipped before intersections are computed and the
+	 * closest hits are written in the batch itself (see RayCastBatch::hit())
+	 * \param batch the batch of rays to cast. Hits are stored here
+	 */
+	void worldRayCastClosest(RayCastBatch& batch);
+
 	/**
 	 * \brief Returns the MaterialDB object managing World's materials
 	 *
@@ -336,11 +396,52 @@ public:
 	 * \brief Sets the number of threads used internally by the physics
 	 *        engine
 	 *
+	 * The value is kept when the world is reset. Note that the results of
+	 * the simulation can change with the number of threads
 	 * \param numThreads the number of threads used internally by the
 	 *                   physics engine
 	 */
 	void setMultiThread(int numThreads);
 
+	/**
+	 * \brief Returns the number of threads used internally by the physics
+	 *        engine
+	 *
+	 * \return the number of threads used internally by the physics engine
+	 */
+	int multiThread() const
+	{
+		return m_numThreads;
+	}
+
+	/**
+	 * \brief Sets whether the world only contains kinematic objects
+	 *
+	 * In kinematic-only mode the physics engine doesn't simulate dynamics:
+	 * advance() only calls preUpdate() and postUpdate() on entities (which
+	 * is where kinematic robots move) and doesn't perform the physical
+	 * simulation step. Moreover changes of the position of objects are not
+	 * immediately sent to the physics engine, they are only sent before
+	 * functions that need them (worldRayCast() and worldRayCastClosest())
+	 * are called. This is much faster for simulations with only kinematic
+	 * robots (e.g. wheeled robots in an arena whose collisions are handled
+	 * by Arena). Dynamic objects do not move in this mode and contacts()
+	 * is always empty
+	 * \param kinematicOnly if true the world only contains kinematic objects
+	 */
+	void setKinematicOnly(bool kinematicOnly);
+
+	/**
+	 * \brief Returns true if the world is in kinematic-only mode
+	 *
+	 * \return true if the world is in kinematic-only mode
+	 * \see setKinematicOnly()
+	 */
+	bool isKinematicOnly() const
+	{
+		return m_kinematicOnly;
+	}
+
 	/**
 	 * \brief Sets the size of the world
 	 *
@@ -376,8 +477,9 @@ public:
 	 * \brief Does a step of the World
 	 *
 	 * \note The sequence of actions here is: call preUpdate on all
-	 *       Entities; perform the actual physical simulation step; call
-	 *       postUpdate on all entities
+	 *       Entities; perform the actual physical simulation step (unless
+	 *       the world is in kinematic-only mode); call postUpdate on all
+	 *       entities
 	 */
 	void advance();
 
@@ -518,6 +620,15 @@ private:
 	// createRenderersContainer()
 	bool checkCreatingFromWorldAndResetFlag();
 
+	// Sends to the physics engine the position of objects moved in
+	// kinematic-only mode
+	void syncMovedObjects();
+
+	// Reads a state saved by saveState(). If apply is false the state is
+	// only checked against entities in the world, otherwise it is also
+	// restored. Returns false if the state doesn't match the world
+	bool readState(const QByteArray& state, bool apply);
+
 	// This function is called at the end of the creation of an entity to
 	// perform type-specific initialization. This implementation does
 	// nothing, only overloadings do useful things. This is not declared
@@ -621,6 +732,9 @@ private:
 	// The map of contacts
 	ContactMap m_cmap;
 
+	// The trigger of changes in the map of contacts
+	UpdateTriggerLong m_contactsChanged;
+
 	// The type for a couple of objects that doesn't collide each other
 	typedef QPair<PhyObject*, PhyObject*> NObj;
 
@@ -633,6 +747,16 @@ private:
 	// This is true if we have been initialized
 	bool m_isInitialized;
 
+	// If true the world is in kinematic-only mode (see setKinematicOnly())
+	bool m_kinematicOnly;
+
+	// The number of threads of the physics engine (see setMultiThread())
+	int m_numThreads;
+
+	// The objects whose position changed in kinematic-only mode and has not
+	// been sent to the physics engine yet
+	QSet<PhyObject*> m_movedObjects;
+
 	// Engine encapsulation
 	std::unique_ptr<WorldPrivate> m_priv;
 
@@ -227,6 +227,195 @@ public:
 /*! Vector of RayCastHit */
 typedef QVector<RayCastHit> RayCastHitVector;
 
+/**
+ * \brief A batch of rays cast together by World::worldRayCastClosest()
+ *
+ * This contains the start and end points of a set of rays (in the global
+ * frame of reference), the objects to ignore and, after the cast, the closest
+ * hit of each ray. Each ray can have its own ignored object (e.g. the object
+ * the sensor is attached to) in addition to the objects ignored by all rays.
+ * Clearing the batch does not release memory, so the same instance can be
+ * filled and cast at every step without allocations
+ */
+class SALSA_WSIM_TEMPLATE RayCastBatch {
+public:
+	/**
+	 * \brief Constructor
+	 */
+	RayCastBatch()
+		: m_numRays(0)
+		, m_starts()
+		, m_ends()
+		, m_rayIgnoredObjs()
+		, m_ignoredObjs()
+		, m_hits()
+	{
+	}
+
+	/**
+	 * \brief Removes all rays
+	 *
+	 * Objects ignored by all rays are kept, use clearIgnoredObjects() to
+	 * remove them
+	 */
+	void clear()
+	{
+		m_numRays = 0;
+	}
+
+	/**
+	 * \brief Adds a ray to the batch
+	 *
+	 * \param start the starting point of the ray (in the global frame of
+	 *              reference)
+	 * \param end the ending point of the ray (in the global frame of
+	 *            reference)
+	 * \param ignoredObj an object that is ignored by this ray only. Can be
+	 *                   nullptr
+	 * \return the index of the ray in the batch
+	 */
+	int addRay(const wVector& start, const wVector& end, const PhyObject* ignoredObj = nullptr)
+	{
+		if (m_numRays == m_starts.size()) {
+			m_starts.append(start);
+			m_ends.append(end);
+			m_rayIgnoredObjs.append(ignoredObj);
+			m_hits.append(RayCastHit());
+		} else {
+			m_starts[m_numRays] = start;
+			m_ends[m_numRays] = end;
+			m_rayIgnoredObjs[m_numRays] = ignoredObj;
+		}
+
+		return m_numRays++;
+	}
+
+	/**
+	 * \brief Adds an object that is ignored by all rays
+	 *
+	 * \param obj the object to ignore
+	 */
+	void addIgnoredObject(const PhyObject* obj)
+	{
+		if (!m_ignoredObjs.contains(obj)) {
+			m_ignoredObjs.append(obj);
+		}
+	}
+
+	/**
+	 * \brief Removes all objects ignored by all rays
+	 */
+	void clearIgnoredObjects()
+	{
+		m_ignoredObjs.clear();
+	}
+
+	/**
+	 * \brief Returns the number of rays in the batch
+	 *
+	 * \return the number of rays in the batch
+	 */
+	int size() const
+	{
+		return m_numRays;
+	}
+
+	/**
+	 * \brief Returns the starting point of the i-th ray
+	 *
+	 * \param i the index of the ray
+	 * \return the starting point of the i-th ray
+	 */
+	const wVector& start(int i) const
+	{
+		return m_starts[i];
+	}
+
+	/**
+	 * \brief Returns the ending point of the i-th ray
+	 *
+	 * \param i the index of the ray
+	 * \return the ending point of the i-th ray
+	 */
+	const wVector& end(int i) const
+	{
+		return m_ends[i];
+	}
+
+	/**
+	 * \brief Returns true if the i-th ray ignores the given object
+	 *
+	 * The list of objects ignored by all rays is scanned linearly: it is
+	 * expected to be very short
+	 * \param i the index of the ray
+	 * \param obj the object to check
+	 * \return true if the i-th ray ignores obj
+	 */
+	bool isIgnored(int i, const PhyObject* obj) const
+	{
+		return (m_rayIgnoredObjs[i] == obj) || m_ignoredObjs.contains(obj);
+	}
+
+	/**
+	 * \brief Returns the closest hit of the i-th ray
+	 *
+	 * This is only valid after the batch has been cast. If the ray hits
+	 * nothing, the object is nullptr and the distance is 1.0
+	 * \param i the index of the ray
+	 * \return the closest hit of the i-th ray
+	 */
+	const RayCastHit& hit(int i) const
+	{
+		return m_hits[i];
+	}
+
+	/**
+	 * \brief Returns the closest hit of the i-th ray (non-const version)
+	 *
+	 * This is used by World to fill the result of the cast
+	 * \param i the index of the ray
+	 * \return the closest hit of the i-th ray
+	 */
+	RayCastHit& hit(int i)
+	{
+		return m_hits[i];
+	}
+
+private:
+	/**
+	 * \brief The number of rays in the batch
+	 *
+	 * Vectors below can be larger than this, elements past m_numRays are
+	 * unused
+	 */
+	int m_numRays;
+
+	/**
+	 * \brief The starting points of rays
+	 */
+	QVector<wVector> m_starts;
+
+	/**
+	 * \brief The ending points of rays
+	 */
+	QVector<wVector> m_ends;
+
+	/**
+	 * \brief The object ignored by each ray (can be nullptr)
+	 */
+	QVector<const PhyObject*> m_rayIgnoredObjs;
+
+	/**
+	 * \brief The objects ignored by all rays
+	 */
+	QVector<const PhyObject*> m_ignoredObjs;
+
+	/**
+	 * \brief The closest hit of each ray
+	 */
+	RayCastHitVector m_hits;
+};
+
 /**
  * \brief The class to specify the type of objects to create
  *
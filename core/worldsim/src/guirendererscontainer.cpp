@@ -164,10 +164,17 @@ void GUIRenderersContainer::sendData()
 	}
 	d->worldGraphicalInfoChanged = m_worldGraphicalInfoChanged;
 
-	// Also copying the contact map
-	d->contacts = world()->contacts();
+	// Copying the contact map only if it has changed since the last time this datum was used
+	if (world()->contactsUpdateNeeded(d->contactsChecker)) {
+		d->contacts = world()->contacts();
+	}
+
+	// Also copying time information
+	d->timeStep = world()->timeStep();
+	d->elapsedTime = world()->elapsedTime();
 
-	// Now copying data
+	// Now copying data. Proxies only copy the shared data of entities that changed since the
+	// last time this datum was used
 	foreach (AbstractRenderingProxy* p, d->renderingProxies) {
 		p->copyDataFromWEntity();
 	}
@@ -211,9 +211,9 @@ PhyKhepera::PhyKhepera(World* world, SharedDataWrapper<Shared> shared, QString n
 	const real maxAngularSpeed = 1.1f * 2.0f * PI_GRECO;
 	m_wheelsCtrl->setSpeedLimits(-maxAngularSpeed, -maxAngularSpeed, maxAngularSpeed, maxAngularSpeed);
 
-	// Connecting wheels speed signals to be able to move the robot when in kinematic
-	connect(m_wheelJoints[0]->dofs()[0], SIGNAL(changedDesiredVelocity(real)), this, SLOT(setRightWheelDesideredVelocity(real)));
-	connect(m_wheelJoints[1]->dofs()[0], SIGNAL(changedDesiredVelocity(real)), this, SLOT(setLeftWheelDesideredVelocity(real)));
+	// Listening to changes of wheels speed to be able to move the robot when in kinematic
+	m_wheelJoints[0]->dofs()[0]->addListener(this);
+	m_wheelJoints[1]->dofs()[0]->addListener(this);
 
 	// Creating the proximity IR sensors
 	QVector<SingleIR::InitParams> sensors;
@@ -354,6 +354,15 @@ void PhyKhepera::setRightWheelDesideredVelocity(real velocity)
 	m_shared.getModifiableShared()->rightWheelVelocity = velocity;
 }
 
+void PhyKhepera::dofChangedDesiredVelocity(PhyDOF* dof, real wishVel)
+{
+	if (dof->joint() == m_wheelJoints[0]) {
+		setRightWheelDesideredVelocity(wishVel);
+	} else if (dof->joint() == m_wheelJoints[1]) {
+		setLeftWheelDesideredVelocity(wishVel);
+	}
+}
+
 void PhyKhepera::changedMatrix()
 {
 	wMatrix tm = matrix();
@@ -213,9 +213,9 @@ PhyMarXbot::PhyMarXbot(World* world, SharedDataWrapper<Shared> shared, QString n
 #endif
 	m_wheelsCtrl->setSpeedLimits( -10.0, -10.0, 10.0, 10.0 );
 
-	// Connecting wheels speed signals to be able to move the robot when in kinematic
-	connect(m_wheelJoints[0]->dofs()[0], SIGNAL(changedDesiredVelocity(real)), this, SLOT(setRightWheelDesideredVelocity(real)));
-	connect(m_wheelJoints[1]->dofs()[0], SIGNAL(changedDesiredVelocity(real)), this, SLOT(setLeftWheelDesideredVelocity(real)));
+	// Listening to changes of wheels speed to be able to move the robot when in kinematic
+	m_wheelJoints[0]->dofs()[0]->addListener(this);
+	m_wheelJoints[1]->dofs()[0]->addListener(this);
 
 	// Creating the proximity IR sensors
 	QVector<SingleIR::InitParams> sensors;
@@ -526,6 +526,15 @@ void PhyMarXbot::setRightWheelDesideredVelocity(real velocity)
 	m_shared.getModifiableShared()->rightWheelVelocity = velocity;
 }
 
+void PhyMarXbot::dofChangedDesiredVelocity(PhyDOF* dof, real wishVel)
+{
+	if (dof->joint() == m_wheelJoints[0]) {
+		setRightWheelDesideredVelocity(wishVel);
+	} else if (dof->joint() == m_wheelJoints[1]) {
+		setLeftWheelDesideredVelocity(wishVel);
+	}
+}
+
 void PhyMarXbot::changedMatrix() {
 	wMatrix tm = matrix();
 	m_base->setMatrix( tm );
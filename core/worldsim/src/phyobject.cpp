@@ -430,6 +430,23 @@ void PhyObject::changedMatrix()
 		return;
 	}
 
+	// In kinematic-only mode the world sends the matrix to the engine only when needed
+	if (world()->isKinematicOnly()) {
+		world()->m_movedObjects.insert(this);
+		return;
+	}
+
+	syncMatrixWithEngine();
+#endif
+}
+
+void PhyObject::syncMatrixWithEngine()
+{
+#ifdef WORLDSIM_USE_NEWTON
+	if ((m_priv == nullptr) || (m_priv->body == nullptr)) {
+		return;
+	}
+
 	//qDebug() << "SYNC POSITION" << tm[3][0] << tm[3][1] << tm[3][2];
 	NewtonBodySetMatrix( m_priv->body, &(m_shared->tm[0][0]) );
 #endif
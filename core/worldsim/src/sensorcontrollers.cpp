@@ -60,6 +60,8 @@ SimulatedIRProximitySensorController::SimulatedIRProximitySensorController(World
 	, m_drawSensor(false)
 	, m_drawRay(false)
 	, m_drawRealRay(false)
+	, m_rayCastBatch()
+	, m_firstRay(sensors.size())
 {
 	// Creating sensors
 	for (int i = 0; i < m_sensors.size(); ++i) {
@@ -77,9 +79,18 @@ SimulatedIRProximitySensorController::~SimulatedIRProximitySensorController()
 
 void SimulatedIRProximitySensorController::update()
 {
+	// Casting the rays of all active sensors at once
+	m_rayCastBatch.clear();
 	for (int i = 0; i < m_sensors.size(); i++) {
 		if (m_activeSensor[i]) {
-			m_sensors[i]->update();
+			m_firstRay[i] = m_sensors[i]->appendRays(m_rayCastBatch);
+		}
+	}
+	world()->worldRayCastClosest(m_rayCastBatch);
+
+	for (int i = 0; i < m_sensors.size(); i++) {
+		if (m_activeSensor[i]) {
+			m_sensors[i]->updateFromBatch(m_rayCastBatch, m_firstRay[i]);
 			// If there was no hit, distance is 1.0 and activation 0.0
 			m_activations[i] = 1.0 - m_sensors[i]->getRayCastHit().distance;
 		} else {
@@ -117,6 +128,8 @@ SimulatedIRGroundSensorController::SimulatedIRGroundSensorController(World* worl
 	, m_drawSensor(false)
 	, m_drawRay(false)
 	, m_drawRealRay(false)
+	, m_rayCastBatch()
+	, m_firstRay(sensors.size())
 {
 	// Creating sensors
 	for (int i = 0; i < m_sensors.size(); ++i) {
@@ -133,9 +146,18 @@ SimulatedIRGroundSensorController::~SimulatedIRGroundSensorController()
 
 void SimulatedIRGroundSensorController::update()
 {
+	// Casting the rays of all active sensors at once
+	m_rayCastBatch.clear();
+	for (int i = 0; i < m_sensors.size(); i++) {
+		if (m_activeSensor[i]) {
+			m_firstRay[i] = m_sensors[i]->appendRays(m_rayCastBatch);
+		}
+	}
+	world()->worldRayCastClosest(m_rayCastBatch);
+
 	for (int i = 0; i < m_sensors.size(); i++) {
 		if (m_activeSensor[i]) {
-			m_sensors[i]->update();
+			m_sensors[i]->updateFromBatch(m_rayCastBatch, m_firstRay[i]);
 
 			// Now taking the color of the nearest solid, converting to HSL and taking
 			// normalized lightness as activation
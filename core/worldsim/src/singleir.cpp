@@ -54,43 +54,59 @@ SingleIR::~SingleIR()
 
 void SingleIR::update()
 {
+	m_batch.clear();
+
+	const int firstRay = appendRays(m_batch);
+	world()->worldRayCastClosest(m_batch);
+	updateFromBatch(m_batch, firstRay);
+}
+
+int SingleIR::appendRays(RayCastBatch& batch)
+{
+	const int firstRay = batch.size();
+
 	// Checking if the sensor is valid
 	if (!isValid()) {
-		return;
+		return firstRay;
 	}
 
-	// Resetting the current RayCastHit object
-	Shared* const d = m_shared.getModifiableShared();
-	d->rayCastHit.object = nullptr;
-	d->rayCastHit.distance = 1.0;
-
 	// Getting the owner as a WObject
 	WObject* own = ownerWObject();
 
 	// If we are attached to a phyobject, we ignore it in collisions
-	QSet<PhyObject*> ignoredObjs;
-	if (own != nullptr) {
-		PhyObject* phyObj = dynamic_cast<PhyObject*>(own);
-		if (phyObj != nullptr) {
-			ignoredObjs.insert(phyObj);
-		}
-	}
+	const PhyObject* phyObj = dynamic_cast<PhyObject*>(own);
 
-	// The minimum distance (distances range from 0.0 to 1.0)
-	double minDist = 2.0;
 	for (unsigned int i = 0; i < m_shared->numRays; i++) {
 		// Computing the start and end point of the ray in the global frame of reference
 		const wVector start = own->matrix().transformVector(m_shared->startingRayPoints[i]);
 		const wVector end = own->matrix().transformVector(m_shared->endingRayPoints[i]);
 
-		// Casting the ray
-		const RayCastHitVector v = world()->worldRayCast(start, end, true, ignoredObjs);
+		batch.addRay(start, end, phyObj);
+	}
+
+	return firstRay;
+}
+
+void SingleIR::updateFromBatch(const RayCastBatch& batch, int firstRay)
+{
+	// Checking if the sensor is valid
+	if (!isValid()) {
+		return;
+	}
 
-		// Taking the lowest distance: this sensor only reports the distance of the closest
-		// object
-		if ((v.size() != 0) && (v[0].distance < minDist)) {
-			minDist = v[0].distance;
-			d->rayCastHit = v[0];
+	// Resetting the current RayCastHit object
+	Shared* const d = m_shared.getModifiableShared();
+	d->rayCastHit.object = nullptr;
+	d->rayCastHit.distance = 1.0;
+
+	// Taking the lowest distance: this sensor only reports the distance of the closest
+	// object
+	double minDist = 2.0;
+	for (unsigned int i = 0; i < m_shared->numRays; i++) {
+		const RayCastHit& h = batch.hit(firstRay + i);
+		if ((h.object != nullptr) && (h.distance < minDist)) {
+			minDist = h.distance;
+			d->rayCastHit = h;
 		}
 	}
 }
@@ -0,0 +1,548 @@
+/********************************************************************************
+ *  SALSA                                                                       *
+ *  Copyright (C) 2007-2012                                                     *
+ *  Gianluca Massera <emmegian@yahoo.it>                                        *
+ *  Stefano Nolfi <stefano.nolfi@istc.cnr.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                         *
+ *                                                                              *
+ *  This program is free software; you can redistribute it and/or modify        *
+ *  it under the terms of the GNU General Public License as published by        *
+ *  the Free Software Foundation; either version 2 of the License, or           *
+ *  (at your option) any later version.                                         *
+ *                                                                              *
+ *  This program is distributed in the hope that it will be useful,             *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+ *  GNU General Public License for more details.                                *
+ *                                                                              *
+ *  You should have received a copy of the GNU General Public License           *
+ *  along with this program; if not, write to the Free Software                 *
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA  *
+ ********************************************************************************/
+
+#include "trajectoryrecorder.h"
+#include "world.h"
+#include "wobject.h"
+#include "phyobject.h"
+#include "logger.h"
+#include "utilitiesexceptions.h"
+#include <QDataStream>
+#include <QTextStream>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace salsa {
+
+namespace {
+	// The magic string at the beginning of trajectory files
+	const char trajectoryMagic[] = "SALSATRJ";
+
+	// The length of the magic string (without the terminator)
+	const int trajectoryMagicLength = 8;
+
+	// The length of the header of chunks (type and payload length)
+	const int chunkHeaderLength = 8;
+
+	// Sets the byte order and the precision of reals used in trajectory files
+	void setupStream(QDataStream& stream)
+	{
+		stream.setByteOrder(QDataStream::LittleEndian);
+		stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+	}
+
+	void writeString(QDataStream& out, const QString& str)
+	{
+		const QByteArray utf8 = str.toUtf8();
+
+		out << quint32(utf8.size());
+		out.writeRawData(utf8.constData(), utf8.size());
+	}
+
+	// Reads a string written by writeString(). If the length is not valid
+	// (i.e. it is greater than the number of bytes left in the stream) nothing
+	// is allocated, the status of the stream is set to ReadCorruptData and an
+	// empty string is returned
+	QString readString(QDataStream& in)
+	{
+		quint32 size;
+		in >> size;
+
+		if ((in.status() != QDataStream::Ok) || (qint64(size) > in.device()->bytesAvailable())) {
+			in.setStatus(QDataStream::ReadCorruptData);
+
+			return QString();
+		}
+
+		QByteArray utf8(int(size), '\0');
+		if (in.readRawData(utf8.data(), int(size)) != int(size)) {
+			in.setStatus(QDataStream::ReadPastEnd);
+
+			return QString();
+		}
+
+		return QString::fromUtf8(utf8);
+	}
+
+	void writeVector(QDataStream& out, const wVector& v)
+	{
+		out << v.x << v.y << v.z;
+	}
+
+	wVector readVector(QDataStream& in, real w)
+	{
+		real x, y, z;
+		in >> x >> y >> z;
+
+		return wVector(x, y, z, w);
+	}
+
+	void writeMatrix(QDataStream& out, const wMatrix& m)
+	{
+		writeVector(out, m.x_ax);
+		writeVector(out, m.y_ax);
+		writeVector(out, m.z_ax);
+		writeVector(out, m.w_pos);
+	}
+
+	wMatrix readMatrix(QDataStream& in)
+	{
+		const wVector x = readVector(in, 0.0);
+		const wVector y = readVector(in, 0.0);
+		const wVector z = readVector(in, 0.0);
+		const wVector p = readVector(in, 1.0);
+
+		return wMatrix(x, y, z, p);
+	}
+
+	bool sameVector(const wVectorT<true>& a, const wVectorT<true>& b)
+	{
+		return (a.x == b.x) && (a.y == b.y) && (a.z == b.z);
+	}
+
+	bool samePose(const wMatrix& a, const wMatrix& b)
+	{
+		return sameVector(a.w_pos, b.w_pos) && sameVector(a.x_ax, b.x_ax) && sameVector(a.y_ax, b.y_ax) && sameVector(a.z_ax, b.z_ax);
+	}
+
+	// Writes a quint32 at the given position of the stream device and moves back to the end
+	void patchCount(QDataStream& out, qint64 pos, quint32 count)
+	{
+		const qint64 end = out.device()->pos();
+		out.device()->seek(pos);
+		out << count;
+		out.device()->seek(end);
+	}
+
+	bool entityNameLessThan(const WObject* a, const WObject* b)
+	{
+		return a->name() < b->name();
+	}
+}
+
+TrajectoryRecorder::TrajectoryRecorder(World* world, QString filename, int keyframeInterval)
+	: AbstractRendererContainer(world)
+	, m_file(filename)
+	, m_keyframeInterval(std::max(keyframeInterval, 1))
+	, m_numFrames(0)
+	, m_framesSinceKeyframe(0)
+	, m_entitiesChanged(true)
+	, m_objects()
+	, m_objectsIndices()
+	, m_lastPoses()
+	, m_values()
+	, m_payload()
+{
+	if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		throw RuntimeUserException(QString("Cannot open trajectory file %1 for writing").arg(filename).toLatin1().data());
+	}
+
+	// Writing the header
+	QDataStream out(&m_file);
+	setupStream(out);
+	out.writeRawData(trajectoryMagic, trajectoryMagicLength);
+	out << formatVersion;
+
+	// Reserving memory so that it is not freed when the buffer is truncated
+	m_payload.reserve(4096);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+	// Renderers have been deleted by the world in rendererToBeDeleted(), here we only have to close the file
+	m_file.close();
+}
+
+void TrajectoryRecorder::update()
+{
+	if (m_entitiesChanged) {
+		writeEntitiesTable();
+	}
+
+	const bool keyframe = (m_framesSinceKeyframe == 0);
+
+	QDataStream out(&m_payload, QIODevice::WriteOnly);
+	setupStream(out);
+
+	out << quint8(keyframe ? 1 : 0);
+	out << world()->elapsedTime();
+
+	// Writing poses. Only those that changed are written, unless this is a keyframe
+	qint64 countPos = out.device()->pos();
+	quint32 count = 0;
+	out << count;
+	for (int i = 0; i < m_objects.size(); ++i) {
+		const wMatrix& m = m_objects[i]->matrix();
+
+		if (keyframe || !samePose(m, m_lastPoses[i])) {
+			out << quint32(i);
+			writeMatrix(out, m);
+			m_lastPoses[i] = m;
+			++count;
+		}
+	}
+	patchCount(out, countPos, count);
+
+	// Writing contacts. Each contact is stored twice in the map (once for each object), we only write it once
+	countPos = out.device()->pos();
+	count = 0;
+	out << count;
+	for (ContactMap::const_iterator it = world()->contacts().constBegin(); it != world()->contacts().constEnd(); ++it) {
+		foreach (const Contact& c, it.value()) {
+			const quint32 objectIndex = m_objectsIndices.value(c.object, quint32(m_objects.size()));
+			const quint32 collideIndex = m_objectsIndices.value(c.collide, quint32(m_objects.size()));
+
+			if ((objectIndex < collideIndex) && (collideIndex < quint32(m_objects.size()))) {
+				out << objectIndex << collideIndex;
+				writeVector(out, c.worldPos);
+				++count;
+			}
+		}
+	}
+	patchCount(out, countPos, count);
+
+	// Writing arrays of values
+	out << quint32(m_values.size());
+	for (QMap<QString, QVector<real> >::const_iterator it = m_values.constBegin(); it != m_values.constEnd(); ++it) {
+		writeString(out, it.key());
+		out << quint32(it.value().size());
+		foreach (real v, it.value()) {
+			out << v;
+		}
+	}
+	m_values.clear();
+
+	writeChunk(FrameChunk);
+
+	++m_numFrames;
+	m_framesSinceKeyframe = (m_framesSinceKeyframe + 1) % m_keyframeInterval;
+}
+
+void TrajectoryRecorder::recordValues(const QString& name, const QVector<real>& values)
+{
+	m_values[name] = values;
+}
+
+void TrajectoryRecorder::rendererAdded(RenderWEntity*)
+{
+	// We do not use renderers, we only have to write a new table of entities
+
+	m_entitiesChanged = true;
+}
+
+void TrajectoryRecorder::rendererToBeDeleted(RenderWEntity* renderer)
+{
+	// Renderers live in our thread, so we can delete them immediately. The entity is going to be deleted, so we
+	// also remove it from the list of objects to prevent accessing it before the new table of entities is written
+	delete renderer;
+
+	m_entitiesChanged = true;
+	m_objects.clear();
+	m_objectsIndices.clear();
+	m_lastPoses.clear();
+}
+
+void TrajectoryRecorder::textureAdded(const QString&)
+{
+	// Textures are not recorded
+}
+
+void TrajectoryRecorder::textureToBeDeleted(const QString&)
+{
+	// Textures are not recorded
+}
+
+void TrajectoryRecorder::worldGraphicalInfoChanged(const WorldGraphicalInfo&)
+{
+	// Graphical information is not recorded
+}
+
+void TrajectoryRecorder::writeEntitiesTable()
+{
+	// Building the list of objects. Sorting by name so that the order does not depend on the address of objects
+	m_objects.clear();
+	foreach (const WEntity* e, world()->entities()) {
+		const WObject* o = dynamic_cast<const WObject*>(e);
+
+		if (o != nullptr) {
+			m_objects.append(o);
+		}
+	}
+	std::stable_sort(m_objects.begin(), m_objects.end(), entityNameLessThan);
+
+	m_objectsIndices.clear();
+	for (int i = 0; i < m_objects.size(); ++i) {
+		m_objectsIndices.insert(m_objects[i], quint32(i));
+	}
+	m_lastPoses.fill(wMatrix::identity(), m_objects.size());
+
+	QDataStream out(&m_payload, QIODevice::WriteOnly);
+	setupStream(out);
+
+	out << quint32(m_objects.size());
+	foreach (const WObject* o, m_objects) {
+		writeString(out, o->name());
+	}
+
+	writeChunk(EntitiesChunk);
+
+	// The next frame must be a keyframe, as poses refer to the new table
+	m_entitiesChanged = false;
+	m_framesSinceKeyframe = 0;
+}
+
+void TrajectoryRecorder::writeChunk(ChunkType type)
+{
+	uchar header[chunkHeaderLength];
+	qToLittleEndian(quint32(type), header);
+	qToLittleEndian(quint32(m_payload.size()), header + 4);
+
+	if ((m_file.write(reinterpret_cast<const char*>(header), chunkHeaderLength) != chunkHeaderLength) || (m_file.write(m_payload) != m_payload.size())) {
+		Logger::error(QString("Error writing to trajectory file %1: %2").arg(m_file.fileName()).arg(m_file.errorString()));
+	}
+}
+
+TrajectoryReader::TrajectoryReader(QString filename)
+	: m_file(filename)
+	, m_data(nullptr)
+	, m_size(0)
+	, m_entitiesTables()
+	, m_frames()
+	, m_currentFrame(-1)
+	, m_time(0.0)
+	, m_entities()
+	, m_poses()
+	, m_contacts()
+	, m_values()
+{
+	if (!m_file.open(QIODevice::ReadOnly)) {
+		throw RuntimeUserException(QString("Cannot open trajectory file %1").arg(filename).toLatin1().data());
+	}
+
+	m_size = m_file.size();
+	m_data = m_file.map(0, m_size);
+	if (m_data == nullptr) {
+		throw RuntimeUserException(QString("Cannot map trajectory file %1").arg(filename).toLatin1().data());
+	}
+
+	// Checking the header
+	const qint64 headerLength = trajectoryMagicLength + 4;
+	if ((m_size < headerLength) || (memcmp(m_data, trajectoryMagic, trajectoryMagicLength) != 0)) {
+		throw RuntimeUserException(QString("%1 is not a trajectory file").arg(filename).toLatin1().data());
+	}
+	if (qFromLittleEndian<quint32>(m_data + trajectoryMagicLength) != TrajectoryRecorder::formatVersion) {
+		throw RuntimeUserException(QString("Unsupported version of trajectory file %1").arg(filename).toLatin1().data());
+	}
+
+	// Building the index. Only tables of entities are decoded here, for frames we only store the position
+	int lastKeyframe = -1;
+	qint64 pos = headerLength;
+	while ((pos + chunkHeaderLength) <= m_size) {
+		const quint32 type = qFromLittleEndian<quint32>(m_data + pos);
+		const quint32 length = qFromLittleEndian<quint32>(m_data + pos + 4);
+		const qint64 payload = pos + chunkHeaderLength;
+
+		// Ignoring an incomplete last chunk
+		if ((payload + length) > m_size) {
+			break;
+		}
+
+		if (type == TrajectoryRecorder::EntitiesChunk) {
+			QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + payload), length));
+			setupStream(in);
+
+			quint32 numEntities;
+			in >> numEntities;
+			QStringList names;
+			for (quint32 i = 0; (i < numEntities) && (in.status() == QDataStream::Ok); ++i) {
+				names.append(readString(in));
+			}
+			if (in.status() != QDataStream::Ok) {
+				throw RuntimeUserException(QString("Corrupted table of entities in trajectory file %1").arg(filename).toLatin1().data());
+			}
+			m_entitiesTables.append(names);
+		} else if ((type == TrajectoryRecorder::FrameChunk) && (length > 0) && !m_entitiesTables.isEmpty()) {
+			if (m_data[payload] != 0) {
+				lastKeyframe = m_frames.size();
+			}
+
+			// Frames before the first keyframe cannot be decoded
+			if (lastKeyframe != -1) {
+				FrameIndex f;
+				f.offset = payload;
+				f.length = length;
+				f.entitiesTable = m_entitiesTables.size() - 1;
+				f.keyframe = lastKeyframe;
+				m_frames.append(f);
+			}
+		}
+
+		// Unknown chunks are skipped
+		pos = payload + length;
+	}
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+	m_file.unmap(const_cast<uchar*>(m_data));
+	m_file.close();
+}
+
+bool TrajectoryReader::readFrame(int frame)
+{
+	if ((frame < 0) || (frame >= m_frames.size())) {
+		return false;
+	}
+
+	// If we are moving to the next frame we can simply apply the differences, otherwise we have to start from the
+	// keyframe
+	const FrameIndex& f = m_frames[frame];
+	int first = f.keyframe;
+	if ((m_currentFrame != -1) && (m_currentFrame < frame) && (m_currentFrame >= f.keyframe)) {
+		first = m_currentFrame + 1;
+	}
+
+	if (first == f.keyframe) {
+		m_entities = m_entitiesTables[f.entitiesTable];
+		m_poses.fill(wMatrix::identity(), m_entities.size());
+	}
+
+	for (int i = first; i <= frame; ++i) {
+		decodeFrame(i);
+	}
+	m_currentFrame = frame;
+
+	return true;
+}
+
+int TrajectoryReader::applyToWorld(World* world) const
+{
+	// Grouping objects in the world by name, to match entities with the same name in order
+	QHash<QString, QList<WObject*> > objects;
+	foreach (WEntity* e, world->entities()) {
+		WObject* o = dynamic_cast<WObject*>(e);
+
+		if (o != nullptr) {
+			objects[o->name()].append(o);
+		}
+	}
+
+	int numApplied = 0;
+	for (int i = 0; i < m_entities.size(); ++i) {
+		QHash<QString, QList<WObject*> >::iterator it = objects.find(m_entities[i]);
+
+		if ((it != objects.end()) && !it.value().isEmpty()) {
+			it.value().takeFirst()->setMatrix(m_poses[i]);
+			++numApplied;
+		}
+	}
+
+	return numApplied;
+}
+
+bool TrajectoryReader::exportCSV(QString filename)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		return false;
+	}
+
+	QTextStream out(&file);
+	out << "frame,time,entity,x,y,z,xx,xy,xz,yx,yy,yz,zx,zy,zz\n";
+	for (int f = 0; f < numFrames(); ++f) {
+		readFrame(f);
+
+		for (int i = 0; i < m_entities.size(); ++i) {
+			const wMatrix& m = m_poses[i];
+
+			out << f << "," << m_time << ",\"" << m_entities[i] << "\"";
+			out << "," << m.w_pos.x << "," << m.w_pos.y << "," << m.w_pos.z;
+			out << "," << m.x_ax.x << "," << m.x_ax.y << "," << m.x_ax.z;
+			out << "," << m.y_ax.x << "," << m.y_ax.y << "," << m.y_ax.z;
+			out << "," << m.z_ax.x << "," << m.z_ax.y << "," << m.z_ax.z << "\n";
+		}
+	}
+
+	out.flush();
+
+	return (out.status() == QTextStream::Ok);
+}
+
+void TrajectoryReader::decodeFrame(int frame)
+{
+	const FrameIndex& f = m_frames[frame];
+
+	QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + f.offset), f.length));
+	setupStream(in);
+
+	quint8 keyframe;
+	in >> keyframe >> m_time;
+
+	quint32 numPoses;
+	in >> numPoses;
+	for (quint32 i = 0; (i < numPoses) && (in.status() == QDataStream::Ok); ++i) {
+		quint32 index;
+		in >> index;
+		const wMatrix m = readMatrix(in);
+
+		if (index < quint32(m_poses.size())) {
+			m_poses[index] = m;
+		}
+	}
+
+	quint32 numContacts;
+	in >> numContacts;
+	m_contacts.clear();
+	for (quint32 i = 0; (i < numContacts) && (in.status() == QDataStream::Ok); ++i) {
+		quint32 object, collide;
+		in >> object >> collide;
+
+		RecordedContact c;
+		c.object = object;
+		c.collide = collide;
+		c.worldPos = readVector(in, 1.0);
+		m_contacts.append(c);
+	}
+
+	quint32 numValues;
+	in >> numValues;
+	m_values.clear();
+	for (quint32 i = 0; (i < numValues) && (in.status() == QDataStream::Ok); ++i) {
+		const QString name = readString(in);
+		if (in.status() != QDataStream::Ok) {
+			break;
+		}
+
+		quint32 size;
+		in >> size;
+		QVector<real> values;
+		for (quint32 j = 0; (j < size) && (in.status() == QDataStream::Ok); ++j) {
+			real v;
+			in >> v;
+			values.append(v);
+		}
+		m_values.insert(name, values);
+	}
+}
+
+} // end namespace salsa
@@ -28,9 +28,43 @@
 #include "motorcontrollers.h"
 #include "logger.h"
 #include <QPair>
+#include <cstring>
 
 namespace salsa {
 
+namespace {
+	// The first value in the state returned by World::saveState()
+	const quint32 worldStateMagic = 0x57535354;
+
+	// The tags preceding the state of each entity in the state returned by
+	// World::saveState()
+	const quint8 phyObjectTag = 1;
+	const quint8 phyJointTag = 2;
+
+	// Appends the in-memory representation of n values to state
+	template <class T>
+	void appendValues(QByteArray& state, const T* v, int n = 1)
+	{
+		state.append(reinterpret_cast<const char*>(v), n * sizeof(T));
+	}
+
+	// Reads n values from state starting at pos, which is advanced. Returns
+	// false if state is too short
+	template <class T>
+	bool readValues(const QByteArray& state, int& pos, T* v, int n = 1)
+	{
+		const int size = n * sizeof(T);
+		if ((pos + size) > state.size()) {
+			return false;
+		}
+
+		memcpy(v, state.constData() + pos, size);
+		pos += size;
+
+		return true;
+	}
+}
+
 World::World(QString worldname)
 	: m_name(worldname)
 	, m_time(0.0f)
@@ -46,9 +80,13 @@ World::World(QString worldname)
 	, m_mapObjJoints()
 	, m_creatingSomething(false)
 	, m_cmap()
+	, m_contactsChanged()
 	, m_nobjs()
 	, m_mats()
 	, m_isInitialized(false)
+	, m_kinematicOnly(false)
+	, m_numThreads(1)
+	, m_movedObjects()
 	, m_priv()
 	, m_textures()
 {
@@ -81,6 +119,65 @@ void World::resetElapsedTime()
 	m_time = 0.0;
 }
 
+QByteArray World::saveState()
+{
+	QByteArray state;
+
+	appendValues(state, &worldStateMagic);
+	appendValues(state, &m_time);
+
+	for (QLinkedList<WEntityAndBuddies>::iterator it = m_entities.begin(); it != m_entities.end(); ++it) {
+		PhyObject* const obj = dynamic_cast<PhyObject*>(it->entity);
+		PhyJoint* const joint = dynamic_cast<PhyJoint*>(it->entity);
+
+		if (obj != nullptr) {
+			const wVector velocity = obj->velocity();
+			const wVector omega = obj->omega();
+			const quint8 flags = (obj->getKinematic() ? 1 : 0) | (obj->m_shared->isKinematicCollidable ? 2 : 0) | (obj->getStatic() ? 4 : 0);
+
+			appendValues(state, &phyObjectTag);
+			appendValues(state, &(obj->matrix()[0][0]), 16);
+			appendValues(state, &velocity[0], 3);
+			appendValues(state, &omega[0], 3);
+			appendValues(state, &(obj->m_shared->forceAcc[0]), 3);
+			appendValues(state, &(obj->m_shared->torqueAcc[0]), 3);
+			appendValues(state, &flags);
+		} else if (joint != nullptr) {
+			const quint32 numDofs = joint->dofs().size();
+			const quint8 enabled = joint->isEnabled() ? 1 : 0;
+
+			appendValues(state, &phyJointTag);
+			appendValues(state, &numDofs);
+			appendValues(state, &enabled);
+			foreach (const PhyDOF* dof, joint->dofs()) {
+				const qint32 mode = dof->motion();
+				const real values[5] = { dof->desiredPosition(), dof->desiredVelocity(), dof->appliedForce(), dof->position(), dof->velocity() };
+
+				appendValues(state, &mode);
+				appendValues(state, values, 5);
+			}
+		}
+	}
+
+	return state;
+}
+
+bool World::restoreState(const QByteArray& state)
+{
+	// Checking the whole state first, so that nothing is changed if it doesn't match the world
+	if (!readState(state, false)) {
+		return false;
+	}
+
+	readState(state, true);
+
+	// Removing contacts and data cached by the physics engine, so that the simulation
+	// continues as it did after the state was saved
+	cleanUpMemory();
+
+	return true;
+}
+
 void World::setTimeStep(real timestep)
 {
 	m_timestep = timestep;
@@ -217,8 +314,9 @@ bool World::smartCheckContacts(PhyObject* obj1, PhyObject* obj2, int maxContacts
 			return false;
 		}
 
-		// Taking the vector of contacts
-		const ContactVec& c = m_cmap[obj1];
+		// Taking the vector of contacts. Using value() instead of operator[] so that we don't
+		// detach the map if it is shared (e.g. with a renderers container)
+		const ContactVec c = m_cmap.value(obj1);
 		bool collision = false;
 		if (contacts != nullptr) {
 			contacts->clear();
@@ -265,6 +363,8 @@ real World::collisionRayCast(PhyObject* obj, wVector start, wVector end, wVector
 
 RayCastHitVector World::worldRayCast(wVector start, wVector end, bool onlyClosest, const QSet<PhyObject*>& ignoredObjs)
 {
+	syncMovedObjects();
+
 #ifdef WORLDSIM_USE_NEWTON
 	WorldPrivate::WorldRayCastCallbackUserData data(start, end, onlyClosest, ignoredObjs);
 
@@ -277,6 +377,26 @@ RayCastHitVector World::worldRayCast(wVector start, wVector end, bool onlyCloses
 #endif
 }
 
+void World::worldRayCastClosest(RayCastBatch& batch)
+{
+	syncMovedObjects();
+
+	for (int i = 0; i < batch.size(); i++) {
+		RayCastHit& h = batch.hit(i);
+		h.object = nullptr;
+		h.distance = 1.0;
+
+#ifdef WORLDSIM_USE_NEWTON
+		WorldPrivate::WorldRayCastBatchCallbackUserData data(batch, i);
+
+		// Casting the ray
+		wVector start = batch.start(i);
+		wVector end = batch.end(i);
+		NewtonWorldRayCast(m_priv->world, &start[0], &end[0], WorldPrivate::worldRayBatchFilterCallback, &data, WorldPrivate::worldRayBatchPrefilterCallback);
+#endif
+	}
+}
+
 
 MaterialDB& World::materials()
 {
@@ -312,12 +432,22 @@ void World::setFrictionModel(QString model)
 
 void World::setMultiThread(int numThreads)
 {
+	m_numThreads = max(1, numThreads);
 #ifdef WORLDSIM_USE_NEWTON
-	numThreads = max(1, numThreads);
-	NewtonSetThreadsCount(m_priv->world, numThreads);
+	NewtonSetThreadsCount(m_priv->world, m_numThreads);
 #endif
 }
 
+void World::setKinematicOnly(bool kinematicOnly)
+{
+	m_kinematicOnly = kinematicOnly;
+
+	// When leaving kinematic-only mode, the physics engine must know the actual position of all objects
+	if (!m_kinematicOnly) {
+		syncMovedObjects();
+	}
+}
+
 void World::setSize(const wVector& minPoint, const wVector& maxPoint)
 {
 	m_minP = minPoint;
@@ -345,7 +475,10 @@ void World::cleanUpMemory()
 {
 #ifdef WORLDSIM_USE_NEWTON
 	NewtonInvalidateCache(m_priv->world);
-	m_cmap.clear();
+	if (!m_cmap.isEmpty()) {
+		m_cmap.clear();
+		m_contactsChanged.triggerUpdate();
+	}
 #endif
 }
 
@@ -372,10 +505,16 @@ void World::advance()
 
 	// Simulate physic. Before doing the actual simulation step, clearing the map of contacts
 	// (we do it here so that calls to preUpdate() can access the old map of contacts)
+	const bool hadContacts = !m_cmap.isEmpty();
 	m_cmap.clear();
 #ifdef WORLDSIM_USE_NEWTON
-	NewtonUpdate(m_priv->world, m_timestep);
+	if (!m_kinematicOnly) {
+		NewtonUpdate(m_priv->world, m_timestep);
+	}
 #endif
+	if (hadContacts || !m_cmap.isEmpty()) {
+		m_contactsChanged.triggerUpdate();
+	}
 
 	// Call postUpdate() on all entities
 	for (QLinkedList<WEntityAndBuddies>::iterator it = m_entities.begin(); it != m_entities.end(); ++it) {
@@ -415,6 +554,8 @@ void World::deleteEntity(WEntity* entity)
 	// Now performing all actions that are type-dependent
 	PhyObject* const phyObject = dynamic_cast<PhyObject*>(entity);
 	if (phyObject != nullptr) {
+		m_movedObjects.remove(phyObject);
+
 		// Destroying joints. We have to do this because Newton destroys them anyway
 		if (m_mapObjJoints.contains(phyObject)) {
 			// Getting the list of joints for the object
@@ -448,6 +589,7 @@ void World::deleteEntity(WEntity* entity)
 				}
 			}
 			m_cmap.remove(phyObject);
+			m_contactsChanged.triggerUpdate();
 		}
 
 		// Also removing the object from the m_nobjs set
@@ -575,6 +717,8 @@ void World::createWorld()
 	// exact model as default
 	NewtonSetSolverModel(m_priv->world, 0);
 	NewtonSetFrictionModel(m_priv->world, 0);
+	// The number of threads is kept when the world is reset
+	NewtonSetThreadsCount(m_priv->world, m_numThreads);
 #endif
 
 	// Registering all pre-defined textures
@@ -623,6 +767,105 @@ void World::createWorld()
 	}
 }
 
+void World::syncMovedObjects()
+{
+	foreach (PhyObject* obj, m_movedObjects) {
+		obj->syncMatrixWithEngine();
+	}
+	m_movedObjects.clear();
+}
+
+bool World::readState(const QByteArray& state, bool apply)
+{
+	int pos = 0;
+
+	quint32 magic;
+	real time;
+	if (!readValues(state, pos, &magic) || (magic != worldStateMagic) || !readValues(state, pos, &time)) {
+		return false;
+	}
+	if (apply) {
+		m_time = time;
+	}
+
+	for (QLinkedList<WEntityAndBuddies>::iterator it = m_entities.begin(); it != m_entities.end(); ++it) {
+		PhyObject* const obj = dynamic_cast<PhyObject*>(it->entity);
+		PhyJoint* const joint = dynamic_cast<PhyJoint*>(it->entity);
+
+		if ((obj == nullptr) && (joint == nullptr)) {
+			continue;
+		}
+
+		quint8 tag;
+		if (!readValues(state, pos, &tag)) {
+			return false;
+		}
+
+		if (obj != nullptr) {
+			wMatrix tm;
+			wVector velocity;
+			wVector omega;
+			wVector force;
+			wVector torque;
+			quint8 flags;
+			if ((tag != phyObjectTag) || !readValues(state, pos, &tm[0][0], 16) || !readValues(state, pos, &velocity[0], 3) ||
+			    !readValues(state, pos, &omega[0], 3) || !readValues(state, pos, &force[0], 3) ||
+			    !readValues(state, pos, &torque[0], 3) || !readValues(state, pos, &flags)) {
+				return false;
+			}
+
+			if (apply) {
+				const bool kinematic = ((flags & 1) != 0);
+				const bool kinematicCollidable = ((flags & 2) != 0);
+				if ((obj->getKinematic() != kinematic) || (obj->m_shared->isKinematicCollidable != kinematicCollidable)) {
+					obj->setKinematic(kinematic, kinematicCollidable);
+				}
+				obj->setStatic((flags & 4) != 0);
+
+				// This also removes contacts involving the object
+				obj->reset();
+				obj->setMatrix(tm);
+				obj->setVelocity(velocity);
+				obj->setOmega(omega);
+				obj->setForce(force);
+				obj->setTorque(torque);
+			}
+		} else {
+			quint32 numDofs;
+			quint8 enabled;
+			if ((tag != phyJointTag) || !readValues(state, pos, &numDofs) || (numDofs != quint32(joint->dofs().size())) ||
+			    !readValues(state, pos, &enabled)) {
+				return false;
+			}
+
+			if (apply) {
+				joint->enable(enabled != 0);
+			}
+
+			foreach (PhyDOF* dof, joint->dofs()) {
+				qint32 mode;
+				real values[5];
+				if (!readValues(state, pos, &mode) || (mode < PhyDOFShared::Force) || (mode > PhyDOFShared::Off) || !readValues(state, pos, values, 5)) {
+					return false;
+				}
+
+				if (apply) {
+					// Using the public functions so that signals are emitted. The motion
+					// mode is set last because each of these functions changes it
+					dof->setDesiredPosition(values[0]);
+					dof->setDesiredVelocity(values[1]);
+					dof->applyForce(values[2]);
+					dof->setMotionMode(PhyDOFShared::MotionMode(mode));
+					dof->setPosition(values[3]);
+					dof->setVelocity(values[4]);
+				}
+			}
+		}
+	}
+
+	return (pos == state.size());
+}
+
 void World::destroyWorld()
 {
 	// First of removing all textures. Renderer containers are not deleted and renderers will be
@@ -0,0 +1,278 @@
+/***************************************************************************
+ *  SALSA Configuration Library                                            *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+
+#include <QtTest/QtTest>
+#include <QList>
+#include <QMap>
+#include <QTemporaryDir>
+#include <QVector>
+#include "world.h"
+#include "phybox.h"
+#include "physphere.h"
+#include "trajectoryrecorder.h"
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+namespace {
+	// The maximum difference between recorded and live values. Reals are
+	// written as 32 bits floats
+	const real tolerance = 1e-5f;
+
+	// The number of steps to record
+	const int numSteps = 60;
+
+	// The number of frames between two keyframes
+	const int keyframeInterval = 10;
+
+	// A recorded contact with the names of the two objects, in alphabetical
+	// order
+	struct NamedContact
+	{
+		QString object;
+		QString collide;
+		wVector worldPos;
+	};
+
+	// The state of the world after a step
+	struct Snapshot
+	{
+		real time;
+		QMap<QString, wMatrix> poses;
+		QList<NamedContact> contacts;
+		QVector<real> values;
+	};
+
+	// Builds a world with a static ground, a box falling on it, a sphere
+	// flying away and a static box that never moves (so that it is only
+	// written in keyframes). Names are unique so that objects can be matched
+	// when replaying
+	struct TestWorld
+	{
+		TestWorld()
+			: world("trajectoryWorld")
+			, objects()
+		{
+			wMatrix mtr = wMatrix::identity();
+
+			mtr.w_pos = wVector(0.0, 0.0, 0.0);
+			PhyBox* ground = world.createEntity(TypeToCreate<PhyBox>(), 2.0, 2.0, 0.1, "ground", mtr);
+			ground->setStatic(true);
+
+			mtr.w_pos = wVector(0.5, 0.5, 0.5);
+			PhyBox* pillar = world.createEntity(TypeToCreate<PhyBox>(), 0.1, 0.1, 0.5, "pillar", mtr);
+			pillar->setStatic(true);
+
+			mtr.w_pos = wVector(0.0, 0.0, 0.2);
+			PhyBox* box = world.createEntity(TypeToCreate<PhyBox>(), 0.1, 0.1, 0.1, "box", mtr);
+			box->setMass(1.0);
+			box->setOmega(wVector(0.0, 0.0, 2.0));
+
+			mtr.w_pos = wVector(-0.5, -0.5, 1.5);
+			PhySphere* sphere = world.createEntity(TypeToCreate<PhySphere>(), 0.05, "sphere", mtr);
+			sphere->setMass(0.3);
+			sphere->setVelocity(wVector(0.5, 0.0, 3.0));
+
+			objects << ground << pillar << box << sphere;
+		}
+
+		Snapshot snapshot(const QVector<real>& values) const
+		{
+			Snapshot s;
+			s.time = world.elapsedTime();
+			foreach (const PhyObject* o, objects) {
+				s.poses.insert(o->name(), o->matrix());
+			}
+			// The same order in which the recorder writes contacts
+			for (ContactMap::const_iterator it = world.contacts().constBegin(); it != world.contacts().constEnd(); ++it) {
+				foreach (const Contact& c, it.value()) {
+					if (c.object->name() < c.collide->name()) {
+						NamedContact n;
+						n.object = c.object->name();
+						n.collide = c.collide->name();
+						n.worldPos = c.worldPos;
+						s.contacts.append(n);
+					}
+				}
+			}
+			s.values = values;
+
+			return s;
+		}
+
+		World world;
+		QList<PhyObject*> objects;
+	};
+
+	template <bool aShared, bool bShared>
+	bool sameVector(const wVectorT<aShared>& a, const wVectorT<bShared>& b)
+	{
+		return (qAbs(a.x - b.x) <= tolerance) && (qAbs(a.y - b.y) <= tolerance) && (qAbs(a.z - b.z) <= tolerance);
+	}
+
+	bool samePose(const wMatrix& a, const wMatrix& b)
+	{
+		return sameVector(a.x_ax, b.x_ax) && sameVector(a.y_ax, b.y_ax) && sameVector(a.z_ax, b.z_ax) && sameVector(a.w_pos, b.w_pos);
+	}
+
+	// Returns an empty string if the current frame of the reader matches the
+	// snapshot, a description of the difference otherwise
+	QString compareFrame(const TrajectoryReader& reader, const Snapshot& expected)
+	{
+		if (qAbs(reader.time() - expected.time) > tolerance) {
+			return QString("time is %1 instead of %2").arg(reader.time()).arg(expected.time);
+		}
+
+		for (QMap<QString, wMatrix>::const_iterator it = expected.poses.constBegin(); it != expected.poses.constEnd(); ++it) {
+			const int index = reader.entities().indexOf(it.key());
+			if (index == -1) {
+				return QString("entity %1 not found").arg(it.key());
+			}
+			if (!samePose(reader.poses()[index], it.value())) {
+				return QString("wrong pose of entity %1").arg(it.key());
+			}
+		}
+
+		if (reader.contacts().size() != expected.contacts.size()) {
+			return QString("%1 contacts instead of %2").arg(reader.contacts().size()).arg(expected.contacts.size());
+		}
+		for (int i = 0; i < expected.contacts.size(); i++) {
+			const TrajectoryReader::RecordedContact& c = reader.contacts()[i];
+			const NamedContact& e = expected.contacts[i];
+			if ((reader.entities()[c.object] != e.object) || (reader.entities()[c.collide] != e.collide) || !sameVector(c.worldPos, e.worldPos)) {
+				return QString("wrong contact %1").arg(i);
+			}
+		}
+
+		QMap<QString, QVector<real> > expectedValues;
+		expectedValues.insert("step", expected.values);
+		if (reader.values() != expectedValues) {
+			return QString("wrong values");
+		}
+
+		return QString();
+	}
+}
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class TrajectoryRecorder_Test : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase()
+	{
+		QVERIFY(m_dir.isValid());
+		m_filename = m_dir.path() + "/trajectory.trj";
+
+		TestWorld w;
+		TrajectoryRecorder* recorder = w.world.createRenderersContainer(TypeToCreate<TrajectoryRecorder>(), m_filename, keyframeInterval);
+		for (int i = 0; i < numSteps; i++) {
+			const QVector<real> values = QVector<real>() << real(i) << real(i) * 0.5f;
+			recorder->recordValues("step", values);
+			w.world.advance();
+			m_snapshots.append(w.snapshot(values));
+		}
+		QCOMPARE(recorder->numFrames(), numSteps);
+		// This also closes the file
+		w.world.deleteRenderersContainer(recorder);
+
+		// Checking that the recording is meaningful: the box must hit the
+		// ground and the sphere must be flying halfway through the recording
+		bool contacts = false;
+		foreach (const Snapshot& s, m_snapshots) {
+			contacts = contacts || !s.contacts.isEmpty();
+		}
+		QVERIFY(contacts);
+		QVERIFY(!samePose(m_snapshots[numSteps / 2].poses["sphere"], m_snapshots[numSteps / 2 + 1].poses["sphere"]));
+	}
+
+	void sequentialRead()
+	{
+		TrajectoryReader reader(m_filename);
+		QCOMPARE(reader.numFrames(), numSteps);
+
+		// Apart from keyframes, each frame is decoded applying the
+		// differences to the previous one
+		for (int i = 0; i < numSteps; i++) {
+			QVERIFY(reader.readFrame(i));
+			QCOMPARE(reader.currentFrame(), i);
+			const QString error = compareFrame(reader, m_snapshots[i]);
+			if (!error.isEmpty()) {
+				QFAIL(QString("Frame %1: %2").arg(i).arg(error).toLatin1().data());
+			}
+		}
+		QVERIFY(!reader.readFrame(numSteps));
+	}
+
+	void randomAccess()
+	{
+		TrajectoryReader reader(m_filename);
+
+		// Moving backward always starts from a keyframe, moving forward
+		// applies differences if the frame follows the same keyframe and
+		// starts from a keyframe otherwise
+		const QList<int> frames = QList<int>() << 59 << 12 << 17 << 19 << 25 << 10 << 9 << 0 << 33 << 31 << 40;
+		foreach (int i, frames) {
+			QVERIFY(reader.readFrame(i));
+			const QString error = compareFrame(reader, m_snapshots[i]);
+			if (!error.isEmpty()) {
+				QFAIL(QString("Frame %1: %2").arg(i).arg(error).toLatin1().data());
+			}
+		}
+	}
+
+	void replayInWorld()
+	{
+		TrajectoryReader reader(m_filename);
+
+		// Replaying in a world that does not simulate dynamics
+		TestWorld replay;
+		replay.world.setKinematicOnly(true);
+
+		foreach (int i, QList<int>() << 0 << 15 << 30 << 59) {
+			QVERIFY(reader.readFrame(i));
+			QCOMPARE(reader.applyToWorld(&replay.world), reader.entities().size());
+			foreach (const PhyObject* o, replay.objects) {
+				if (!samePose(o->matrix(), m_snapshots[i].poses[o->name()])) {
+					QFAIL(QString("Frame %1: wrong pose of %2 after applyToWorld()").arg(i).arg(o->name()).toLatin1().data());
+				}
+			}
+		}
+	}
+
+private:
+	QTemporaryDir m_dir;
+	QString m_filename;
+	QList<Snapshot> m_snapshots;
+};
+
+QTEST_MAIN(TrajectoryRecorder_Test)
+#include "trajectoryrecorder_test.moc"
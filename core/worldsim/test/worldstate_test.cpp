@@ -0,0 +1,200 @@
+/***************************************************************************
+ *  SALSA Configuration Library                                            *
+ *  Copyright (C) 2007-2013                                                *
+ *  Gianluca Massera <emmegian@yahoo.it>                                   *
+ *  Tomassino Ferrauto <tomassino.ferrauto@istc.cnr.it>                    *
+ *                                                                         *
+ *  This program is free software; you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation; either version 2 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program; if not, write to the                          *
+ *  Free Software Foundation, Inc.,                                        *
+ *  59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.              *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+#include <QList>
+#include "world.h"
+#include "phybox.h"
+#include "physphere.h"
+#include "phyhinge.h"
+
+// NOTES AND TODOS
+//
+//
+
+using namespace salsa;
+
+namespace {
+	// The maximum difference between values of the original and the
+	// restored simulation
+	const real tolerance = 1e-4f;
+
+	// The state of the simulation that is checked by tests
+	struct Snapshot
+	{
+		QList<wMatrix> matrices;
+		real jointPosition;
+		real jointVelocity;
+	};
+
+	// Builds a world with a static base, a pendulum hinged to it and two
+	// falling objects, all far from each other so that there are no contacts
+	struct TestWorld
+	{
+		TestWorld()
+			: world("stateWorld")
+			, base(nullptr)
+			, pendulum(nullptr)
+			, hinge(nullptr)
+			, objects()
+		{
+			wMatrix mtr = wMatrix::identity();
+
+			mtr.w_pos = wVector(0.0, 0.0, 1.0);
+			base = world.createEntity(TypeToCreate<PhyBox>(), 0.1, 0.1, 0.1, "base", mtr);
+			base->setStatic(true);
+
+			mtr.w_pos = wVector(0.3, 0.0, 1.0);
+			pendulum = world.createEntity(TypeToCreate<PhyBox>(), 0.4, 0.05, 0.05, "pendulum", mtr);
+			pendulum->setMass(0.5);
+			hinge = world.createEntity(TypeToCreate<PhyHinge>(), base, pendulum, wVector(0.0, 1.0, 0.0), wVector(0.0, 0.0, 0.0), 0.0);
+
+			mtr.w_pos = wVector(2.0, 0.0, 5.0);
+			PhyBox* box = world.createEntity(TypeToCreate<PhyBox>(), 0.1, 0.2, 0.3, "box", mtr);
+			box->setMass(1.0);
+			box->setOmega(wVector(1.0, 2.0, 3.0));
+
+			mtr.w_pos = wVector(-2.0, 0.0, 5.0);
+			PhySphere* sphere = world.createEntity(TypeToCreate<PhySphere>(), 0.1, "sphere", mtr);
+			sphere->setMass(0.3);
+			sphere->setVelocity(wVector(0.5, -0.5, 1.0));
+
+			objects << base << pendulum << box << sphere;
+		}
+
+		void step(int n)
+		{
+			for (int i = 0; i < n; i++) {
+				world.advance();
+			}
+		}
+
+		Snapshot snapshot() const
+		{
+			Snapshot s;
+			foreach (const PhyObject* o, objects) {
+				s.matrices.append(o->matrix());
+			}
+			s.jointPosition = hinge->dofs()[0]->position();
+			s.jointVelocity = hinge->dofs()[0]->velocity();
+
+			return s;
+		}
+
+		World world;
+		PhyBox* base;
+		PhyBox* pendulum;
+		PhyHinge* hinge;
+		QList<PhyObject*> objects;
+	};
+
+	bool sameSnapshot(const Snapshot& a, const Snapshot& b)
+	{
+		if (a.matrices.size() != b.matrices.size()) {
+			return false;
+		}
+
+		for (int m = 0; m < a.matrices.size(); m++) {
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					if (qAbs(a.matrices[m][i][j] - b.matrices[m][i][j]) > tolerance) {
+						return false;
+					}
+				}
+			}
+		}
+
+		return (qAbs(a.jointPosition - b.jointPosition) <= tolerance) && (qAbs(a.jointVelocity - b.jointVelocity) <= tolerance);
+	}
+}
+
+/**
+ * \brief The class to perform unit tests
+ *
+ * Each private slot is a test
+ */
+class WorldState_Test : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void saveAndRestore()
+	{
+		TestWorld w;
+		const int numSteps = 50;
+
+		w.step(20);
+		const Snapshot saved = w.snapshot();
+		const real savedTime = w.world.elapsedTime();
+		const QByteArray state = w.world.saveState();
+
+		w.step(numSteps);
+		const Snapshot expected = w.snapshot();
+		const real expectedTime = w.world.elapsedTime();
+
+		// Checking that the simulation moved, otherwise the test is useless
+		QVERIFY(!sameSnapshot(saved, expected));
+
+		QVERIFY(w.world.restoreState(state));
+		QVERIFY(sameSnapshot(w.snapshot(), saved));
+		QCOMPARE(w.world.elapsedTime(), savedTime);
+
+		w.step(numSteps);
+		QVERIFY(sameSnapshot(w.snapshot(), expected));
+		QCOMPARE(w.world.elapsedTime(), expectedTime);
+	}
+
+	void wrongMagicNumber()
+	{
+		TestWorld w;
+
+		w.step(5);
+		QByteArray state = w.world.saveState();
+		state[0] = char(state[0] ^ 0xFF);
+
+		w.step(5);
+		const Snapshot current = w.snapshot();
+		QVERIFY(!w.world.restoreState(state));
+		QVERIFY(sameSnapshot(w.snapshot(), current));
+	}
+
+	void differentNumberOfObjects()
+	{
+		TestWorld w;
+
+		w.step(5);
+		const QByteArray state = w.world.saveState();
+
+		// The state has one object less than the world
+		wMatrix mtr = wMatrix::identity();
+		mtr.w_pos = wVector(0.0, 3.0, 5.0);
+		w.world.createEntity(TypeToCreate<PhySphere>(), 0.1, "otherSphere", mtr)->setMass(0.3);
+
+		w.step(5);
+		const Snapshot current = w.snapshot();
+		QVERIFY(!w.world.restoreState(state));
+		QVERIFY(sameSnapshot(w.snapshot(), current));
+	}
+};
+
+QTEST_MAIN(WorldState_Test)
+#include "worldstate_test.moc"